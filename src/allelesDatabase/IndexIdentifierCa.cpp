@@ -1,61 +1,71 @@
 #include "IndexIdentifierCa.hpp"
 #include "../apiDb/db.hpp"
+#include "../apiDb/RecordCodec.hpp"
 #include "../commonTools/bytesLevel.hpp"
 #include <boost/lexical_cast.hpp>
+#include <algorithm>
 
 	enum caRecordType : uint8_t
 	{
 		genomicVariation = 1
 	};
 
-	class CaRecord : public RecordT<uint32_t>
+	struct CaValue
 	{
-	public:
 		caRecordType type = caRecordType::genomicVariation;
 		BinaryGenomicVariantDefinition definition; // must be sorted by position
-		CaRecord(uint32_t caId) : RecordT<uint32_t>(caId), definition(0) { }
-		virtual unsigned dataLength() const;
-		virtual void saveData(uint8_t *& ptr) const;
-		virtual void loadData(uint8_t const *& ptr);
-		virtual ~CaRecord() {}
+		CaValue() : definition(0) { }
 	};
 
-	unsigned CaRecord::dataLength() const
-	{
-		return (1 + 4 + definition.dataLength());
-	}
-
-	void CaRecord::saveData(uint8_t *& ptr) const
+	// codec for readValues()/writeValues() (see RecordCodec.hpp)
+	struct CaCodec
 	{
-//		std::cout << "BEGIN-CA" << std::endl;
-		writeUnsignedInteger<1>(ptr, static_cast<unsigned>(type));
-		writeUnsignedInteger<4>(ptr, definition.firstPosition());
-		definition.saveData(ptr);
-//		std::cout << "END-CA" << std::endl;
-	}
+		typedef uint32_t Key;
+		typedef CaValue Value;
+		static unsigned dataLength(Value const & v)
+		{
+			return (1 + 4 + v.definition.dataLength());
+		}
+		static void saveData(Value const & v, uint8_t *& ptr)
+		{
+			writeUnsignedInteger<1>(ptr, static_cast<unsigned>(v.type));
+			writeUnsignedInteger<4>(ptr, v.definition.firstPosition());
+			v.definition.saveData(ptr);
+		}
+		static void loadData(Key, uint8_t const *& ptr, Value & v)
+		{
+			v.type = static_cast<caRecordType>(readUnsignedInteger<1,unsigned>(ptr));
+			v.definition.loadData(readUnsignedInteger<4,unsigned>(ptr), ptr);
+		}
+	};
 
-	void CaRecord::loadData(uint8_t const *& ptr)
+	class CaRecord : public RecordT<uint32_t>, public CaValue
 	{
-		type = static_cast<caRecordType>(readUnsignedInteger<1,unsigned>(ptr));
-		definition = BinaryGenomicVariantDefinition( readUnsignedInteger<4,unsigned>(ptr) );
-		definition.loadData(ptr);
-	}
+	public:
+		CaRecord(uint32_t caId) : RecordT<uint32_t>(caId) { }
+		virtual unsigned dataLength() const { return CaCodec::dataLength(*this); }
+		virtual void saveData(uint8_t *& ptr) const { CaCodec::saveData(*this, ptr); }
+		virtual void loadData(uint8_t const *& ptr) { CaCodec::loadData(key, ptr, *this); }
+		virtual ~CaRecord() {}
+	};
 
 
 	struct IndexIdentifierCa::Pim
 	{
 		std::string const dirPath;
 		DatabaseT<> db;
-		Pim(std::string const & pDirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB)
+		Pim(std::string const & pDirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB, DatabaseOptions const & options)
 		: dirPath(pDirPath)
-		, db(cpuTaskManager, ioTaskManager, dirPath + "idCa", createRecord<CaRecord>, cacheInMB)
+		, db(cpuTaskManager, ioTaskManager, dirPath + "idCa", createRecord<CaRecord>, cacheInMB, options)
 		{}
 	};
 
-	IndexIdentifierCa::IndexIdentifierCa(std::string dirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB) : pim(nullptr)
+	IndexIdentifierCa::IndexIdentifierCa(std::string dirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB, DatabaseOptions const & options) : pim(nullptr)
 	{
 		if ( (! dirPath.empty()) && dirPath.back() != '/') dirPath += "/";
-		pim = new Pim(dirPath, cpuTaskManager, ioTaskManager, cacheInMB);
+		DatabaseOptions indexOptions = options;
+		indexOptions.keysFilterBitsPerKey = 10;  // filters with 10 bits per key for lookups of absent ids
+		pim = new Pim(dirPath, cpuTaskManager, ioTaskManager, cacheInMB, indexOptions);
 		std::cout << "index CA:\trecordsCount=" << pim->db.getRecordsCount() << "\ttheLargestKey=" << pim->db.getTheLargestKey() << "\n";
 	}
 
@@ -64,37 +74,43 @@
 		delete pim;
 	}
 
-	std::vector<RecordGenomicVariant*> IndexIdentifierCa::fetchDefinitions( std::vector<uint32_t> const & caIds) const
+	void IndexIdentifierCa::flushPendingChanges() const
 	{
-		std::vector<RecordT<uint32_t>*> records;
-		records.reserve(caIds.size());
-		for (auto id: caIds) {
-			records.push_back( new CaRecord(id) );
-		}
+		pim->db.flushPendingChanges();
+	}
 
-		auto visitor = [](std::vector<RecordT<uint32_t> const *> const & dbRecords, std::vector<RecordT<uint32_t> *> const & records)
+	std::vector<RecordGenomicVariant*> IndexIdentifierCa::fetchDefinitions( std::vector<uint32_t> const & caIds) const
+	{
+		// identifiers with their positions in the output
+		std::vector<std::pair<uint32_t,unsigned>> idsWithIndexes;
+		idsWithIndexes.reserve(caIds.size());
+		for (unsigned i = 0; i < caIds.size(); ++i) idsWithIndexes.push_back( std::make_pair(caIds[i], i) );
+		std::sort(idsWithIndexes.begin(), idsWithIndexes.end());
+		std::vector<uint32_t> keys;
+		keys.reserve(caIds.size());
+		for (auto const & p: idsWithIndexes) if (keys.empty() || keys.back() != p.first) keys.push_back(p.first);
+
+		std::vector<RecordGenomicVariant*> outRecords(caIds.size(), nullptr);
+
+		auto visitor = [&idsWithIndexes,&outRecords](uint32_t key, std::vector<CaValue> const & dbValues)
 		{
-			if (records.empty()) throw std::logic_error("No records in visitor'c callback!");
-			if (dbRecords.empty()) return;
-			if (dbRecords.size() > 1) throw std::logic_error("More than one record with the same CA ID: " + boost::lexical_cast<std::string>(records.front()->key));
-			CaRecord const * dbRecord = dynamic_cast<CaRecord const *>( dbRecords.front() );
-			for (auto r: records) {
-				CaRecord * rec = dynamic_cast<CaRecord*>(r);
-				rec->type = dbRecord->type;
-				rec->definition = dbRecord->definition;
+			if (dbValues.empty()) return;
+			if (dbValues.size() > 1) throw std::logic_error("More than one record with the same CA ID: " + boost::lexical_cast<std::string>(key));
+			CaValue const & dbValue = dbValues.front();
+			if ( dbValue.definition.raw().size() == 1 && dbValue.definition.firstPosition() == 0 ) return;  // TODO - null or something
+			auto it = std::lower_bound(idsWithIndexes.begin(), idsWithIndexes.end(), std::make_pair(key, 0u));
+			for ( ;  it != idsWithIndexes.end() && it->first == key;  ++it ) {
+				RecordGenomicVariant * r = new RecordGenomicVariant(dbValue.definition);
+				r->identifiers.lastId() = key;
+				outRecords[it->second] = r;
 			}
 		};
 
-		pim->db.readRecords(records, visitor);
-
-		std::vector<RecordGenomicVariant*> outRecords(records.size(), nullptr);
-		for (unsigned i = 0; i < records.size(); ++i) {
-			CaRecord * rec = dynamic_cast<CaRecord*>(records[i]);
-			if ( rec->definition.raw().size() > 1 || rec->definition.firstPosition() > 0 ) {  // TODO - null or something
-				outRecords[i] = new RecordGenomicVariant(rec->definition);
-				outRecords[i]->identifiers.lastId() = rec->key;
-			}
-			delete rec;
+		try {
+			readValues<CaCodec>(pim->db, keys, visitor);
+		} catch (...) {
+			for (auto r: outRecords) delete r;
+			throw;
 		}
 
 		return outRecords;
@@ -102,25 +118,28 @@
 
 	void IndexIdentifierCa::addIdentifiers(std::vector<RecordGenomicVariant const *> const & varRecords)
 	{
-		std::vector<RecordT<uint32_t>*> records;
+		std::vector<std::pair<uint32_t,RecordGenomicVariant const *>> records;
 		records.reserve(varRecords.size());
-		for (auto r: varRecords) {
-			CaRecord *cr = new CaRecord(r->identifiers.lastId());
-			cr->type = caRecordType::genomicVariation;
-			cr->definition = r->definition;
-			records.push_back( cr );
-		}
+		for (auto r: varRecords) records.push_back( std::make_pair(r->identifiers.lastId(), r) );
+		std::stable_sort( records.begin(), records.end(), [](std::pair<uint32_t,RecordGenomicVariant const *> const & r1, std::pair<uint32_t,RecordGenomicVariant const *> const & r2)->bool{ return (r1.first < r2.first); } );
+		std::vector<uint32_t> keys;
+		keys.reserve(records.size());
+		for (auto const & r: records) if (keys.empty() || keys.back() != r.first) keys.push_back(r.first);
 
-		auto visitor = [](std::vector<RecordT<uint32_t>*> & dbRecords, std::vector<RecordT<uint32_t> *> const & records) -> bool
+		auto visitor = [&records](uint32_t key, std::vector<CaValue> & dbValues) -> bool
 		{
-			if (records.empty()) throw std::logic_error("No records in visitor'c callback!");
-			if (! dbRecords.empty()) throw std::logic_error("CA ID already exists: " + boost::lexical_cast<std::string>(records.front()->key));
-			if (records.size() > 1) throw std::logic_error("More than one record with the same CA ID: " + boost::lexical_cast<std::string>(records.front()->key));
-			dbRecords.push_back( records[0] );
+			auto it = std::lower_bound( records.begin(), records.end(), key, [](std::pair<uint32_t,RecordGenomicVariant const *> const & r, uint32_t k)->bool{ return (r.first < k); } );
+			if (it == records.end() || it->first != key) throw std::logic_error("No records in visitor'c callback!");
+			if (! dbValues.empty()) throw std::logic_error("CA ID already exists: " + boost::lexical_cast<std::string>(key));
+			if (it+1 != records.end() && (it+1)->first == key) throw std::logic_error("More than one record with the same CA ID: " + boost::lexical_cast<std::string>(key));
+			CaValue value;
+			value.type = caRecordType::genomicVariation;
+			value.definition = it->second->definition;
+			dbValues.push_back(value);
 			return true;
 		};
 
-		pim->db.writeRecords(records, visitor);
+		writeValues<CaCodec>(pim->db, keys, visitor);
 	}
 
 	uint32_t IndexIdentifierCa::getMaxIdentifier() const
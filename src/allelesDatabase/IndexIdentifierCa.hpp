@@ -3,13 +3,14 @@
 
 #include "RecordVariant.hpp"
 #include "../apiDb/TasksManager.hpp"
+#include "../apiDb/db.hpp"
 
 	class IndexIdentifierCa {
 	private:
 		struct Pim;
 		Pim * pim;
 	public:
-		IndexIdentifierCa(std::string dirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB);
+		IndexIdentifierCa(std::string dirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB, DatabaseOptions const & options = DatabaseOptions());
 		std::vector<RecordGenomicVariant*> fetchDefinitions( std::vector<uint32_t> const &) const;
 		void addIdentifiers(std::vector<RecordGenomicVariant const *> const & records);
 		uint32_t getMaxIdentifier() const;
@@ -18,6 +19,8 @@
 		bool isNewDb() const;
 		// destructor
 		~IndexIdentifierCa();
+		// returns when all changes are committed (see DatabaseT::flushPendingChanges())
+		void flushPendingChanges() const;
 	};
 
 
@@ -46,16 +46,18 @@
 	{
 		std::string const dirPath;
 		DatabaseT<> db;
-		Pim(std::string const & pDirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB)
+		Pim(std::string const & pDirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB, DatabaseOptions const & options)
 		: dirPath(pDirPath)
-		, db(cpuTaskManager, ioTaskManager, dirPath + "idPa", createRecord<PaRecord>, cacheInMB)
+		, db(cpuTaskManager, ioTaskManager, dirPath + "idPa", createRecord<PaRecord>, cacheInMB, options)
 		{}
 	};
 
-	IndexIdentifierPa::IndexIdentifierPa(std::string dirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB) : pim(nullptr)
+	IndexIdentifierPa::IndexIdentifierPa(std::string dirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB, DatabaseOptions const & options) : pim(nullptr)
 	{
 		if ( (! dirPath.empty()) && dirPath.back() != '/') dirPath += "/";
-		pim = new Pim(dirPath, cpuTaskManager, ioTaskManager, cacheInMB);
+		DatabaseOptions indexOptions = options;
+		indexOptions.keysFilterBitsPerKey = 10;  // filters with 10 bits per key for lookups of absent ids
+		pim = new Pim(dirPath, cpuTaskManager, ioTaskManager, cacheInMB, indexOptions);
 		std::cout << "index PA:\trecordsCount=" << pim->db.getRecordsCount() << "\ttheLargestKey=" << pim->db.getTheLargestKey() << "\n";
 	}
 
@@ -64,6 +66,11 @@
 		delete pim;
 	}
 
+	void IndexIdentifierPa::flushPendingChanges() const
+	{
+		pim->db.flushPendingChanges();
+	}
+
 	std::vector<RecordProteinVariant*> IndexIdentifierPa::fetchDefinitions( std::vector<uint32_t> const & paIds) const
 	{
 		std::vector<RecordT<uint32_t>*> records;
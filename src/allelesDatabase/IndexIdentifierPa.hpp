@@ -3,13 +3,14 @@
 
 #include "RecordVariant.hpp"
 #include "../apiDb/TasksManager.hpp"
+#include "../apiDb/db.hpp"
 
 	class IndexIdentifierPa {
 	private:
 		struct Pim;
 		Pim * pim;
 	public:
-		IndexIdentifierPa(std::string dirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB);
+		IndexIdentifierPa(std::string dirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB, DatabaseOptions const & options = DatabaseOptions());
 		std::vector<RecordProteinVariant*> fetchDefinitions( std::vector<uint32_t> const &) const;
 		void addIdentifiers(std::vector<RecordProteinVariant const *> const & records);
 		uint32_t getMaxIdentifier() const;
@@ -18,6 +19,8 @@
 		bool isNewDb() const;
 		// destructor
 		~IndexIdentifierPa();
+		// returns when all changes are committed (see DatabaseT::flushPendingChanges())
+		void flushPendingChanges() const;
 	};
 
 
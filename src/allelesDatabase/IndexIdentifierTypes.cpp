@@ -0,0 +1,244 @@
+#include "IndexIdentifierTypes.hpp"
+#include "../apiDb/db.hpp"
+#include "../apiDb/RecordCodec.hpp"
+#include "../commonTools/bytesLevel.hpp"
+#include <algorithm>
+#include <cstring>
+
+	// each container covers 2^containerBits blocks, the key of the record is (idType, isProtein, number of container)
+	static unsigned const containerBits = 12;
+	static unsigned const blocksPerContainer = (1u << containerBits);
+	// containers with more blocks are saved as bitmaps (bitmap has the same size as an array of 256 offsets)
+	static unsigned const maxArraySize = blocksPerContainer / 16;
+	// ranges separated by less keys than this are merged
+	static uint64_t const minGapBetweenRanges = 4096;
+
+	static inline uint64_t containerKey(identifierType idType, bool isProtein, uint64_t container)
+	{
+		return ( (uint64_t(idType) << 56) | (uint64_t(isProtein) << 55) | container );
+	}
+
+	// sorted offsets of marked blocks in the container
+	struct BlocksValue
+	{
+		std::vector<uint16_t> offsets;
+	};
+
+	// codec for readValues()/writeValues() (see RecordCodec.hpp)
+	struct BlocksCodec
+	{
+		typedef uint64_t Key;
+		typedef BlocksValue Value;
+		static unsigned dataLength(Value const & v)
+		{
+			return ( 2 + ((v.offsets.size() > maxArraySize) ? (blocksPerContainer / 8) : (2 * v.offsets.size())) );
+		}
+		static void saveData(Value const & v, uint8_t *& ptr)
+		{
+			writeUnsignedInteger<2>(ptr, v.offsets.size());
+			if (v.offsets.size() > maxArraySize) {
+				std::memset(ptr, 0, blocksPerContainer / 8);
+				for (auto o: v.offsets) ptr[o / 8] |= (1u << (o % 8));
+				ptr += blocksPerContainer / 8;
+			} else {
+				for (auto o: v.offsets) writeUnsignedInteger<2>(ptr, o);
+			}
+		}
+		static void loadData(Key, uint8_t const *& ptr, Value & v)
+		{
+			unsigned const count = readUnsignedInteger<2,unsigned>(ptr);
+			v.offsets.clear();
+			v.offsets.reserve(count);
+			if (count > maxArraySize) {
+				for (unsigned i = 0; i < blocksPerContainer / 8; ++i) {
+					for (unsigned b = ptr[i]; b != 0; b &= (b - 1)) v.offsets.push_back( i * 8 + __builtin_ctz(b) );
+				}
+				ptr += blocksPerContainer / 8;
+				if (v.offsets.size() != count) throw std::logic_error("Incorrect number of bits in the bitmap of blocks");
+			} else {
+				for (unsigned i = 0; i < count; ++i) v.offsets.push_back( readUnsignedInteger<2,uint16_t>(ptr) );
+			}
+		}
+	};
+
+	class BlocksRecord : public RecordT<uint64_t>, public BlocksValue
+	{
+	public:
+		BlocksRecord(uint64_t key) : RecordT<uint64_t>(key) { }
+		virtual unsigned dataLength() const { return BlocksCodec::dataLength(*this); }
+		virtual void saveData(uint8_t *& ptr) const { BlocksCodec::saveData(*this, ptr); }
+		virtual void loadData(uint8_t const *& ptr) { BlocksCodec::loadData(key, ptr, *this); }
+		virtual ~BlocksRecord() {}
+	};
+
+
+	struct IndexIdentifierTypes::Pim
+	{
+		std::string const dirPath;
+		DatabaseT<uint64_t,8> db;
+		Pim(std::string const & pDirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB, DatabaseOptions const & options)
+		: dirPath(pDirPath)
+		, db(cpuTaskManager, ioTaskManager, dirPath + "idTypes", createRecord<BlocksRecord>, cacheInMB, options)
+		{}
+		// saves given pairs (key of container, offset of block)
+		void addBlocks(std::vector<std::pair<uint64_t,uint16_t>> & blocks)
+		{
+			std::sort(blocks.begin(), blocks.end());
+			blocks.erase( std::unique(blocks.begin(), blocks.end()), blocks.end() );
+			std::vector<uint64_t> keys;
+			for (auto const & b: blocks) if (keys.empty() || keys.back() != b.first) keys.push_back(b.first);
+			auto visitor = [&blocks](uint64_t key, std::vector<BlocksValue> & values) -> bool
+			{
+				auto it = std::lower_bound(blocks.begin(), blocks.end(), std::make_pair(key, uint16_t(0)));
+				if (values.empty()) values.resize(1);
+				std::vector<uint16_t> & offsets = values.front().offsets;
+				unsigned const oldSize = offsets.size();
+				for ( ;  it != blocks.end() && it->first == key;  ++it ) {
+					if ( ! std::binary_search(offsets.begin(), offsets.begin() + oldSize, it->second) ) offsets.push_back(it->second);
+				}
+				if (offsets.size() == oldSize) return false;
+				std::inplace_merge(offsets.begin(), offsets.begin() + oldSize, offsets.end());
+				return true;
+			};
+			writeValues<BlocksCodec>(db, keys, visitor);
+		}
+		// returns ranges of keys of the table for given types, see IndexIdentifierTypes::genomicKeysRanges()
+		std::vector<std::pair<uint64_t,uint64_t>> keysRanges(std::vector<identifierType> const & idTypes, bool isProtein) const
+		{
+			std::vector<std::pair<uint64_t,uint64_t>> ranges;
+			for (auto idType: idTypes) {
+				auto visitor = [&ranges](std::vector<RecordViewT<uint64_t>> const & views, bool &)
+				{
+					BlocksValue v;
+					for (auto const & view: views) {
+						uint8_t const * ptr = view.data;
+						BlocksCodec::loadData(view.key, ptr, v);
+						uint64_t const firstBlock = (view.key & ((1ull << 55) - 1)) << containerBits;
+						for (auto o: v.offsets) {
+							uint64_t const block = firstBlock + o;
+							ranges.push_back( std::make_pair(block << blockBits, ((block + 1) << blockBits) - 1) );
+						}
+					}
+				};
+				db.readRawRecordsInOrder(visitor, containerKey(idType, isProtein, 0), containerKey(idType, isProtein, (1ull << 55) - 1));
+			}
+			// ranges of different types may overlap
+			std::sort(ranges.begin(), ranges.end());
+			std::vector<std::pair<uint64_t,uint64_t>> merged;
+			for (auto const & r: ranges) {
+				if ( (! merged.empty()) && r.first <= merged.back().second + minGapBetweenRanges ) {
+					merged.back().second = std::max(merged.back().second, r.second);
+				} else {
+					merged.push_back(r);
+				}
+			}
+			return merged;
+		}
+	};
+
+
+	IndexIdentifierTypes::IndexIdentifierTypes(std::string dirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB, DatabaseOptions const & options)
+	{
+		if ( (! dirPath.empty()) && dirPath.back() != '/') dirPath += "/";
+		pim = new Pim(dirPath, cpuTaskManager, ioTaskManager, cacheInMB, options);
+		std::cout << "index idTypes:\trecordsCount=" << pim->db.getRecordsCount() << "\ttheLargestKey=" << pim->db.getTheLargestKey() << "\n";
+	}
+
+	IndexIdentifierTypes::~IndexIdentifierTypes()
+	{
+		delete pim;
+	}
+
+	void IndexIdentifierTypes::flushPendingChanges() const
+	{
+		pim->db.flushPendingChanges();
+	}
+
+
+	// returns (container key, block offset) pairs for types of identifiers from the list
+	static void blocksOfVariant( BinaryIdentifiers const & identifiers, uint64_t tableKey, bool isProtein
+							   , std::set<identifierType> const & idTypes, std::vector<std::pair<uint64_t,uint16_t>> & blocks )
+	{
+		static std::set<identifierType> const allTypes = IndexIdentifierTypes::indexedTypes();
+		uint64_t const block = (tableKey >> IndexIdentifierTypes::blockBits);
+		uint64_t const container = (block >> containerBits);
+		uint16_t const offset = (block & (blocksPerContainer - 1));
+		identifierType lastType = identifierType::CA;
+		auto add = [&](identifierType t)
+		{
+			if (t == lastType) return;
+			lastType = t;
+			if ( ! allTypes.count(t) ) return;
+			if ( (! idTypes.empty()) && ! idTypes.count(t) ) return;
+			blocks.push_back( std::make_pair(containerKey(t, isProtein, container), offset) );
+		};
+		for (auto const & id: identifiers.rawShort()) add(id.fIdType);
+		for (auto const & id: identifiers.rawHgvs()) add(id.idType);
+	}
+
+
+	void IndexIdentifierTypes::addVariants(std::vector<RecordGenomicVariant const *> const & records, std::set<identifierType> const & idTypes)
+	{
+		std::vector<std::pair<uint64_t,uint16_t>> blocks;
+		for (auto r: records) blocksOfVariant(r->identifiers, r->key, false, idTypes, blocks);
+		if ( ! blocks.empty() ) pim->addBlocks(blocks);
+	}
+
+
+	void IndexIdentifierTypes::addVariants(std::vector<RecordProteinVariant const *> const & records, std::set<identifierType> const & idTypes)
+	{
+		std::vector<std::pair<uint64_t,uint16_t>> blocks;
+		for (auto r: records) blocksOfVariant(r->identifiers, r->key, true, idTypes, blocks);
+		if ( ! blocks.empty() ) pim->addBlocks(blocks);
+	}
+
+
+	void IndexIdentifierTypes::clear(std::set<identifierType> const & idTypes)
+	{
+		std::vector<uint64_t> keys;
+		auto visitor = [&keys](std::vector<RecordViewT<uint64_t>> const & views, bool &)
+		{
+			for (auto const & v: views) if (keys.empty() || keys.back() != v.key) keys.push_back(v.key);
+		};
+		for (auto idType: idTypes) {
+			pim->db.readRawRecordsInOrder(visitor, containerKey(idType, false, 0), containerKey(idType, true, (1ull << 55) - 1));
+		}
+		if (keys.empty()) return;
+		auto eraser = [](uint64_t, std::vector<RecordViewT<uint64_t>> & views, RecordT<uint64_t>::tAllocateRawRecordFunction) -> bool
+		{
+			if (views.empty()) return false;
+			views.clear();
+			return true;
+		};
+		pim->db.writeRawRecords(keys, eraser);
+	}
+
+
+	std::vector<std::pair<uint32_t,uint32_t>> IndexIdentifierTypes::genomicKeysRanges(std::vector<identifierType> const & idTypes) const
+	{
+		std::vector<std::pair<uint64_t,uint64_t>> const ranges = pim->keysRanges(idTypes, false);
+		std::vector<std::pair<uint32_t,uint32_t>> out;
+		out.reserve(ranges.size());
+		for (auto const & r: ranges) out.push_back( std::make_pair(static_cast<uint32_t>(r.first), static_cast<uint32_t>(r.second)) );
+		return out;
+	}
+
+
+	std::vector<std::pair<uint64_t,uint64_t>> IndexIdentifierTypes::proteinKeysRanges(std::vector<identifierType> const & idTypes) const
+	{
+		return pim->keysRanges(idTypes, true);
+	}
+
+
+	bool IndexIdentifierTypes::isNewDb() const
+	{
+		return pim->db.isNewDb();
+	}
+
+
+	std::set<identifierType> IndexIdentifierTypes::indexedTypes()
+	{
+		return { identifierType::dbSNP, identifierType::ClinVarAllele, identifierType::ClinVarVariant, identifierType::MyVariantInfo_hg19
+			   , identifierType::MyVariantInfo_hg38, identifierType::ExAC, identifierType::gnomAD, identifierType::ClinVarRCV
+			   , identifierType::AllelicEpigenome, identifierType::COSMIC, identifierType::externalSource };
+	}
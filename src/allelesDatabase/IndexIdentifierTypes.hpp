@@ -0,0 +1,37 @@
+#ifndef INDEXIDENTIFIERTYPES_HPP_
+#define INDEXIDENTIFIERTYPES_HPP_
+
+#include "RecordVariant.hpp"
+#include <set>
+
+	// bitmap index of identifier types: for each type it stores blocks of keys of the genomic/protein table (2^blockBits
+	// consecutive keys) with at least one variant having identifier of this type; bitmaps are divided into containers
+	// (roaring-style) saved as records of the database, sparse containers are saved as arrays of offsets
+	// bits are only added, so blocks may be marked after deletion of identifiers (queries must filter records anyway)
+	class IndexIdentifierTypes {
+	private:
+		struct Pim;
+		Pim * pim;
+	public:
+		static unsigned const blockBits = 6;
+		IndexIdentifierTypes(std::string dirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB, DatabaseOptions const & options = DatabaseOptions());
+		~IndexIdentifierTypes();
+		// returns when all changes are committed (see DatabaseT::flushPendingChanges())
+		void flushPendingChanges() const;
+		// marks blocks of given variants for types of their identifiers (only types from the set are taken if it is not empty)
+		void addVariants(std::vector<RecordGenomicVariant const *> const &, std::set<identifierType> const & idTypes = std::set<identifierType>());
+		void addVariants(std::vector<RecordProteinVariant const *> const &, std::set<identifierType> const & idTypes = std::set<identifierType>());
+		// removes bitmaps of given types
+		void clear(std::set<identifierType> const & idTypes);
+		// returns sorted and disjoint ranges of keys of blocks marked for at least one of given types,
+		// close ranges are merged (it is cheaper to read a few more records than to start a new scan)
+		std::vector<std::pair<uint32_t,uint32_t>> genomicKeysRanges(std::vector<identifierType> const & idTypes) const;
+		std::vector<std::pair<uint64_t,uint64_t>> proteinKeysRanges(std::vector<identifierType> const & idTypes) const;
+		// return true if the index was created in this run
+		bool isNewDb() const;
+		// identifier types saved in the index
+		static std::set<identifierType> indexedTypes();
+	};
+
+
+#endif /* INDEXIDENTIFIERTYPES_HPP_ */
@@ -1,19 +1,16 @@
 #include "IndexIdentifierUInt32.hpp"
 #include "RecordVariant.hpp"
+#include "../apiDb/RecordCodec.hpp"
 #include "../commonTools/bytesLevel.hpp"
+#include <algorithm>
 
-	class IdRecord : public RecordT<uint32_t>
+	struct IdValue
 	{
-	public:
 		BinaryGenomicVariantDefinition defGenomic;
 		BinaryProteinVariantDefinition defProtein;
 		bool isGenomic;
-		IdRecord(uint32_t id) : RecordT<uint32_t>(id), defGenomic(0), defProtein(0), isGenomic(true) { }
-		virtual unsigned dataLength() const;
-		virtual void saveData(uint8_t *& ptr) const;
-		virtual void loadData(uint8_t const *& ptr);
-		virtual ~IdRecord() {}
-		inline bool operator==(IdRecord const & o) const
+		IdValue() : defGenomic(0), defProtein(0), isGenomic(true) { }
+		inline bool operator==(IdValue const & o) const
 		{
 			if (isGenomic != o.isGenomic) return false;
 			if (isGenomic) return (defGenomic == o.defGenomic);
@@ -21,66 +18,69 @@
 		}
 	};
 
-	unsigned IdRecord::dataLength() const
+	// codec for readValues()/writeValues() (see RecordCodec.hpp)
+	struct IdCodec
 	{
-		if (isGenomic) {
-			return ( 1 + 4 + defGenomic.dataLength() );
-		} else {
-			return ( 1 + 8 + defProtein.dataLength() );
+		typedef uint32_t Key;
+		typedef IdValue Value;
+		static unsigned dataLength(Value const & v)
+		{
+			if (v.isGenomic) {
+				return ( 1 + 4 + v.defGenomic.dataLength() );
+			} else {
+				return ( 1 + 8 + v.defProtein.dataLength() );
+			}
 		}
-	}
-
-	void IdRecord::saveData(uint8_t *& ptr) const
-	{
-		if (isGenomic) {
-			writeUnsignedInteger<1>(ptr, 1);
-			writeUnsignedInteger<4>(ptr, defGenomic.firstPosition());
-			defGenomic.saveData(ptr);
-		} else {
-			writeUnsignedInteger<1>(ptr, 0);
-			writeUnsignedInteger<8>(ptr, defProtein.proteinAccIdAndFirstPosition());
-			defProtein.saveData(ptr);
+		static void saveData(Value const & v, uint8_t *& ptr)
+		{
+			if (v.isGenomic) {
+				writeUnsignedInteger<1>(ptr, 1);
+				writeUnsignedInteger<4>(ptr, v.defGenomic.firstPosition());
+				v.defGenomic.saveData(ptr);
+			} else {
+				writeUnsignedInteger<1>(ptr, 0);
+				writeUnsignedInteger<8>(ptr, v.defProtein.proteinAccIdAndFirstPosition());
+				v.defProtein.saveData(ptr);
+			}
 		}
-	}
-
-	void IdRecord::loadData(uint8_t const *& ptr)
-	{
-		isGenomic = ( readUnsignedInteger<1,unsigned>(ptr) == 1 );
-		if (isGenomic) {
-			defGenomic = BinaryGenomicVariantDefinition(readUnsignedInteger<4,uint32_t>(ptr));
-			defGenomic.loadData(ptr);
-		} else {
-			defProtein = BinaryProteinVariantDefinition(readUnsignedInteger<8,uint64_t>(ptr));
-			defProtein.loadData(ptr);
+		static void loadData(Key, uint8_t const *& ptr, Value & v)
+		{
+			v.isGenomic = ( readUnsignedInteger<1,unsigned>(ptr) == 1 );
+			if (v.isGenomic) {
+				v.defGenomic.loadData(readUnsignedInteger<4,uint32_t>(ptr), ptr);
+			} else {
+				v.defProtein.loadData(readUnsignedInteger<8,uint64_t>(ptr), ptr);
+			}
 		}
-	}
+	};
 
-	class RecordWithDefinitions : public RecordT<uint32_t>
+	class IdRecord : public RecordT<uint32_t>, public IdValue
 	{
 	public:
-		std::vector<BinaryGenomicVariantDefinition> defsGenomic;
-		std::vector<BinaryProteinVariantDefinition> defsProtein;
-		RecordWithDefinitions(uint32_t id) : RecordT<uint32_t>(id) { }
-		virtual unsigned dataLength() const { return 0; }
-		virtual void saveData(uint8_t *& ptr) const {}
-		virtual void loadData(uint8_t const *& ptr) {}
+		IdRecord(uint32_t id) : RecordT<uint32_t>(id) { }
+		virtual unsigned dataLength() const { return IdCodec::dataLength(*this); }
+		virtual void saveData(uint8_t *& ptr) const { IdCodec::saveData(*this, ptr); }
+		virtual void loadData(uint8_t const *& ptr) { IdCodec::loadData(key, ptr, *this); }
+		virtual ~IdRecord() {}
 	};
 
 	struct IndexIdentifierUInt32::Pim
 	{
 		std::string const dirPath;
 		DatabaseT<> db;
-		Pim(std::string const & pDirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, std::string const & name, unsigned cacheInMB)
+		Pim(std::string const & pDirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, std::string const & name, unsigned cacheInMB, DatabaseOptions const & options)
 		: dirPath(pDirPath)
-		, db(cpuTaskManager, ioTaskManager, dirPath + "id" + name, createRecord<IdRecord>, cacheInMB)
+		, db(cpuTaskManager, ioTaskManager, dirPath + "id" + name, createRecord<IdRecord>, cacheInMB, options)
 		{}
 	};
 
 
-	IndexIdentifierUInt32::IndexIdentifierUInt32(std::string dirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, std::string const & name, unsigned cacheInMB)
+	IndexIdentifierUInt32::IndexIdentifierUInt32(std::string dirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, std::string const & name, unsigned cacheInMB, DatabaseOptions const & options)
 	{
 		if ( (! dirPath.empty()) && dirPath.back() != '/') dirPath += "/";
-		pim = new Pim(dirPath, cpuTaskManager, ioTaskManager, name, cacheInMB);
+		DatabaseOptions indexOptions = options;
+		indexOptions.keysFilterBitsPerKey = 10;  // filters with 10 bits per key for lookups of absent ids
+		pim = new Pim(dirPath, cpuTaskManager, ioTaskManager, name, cacheInMB, indexOptions);
 		std::cout << "index " << name << ":\trecordsCount=" << pim->db.getRecordsCount() << "\ttheLargestKey=" << pim->db.getTheLargestKey() << "\n";
 	}
 
@@ -89,47 +89,36 @@
 		delete pim;
 	}
 
+	void IndexIdentifierUInt32::flushPendingChanges() const
+	{
+		pim->db.flushPendingChanges();
+	}
+
 
 	std::vector<std::vector<RecordVariantPtr>> IndexIdentifierUInt32::queryDefinitions(std::vector<uint32_t> const & ids) const
 	{
-		std::vector<RecordT<uint32_t>*> records;
-		records.reserve(ids.size());
-		for (auto id: ids) {
-			records.push_back( new RecordWithDefinitions(id) );
-		}
+		// identifiers with their positions in the output
+		std::vector<std::pair<uint32_t,unsigned>> idsWithIndexes;
+		idsWithIndexes.reserve(ids.size());
+		for (unsigned i = 0; i < ids.size(); ++i) idsWithIndexes.push_back( std::make_pair(ids[i], i) );
+		std::sort(idsWithIndexes.begin(), idsWithIndexes.end());
+		std::vector<uint32_t> keys;
+		keys.reserve(ids.size());
+		for (auto const & p: idsWithIndexes) if (keys.empty() || keys.back() != p.first) keys.push_back(p.first);
+
+		std::vector<std::vector<RecordVariantPtr>> output(ids.size());
 
-		auto visitor = [](std::vector<RecordT<uint32_t> const *> const & dbRecords, std::vector<RecordT<uint32_t> *> const & records)
+		auto visitor = [&idsWithIndexes,&output](uint32_t key, std::vector<IdValue> const & dbValues)
 		{
-			if (records.empty()) throw std::logic_error("No records in visitor's callback!");
-			if (dbRecords.empty()) return;
-			RecordWithDefinitions * rec = dynamic_cast<RecordWithDefinitions*>(records.front());
-			for (auto r2: dbRecords) {
-				IdRecord const * dbRecord = dynamic_cast<IdRecord const *>( r2 );
-				if (dbRecord->isGenomic) {
-					rec->defsGenomic.push_back( dbRecord->defGenomic );
-				} else {
-					rec->defsProtein.push_back( dbRecord->defProtein );
-				}
-			}
-			for (unsigned i = 1; i < records.size(); ++i) {
-				(dynamic_cast<RecordWithDefinitions*>(records[i]))->defsGenomic = rec->defsGenomic;
-				(dynamic_cast<RecordWithDefinitions*>(records[i]))->defsProtein = rec->defsProtein;
+			auto it = std::lower_bound(idsWithIndexes.begin(), idsWithIndexes.end(), std::make_pair(key, 0u));
+			for ( ;  it != idsWithIndexes.end() && it->first == key;  ++it ) {
+				std::vector<RecordVariantPtr> & out = output[it->second];
+				for (auto const & v: dbValues) if (v.isGenomic) out.push_back( new RecordGenomicVariant(v.defGenomic) );
+				for (auto const & v: dbValues) if (! v.isGenomic) out.push_back( new RecordProteinVariant(v.defProtein) );
 			}
 		};
 
-		pim->db.readRecords(records, visitor);
-
-		std::vector<std::vector<RecordVariantPtr>> output(ids.size());
-		for (unsigned i = 0; i < output.size(); ++i) {
-			RecordWithDefinitions * r = dynamic_cast<RecordWithDefinitions*>(records[i]);
-			for (BinaryGenomicVariantDefinition const & vd: r->defsGenomic) {
-				output[i].push_back( new RecordGenomicVariant(vd) );
-			}
-			for (BinaryProteinVariantDefinition const & vd: r->defsProtein) {
-				output[i].push_back( new RecordProteinVariant(vd) );
-			}
-			delete r;
-		}
+		readValues<IdCodec>(pim->db, keys, visitor);
 
 		return output;
 	}
@@ -137,43 +126,35 @@
 
 	void IndexIdentifierUInt32::addIdentifiers(std::vector<std::pair<uint32_t,RecordVariantPtr>> const & identifiersToAdd)
 	{
-		std::vector<RecordT<uint32_t>*> records;
-		records.reserve(identifiersToAdd.size());
-		for (auto id2rec: identifiersToAdd) {
-			IdRecord * r = new IdRecord(id2rec.first);
-			if (id2rec.second.isRecordGenomicVariantPtr()) {
-				r->isGenomic = true;
-				r->defGenomic = id2rec.second.asRecordGenomicVariantPtr()->definition;
-			} else {
-				r->isGenomic = false;
-				r->defProtein = id2rec.second.asRecordProteinVariantPtr()->definition;
-			}
-			records.push_back( r );
-		}
+		std::vector<std::pair<uint32_t,RecordVariantPtr>> records(identifiersToAdd);
+		std::stable_sort( records.begin(), records.end(), [](std::pair<uint32_t,RecordVariantPtr> const & r1, std::pair<uint32_t,RecordVariantPtr> const & r2)->bool{ return (r1.first < r2.first); } );
+		std::vector<uint32_t> keys;
+		keys.reserve(records.size());
+		for (auto const & r: records) if (keys.empty() || keys.back() != r.first) keys.push_back(r.first);
 
-		auto visitor = [](std::vector<RecordT<uint32_t>*> & dbRecords, std::vector<RecordT<uint32_t> *> const & records) -> bool
+		auto visitor = [&records](uint32_t key, std::vector<IdValue> & dbValues) -> bool
 		{
-			if (records.empty()) throw std::logic_error("No records in visitor's callback!");
+			auto it = std::lower_bound( records.begin(), records.end(), key, [](std::pair<uint32_t,RecordVariantPtr> const & r, uint32_t k)->bool{ return (r.first < k); } );
+			if (it == records.end() || it->first != key) throw std::logic_error("No records in visitor's callback!");
 			bool changes = false;
-			for (auto r: records) {
-				IdRecord * newRecord = dynamic_cast<IdRecord*>(r);
-				for (auto r2: dbRecords) {
-					IdRecord * dbRecord = dynamic_cast<IdRecord*>(r2);
-					if (*newRecord == *dbRecord) {
-						delete newRecord;
-						newRecord = nullptr;
-						break;
-					}
+			for ( ;  it != records.end() && it->first == key;  ++it ) {
+				IdValue newValue;
+				if (it->second.isRecordGenomicVariantPtr()) {
+					newValue.isGenomic = true;
+					newValue.defGenomic = it->second.asRecordGenomicVariantPtr()->definition;
+				} else {
+					newValue.isGenomic = false;
+					newValue.defProtein = it->second.asRecordProteinVariantPtr()->definition;
 				}
-				if (newRecord != nullptr) {
-					dbRecords.push_back(newRecord);
+				if (std::find(dbValues.begin(), dbValues.end(), newValue) == dbValues.end()) {
+					dbValues.push_back(newValue);
 					changes = true;
 				}
 			}
 			return changes;
 		};
 
-		pim->db.writeRecords(records, visitor);
+		writeValues<IdCodec>(pim->db, keys, visitor);
 	}
 
 
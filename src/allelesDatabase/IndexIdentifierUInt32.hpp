@@ -9,8 +9,10 @@
 		struct Pim;
 		Pim * pim;
 	public:
-		IndexIdentifierUInt32(std::string dirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, std::string const & name, unsigned cacheInMB);
+		IndexIdentifierUInt32(std::string dirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, std::string const & name, unsigned cacheInMB, DatabaseOptions const & options = DatabaseOptions());
 		~IndexIdentifierUInt32();
+		// returns when all changes are committed (see DatabaseT::flushPendingChanges())
+		void flushPendingChanges() const;
 		std::vector<std::vector<RecordVariantPtr>> queryDefinitions(std::vector<uint32_t> const &) const;
 		void addIdentifiers   (std::vector<std::pair<uint32_t,RecordVariantPtr>> const &);
 		void deleteIdentifiers(std::vector<std::pair<uint32_t,RecordVariantPtr>> const &);
@@ -153,6 +153,71 @@
 		}
 	}
 
+	// decodes simple variant saved as a single byte
+	static inline void loadShortVariant(uint8_t const byte, BinaryNucleotideSequenceModification & sr)
+	{
+		if ( ! checkBits<1>(byte) ) {
+			sr.category = variantCategory::nonShiftable;
+			sr.lengthBefore = 0;
+			sr.lengthChangeOrSeqLength = 3;
+			sr.sequence = getValue<2,6>(byte);
+			return;
+		}
+		if ( ! checkBits<2>(byte) ) {
+			sr.category = variantCategory::nonShiftable;
+			sr.lengthBefore = getValue<3,1>(byte);
+			sr.lengthChangeOrSeqLength = 2;
+			sr.sequence = getValue<4,4>(byte);
+			return;
+		}
+		if ( ! checkBits<3>(byte) ) {
+			if ( ! checkBits<4>(byte) ) {
+				sr.category = variantCategory::nonShiftable;
+				sr.lengthBefore = getValue<5,1>(byte);
+				sr.lengthChangeOrSeqLength = 1;
+				sr.sequence = getValue<6,2>(byte);
+				return;
+			}
+			if ( ! checkBits<5>(byte) ) {
+				sr.category = variantCategory::nonShiftable;
+				sr.lengthBefore = getValue<6,2>(byte) + 1;
+				sr.lengthChangeOrSeqLength = 0;
+				return;
+			}
+			sr.category = variantCategory::shiftableDeletion;
+			sr.lengthChangeOrSeqLength = getValue<6,2>(byte) + 1;
+			sr.lengthBefore = sr.lengthChangeOrSeqLength + 1;
+			return;
+		}
+		if ( ! checkBits<4>(byte) ) {
+			sr.category = variantCategory::duplication;
+			sr.lengthChangeOrSeqLength = getValue<5,1>(byte) + 1;
+			sr.lengthBefore = getValue<6,2>(byte) + sr.lengthChangeOrSeqLength;
+			return;
+		}
+		sr.category = variantCategory::shiftableInsertion;
+		sr.lengthBefore = getValue<5,1>(byte) + 1;
+		sr.lengthChangeOrSeqLength = 1;
+		sr.sequence = getValue<6,2>(byte);
+	}
+
+	// decodes simple variant saved in standard format (without position), returns true if there is a next simple variant
+	static inline bool loadStandardVariant(uint8_t const *& ptr, BinaryNucleotideSequenceModification & vr2)
+	{
+		// --- definition
+		uint32_t const def = readUnsignedInteger<4,uint32_t>(ptr);
+		vr2.category = static_cast<variantCategory>(getValue<2,2>(def));
+		vr2.lengthBefore = getValue<4,14>(def);
+		vr2.lengthChangeOrSeqLength = getValue<18,14>(def);
+		if (vr2.category == variantCategory::shiftableDeletion) vr2.lengthBefore += vr2.lengthChangeOrSeqLength;
+		// --- sequence
+		if (vr2.category == variantCategory::nonShiftable || vr2.category == variantCategory::shiftableInsertion) {
+			unsigned const seqLength = std::min( (vr2.lengthChangeOrSeqLength + 3) / 4,  4 );
+			vr2.sequence = readUnsignedInteger<uint32_t>(ptr, seqLength);
+		}
+		return checkBits<1>(def);
+	}
+
 	// vr exists and is empty (just constructed)
 	// definition has at least one element (with position)
 	void BinaryGenomicVariantDefinition::loadData(uint8_t const *& ptr)
@@ -162,52 +227,8 @@
 		std::vector<BinaryNucleotideSequenceModification> & definition = this->simpleVariants;
 		// ================================ short variants
 		if ( ! checkBits<0>(*ptr) ) {
-			uint8_t const byte = *ptr;
-			BinaryNucleotideSequenceModification & sr = definition.front();
+			loadShortVariant(*ptr, definition.front());
 			++ptr;
-			if ( ! checkBits<1>(byte) ) {
-				sr.category = variantCategory::nonShiftable;
-				sr.lengthBefore = 0;
-				sr.lengthChangeOrSeqLength = 3;
-				sr.sequence = getValue<2,6>(byte);
-				return;
-			}
-			if ( ! checkBits<2>(byte) ) {
-				sr.category = variantCategory::nonShiftable;
-				sr.lengthBefore = getValue<3,1>(byte);
-				sr.lengthChangeOrSeqLength = 2;
-				sr.sequence = getValue<4,4>(byte);
-				return;
-			}
-			if ( ! checkBits<3>(byte) ) {
-				if ( ! checkBits<4>(byte) ) {
-					sr.category = variantCategory::nonShiftable;
-					sr.lengthBefore = getValue<5,1>(byte);
-					sr.lengthChangeOrSeqLength = 1;
-					sr.sequence = getValue<6,2>(byte);
-					return;
-				}
-				if ( ! checkBits<5>(byte) ) {
-					sr.category = variantCategory::nonShiftable;
-					sr.lengthBefore = getValue<6,2>(byte) + 1;
-					sr.lengthChangeOrSeqLength = 0;
-					return;
-				}
-				sr.category = variantCategory::shiftableDeletion;
-				sr.lengthChangeOrSeqLength = getValue<6,2>(byte) + 1;
-				sr.lengthBefore = sr.lengthChangeOrSeqLength + 1;
-				return;
-			}
-			if ( ! checkBits<4>(byte) ) {
-				sr.category = variantCategory::duplication;
-				sr.lengthChangeOrSeqLength = getValue<5,1>(byte) + 1;
-				sr.lengthBefore = getValue<6,2>(byte) + sr.lengthChangeOrSeqLength;
-				return;
-			}
-			sr.category = variantCategory::shiftableInsertion;
-			sr.lengthBefore = getValue<5,1>(byte) + 1;
-			sr.lengthChangeOrSeqLength = 1;
-			sr.sequence = getValue<6,2>(byte);
 			return;
 		}
 		// =================================== standard variants
@@ -215,23 +236,53 @@
 			BinaryNucleotideSequenceModification & vr2 = definition.back();
 			// --- position
 			if (definition.size() > 1) vr2.position = readUnsignedInteger<4,uint32_t>(ptr);
-			// --- definition
-			uint32_t const def = readUnsignedInteger<4,uint32_t>(ptr);
-			hasNextDef = checkBits<1>(def);
-			vr2.category = static_cast<variantCategory>(getValue<2,2>(def));
-			vr2.lengthBefore = getValue<4,14>(def);
-			vr2.lengthChangeOrSeqLength = getValue<18,14>(def);
-			if (vr2.category == variantCategory::shiftableDeletion) vr2.lengthBefore += vr2.lengthChangeOrSeqLength;
-			// --- sequence
-			if (vr2.category == variantCategory::nonShiftable || vr2.category == variantCategory::shiftableInsertion) {
-				unsigned const seqLength = std::min( (vr2.lengthChangeOrSeqLength + 3) / 4,  4 );
-				vr2.sequence = readUnsignedInteger<uint32_t>(ptr, seqLength);
-			}
+			hasNextDef = loadStandardVariant(ptr, vr2);
 			// --- next part
 			if (hasNextDef) definition.resize( definition.size()+1 );
 		}
 	}
 
+	void BinaryGenomicVariantDefinition::loadData(uint32_t firstPosition, uint8_t const *& ptr)
+	{
+		this->simpleVariants.resize(1);
+		this->simpleVariants[0] = BinaryNucleotideSequenceModification();
+		this->simpleVariants[0].position = firstPosition;
+		loadData(ptr);
+	}
+
+	BinaryNucleotideSequenceModification BinaryGenomicVariantDefinition::loadFirstSimpleVariant(uint32_t firstPosition, uint8_t const * ptr)
+	{
+		BinaryNucleotideSequenceModification sr;
+		sr.position = firstPosition;
+		if ( ! checkBits<0>(*ptr) ) {
+			loadShortVariant(*ptr, sr);
+		} else {
+			loadStandardVariant(ptr, sr);
+		}
+		return sr;
+	}
+
+
+	// mixes next value to the hash (the final step of MurmurHash3 is applied to each value)
+	static inline uint64_t hashCombine(uint64_t hash, uint64_t value)
+	{
+		value ^= (value >> 33);
+		value *= 0xff51afd7ed558ccdull;
+		value ^= (value >> 33);
+		value *= 0xc4ceb9fe1a85ec53ull;
+		value ^= (value >> 33);
+		return ( (hash ^ value) * 0x9e3779b97f4a7c15ull + (hash >> 29) );
+	}
+
+	uint64_t BinaryGenomicVariantDefinition::fingerprint() const
+	{
+		uint64_t hash = simpleVariants.size();
+		for (auto const & sv: simpleVariants) {
+			hash = hashCombine(hash, (uint64_t(sv.position) << 32) | (uint64_t(sv.lengthBefore) << 16) | sv.lengthChangeOrSeqLength);
+			hash = hashCombine(hash, (uint64_t(sv.category) << 32) | sv.sequence);
+		}
+		return hash;
+	}
 
 	std::string BinaryGenomicVariantDefinition::toString() const
 	{
@@ -250,32 +301,38 @@
 	}
 
 
-	unsigned RecordGenomicVariant::dataLength() const
+	unsigned GenomicVariantCodec::dataLength(Value const & value)
 	{
-		unsigned length = this->definition.dataLength();
-//for (auto & c:complexDefinition) std::cout << static_cast<unsigned>(c.category) << " " << c.lengthChangeOrSeqLength << std::endl;
-//std::cout << "lenght 1=" << length << std::endl;
+		unsigned length = value.definition.dataLength();
 		// revision
-		length += lengthUnsignedIntVarSize<2,1>(revision);
-//std::cout << "lenght 2=" << length << std::endl;
+		length += lengthUnsignedIntVarSize<2,1>(value.revision);
 		// identifiers
-		length += identifiers.dataLength();
-//std::cout << "lenght 3=" << length << std::endl;
+		length += value.identifiers.dataLength();
 		return length;
 	}
 
+	void GenomicVariantCodec::saveData(Value const & value, uint8_t *& ptr)
+	{
+		value.definition.saveData(ptr);
+		writeUnsignedIntVarSize<2,1>(ptr,value.revision);
+		value.identifiers.saveData(ptr);
+	}
+
+	void GenomicVariantCodec::loadData(Key key, uint8_t const *& ptr, Value & value)
+	{
+		value.definition.loadData(key, ptr);
+		value.revision = readUnsignedIntVarSize<2,1,uint32_t>(ptr);
+		value.identifiers.loadData(ptr);
+	}
+
+	unsigned RecordGenomicVariant::dataLength() const
+	{
+		return GenomicVariantCodec::dataLength(*this);
+	}
+
 	void RecordGenomicVariant::saveData(uint8_t *& ptr) const
 	{
-//uint8_t * const p = ptr;
-//		std::cout << "BEGIN - RecordGenomicVariant" << std::endl;
-		this->definition.saveData(ptr);
-//std::cout << definition.toString() << "\n";
-//std::cout << "Written 1=" << (ptr-p) << "\n";
-		writeUnsignedIntVarSize<2,1>(ptr,revision);
-//std::cout << "Written 2=" << (ptr-p) << "\n";
-		identifiers.saveData(ptr);
-//std::cout << "Written 3=" << (ptr-p) << "\n";
-//		std::cout << "END - RecordGenomicVariant" << std::endl;
+		GenomicVariantCodec::saveData(*this, ptr);
 	}
 
 	void RecordGenomicVariant::loadData(uint8_t const *& ptr)
@@ -498,6 +555,26 @@
 	}
 
 
+	void BinaryProteinVariantDefinition::loadData(uint64_t proteinAccIdAndFirstPosition, uint8_t const *& ptr)
+	{
+		this->fProteinAccessionIdentifier = (proteinAccIdAndFirstPosition >> 16);
+		this->simpleVariants.resize(1);
+		this->simpleVariants[0] = BinaryAminoAcidSequenceModification();
+		this->simpleVariants[0].position = proteinAccIdAndFirstPosition % (256 * 256);
+		loadData(ptr);
+	}
+
+
+	uint64_t BinaryProteinVariantDefinition::fingerprint() const
+	{
+		uint64_t hash = hashCombine(simpleVariants.size(), fProteinAccessionIdentifier);
+		for (auto const & sv: simpleVariants) {
+			hash = hashCombine(hash, (uint64_t(sv.position) << 32) | (uint64_t(sv.lengthBefore) << 16) | sv.lengthChangeOrSeqLength);
+			hash = hashCombine(hash, (uint64_t(sv.category) << 32) | sv.sequence);
+		}
+		return hash;
+	}
+
 	std::string BinaryProteinVariantDefinition::toString() const
 	{
 		std::string s = "[" + boost::lexical_cast<std::string>(fProteinAccessionIdentifier) + ",";
@@ -515,32 +592,38 @@
 	}
 
 
-	unsigned RecordProteinVariant::dataLength() const
+	unsigned ProteinVariantCodec::dataLength(Value const & value)
 	{
-		unsigned length = this->definition.dataLength();
-//for (auto & c:complexDefinition) std::cout << static_cast<unsigned>(c.category) << " " << c.lengthChangeOrSeqLength << std::endl;
-//std::cout << "lenght 1=" << length << std::endl;
+		unsigned length = value.definition.dataLength();
 		// revision
-		length += lengthUnsignedIntVarSize<2,1>(revision);
-//std::cout << "lenght 2=" << length << std::endl;
+		length += lengthUnsignedIntVarSize<2,1>(value.revision);
 		// identifiers
-		length += identifiers.dataLength();
-//std::cout << "lenght 3=" << length << std::endl;
+		length += value.identifiers.dataLength();
 		return length;
 	}
 
+	void ProteinVariantCodec::saveData(Value const & value, uint8_t *& ptr)
+	{
+		value.definition.saveData(ptr);
+		writeUnsignedIntVarSize<2,1>(ptr,value.revision);
+		value.identifiers.saveData(ptr);
+	}
+
+	void ProteinVariantCodec::loadData(Key key, uint8_t const *& ptr, Value & value)
+	{
+		value.definition.loadData(key, ptr);
+		value.revision = readUnsignedIntVarSize<2,1,uint32_t>(ptr);
+		value.identifiers.loadData(ptr);
+	}
+
+	unsigned RecordProteinVariant::dataLength() const
+	{
+		return ProteinVariantCodec::dataLength(*this);
+	}
+
 	void RecordProteinVariant::saveData(uint8_t *& ptr) const
 	{
-//std::cout << "BEGIN - RecordProteinVariant" << std::endl;
-//uint8_t * const p = ptr;
-		this->definition.saveData(ptr);
-//for (auto & c:complexDefinition) std::cout << static_cast<unsigned>(c.category) << " " << c.lengthChangeOrSeqLength << std::endl;
-//std::cout << "Written 1=" << (ptr-p) << std::endl;
-		writeUnsignedIntVarSize<2,1>(ptr,revision);
-//std::cout << "Written 2=" << (ptr-p) << std::endl;
-		identifiers.saveData(ptr);
-//std::cout << "Written 3=" << (ptr-p) << std::endl;
-//std::cout << "END - RecordProteinVariant" << std::endl;
+		ProteinVariantCodec::saveData(*this, ptr);
 	}
 
 	void RecordProteinVariant::loadData(uint8_t const *& ptr)
@@ -632,7 +715,7 @@
 			if (*iType < iId2->idType) {
 				++iType;
 			} else if (*iType > iId2->idType) {
-				++iId1;
+				++iId2;
 			} else {
 				return true;
 			}
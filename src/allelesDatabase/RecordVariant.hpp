@@ -4,6 +4,7 @@
 #include "../apiDb/db.hpp"
 #include "../core/variants.hpp"
 #include <map>
+#include <unordered_map>
 
 	struct BinaryNucleotideSequenceModification
 	{
@@ -38,8 +39,14 @@
 		unsigned dataLength() const;
 		void saveData(uint8_t *& ptr) const;
 		void loadData(uint8_t const *& ptr);
+		// the same as above but the definition is overwritten (the first position is set), buffers of the object are reused
+		void loadData(uint32_t firstPosition, uint8_t const *& ptr);
+		// decodes only the first simple variant from data saved by saveData(), the rest of data is not touched
+		static BinaryNucleotideSequenceModification loadFirstSimpleVariant(uint32_t firstPosition, uint8_t const * ptr);
 		// toString
 		std::string toString() const;
+		// 64-bit hash of all simple variants, equal definitions have equal fingerprints
+		uint64_t fingerprint() const;
 		// less
 		inline bool operator<(BinaryGenomicVariantDefinition const & v) const
 		{
@@ -101,15 +108,32 @@
 	RELATIONAL_OPERATORS(BinaryIdentifiers);
 
 
-	class RecordGenomicVariant : public RecordT<uint32_t>
+	// fields of genomic variant saved in the database, the key is the first position of the definition
+	struct GenomicVariantValue
 	{
-	public:
 		BinaryGenomicVariantDefinition definition;
 		//CanonicalId caId;
 		BinaryIdentifiers identifiers;
 		uint32_t revision = 0;
-		explicit RecordGenomicVariant(uint32_t pKey) : RecordT<uint32_t>(pKey), definition(pKey), identifiers(identifierType::CA) {}
-		explicit RecordGenomicVariant(BinaryGenomicVariantDefinition const & def) : RecordT<uint32_t>(def.firstPosition()), definition(def), identifiers(identifierType::CA) {}
+		GenomicVariantValue() : definition(0), identifiers(identifierType::CA) {}
+		explicit GenomicVariantValue(BinaryGenomicVariantDefinition const & def) : definition(def), identifiers(identifierType::CA) {}
+	};
+
+	// codec for readValues()/writeValues() (see RecordCodec.hpp)
+	struct GenomicVariantCodec
+	{
+		typedef uint32_t Key;
+		typedef GenomicVariantValue Value;
+		static unsigned dataLength(Value const &);
+		static void saveData(Value const &, uint8_t *& ptr);
+		static void loadData(Key, uint8_t const *& ptr, Value &);
+	};
+
+	class RecordGenomicVariant : public RecordT<uint32_t>, public GenomicVariantValue
+	{
+	public:
+		explicit RecordGenomicVariant(uint32_t pKey) : RecordT<uint32_t>(pKey), GenomicVariantValue(BinaryGenomicVariantDefinition(pKey)) {}
+		explicit RecordGenomicVariant(BinaryGenomicVariantDefinition const & def) : RecordT<uint32_t>(def.firstPosition()), GenomicVariantValue(def) {}
 		virtual unsigned dataLength() const;
 		virtual void saveData(uint8_t *& ptr) const;
 		virtual void loadData(uint8_t const *& ptr);
@@ -154,8 +178,12 @@
 		unsigned dataLength() const;
 		void saveData(uint8_t *& ptr) const;
 		void loadData(uint8_t const *& ptr);
+		// the same as above but the definition is overwritten (the accession and the first position are set)
+		void loadData(uint64_t proteinAccIdAndFirstPosition, uint8_t const *& ptr);
 		// toString
 		std::string toString() const;
+		// 64-bit hash of the accession and all simple variants, equal definitions have equal fingerprints
+		uint64_t fingerprint() const;
 		// less
 		inline bool operator<(BinaryProteinVariantDefinition const & v) const
 		{
@@ -168,14 +196,73 @@
 	RELATIONAL_OPERATORS(BinaryProteinVariantDefinition);
 
 
-	class RecordProteinVariant : public RecordT<uint64_t>
+	// set of definitions (given by indices) searched by fingerprints, it is used to match variants with the same key
+	// in linear time (there are hundreds of variants per key in some regions), definitions are compared only when
+	// fingerprints are equal; small sets are scanned, larger ones are kept in the hash table
+	template<typename tDefinition>
+	class DefinitionsIndex
 	{
+	private:
+		static unsigned const maxScannedSize = 16;
+		std::pair<uint64_t,unsigned> fScanned[maxScannedSize];  // no allocations for small sets
+		unsigned fScannedSize = 0;
+		std::unordered_multimap<uint64_t,unsigned> fHashed;
 	public:
+		// returns index of the added definition equal to given one or -1, getDefinition(index) must return added definitions
+		template<typename tGetDefinition>
+		int find(tDefinition const & def, uint64_t fingerprint, tGetDefinition getDefinition) const
+		{
+			if (fHashed.empty()) {
+				for (unsigned i = 0; i < fScannedSize; ++i) {
+					if (fScanned[i].first == fingerprint && getDefinition(fScanned[i].second) == def) return fScanned[i].second;
+				}
+			} else {
+				auto const range = fHashed.equal_range(fingerprint);
+				for (auto it = range.first; it != range.second; ++it) if (getDefinition(it->second) == def) return it->second;
+			}
+			return -1;
+		}
+		void add(uint64_t fingerprint, unsigned index)
+		{
+			if (fHashed.empty() && fScannedSize < maxScannedSize) {
+				fScanned[fScannedSize++] = std::make_pair(fingerprint, index);
+				return;
+			}
+			if (fHashed.empty()) {
+				fHashed.reserve(4 * maxScannedSize);
+				fHashed.insert(fScanned, fScanned + fScannedSize);
+				fScannedSize = 0;
+			}
+			fHashed.insert( std::make_pair(fingerprint, index) );
+		}
+	};
+
+
+	// fields of protein variant saved in the database, the key is made from the accession and the first position
+	struct ProteinVariantValue
+	{
 		BinaryProteinVariantDefinition definition;
 		BinaryIdentifiers identifiers;
 		uint32_t revision = 0;
-		explicit RecordProteinVariant(uint64_t pKey) : RecordT<uint64_t>(pKey), definition(pKey), identifiers(identifierType::PA) {}
-		explicit RecordProteinVariant(BinaryProteinVariantDefinition const & def) : RecordT<uint64_t>(def.proteinAccIdAndFirstPosition()), definition(def), identifiers(identifierType::PA) {}
+		ProteinVariantValue() : definition(0), identifiers(identifierType::PA) {}
+		explicit ProteinVariantValue(BinaryProteinVariantDefinition const & def) : definition(def), identifiers(identifierType::PA) {}
+	};
+
+	// codec for readValues()/writeValues() (see RecordCodec.hpp)
+	struct ProteinVariantCodec
+	{
+		typedef uint64_t Key;
+		typedef ProteinVariantValue Value;
+		static unsigned dataLength(Value const &);
+		static void saveData(Value const &, uint8_t *& ptr);
+		static void loadData(Key, uint8_t const *& ptr, Value &);
+	};
+
+	class RecordProteinVariant : public RecordT<uint64_t>, public ProteinVariantValue
+	{
+	public:
+		explicit RecordProteinVariant(uint64_t pKey) : RecordT<uint64_t>(pKey), ProteinVariantValue(BinaryProteinVariantDefinition(pKey)) {}
+		explicit RecordProteinVariant(BinaryProteinVariantDefinition const & def) : RecordT<uint64_t>(def.proteinAccIdAndFirstPosition()), ProteinVariantValue(def) {}
 		virtual unsigned dataLength() const;
 		virtual void saveData(uint8_t *& ptr) const;
 		virtual void loadData(uint8_t const *& ptr);
@@ -0,0 +1,197 @@
+#include "StagesExecutor.hpp"
+#include "../commonTools/assert.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+	enum class stageState : uint8_t
+	{
+		  waiting
+		, running
+		, completed
+		, failed      // the stage or one of its dependencies threw an exception
+	};
+
+	// threads shared by all executors, a new thread is created only when all threads are busy, so threads are reused by
+	// consecutive runs; threads are detached and wait for stages until the end of the process (the object is never deleted)
+	class StagesThreads
+	{
+	private:
+		std::mutex access;
+		std::condition_variable newStage;
+		std::deque<std::function<void()>> queue;
+		unsigned idleThreadsCount = 0;
+		void work()
+		{
+			std::unique_lock<std::mutex> synch(access);
+			while (true) {
+				++idleThreadsCount;
+				newStage.wait(synch, [this]()->bool { return ! queue.empty(); });
+				--idleThreadsCount;
+				std::function<void()> stage = queue.front();
+				queue.pop_front();
+				synch.unlock();
+				stage();
+				stage = nullptr;
+				synch.lock();
+			}
+		}
+	public:
+		// runs given function in one of the threads, throws std::system_error if a new thread is needed and cannot be created
+		void run(std::function<void()> const & stage)
+		{
+			std::lock_guard<std::mutex> synch(access);
+			queue.push_back(stage);
+			if (idleThreadsCount >= queue.size()) {
+				newStage.notify_one();
+				return;
+			}
+			try {
+				std::thread(&StagesThreads::work, this).detach();
+			} catch (...) {
+				queue.pop_back();
+				throw;
+			}
+		}
+		static StagesThreads & instance()
+		{
+			static StagesThreads * threads = new StagesThreads;
+			return *threads;
+		}
+	};
+
+
+	struct StagesExecutor::Pim
+	{
+		struct Stage
+		{
+			std::string name;
+			std::function<void()> task;
+			std::vector<unsigned> dependencies;
+			stageState state = stageState::waiting;
+			StageTime time;
+		};
+		std::vector<Stage> stages;
+		std::mutex access;
+		std::condition_variable stageFinished;
+		std::exception_ptr firstException;
+	};
+
+
+	StagesExecutor::StagesExecutor() : pim(new Pim)
+	{}
+
+	StagesExecutor::~StagesExecutor()
+	{
+		delete pim;
+	}
+
+
+	unsigned StagesExecutor::addStage(std::string const & name, std::function<void()> stage, std::vector<unsigned> const & dependencies)
+	{
+		unsigned const id = pim->stages.size();
+		for (auto d: dependencies) ASSERT(d < id);
+		Pim::Stage s;
+		s.name = name;
+		s.task = stage;
+		s.dependencies = dependencies;
+		s.time.name = name;
+		pim->stages.push_back(s);
+		return id;
+	}
+
+
+	void StagesExecutor::run()
+	{
+		typedef std::chrono::steady_clock clock;
+		clock::time_point const start = clock::now();
+		auto msFromStart = [start]()->unsigned{ return std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start).count(); };
+
+		for (auto & s: pim->stages) {
+			s.state = stageState::waiting;
+			s.time.startMs = s.time.durationMs = 0;
+		}
+		pim->firstException = nullptr;
+
+		std::unique_lock<std::mutex> synch(pim->access);
+		while (true) {
+			// start stages with completed dependencies, mark stages with failed dependencies
+			bool changes = true;
+			unsigned unfinishedCount = 0;
+			while (changes) {
+				changes = false;
+				unfinishedCount = 0;
+				for (unsigned i = 0; i < pim->stages.size(); ++i) {
+					Pim::Stage & s = pim->stages[i];
+					if (s.state == stageState::running) ++unfinishedCount;
+					if (s.state != stageState::waiting) continue;
+					bool ready = true;
+					bool failed = false;
+					for (auto d: s.dependencies) {
+						if (pim->stages[d].state == stageState::failed) failed = true;
+						if (pim->stages[d].state != stageState::completed) ready = false;
+					}
+					if (failed) {
+						s.state = stageState::failed;
+						changes = true;
+					} else if (ready) {
+						s.state = stageState::running;
+						s.time.startMs = msFromStart();
+						++unfinishedCount;
+						auto runStage = [this,i,&msFromStart]()
+						{
+							Pim::Stage & s = pim->stages[i];
+							std::exception_ptr exception;
+							try {
+								s.task();
+							} catch (...) {
+								exception = std::current_exception();
+							}
+							std::lock_guard<std::mutex> synch(pim->access);
+							s.time.durationMs = msFromStart() - s.time.startMs;
+							s.state = (exception) ? stageState::failed : stageState::completed;
+							if (exception && ! pim->firstException) pim->firstException = exception;
+							pim->stageFinished.notify_one();
+						};
+						try {
+							StagesThreads::instance().run(runStage);
+						} catch (...) {
+							// the thread cannot be created, stages already started are waited for below
+							s.state = stageState::failed;
+							if ( ! pim->firstException ) pim->firstException = std::current_exception();
+							changes = true;
+						}
+					} else {
+						++unfinishedCount;
+					}
+				}
+			}
+			if (unfinishedCount == 0) break;
+			pim->stageFinished.wait(synch);
+		}
+		synch.unlock();
+
+		if (pim->firstException) std::rethrow_exception(pim->firstException);
+	}
+
+
+	std::vector<StagesExecutor::StageTime> StagesExecutor::timings() const
+	{
+		std::vector<StageTime> r;
+		for (auto const & s: pim->stages) r.push_back(s.time);
+		return r;
+	}
+
+
+	std::string StagesExecutor::timingsToString() const
+	{
+		std::string r;
+		for (auto const & s: pim->stages) {
+			if ( ! r.empty() ) r += " ";
+			r += s.name + "=" + std::to_string(s.time.startMs) + "+" + std::to_string(s.time.durationMs);
+		}
+		return r;
+	}
@@ -0,0 +1,38 @@
+#ifndef STAGESEXECUTOR_HPP_
+#define STAGESEXECUTOR_HPP_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+	// runs a set of stages with dependencies between them, each stage is started in a separate thread as soon as all stages
+	// it depends on are completed, so independent stages (e.g. updates of different tables) run concurrently
+	// stages may block on operations of databases (they are not run by TasksManager, which executes these operations)
+	// threads are taken from a pool shared by all executors, new threads are created only when all threads in the pool are busy
+	class StagesExecutor {
+	private:
+		struct Pim;
+		Pim * pim;
+	public:
+		struct StageTime {
+			std::string name;
+			unsigned startMs;     // from the beginning of run()
+			unsigned durationMs;  // 0 if the stage was not run
+		};
+		StagesExecutor();
+		~StagesExecutor();
+		StagesExecutor(StagesExecutor const &) = delete;
+		StagesExecutor & operator=(StagesExecutor const &) = delete;
+		// adds new stage, dependencies are ids of stages added before, returns id of the stage
+		unsigned addStage(std::string const & name, std::function<void()> stage, std::vector<unsigned> const & dependencies = std::vector<unsigned>());
+		// runs all stages and returns when all of them are finished; if a stage throws an exception, stages depending on it
+		// are not run and the first exception is rethrown at the end (also if a thread for a stage cannot be created)
+		void run();
+		// times of stages from the last run(), in order of adding
+		std::vector<StageTime> timings() const;
+		// timings as text "name=startMs+durationMs ..."
+		std::string timingsToString() const;
+	};
+
+
+#endif /* STAGESEXECUTOR_HPP_ */
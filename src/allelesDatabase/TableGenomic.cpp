@@ -3,6 +3,7 @@
 #include <mutex>
 
 #include "../apiDb/db.hpp"
+#include "../apiDb/RecordCodec.hpp"
 
 
 	// ================================================ TABLE
@@ -12,16 +13,16 @@
 		std::string const dirPath;
 		std::atomic<uint32_t> & nextFreeCaId;
 		DatabaseT<> db;
-		Pim(std::string const & pDirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB, std::atomic<uint32_t> & pNextFreeCaId)
+		Pim(std::string const & pDirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB, std::atomic<uint32_t> & pNextFreeCaId, DatabaseOptions const & options)
 		: dirPath(pDirPath), nextFreeCaId(pNextFreeCaId)
-		, db(cpuTaskManager, ioTaskManager, dirPath + "genomic", createRecord<RecordGenomicVariant>, cacheInMB)
+		, db(cpuTaskManager, ioTaskManager, dirPath + "genomic", createRecord<RecordGenomicVariant>, cacheInMB, options)
 		{}
 	};
 
-	TableGenomic::TableGenomic(std::string dirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB, std::atomic<uint32_t> & nextFreeCaId)
+	TableGenomic::TableGenomic(std::string dirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB, std::atomic<uint32_t> & nextFreeCaId, DatabaseOptions const & options)
 	{
 		if ( (! dirPath.empty()) && dirPath.back() != '/') dirPath += "/";
-		pim = new Pim(dirPath, cpuTaskManager, ioTaskManager, cacheInMB, nextFreeCaId);
+		pim = new Pim(dirPath, cpuTaskManager, ioTaskManager, cacheInMB, nextFreeCaId, options);
 		std::cout << "table genomic:\trecordsCount=" << pim->db.getRecordsCount() << "\ttheLargestKey=" << pim->db.getTheLargestKey() << "\n";
 	}
 
@@ -30,52 +31,149 @@
 		delete pim;
 	}
 
+	void TableGenomic::flushPendingChanges() const
+	{
+		pim->db.flushPendingChanges();
+	}
 
-	void TableGenomic::query( tCallbackWithResults callback, unsigned & recordsToSkip, uint32_t first, uint32_t last, unsigned minChunkSize, unsigned hintQuerySize ) const
+
+	// sends records to the callback, records with the largest key are held back until the last call
+	// (the next chunk from the database may contain more records with the same key)
+	static void sendChunkOfResults(TableGenomic::tCallbackWithResults callback, std::vector<RecordGenomicVariant*> & records, bool & lastCall)
+	{
+		std::sort( records.begin(), records.end(), [](RecordGenomicVariant const *r1,RecordGenomicVariant const *r2){ return (r1->definition < r2->definition); } );
+		auto itEnd = records.end();
+		if ( ! lastCall ) {
+			while ( itEnd != records.begin() && (*(itEnd-1))->key == records.back()->key ) --itEnd;
+			if (itEnd == records.begin()) return;
+		}
+		std::vector<RecordGenomicVariant*> chunk(records.begin(), itEnd);
+		records.erase(records.begin(), itEnd);
+		try {
+			callback(chunk,lastCall);
+		} catch (...) {
+			for (auto r: chunk) delete r;
+			throw;
+		}
+		for (auto r: chunk) delete r;
+	}
+
+
+	// reads records with keys from given ranges (sorted and disjoint), chunks from all ranges are sent as from one query
+	static void queryRecords( DatabaseT<> const & db, TableGenomic::tCallbackWithResults callback, BinaryGenomicVariantDefinition const * after
+							, unsigned & recordsToSkip, uint32_t first, std::vector<std::pair<uint32_t,uint32_t>> const & keysRanges
+							, unsigned minChunkSize, unsigned hintQuerySize )
 	{
+		if (keysRanges.empty()) {
+			std::vector<RecordGenomicVariant*> empty;
+			bool lastCall = true;
+			callback(empty, lastCall);
+			return;
+		}
+
 		std::vector<RecordGenomicVariant*> records2;
-		auto visitor = [callback, first, &recordsToSkip, &records2, minChunkSize](std::vector<RecordT<uint32_t> const *> const & records, bool & lastCall)
+		bool terminated = false;
+		// only the first simple variant is decoded to check the position, records are created for matching views only
+		auto visitor = [callback, first, after, &recordsToSkip, &records2, minChunkSize, &terminated](std::vector<RecordViewT<uint32_t>> const & views, bool & lastCall, bool lastRange)
 		{
-			for (auto r: records) {
-				RecordGenomicVariant const * vr = dynamic_cast<RecordGenomicVariant const *>(r);
-				if (vr->definition.firstPosition() + vr->definition.raw()[0].lengthBefore > first) {
-					if (recordsToSkip) {
-						--recordsToSkip;
-					} else {
-						records2.push_back(new RecordGenomicVariant(*vr));
+			for (auto const & v: views) {
+				BinaryNucleotideSequenceModification const sr = BinaryGenomicVariantDefinition::loadFirstSimpleVariant(v.key, v.data);
+				if (sr.position + sr.lengthBefore <= first) continue;
+				uint8_t const * ptr = v.data;
+				RecordGenomicVariant * r = nullptr;
+				if (after != nullptr && v.key == after->firstPosition()) {
+					// records with the key of the last variant are compared by definitions
+					r = static_cast<RecordGenomicVariant*>(createRecord<RecordGenomicVariant>(v.key, ptr));
+					if ( ! (*after < r->definition) ) {
+						delete r;
+						continue;
 					}
 				}
+				if (recordsToSkip) {
+					--recordsToSkip;
+					delete r;
+					continue;
+				}
+				if (r == nullptr) r = static_cast<RecordGenomicVariant*>(createRecord<RecordGenomicVariant>(v.key, ptr));
+				records2.push_back(r);
 			}
-			if (records2.size() >= minChunkSize || lastCall) {
-				// TODO - problem with order between following vectors
-				std::sort( records2.begin(), records2.end(), [](RecordGenomicVariant const *r1,RecordGenomicVariant const *r2){ return (r1->definition < r2->definition); } );
-				callback(records2,lastCall);
-				for (auto r: records2) delete r;
-				records2.clear();
+			// the end of the range which is not the last one is not the end of the query
+			bool lastChunk = lastCall && lastRange;
+			if (records2.size() >= minChunkSize || lastChunk) {
+				sendChunkOfResults(callback, records2, lastChunk);
+				if (lastChunk) lastCall = terminated = true;
 			}
 		};
 
+		try {
+			for (unsigned i = 0; i < keysRanges.size() && ! terminated; ++i) {
+				bool const lastRange = (i + 1 == keysRanges.size());
+				auto rangeVisitor = [&visitor,lastRange](std::vector<RecordViewT<uint32_t>> const & views, bool & lastCall){ visitor(views, lastCall, lastRange); };
+				db.readRawRecordsInOrder( rangeVisitor, keysRanges[i].first, keysRanges[i].second, hintQuerySize );
+			}
+		} catch (...) {
+			for (auto r: records2) delete r;
+			throw;
+		}
+		// records left after termination of the query by the callback
+		for (auto r: records2) delete r;
+	}
+
+
+	// returns the range of keys of variants overlapping the region starting at first (they may start before it)
+	static std::vector<std::pair<uint32_t,uint32_t>> rangeOfKeys(BinaryGenomicVariantDefinition const * after, uint32_t first, uint32_t last)
+	{
 		uint32_t const margin = 10000;
-		pim->db.readRecordsInOrder( visitor, (first > margin) ? (first-margin) : (0), last, hintQuerySize );
+		uint32_t firstKey = (first > margin) ? (first-margin) : (0);
+		if (after != nullptr) firstKey = std::max(firstKey, after->firstPosition());
+		std::vector<std::pair<uint32_t,uint32_t>> keysRanges;
+		if (firstKey <= last) keysRanges.push_back( std::make_pair(firstKey, last) );
+		return keysRanges;
+	}
+
+
+	void TableGenomic::query( tCallbackWithResults callback, unsigned & recordsToSkip, uint32_t first, uint32_t last, unsigned minChunkSize, unsigned hintQuerySize ) const
+	{
+		queryRecords(pim->db, callback, nullptr, recordsToSkip, first, rangeOfKeys(nullptr, first, last), minChunkSize, hintQuerySize);
+	}
+
+
+	void TableGenomic::query( tCallbackWithResults callback, BinaryGenomicVariantDefinition const & after, unsigned & recordsToSkip
+							, uint32_t first, uint32_t last, unsigned minChunkSize, unsigned hintQuerySize ) const
+	{
+		queryRecords(pim->db, callback, &after, recordsToSkip, first, rangeOfKeys(&after, first, last), minChunkSize, hintQuerySize);
+	}
+
+
+	void TableGenomic::query( tCallbackWithResults callback, std::vector<std::pair<uint32_t,uint32_t>> keysRanges, BinaryGenomicVariantDefinition const * after
+							, unsigned & recordsToSkip, unsigned minChunkSize, unsigned hintQuerySize ) const
+	{
+		if (after != nullptr) {
+			// ranges before the last variant are skipped
+			uint32_t const firstKey = after->firstPosition();
+			auto it = std::find_if( keysRanges.begin(), keysRanges.end(), [firstKey](std::pair<uint32_t,uint32_t> const & r){ return (r.second >= firstKey); } );
+			keysRanges.erase(keysRanges.begin(), it);
+			if ( ! keysRanges.empty() ) keysRanges.front().first = std::max(keysRanges.front().first, firstKey);
+		}
+		queryRecords(pim->db, callback, after, recordsToSkip, 0, keysRanges, minChunkSize, hintQuerySize);
 	}
 
 
 	void TableGenomic::fetch(std::vector<RecordGenomicVariant*> const & pRecords) const
 	{
-		std::vector<RecordT<uint32_t>*> records;
-		records.insert( records.end(), pRecords.begin(), pRecords.end() );
+		std::vector<RecordGenomicVariant*> records(pRecords);
+		std::vector<uint32_t> const keys = sortByKeys(records);
 
-		auto readFunction = [](std::vector<RecordT<uint32_t> const *> const & currentRecords, std::vector<RecordT<uint32_t>*> const & newRecords)
+		auto readFunction = [&records](uint32_t key, std::vector<GenomicVariantCodec::Value> const & dbValues)
 		{
 			// ======================= read data from the db records
-			for (auto rBase: newRecords) {
-				RecordGenomicVariant * r = dynamic_cast<RecordGenomicVariant*>(rBase);
-				RecordGenomicVariant const * dbRec = nullptr;
-				for (auto r2Base: currentRecords) {
-					RecordGenomicVariant const * r2 = dynamic_cast<RecordGenomicVariant const *>(r2Base);
-					if (r->key != r2->key) throw std::logic_error("Key mismatch");
-					if (r->definition != r2->definition) continue;
-					dbRec = r2;
+			auto const range = recordsWithKey(records, key);
+			for (auto it = range.first; it != range.second; ++it) {
+				RecordGenomicVariant * r = *it;
+				GenomicVariantCodec::Value const * dbRec = nullptr;
+				for (auto const & v: dbValues) {
+					if (r->definition != v.definition) continue;
+					dbRec = &v;
 					break;
 				}
 				if (dbRec == nullptr) {
@@ -90,7 +188,7 @@
 			}
 		};
 
-		pim->db.readRecords(records, readFunction);
+		readValues<GenomicVariantCodec>(pim->db, keys, readFunction);
 	}
 
 
@@ -99,40 +197,58 @@
 		, std::map<identifierType,std::vector<std::pair<uint32_t,RecordVariantPtr>>> & changesInIndexes
 		)
 	{
-		std::vector<RecordT<uint32_t>*> records;
-		records.insert( records.end(), pRecords.begin(), pRecords.end() );
+		std::vector<RecordGenomicVariant*> records(pRecords);
+		std::vector<uint32_t> const keys = sortByKeys(records);
 
 		std::mutex accessToMapWithChanges;
 
-		auto updateFunction = [&records,&changesInIndexes,&accessToMapWithChanges,this](std::vector<RecordT<uint32_t>*> & currentRecords, std::vector<RecordT<uint32_t>*> const & newRecords)->bool
+		auto updateFunction = [&records,&changesInIndexes,&accessToMapWithChanges,this](uint32_t key, std::vector<GenomicVariantCodec::Value> & dbValues)->bool
 		{
+			auto const range = recordsWithKey(records, key);
+			unsigned const count = range.second - range.first;
+			static thread_local std::vector<uint64_t> fingerprints;
+			fingerprints.resize(count);
+			for (unsigned i = 0; i < count; ++i) fingerprints[i] = range.first[i]->definition.fingerprint();
 			// ======================= search for duplicated records in the input, make sure that duplicated records have the same identifiers
-			for (unsigned i = 0; i < newRecords.size(); ++i) {
-				for (unsigned j = i+1; j < newRecords.size(); ++j) {
-					RecordGenomicVariant * r1 = dynamic_cast<RecordGenomicVariant*>(newRecords[i]);
-					RecordGenomicVariant * r2 = dynamic_cast<RecordGenomicVariant*>(newRecords[j]);
-					if (r1->key != r2->key) throw std::logic_error("Key mismatch");
-					if (r1->definition != r2->definition) continue;
-					r1->identifiers.exchange(r2->identifiers);
+			if (count > 1) {
+				// identifiers of duplicates are collected in the first record, then copied to the others (except the last one,
+				// it is already equal to the first record after exchange())
+				static thread_local std::vector<int> firstDuplicates;
+				static thread_local std::vector<unsigned> lastDuplicates;
+				firstDuplicates.assign(count, -1);
+				lastDuplicates.resize(count);
+				DefinitionsIndex<BinaryGenomicVariantDefinition> inputIndex;
+				auto getInputDefinition = [&range](unsigned i)->BinaryGenomicVariantDefinition const &{ return range.first[i]->definition; };
+				for (unsigned i = 0; i < count; ++i) {
+					RecordGenomicVariant * r = range.first[i];
+					firstDuplicates[i] = inputIndex.find(r->definition, fingerprints[i], getInputDefinition);
+					if (firstDuplicates[i] < 0) {
+						inputIndex.add(fingerprints[i], i);
+						continue;
+					}
+					lastDuplicates[firstDuplicates[i]] = i;
+					RecordGenomicVariant * first = range.first[firstDuplicates[i]];
+					first->identifiers.exchange(r->identifiers);
+				}
+				for (unsigned i = 0; i < count; ++i) {
+					if (firstDuplicates[i] < 0 || lastDuplicates[firstDuplicates[i]] == i) continue;
+					range.first[i]->identifiers.exchange(range.first[firstDuplicates[i]]->identifiers);
 				}
 			}
 
 			// ======================= modifications on the db records
+			DefinitionsIndex<BinaryGenomicVariantDefinition> dbIndex;
+			for (unsigned i = 0; i < dbValues.size(); ++i) dbIndex.add(dbValues[i].definition.fingerprint(), i);
+			auto getDbDefinition = [&dbValues](unsigned i)->BinaryGenomicVariantDefinition const &{ return dbValues[i].definition; };
 			bool changes = false;
-			for (auto rBase: newRecords) {
-				RecordGenomicVariant * r = dynamic_cast<RecordGenomicVariant*>(rBase);
-				RecordGenomicVariant * dbRec = nullptr;
-				for (auto r2Base: currentRecords) {
-					RecordGenomicVariant * r2 = dynamic_cast<RecordGenomicVariant*>(r2Base);
-					if (r->key != r2->key) throw std::logic_error("Key mismatch");
-					if (r->definition != r2->definition) continue;
-					dbRec = r2;
-					break;
-				}
+			for (unsigned i = 0; i < count; ++i) {
+				RecordGenomicVariant * r = range.first[i];
+				int const dbIndexOfRecord = dbIndex.find(r->definition, fingerprints[i], getDbDefinition);
+				GenomicVariantCodec::Value * dbRec = (dbIndexOfRecord < 0) ? nullptr : &(dbValues[dbIndexOfRecord]);
 				if (dbRec == nullptr) {
 					if ( r->identifiers.lastId() == CanonicalId::null.value ) r->identifiers.lastId() = (pim->nextFreeCaId)++;
-					dbRec = new RecordGenomicVariant(*r);
-					currentRecords.push_back(dbRec);
+					dbIndex.add(fingerprints[i], dbValues.size());
+					dbValues.push_back(*r);
 					changes = true;
 					std::lock_guard<std::mutex> synch(accessToMapWithChanges);
 					r->identifiers.saveShortIdsToContainer(changesInIndexes, r);
@@ -153,7 +269,7 @@
 			return changes;
 		};
 
-		pim->db.writeRecords(records, updateFunction);
+		writeValues<GenomicVariantCodec>(pim->db, keys, updateFunction);
 	}
 
 
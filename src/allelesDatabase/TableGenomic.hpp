@@ -18,10 +18,22 @@
 		// record objects left in the vector are automatically delete when the callback returns
 		typedef std::function<void(std::vector<RecordGenomicVariant*> &, bool & lastCall)> tCallbackWithResults;
 		// ------------------
-		TableGenomic(std::string dirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB, std::atomic<uint32_t> & nextFreeCaId);
+		TableGenomic(std::string dirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB, std::atomic<uint32_t> & nextFreeCaId, DatabaseOptions const & options = DatabaseOptions());
 		~TableGenomic();
+		// returns when all changes are committed (see DatabaseT::flushPendingChanges())
+		void flushPendingChanges() const;
+		// results are sorted by definitions, records with the same key are always returned in the same chunk
 		void query( tCallbackWithResults, unsigned & recordsToSkip, uint32_t first = 0, uint32_t last = std::numeric_limits<uint32_t>::max()
 				  , unsigned minChunkSize = 1024, unsigned hintQuerySize = std::numeric_limits<unsigned>::max() ) const;
+		// the same as above but results start after the variant with given definition (it does not have to exist)
+		// the scan starts directly from the key of the variant, so the cost does not depend on the number of preceding records
+		void query( tCallbackWithResults, BinaryGenomicVariantDefinition const & after, unsigned & recordsToSkip
+				  , uint32_t first = 0, uint32_t last = std::numeric_limits<uint32_t>::max()
+				  , unsigned minChunkSize = 1024, unsigned hintQuerySize = std::numeric_limits<unsigned>::max() ) const;
+		// the same as above but only records with keys from given ranges are returned (ranges must be sorted and disjoint),
+		// chunks from all ranges are sent as from one query; after is optional (see above)
+		void query( tCallbackWithResults, std::vector<std::pair<uint32_t,uint32_t>> keysRanges, BinaryGenomicVariantDefinition const * after
+				  , unsigned & recordsToSkip, unsigned minChunkSize = 1024, unsigned hintQuerySize = std::numeric_limits<unsigned>::max() ) const;
 		// =========================== FETCH methods
 		// - records are matched to these ones in database by definition
 		// - always return the final caId & identifiers from the database after changes
@@ -3,6 +3,7 @@
 #include <mutex>
 
 #include "../apiDb/db.hpp"
+#include "../apiDb/RecordCodec.hpp"
 
 
 	// ================================================ TABLE
@@ -12,16 +13,16 @@
 		std::string const dirPath;
 		std::atomic<uint32_t> & nextFreeCaId;
 		DatabaseT<uint64_t,8> db;
-		Pim(std::string const & pDirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB, std::atomic<uint32_t> & pNextFreeCaId)
+		Pim(std::string const & pDirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB, std::atomic<uint32_t> & pNextFreeCaId, DatabaseOptions const & options)
 		: dirPath(pDirPath), nextFreeCaId(pNextFreeCaId)
-		, db(cpuTaskManager, ioTaskManager, dirPath + "protein", createRecord<RecordProteinVariant>, cacheInMB)
+		, db(cpuTaskManager, ioTaskManager, dirPath + "protein", createRecord<RecordProteinVariant>, cacheInMB, options)
 		{}
 	};
 
-	TableProtein::TableProtein(std::string dirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB, std::atomic<uint32_t> & nextFreeCaId)
+	TableProtein::TableProtein(std::string dirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB, std::atomic<uint32_t> & nextFreeCaId, DatabaseOptions const & options)
 	{
 		if ( (! dirPath.empty()) && dirPath.back() != '/') dirPath += "/";
-		pim = new Pim(dirPath, cpuTaskManager, ioTaskManager, cacheInMB, nextFreeCaId);
+		pim = new Pim(dirPath, cpuTaskManager, ioTaskManager, cacheInMB, nextFreeCaId, options);
 		std::cout << "table protein:\trecordsCount=" << pim->db.getRecordsCount() << "\ttheLargestKey=" << pim->db.getTheLargestKey() << "\n";
 	}
 
@@ -30,15 +31,55 @@
 		delete pim;
 	}
 
+	void TableProtein::flushPendingChanges() const
+	{
+		pim->db.flushPendingChanges();
+	}
 
-	void TableProtein::query( tCallbackWithResults callback, unsigned & recordsToSkip, uint64_t first, uint64_t last, unsigned minChunkSize, unsigned hintQuerySize ) const
+
+	// sends records to the callback, records with the largest key are held back until the last call
+	// (the next chunk from the database may contain more records with the same key)
+	static void sendChunkOfResults(TableProtein::tCallbackWithResults callback, std::vector<RecordProteinVariant*> & records, bool & lastCall)
+	{
+		std::sort( records.begin(), records.end(), [](RecordProteinVariant const *r1,RecordProteinVariant const *r2){ return (r1->definition < r2->definition); } );
+		auto itEnd = records.end();
+		if ( ! lastCall ) {
+			while ( itEnd != records.begin() && (*(itEnd-1))->key == records.back()->key ) --itEnd;
+			if (itEnd == records.begin()) return;
+		}
+		std::vector<RecordProteinVariant*> chunk(records.begin(), itEnd);
+		records.erase(records.begin(), itEnd);
+		try {
+			callback(chunk,lastCall);
+		} catch (...) {
+			for (auto r: chunk) delete r;
+			throw;
+		}
+		for (auto r: chunk) delete r;
+	}
+
+
+	// reads records with keys from given ranges (sorted and disjoint), chunks from all ranges are sent as from one query
+	static void queryRecords( DatabaseT<uint64_t,8> const & db, TableProtein::tCallbackWithResults callback, BinaryProteinVariantDefinition const * after
+							, unsigned & recordsToSkip, uint64_t first, std::vector<std::pair<uint64_t,uint64_t>> const & keysRanges
+							, unsigned minChunkSize, unsigned hintQuerySize )
 	{
+		if (keysRanges.empty()) {
+			std::vector<RecordProteinVariant*> empty;
+			bool lastCall = true;
+			callback(empty, lastCall);
+			return;
+		}
+
 		std::vector<RecordProteinVariant*> records2;
-		auto visitor = [callback, first, &recordsToSkip, &records2, minChunkSize](std::vector<RecordT<uint64_t> const *> const & records, bool & lastCall)
+		bool terminated = false;
+		auto visitor = [callback, first, after, &recordsToSkip, &records2, minChunkSize, &terminated](std::vector<RecordT<uint64_t> const *> const & records, bool & lastCall, bool lastRange)
 		{
 			for (auto r: records) {
 				RecordProteinVariant const * vr = dynamic_cast<RecordProteinVariant const *>(r);
 				if (vr->definition.proteinAccIdAndFirstPosition() + vr->definition.raw()[0].lengthBefore > first) {
+					// records with the key of the last variant are compared by definitions
+					if (after != nullptr && vr->key == after->proteinAccIdAndFirstPosition() && ! (*after < vr->definition)) continue;
 					if (recordsToSkip) {
 						--recordsToSkip;
 					} else {
@@ -46,36 +87,83 @@
 					}
 				}
 			}
-			if (records2.size() >= minChunkSize || lastCall) {
-				// TODO - problem with order between following vectors
-				std::sort( records2.begin(), records2.end(), [](RecordProteinVariant const *r1,RecordProteinVariant const *r2){ return (r1->definition < r2->definition); } );
-				callback(records2,lastCall);
-				for (auto r: records2) delete r;
-				records2.clear();
+			// the end of the range which is not the last one is not the end of the query
+			bool lastChunk = lastCall && lastRange;
+			if (records2.size() >= minChunkSize || lastChunk) {
+				sendChunkOfResults(callback, records2, lastChunk);
+				if (lastChunk) lastCall = terminated = true;
 			}
 		};
 
+		try {
+			for (unsigned i = 0; i < keysRanges.size() && ! terminated; ++i) {
+				bool const lastRange = (i + 1 == keysRanges.size());
+				auto rangeVisitor = [&visitor,lastRange](std::vector<RecordT<uint64_t> const *> const & records, bool & lastCall){ visitor(records, lastCall, lastRange); };
+				db.readRecordsInOrder( rangeVisitor, keysRanges[i].first, keysRanges[i].second, hintQuerySize );
+			}
+		} catch (...) {
+			for (auto r: records2) delete r;
+			throw;
+		}
+		// records left after termination of the query by the callback
+		for (auto r: records2) delete r;
+	}
+
+
+	// returns the range of keys of variants overlapping the region starting at first (they may start before it)
+	static std::vector<std::pair<uint64_t,uint64_t>> rangeOfKeys(BinaryProteinVariantDefinition const * after, uint64_t first, uint64_t last)
+	{
 		uint32_t const margin = 10000;
-		pim->db.readRecordsInOrder( visitor, (first > margin) ? (first-margin) : (0), last, hintQuerySize );
+		uint64_t firstKey = (first > margin) ? (first-margin) : (0);
+		if (after != nullptr) firstKey = std::max(firstKey, after->proteinAccIdAndFirstPosition());
+		std::vector<std::pair<uint64_t,uint64_t>> keysRanges;
+		if (firstKey <= last) keysRanges.push_back( std::make_pair(firstKey, last) );
+		return keysRanges;
+	}
+
+
+	void TableProtein::query( tCallbackWithResults callback, unsigned & recordsToSkip, uint64_t first, uint64_t last, unsigned minChunkSize, unsigned hintQuerySize ) const
+	{
+		queryRecords(pim->db, callback, nullptr, recordsToSkip, first, rangeOfKeys(nullptr, first, last), minChunkSize, hintQuerySize);
+	}
+
+
+	void TableProtein::query( tCallbackWithResults callback, BinaryProteinVariantDefinition const & after, unsigned & recordsToSkip
+							, uint64_t first, uint64_t last, unsigned minChunkSize, unsigned hintQuerySize ) const
+	{
+		queryRecords(pim->db, callback, &after, recordsToSkip, first, rangeOfKeys(&after, first, last), minChunkSize, hintQuerySize);
+	}
+
+
+	void TableProtein::query( tCallbackWithResults callback, std::vector<std::pair<uint64_t,uint64_t>> keysRanges, BinaryProteinVariantDefinition const * after
+							, unsigned & recordsToSkip, unsigned minChunkSize, unsigned hintQuerySize ) const
+	{
+		if (after != nullptr) {
+			// ranges before the last variant are skipped
+			uint64_t const firstKey = after->proteinAccIdAndFirstPosition();
+			auto it = std::find_if( keysRanges.begin(), keysRanges.end(), [firstKey](std::pair<uint64_t,uint64_t> const & r){ return (r.second >= firstKey); } );
+			keysRanges.erase(keysRanges.begin(), it);
+			if ( ! keysRanges.empty() ) keysRanges.front().first = std::max(keysRanges.front().first, firstKey);
+		}
+		queryRecords(pim->db, callback, after, recordsToSkip, 0, keysRanges, minChunkSize, hintQuerySize);
 	}
 
 
 	void TableProtein::fetch(std::vector<RecordProteinVariant*> const & pRecords) const
 	{
-		std::vector<RecordT<uint64_t>*> records;
-		records.insert( records.end(), pRecords.begin(), pRecords.end() );
+		std::vector<RecordProteinVariant*> records(pRecords);
+		std::vector<uint64_t> const keys = sortByKeys(records);
 
-		auto readFunction = [](std::vector<RecordT<uint64_t> const *> const & currentRecords, std::vector<RecordT<uint64_t>*> const & newRecords)
+		auto readFunction = [&records](uint64_t key, std::vector<ProteinVariantCodec::Value> const & dbValues)
 		{
 			// ======================= read data from the db records
-			for (auto rBase: newRecords) {
-				RecordProteinVariant * r = dynamic_cast<RecordProteinVariant*>(rBase);
-				RecordProteinVariant const * dbRec = nullptr;
-				for (auto r2Base: currentRecords) {
-					RecordProteinVariant const * r2 = dynamic_cast<RecordProteinVariant const *>(r2Base);
-					if (r->key != r2->key) throw std::logic_error("Key mismatch");
-					if (r->definition != r2->definition) continue;
-					dbRec = r2;
+			auto const range = recordsWithKey(records, key);
+			for (auto it = range.first; it != range.second; ++it) {
+				RecordProteinVariant * r = *it;
+				ProteinVariantCodec::Value const * dbRec = nullptr;
+				for (auto const & v: dbValues) {
+					if (r->definition != v.definition) continue;
+					dbRec = &v;
 					break;
 				}
 				if (dbRec == nullptr) {
@@ -90,7 +178,7 @@
 			}
 		};
 
-		pim->db.readRecords(records, readFunction);
+		readValues<ProteinVariantCodec>(pim->db, keys, readFunction);
 	}
 
 
@@ -99,52 +187,63 @@
 		, std::map<identifierType,std::vector<std::pair<uint32_t,RecordVariantPtr>>> & changesInIndexes
 		)
 	{
-		std::vector<RecordT<uint64_t>*> records;
-		records.insert( records.end(), pRecords.begin(), pRecords.end() );
+		std::vector<RecordProteinVariant*> records(pRecords);
+		std::vector<uint64_t> const keys = sortByKeys(records);
 
 		std::mutex accessToMapWithChanges;
 
-		auto updateFunction = [&records,&changesInIndexes,&accessToMapWithChanges,this](std::vector<RecordT<uint64_t>*> & currentRecords, std::vector<RecordT<uint64_t>*> const & newRecords)->bool
+		auto updateFunction = [&records,&changesInIndexes,&accessToMapWithChanges,this](uint64_t key, std::vector<ProteinVariantCodec::Value> & dbValues)->bool
 		{
-//if (newRecords.front()->key == 65534363175ull)
-//{
-//	std::cout << newRecords.front()->key << "\t";
-//	for (auto r: newRecords) std::cout<< dynamic_cast<RecordProteinVariant*>(r)->definition.toString() << ",";
-//	std::cout << "\t";
-//	for (auto r: currentRecords) std::cout<< dynamic_cast<RecordProteinVariant*>(r)->definition.toString() << ",";
-//	std::cout << std::endl;
-//}
+			auto const range = recordsWithKey(records, key);
+			unsigned const count = range.second - range.first;
+			static thread_local std::vector<uint64_t> fingerprints;
+			fingerprints.resize(count);
+			for (unsigned i = 0; i < count; ++i) fingerprints[i] = range.first[i]->definition.fingerprint();
 			// ======================= search for duplicated records in the input, make sure that duplicated records have the same identifiers
-			for (unsigned i = 0; i < newRecords.size(); ++i) {
-				for (unsigned j = i+1; j < newRecords.size(); ++j) {
-					RecordProteinVariant * r1 = dynamic_cast<RecordProteinVariant*>(newRecords[i]);
-					RecordProteinVariant * r2 = dynamic_cast<RecordProteinVariant*>(newRecords[j]);
-					if (r1->key != r2->key) throw std::logic_error("Key mismatch");
-					if (r1->definition != r2->definition) continue;
-					r1->identifiers.exchange(r2->identifiers);
-					// ---- TODO - temp workaround for conflicting PA
-					if ( r1->identifiers.lastId() != r2->identifiers.lastId() ) {
-						r1->identifiers.lastId() = r2->identifiers.lastId() = std::min( r1->identifiers.lastId(), r2->identifiers.lastId() );
+			if (count > 1) {
+				// identifiers of duplicates are collected in the first record, then copied to the others (except the last one,
+				// it is already equal to the first record after exchange())
+				static thread_local std::vector<int> firstDuplicates;
+				static thread_local std::vector<unsigned> lastDuplicates;
+				firstDuplicates.assign(count, -1);
+				lastDuplicates.resize(count);
+				DefinitionsIndex<BinaryProteinVariantDefinition> inputIndex;
+				auto getInputDefinition = [&range](unsigned i)->BinaryProteinVariantDefinition const &{ return range.first[i]->definition; };
+				for (unsigned i = 0; i < count; ++i) {
+					RecordProteinVariant * r = range.first[i];
+					firstDuplicates[i] = inputIndex.find(r->definition, fingerprints[i], getInputDefinition);
+					if (firstDuplicates[i] < 0) {
+						inputIndex.add(fingerprints[i], i);
+						continue;
 					}
+					lastDuplicates[firstDuplicates[i]] = i;
+					RecordProteinVariant * first = range.first[firstDuplicates[i]];
+					first->identifiers.exchange(r->identifiers);
+					// ---- TODO - temp workaround for conflicting PA
+					first->identifiers.lastId() = std::min( first->identifiers.lastId(), r->identifiers.lastId() );
+				}
+				for (unsigned i = 0; i < count; ++i) {
+					if (firstDuplicates[i] < 0) continue;
+					RecordProteinVariant * r = range.first[i];
+					RecordProteinVariant * first = range.first[firstDuplicates[i]];
+					if (lastDuplicates[firstDuplicates[i]] != i) r->identifiers.exchange(first->identifiers);
+					r->identifiers.lastId() = first->identifiers.lastId();
 				}
 			}
 
 			// ======================= modifications on the db records
+			DefinitionsIndex<BinaryProteinVariantDefinition> dbIndex;
+			for (unsigned i = 0; i < dbValues.size(); ++i) dbIndex.add(dbValues[i].definition.fingerprint(), i);
+			auto getDbDefinition = [&dbValues](unsigned i)->BinaryProteinVariantDefinition const &{ return dbValues[i].definition; };
 			bool changes = false;
-			for (auto rBase: newRecords) {
-				RecordProteinVariant * r = dynamic_cast<RecordProteinVariant*>(rBase);
-				RecordProteinVariant * dbRec = nullptr;
-				for (auto r2Base: currentRecords) {
-					RecordProteinVariant * r2 = dynamic_cast<RecordProteinVariant*>(r2Base);
-					if (r->key != r2->key) throw std::logic_error("Key mismatch");
-					if (r->definition != r2->definition) continue;
-					dbRec = r2;
-					break;
-				}
+			for (unsigned i = 0; i < count; ++i) {
+				RecordProteinVariant * r = range.first[i];
+				int const dbIndexOfRecord = dbIndex.find(r->definition, fingerprints[i], getDbDefinition);
+				ProteinVariantCodec::Value * dbRec = (dbIndexOfRecord < 0) ? nullptr : &(dbValues[dbIndexOfRecord]);
 				if (dbRec == nullptr) {
 					if ( r->identifiers.lastId() == CanonicalId::null.value ) r->identifiers.lastId() = (pim->nextFreeCaId)++;
-					dbRec = new RecordProteinVariant(*r);
-					currentRecords.push_back(dbRec);
+					dbIndex.add(fingerprints[i], dbValues.size());
+					dbValues.push_back(*r);
 					changes = true;
 					std::lock_guard<std::mutex> synch(accessToMapWithChanges);
 					r->identifiers.saveShortIdsToContainer(changesInIndexes, r);
@@ -165,7 +264,7 @@
 			return changes;
 		};
 
-		pim->db.writeRecords(records, updateFunction);
+		writeValues<ProteinVariantCodec>(pim->db, keys, updateFunction);
 	}
 
 
@@ -2,8 +2,11 @@
 #include "tools.hpp"
 #include "../commonTools/bytesLevel.hpp"
 #include "../apiDb/db.hpp"
+#include <algorithm>
+#include <cstring>
 #include <limits>
-#include <map>
+#include <mutex>
+#include <unordered_map>
 
 
 inline unsigned CRC32(std::string const & s)
@@ -37,6 +40,18 @@ inline unsigned CRC32(std::string const & s)
 		return length;
 	}
 
+	// saves length and packed nucleotides of the sequence (the record without the internal id)
+	static void saveSequence(std::string const & seq, uint8_t *& ptr)
+	{
+		writeUnsignedIntVarSize<1,1,unsigned>(ptr, seq.size());
+		unsigned const countOfFullSegments = seq.size() / 16;
+		// full segments of 16 nucleotides are saved as big-endian 32-bit integers, i.e. 4 nucleotides per byte
+		convertGenomicToBinary(seq.data(), countOfFullSegments*16, ptr);
+		ptr += countOfFullSegments*4;
+		unsigned const rest = seq.size() - countOfFullSegments*16;
+		writeUnsignedInteger( ptr, convertGenomicToBinary(seq.data() + countOfFullSegments*16, rest), (rest+3)/4 );
+	}
+
 	void SequenceRecord::saveData(uint8_t *& ptr) const
 	{
 		writeUnsignedInteger<1>(ptr, internalId);
@@ -44,13 +59,7 @@ inline unsigned CRC32(std::string const & s)
 			writeUnsignedIntVarSize<1,1,unsigned>(ptr, 0u);
 			return;
 		}
-		writeUnsignedIntVarSize<1,1,unsigned>(ptr, seq->size());
-		unsigned const countOfFullSegments = seq->size() / 16;
-		for (unsigned i = 0; i < countOfFullSegments; ++i) {
-			writeUnsignedInteger<4>(ptr, convertGenomicToBinary(seq->substr(i*16,16)));
-		}
-		std::string const rest = seq->substr(countOfFullSegments*16);
-		writeUnsignedInteger( ptr, convertGenomicToBinary(rest), (rest.size()+3)/4 );
+		saveSequence(*seq, ptr);
 	}
 
 	void SequenceRecord::loadData(uint8_t const *& ptr)
@@ -59,32 +68,77 @@ inline unsigned CRC32(std::string const & s)
 		internalId = readUnsignedInteger<1,unsigned>(ptr);
 		seq->resize(readUnsignedIntVarSize<1,1,unsigned>(ptr), '?');
 		unsigned const countOfFullSegments = seq->size() / 16;
-		for (unsigned i = 0; i < countOfFullSegments; ++i) {
-			std::string const ss = convertBinaryToGenomic(readUnsignedInteger<4,uint32_t>(ptr), 16);
-			seq->replace( i*16, 16, ss );
-		}
+		convertBinaryToGenomic(ptr, countOfFullSegments*16, &((*seq)[0]));
+		ptr += countOfFullSegments*4;
 		unsigned const rest = seq->size() - countOfFullSegments*16;
 		std::string const ss = convertBinaryToGenomic( readUnsignedInteger<uint32_t>(ptr,(rest+3)/4), rest );
 		seq->replace( countOfFullSegments*16, rest, ss );
 	}
 
 
+	// recently used sequences with their ids (ids of sequences are never changed or removed), it has two direct-mapped tables:
+	// by 64-bit hashes of sequences and by ids, a new entry overwrites the entry in its slot (buffers of strings are reused,
+	// so there are no allocations after the warm-up)
+	class SequencesHotCache
+	{
+	private:
+		struct Entry
+		{
+			uint32_t id = TableSequence::unknownSequence;
+			std::string seq;
+		};
+		static unsigned const slotsCountLog2 = 16;
+		std::vector<Entry> fByContent;
+		std::vector<Entry> fById;
+		std::hash<std::string> fHash;
+		inline Entry & slotByContent(std::string const & seq) { return fByContent[fHash(seq) >> (64 - slotsCountLog2)]; }
+		inline Entry & slotById(uint32_t id) { return fById[(id * 0x9e3779b97f4a7c15ull) >> (64 - slotsCountLog2)]; }
+	public:
+		SequencesHotCache() : fByContent(1u << slotsCountLog2), fById(1u << slotsCountLog2) {}
+		void add(std::string const & seq, uint32_t id)
+		{
+			Entry & e1 = slotByContent(seq);
+			e1.id = id;
+			e1.seq = seq;
+			Entry & e2 = slotById(id);
+			e2.id = id;
+			e2.seq = seq;
+		}
+		// returns TableSequence::unknownSequence if the sequence is not in the cache
+		uint32_t findId(std::string const & seq)
+		{
+			Entry const & e = slotByContent(seq);
+			return ( (e.id != TableSequence::unknownSequence && e.seq == seq) ? e.id : TableSequence::unknownSequence );
+		}
+		// returns nullptr if the sequence is not in the cache, the pointer is valid until the next call of add()
+		std::string const * findSequence(uint32_t id)
+		{
+			Entry const & e = slotById(id);
+			return ( (e.id == id) ? &(e.seq) : nullptr );
+		}
+	};
+
+
 	struct TableSequence::Pim
 	{
 		std::string const dirPath;
 		DatabaseT<> db;
-		Pim(std::string const & pDirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB)
+		std::mutex hotCacheAccess;
+		SequencesHotCache hotCache;
+		Pim(std::string const & pDirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB, DatabaseOptions const & options)
 		: dirPath(pDirPath)
-		, db(cpuTaskManager, ioTaskManager, dirPath + "sequence", createRecord<SequenceRecord>, cacheInMB)
+		, db(cpuTaskManager, ioTaskManager, dirPath + "sequence", createRecord<SequenceRecord>, cacheInMB, options)
 		{}
+		// finds ids of sequences, new sequences are added if add is set
+		void findIds(std::vector<std::string const *> const & seq, std::vector<uint32_t> & out, bool add);
 	};
 
 	uint32_t const TableSequence::unknownSequence = std::numeric_limits<uint32_t>::max();
 
-	TableSequence::TableSequence(std::string dirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB)
+	TableSequence::TableSequence(std::string dirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB, DatabaseOptions const & options)
 	{
 		if ( (! dirPath.empty()) && dirPath.back() != '/') dirPath += "/";
-		pim = new Pim(dirPath, cpuTaskManager, ioTaskManager, cacheInMB);
+		pim = new Pim(dirPath, cpuTaskManager, ioTaskManager, cacheInMB, options);
 	}
 
 	TableSequence::~TableSequence()
@@ -92,131 +146,192 @@ inline unsigned CRC32(std::string const & s)
 		delete pim;
 	}
 
+	void TableSequence::flushPendingChanges() const
+	{
+		pim->db.flushPendingChanges();
+	}
+
 	void TableSequence::fetch(std::vector<uint32_t> const & seq, std::vector<std::string*> const & out) const
 	{
 		if (seq.size() != out.size()) throw std::logic_error("TableSequence: parameter mismatch");
-		std::vector<RecordT<uint32_t>*> records( seq.size(), nullptr );
-		for (unsigned i = 0; i < seq.size(); ++i) {
-			uint32_t const id = seq[i];
-			SequenceRecord * r = new SequenceRecord(id >> 8);
-			r->internalId = id % 256;
-			r->seq = out[i];
-			records[i] = r;
-		}
 
-		auto visitor = [](std::vector<RecordT<uint32_t> const *> const & dbRecords, std::vector<RecordT<uint32_t> *> const & records)
+		// sequences from the hot cache, the rest is read from the database (each id once)
+		std::vector<uint32_t> ids;
 		{
-			if (records.empty()) throw std::logic_error("No records in visitor'c callback!");
-			if (dbRecords.empty()) return;
-			std::map<unsigned,std::string const *> internalId2seq;
-			for (auto r: dbRecords) {
-				SequenceRecord const * dbRecord = dynamic_cast<SequenceRecord const *>( r );
-				if (dbRecord->seq != nullptr) internalId2seq[dbRecord->internalId] = dbRecord->seq;
-			}
-			for (auto r: records) {
-				SequenceRecord * rec = dynamic_cast<SequenceRecord*>(r);
-				if (internalId2seq.count(rec->internalId)) {
-					*(rec->seq) = *(internalId2seq[rec->internalId]);
+			std::lock_guard<std::mutex> synch(pim->hotCacheAccess);
+			for (unsigned i = 0; i < seq.size(); ++i) {
+				std::string const * s = pim->hotCache.findSequence(seq[i]);
+				if (s == nullptr) {
+					ids.push_back(seq[i]);
+				} else {
+					*(out[i]) = *s;
 				}
 			}
-		};
-
-		pim->db.readRecords(records, visitor);
-
-		for (auto rec: records) {
-			SequenceRecord * r = dynamic_cast<SequenceRecord*>(rec);
-			r->seq = nullptr;
-			delete r;
-		}
-	}
-
-	void TableSequence::fetch(std::vector<std::string const *> const & seq, std::vector<uint32_t> & out) const
-	{
-		out.clear();
-		out.resize(seq.size(), unknownSequence);
-		std::vector<RecordT<uint32_t>*> records( seq.size(), nullptr );
-		for (unsigned i = 0; i < seq.size(); ++i) {
-			uint32_t const crc = CRC32( *(seq[i]) );
-			SequenceRecord * r = new SequenceRecord(crc >> 8);
-			r->seq = new std::string(*(seq[i]));
-			r->internalId = 123456;
-			records[i] = r;
 		}
+		if (ids.empty()) return;
+		std::sort(ids.begin(), ids.end());
+		ids.erase( std::unique(ids.begin(), ids.end()), ids.end() );
+		std::vector<uint32_t> keys;
+		for (auto id: ids) if (keys.empty() || keys.back() != (id >> 8)) keys.push_back(id >> 8);
 
-		auto visitor = [](std::vector<RecordT<uint32_t> const *> const & dbRecords, std::vector<RecordT<uint32_t> *> const & records)
+		std::vector<std::string*> sequences(ids.size(), nullptr);
+		auto visitor = [&ids,&sequences](uint32_t key, std::vector<RecordViewT<uint32_t>> const & views)
 		{
-			if (records.empty()) throw std::logic_error("No records in visitor'c callback!");
-			if (dbRecords.empty()) return;
-			for (auto r: records) {
-				SequenceRecord * rec = dynamic_cast<SequenceRecord*>(r);
-				for (auto r2: dbRecords) {
-					SequenceRecord const * dbRecord = dynamic_cast<SequenceRecord const *>( r2 );
-					if ( *(rec->seq) == *(dbRecord->seq) ) {
-						rec->internalId = dbRecord->internalId;
-						break;
-					}
+			// only records with requested ids are decoded
+			for (auto it = std::lower_bound(ids.begin(), ids.end(), key << 8);  it != ids.end() && (*it >> 8) == key;  ++it) {
+				for (auto const & v: views) {
+					if ( v.data[0] != (*it & 255) ) continue;
+					SequenceRecord r(key);
+					uint8_t const * ptr = v.data;
+					r.loadData(ptr);
+					sequences[it - ids.begin()] = r.seq;
+					r.seq = nullptr;
+					break;
 				}
 			}
 		};
+		try {
+			pim->db.readRawRecords(keys, visitor);
+		} catch (...) {
+			for (auto s: sequences) delete s;
+			throw;
+		}
 
-		pim->db.readRecords(records, visitor);
-
+		std::lock_guard<std::mutex> synch(pim->hotCacheAccess);
 		for (unsigned i = 0; i < seq.size(); ++i) {
-			SequenceRecord * r = dynamic_cast<SequenceRecord*>(records[i]);
-			if (r->internalId < 256) {
-				out[i] = (r->key << 8) + r->internalId;
-			}
-			delete r;
+			auto it = std::lower_bound(ids.begin(), ids.end(), seq[i]);
+			if (it == ids.end() || *it != seq[i]) continue;
+			std::string const * s = sequences[it - ids.begin()];
+			if (s != nullptr) *(out[i]) = *s;
+		}
+		for (unsigned i = 0; i < ids.size(); ++i) {
+			if (sequences[i] == nullptr) continue;
+			pim->hotCache.add(*(sequences[i]), ids[i]);
+			delete sequences[i];
 		}
 	}
 
-	void TableSequence::fetchAndAdd(std::vector<std::string const *> const & seq, std::vector<uint32_t> & out) const
+	void TableSequence::Pim::findIds(std::vector<std::string const *> const & seq, std::vector<uint32_t> & out, bool add)
 	{
 		out.clear();
 		out.resize(seq.size(), unknownSequence);
-		std::vector<RecordT<uint32_t>*> records( seq.size(), nullptr );
-		for (unsigned i = 0; i < seq.size(); ++i) {
-			uint32_t const crc = CRC32( *(seq[i]) );
-			SequenceRecord * r = new SequenceRecord(crc >> 8);
-			r->seq = new std::string(*(seq[i]));
-			r->internalId = 123456;
-			records[i] = r;
+
+		// sequences from the hot cache, the rest is queried in the database (each sequence once)
+		struct Query
+		{
+			uint32_t key;
+			std::string const * seq;
+			unsigned index;              // position in indices
+			unsigned dataOffset;         // the record saved by SequenceRecord without the internal id (in the buffer data)
+			unsigned dataLength;
+			uint32_t id = unknownSequence;
+			bool operator<(Query const & q) const { return (key < q.key || (key == q.key && *seq < *(q.seq))); }
+		};
+		std::vector<Query> queries;
+		std::vector<unsigned> indices;
+		std::vector<uint8_t> data;
+		{
+			std::lock_guard<std::mutex> synch(hotCacheAccess);
+			for (unsigned i = 0; i < seq.size(); ++i) {
+				out[i] = hotCache.findId(*(seq[i]));
+				if (out[i] == unknownSequence) indices.push_back(i);
+			}
+		}
+		if (indices.empty()) return;
+		queries.resize(indices.size());
+		for (unsigned j = 0; j < indices.size(); ++j) {
+			queries[j].key = CRC32( *(seq[indices[j]]) ) >> 8;
+			queries[j].seq = seq[indices[j]];
+			queries[j].index = j;
+		}
+		std::sort(queries.begin(), queries.end());
+		// duplicates are removed, queryOfIndex keeps positions of remaining queries
+		std::vector<unsigned> queryOfIndex(indices.size());
+		unsigned uniqueCount = 0;
+		for (unsigned j = 0; j < queries.size(); ++j) {
+			if ( uniqueCount == 0 || queries[j].key != queries[uniqueCount-1].key || *(queries[j].seq) != *(queries[uniqueCount-1].seq) ) {
+				queries[uniqueCount++] = queries[j];
+			}
+			queryOfIndex[queries[j].index] = uniqueCount - 1;
+		}
+		queries.resize(uniqueCount);
+		std::vector<uint32_t> keys;
+		unsigned dataSize = 0;
+		for (auto & q: queries) {
+			if (keys.empty() || keys.back() != q.key) keys.push_back(q.key);
+			q.dataOffset = dataSize;
+			q.dataLength = lengthUnsignedIntVarSize(q.seq->size()) + (q.seq->size() + 3) / 4;
+			dataSize += q.dataLength;
+		}
+		data.resize(dataSize);
+		for (auto & q: queries) {
+			uint8_t * ptr = data.data() + q.dataOffset;
+			saveSequence(*(q.seq), ptr);
 		}
 
-		auto visitor = [](std::vector<RecordT<uint32_t>*> & dbRecords, std::vector<RecordT<uint32_t> *> const & records) -> bool
+		// records in the bucket are matched by packed sequences, they are not decoded
+		auto match = [&data](Query & q, std::vector<RecordViewT<uint32_t>> const & views)
 		{
-			if (records.empty()) throw std::logic_error("No records in visitor's callback!");
-			bool changes = false;
-			for (auto r: records) {
-				SequenceRecord * rec = dynamic_cast<SequenceRecord*>(r);
-				unsigned nextInternalId = 0;
-				for (auto r2: dbRecords) {
-					SequenceRecord const * dbRecord = dynamic_cast<SequenceRecord const *>( r2 );
-					if ( *(rec->seq) == *(dbRecord->seq) ) {
-						rec->internalId = dbRecord->internalId;
-						break;
-					}
-					if (nextInternalId <= dbRecord->internalId) nextInternalId = dbRecord->internalId + 1;
-				}
-				if (rec->internalId > 255) {
-					SequenceRecord * newRecord = new SequenceRecord(rec->key);
-					newRecord->internalId = nextInternalId;
-					newRecord->seq = new std::string(*(rec->seq));
-					dbRecords.push_back(newRecord);
-					rec->internalId = newRecord->internalId;
-					changes = true;
-				}
+			for (auto const & v: views) {
+				if ( v.length != 1 + q.dataLength || std::memcmp(v.data + 1, data.data() + q.dataOffset, q.dataLength) != 0 ) continue;
+				q.id = (q.key << 8) + v.data[0];
+				return;
 			}
-			return changes;
 		};
+		auto queriesWithKey = [&queries](uint32_t key)
+		{
+			auto it1 = std::lower_bound( queries.begin(), queries.end(), key, [](Query const & q, uint32_t k){ return (q.key < k); } );
+			auto it2 = it1;
+			while (it2 != queries.end() && it2->key == key) ++it2;
+			return std::make_pair(it1, it2);
+		};
+		if (add) {
+			auto visitor = [&match,&queriesWithKey,&data](uint32_t key, std::vector<RecordViewT<uint32_t>> & views, RecordT<uint32_t>::tAllocateRawRecordFunction allocate) -> bool
+			{
+				auto const range = queriesWithKey(key);
+				bool changes = false;
+				for (auto it = range.first; it != range.second; ++it) {
+					match(*it, views);
+					if (it->id != unknownSequence) continue;
+					unsigned nextInternalId = 0;
+					for (auto const & v: views) nextInternalId = std::max(nextInternalId, v.data[0] + 1u);
+					if (nextInternalId > 255) continue;  // the bucket is full
+					RecordViewT<uint32_t> v;
+					v.key = key;
+					v.length = 1 + it->dataLength;
+					uint8_t * ptr = allocate(v.length);
+					v.data = ptr;
+					writeUnsignedInteger<1>(ptr, nextInternalId);
+					std::memcpy(ptr, data.data() + it->dataOffset, it->dataLength);
+					views.push_back(v);
+					it->id = (key << 8) + nextInternalId;
+					changes = true;
+				}
+				return changes;
+			};
+			db.writeRawRecords(keys, visitor);
+		} else {
+			auto visitor = [&match,&queriesWithKey](uint32_t key, std::vector<RecordViewT<uint32_t>> const & views)
+			{
+				auto const range = queriesWithKey(key);
+				for (auto it = range.first; it != range.second; ++it) match(*it, views);
+			};
+			db.readRawRecords(keys, visitor);
+		}
 
-		pim->db.writeRecords(records, visitor);
-
-		for (unsigned i = 0; i < seq.size(); ++i) {
-			SequenceRecord * r = dynamic_cast<SequenceRecord*>(records[i]);
-			if (r->internalId < 256) {
-				out[i] = (r->key << 8) + r->internalId;
-			}
-			delete r;
+		std::lock_guard<std::mutex> synch(hotCacheAccess);
+		for (unsigned j = 0; j < indices.size(); ++j) {
+			out[indices[j]] = queries[queryOfIndex[j]].id;
 		}
+		for (auto const & q: queries) if (q.id != unknownSequence) hotCache.add(*(q.seq), q.id);
+	}
+
+	void TableSequence::fetch(std::vector<std::string const *> const & seq, std::vector<uint32_t> & out) const
+	{
+		pim->findIds(seq, out, false);
+	}
+
+	void TableSequence::fetchAndAdd(std::vector<std::string const *> const & seq, std::vector<uint32_t> & out) const
+	{
+		pim->findIds(seq, out, true);
 	}
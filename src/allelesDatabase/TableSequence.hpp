@@ -5,6 +5,7 @@
 #include <vector>
 #include <cstdint>
 #include "../apiDb/TasksManager.hpp"
+#include "../apiDb/db.hpp"
 
 	class TableSequence
 	{
@@ -13,8 +14,10 @@
 		Pim * pim;
 	public:
 		static uint32_t const unknownSequence;
-		TableSequence(std::string dirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB);
+		TableSequence(std::string dirPath, TasksManager * cpuTaskManager, TasksManager * ioTaskManager, unsigned cacheInMB, DatabaseOptions const & options = DatabaseOptions());
 		~TableSequence();
+		// returns when all changes are committed (see DatabaseT::flushPendingChanges())
+		void flushPendingChanges() const;
 		void fetch(std::vector<uint32_t> const & seq, std::vector<std::string*> const & out) const;
 		void fetch(std::vector<std::string const *> const & seq, std::vector<uint32_t> & out) const;
 		void fetchAndAdd(std::vector<std::string const *> const & seq, std::vector<uint32_t> & out) const;
@@ -1,8 +1,12 @@
 #include "allelesDatabase.hpp"
 #include <sstream>
+#include <iostream>
 #include <algorithm>
 #include <set>
 #include <mutex>
+#include <memory>
+#include <stdexcept>
+#include <string>
 #include <boost/thread.hpp>
 
 #include "TableSequence.hpp"
@@ -11,6 +15,8 @@
 #include "IndexGenomicComplex.hpp"
 #include "IndexIdentifierCa.hpp"
 #include "IndexIdentifierPa.hpp"
+#include "IndexIdentifierTypes.hpp"
+#include "StagesExecutor.hpp"
 #include "IndexIdentifierUInt32.hpp"
 #include "tools.hpp"
 
@@ -25,30 +31,54 @@ struct AllelesDatabase::Pim
 	std::atomic<uint32_t> nextCaId;
 	TasksManager cpuTaskManager;
 	TasksManager ioTasksManager;
+	std::unique_ptr<WriteAheadLog> wal;  // shared by all tables and indexes, it is null if not used
+	std::unique_ptr<AsyncIo> asyncIo;    // io_uring queue shared by all tables and indexes, it is null if not used
+	std::unique_ptr<CacheBudget> cacheBudget;  // memory shared by caches of all tables and indexes, it is null if not used
+	MemoryArena memoryArena;                   // buffers of caches of all tables and indexes
 	TableSequence tabSequence;
 	TableGenomic  tabGenomic;
 	TableProtein  tabProtein;
 	//IndexGenomicComplex indexGenomicComplex;
 	IndexIdentifierCa indexIdentifierCa;
 	IndexIdentifierPa indexIdentifierPa;
+	IndexIdentifierTypes indexIdentifierTypes;  // blocks of tables with variants having identifiers of given types
 	std::map<identifierType, IndexIdentifierUInt32*> indexIdentifierUInt32;
 	ReferencesDatabase const * refDb;
 	std::vector<unsigned> genomicReferencesToKeyOffsets;
+	// options of all tables and indexes (they share the log, the io_uring queue, the cache budget and the arena)
+	DatabaseOptions databaseOptions(Configuration const & conf, bool compressPages)
+	{
+		DatabaseOptions options;
+		options.wal = wal.get();
+		options.asyncIo = asyncIo.get();
+		options.compressPages = compressPages;
+		options.readOnly = conf.allelesDatabase_readOnly;
+		options.cacheBudget = cacheBudget.get();
+		options.warmUpPagesPerSecond = conf.allelesDatabase_warmUp;
+		options.memoryArena = &memoryArena;
+		options.compactionPagesPerSecond = conf.allelesDatabase_compaction;
+		return options;
+	}
 	Pim(Configuration const & conf, ReferencesDatabase const * pRefDb)
-	: cpuTaskManager(conf.allelesDatabase_threads), ioTasksManager(conf.allelesDatabase_threads)
-	, tabSequence(conf.allelesDatabase_path, &cpuTaskManager, &ioTasksManager, conf.allelesDatabase_cache_sequence)
-	, tabGenomic(conf.allelesDatabase_path, &cpuTaskManager, &ioTasksManager, conf.allelesDatabase_cache_genomic, nextCaId)
-	, tabProtein(conf.allelesDatabase_path, &cpuTaskManager, &ioTasksManager, conf.allelesDatabase_cache_protein, nextCaId) // TODO - PaId
+	: cpuTaskManager(conf.allelesDatabase_threads), ioTasksManager(conf.allelesDatabase_ioTasks)
+	, wal(createWriteAheadLog(conf))
+	, asyncIo(createAsyncIo(conf))
+	, cacheBudget((conf.allelesDatabase_cacheBudget == 0) ? nullptr : new CacheBudget(conf.allelesDatabase_cacheBudget))
+	, memoryArena(256*1024, hugePagesMode(conf))
+	, tabSequence(conf.allelesDatabase_path, &cpuTaskManager, &ioTasksManager, conf.allelesDatabase_cache_sequence, databaseOptions(conf, conf.allelesDatabase_compression_sequence))
+	, tabGenomic(conf.allelesDatabase_path, &cpuTaskManager, &ioTasksManager, conf.allelesDatabase_cache_genomic, nextCaId, databaseOptions(conf, conf.allelesDatabase_compression_genomic))
+	, tabProtein(conf.allelesDatabase_path, &cpuTaskManager, &ioTasksManager, conf.allelesDatabase_cache_protein, nextCaId, databaseOptions(conf, conf.allelesDatabase_compression_protein)) // TODO - PaId
 	//, indexGenomicComplex(conf.allelesDatabase_path, cpuTaskManager)
-	, indexIdentifierCa(conf.allelesDatabase_path, &cpuTaskManager, &ioTasksManager, conf.allelesDatabase_cache_idCa)
-	, indexIdentifierPa(conf.allelesDatabase_path, &cpuTaskManager, &ioTasksManager, conf.allelesDatabase_cache_idPa)
+	, indexIdentifierCa(conf.allelesDatabase_path, &cpuTaskManager, &ioTasksManager, conf.allelesDatabase_cache_idCa, databaseOptions(conf, conf.allelesDatabase_compression_idCa))
+	, indexIdentifierPa(conf.allelesDatabase_path, &cpuTaskManager, &ioTasksManager, conf.allelesDatabase_cache_idPa, databaseOptions(conf, conf.allelesDatabase_compression_idPa))
+	, indexIdentifierTypes(conf.allelesDatabase_path, &cpuTaskManager, &ioTasksManager, conf.allelesDatabase_cache_idTypes, databaseOptions(conf, conf.allelesDatabase_compression_idTypes))
 	, refDb(pRefDb)
 	{
 		nextCaId = std::max(indexIdentifierCa.getMaxIdentifier(), indexIdentifierPa.getMaxIdentifier()) + 1; // TODO - PaId
-		indexIdentifierUInt32[identifierType::dbSNP         ] = new IndexIdentifierUInt32(conf.allelesDatabase_path, &cpuTaskManager, &ioTasksManager, "DbSnp"         , conf.allelesDatabase_cache_idDbSnp);
-		indexIdentifierUInt32[identifierType::ClinVarAllele ] = new IndexIdentifierUInt32(conf.allelesDatabase_path, &cpuTaskManager, &ioTasksManager, "ClinVarAllele" , conf.allelesDatabase_cache_idClinVarAllele);
-		indexIdentifierUInt32[identifierType::ClinVarVariant] = new IndexIdentifierUInt32(conf.allelesDatabase_path, &cpuTaskManager, &ioTasksManager, "ClinVarVariant", conf.allelesDatabase_cache_idClinVarVariant);
-		indexIdentifierUInt32[identifierType::ClinVarRCV    ] = new IndexIdentifierUInt32(conf.allelesDatabase_path, &cpuTaskManager, &ioTasksManager, "ClinVarRCV"    , conf.allelesDatabase_cache_idClinVarRCV);
+		indexIdentifierUInt32[identifierType::dbSNP         ] = new IndexIdentifierUInt32(conf.allelesDatabase_path, &cpuTaskManager, &ioTasksManager, "DbSnp"         , conf.allelesDatabase_cache_idDbSnp, databaseOptions(conf, conf.allelesDatabase_compression_idDbSnp));
+		indexIdentifierUInt32[identifierType::ClinVarAllele ] = new IndexIdentifierUInt32(conf.allelesDatabase_path, &cpuTaskManager, &ioTasksManager, "ClinVarAllele" , conf.allelesDatabase_cache_idClinVarAllele, databaseOptions(conf, conf.allelesDatabase_compression_idClinVarAllele));
+		indexIdentifierUInt32[identifierType::ClinVarVariant] = new IndexIdentifierUInt32(conf.allelesDatabase_path, &cpuTaskManager, &ioTasksManager, "ClinVarVariant", conf.allelesDatabase_cache_idClinVarVariant, databaseOptions(conf, conf.allelesDatabase_compression_idClinVarVariant));
+		indexIdentifierUInt32[identifierType::ClinVarRCV    ] = new IndexIdentifierUInt32(conf.allelesDatabase_path, &cpuTaskManager, &ioTasksManager, "ClinVarRCV"    , conf.allelesDatabase_cache_idClinVarRCV, databaseOptions(conf, conf.allelesDatabase_compression_idClinVarRCV));
 		// this is needed to convert ref+position to uniform 32-bit position value
 		std::vector<unsigned> refsLengths = refDb->getMainGenomeReferencesLengths();
 		genomicReferencesToKeyOffsets.resize(refsLengths.size(), 0);
@@ -58,9 +88,73 @@ struct AllelesDatabase::Pim
 	}
 	~Pim()
 	{
+		// clean shutdown: all changes are moved from the log to files of tables, so the log is empty at the next start
+		if (wal) {
+			try {
+				flushPendingChanges();
+				wal->checkpoint();
+			} catch (std::exception const & e) {
+				std::cerr << "ERROR: the checkpoint of the write-ahead log failed: " << e.what() << std::endl;
+			}
+		}
 		for (auto & kv: indexIdentifierUInt32) delete kv.second;
 	}
 
+	static WriteAheadLog * createWriteAheadLog(Configuration const & conf)
+	{
+		std::string path = conf.allelesDatabase_path;
+		if ( (! path.empty()) && path.back() != '/') path += "/";
+		path += "wal";
+		if (conf.allelesDatabase_walCheckpoint > 0 && ! conf.allelesDatabase_readOnly) {
+			return new WriteAheadLog(path, conf.allelesDatabase_walCheckpoint);
+		}
+		// the log is not used, committed changes left in it (e.g. after a crash) would be silently missing
+		if (WriteAheadLog::hasCommittedChanges(path)) {
+			throw std::runtime_error("The write-ahead log " + path + " contains committed changes not saved in the database files."
+					" The database must be opened once in read-write mode with the write-ahead log to recover them.");
+		}
+		return nullptr;
+	}
+
+	static MemoryArena::HugePages hugePagesMode(Configuration const & conf)
+	{
+		switch (conf.allelesDatabase_hugePages) {
+			case 0 : return MemoryArena::HugePages::none;
+			case 1 : return MemoryArena::HugePages::transparent;
+			case 2 : return MemoryArena::HugePages::hugetlb;
+		}
+		throw std::runtime_error("Incorrect value of allelesDatabase.hugePages: " + std::to_string(conf.allelesDatabase_hugePages));
+	}
+
+	// returns nullptr if io_uring is not used or not supported (databases use pread/pwrite then)
+	static AsyncIo * createAsyncIo(Configuration const & conf)
+	{
+		if (conf.allelesDatabase_ioUring == 0) return nullptr;
+		std::unique_ptr<AsyncIo> asyncIo(new AsyncIo(256, conf.allelesDatabase_ioUring));
+		if ( ! asyncIo->isSupported() ) return nullptr;
+		return asyncIo.release();
+	}
+
+	// returns when changes of all tables and indexes are appended to the log (they are appended by tasks running in background)
+	void flushPendingChanges()
+	{
+		tabSequence.flushPendingChanges();
+		tabGenomic.flushPendingChanges();
+		tabProtein.flushPendingChanges();
+		indexIdentifierCa.flushPendingChanges();
+		indexIdentifierPa.flushPendingChanges();
+		indexIdentifierTypes.flushPendingChanges();
+		for (auto const & kv: indexIdentifierUInt32) kv.second->flushPendingChanges();
+	}
+
+	// makes all changes in tables and indexes durable (one synchronization for all of them)
+	void commitChanges()
+	{
+		if ( ! wal ) return;
+		flushPendingChanges();
+		wal->commit();
+	}
+
 	inline void proteinKey2Coordinates(uint64_t key, ReferenceId & refId, uint16_t & position) const
 	{
 		refId = refDb->getReferenceIdFromProteinAccessionIdentifier(key >> 16);
@@ -348,6 +442,23 @@ struct AllelesDatabase::Pim
 		}
 	}
 
+	// returns the variant given by continuation token (only definition is set), throws ExceptionIncorrectRequest if it does not exist
+	RecordGenomicVariant * fetchLastGenomicVariant(ContinuationToken const & token)
+	{
+		ASSERT( ! token.protein );
+		RecordGenomicVariant * r = indexIdentifierCa.fetchDefinitions({token.id.value}).front();
+		if (r == nullptr) throw ExceptionIncorrectRequest("Allele given in continuation token does not exist: " + token.toString());
+		return r;
+	}
+
+	RecordProteinVariant * fetchLastProteinVariant(ContinuationToken const & token)
+	{
+		ASSERT( token.protein );
+		RecordProteinVariant * r = indexIdentifierPa.fetchDefinitions({token.id.value}).front();
+		if (r == nullptr) throw ExceptionIncorrectRequest("Allele given in continuation token does not exist: " + token.toString());
+		return r;
+	}
+
 	std::vector<Document> convertToDocuments(std::vector<RecordGenomicVariant*> const & varRecords)
 	{
 		std::vector<Document> docs(varRecords.size(), DocumentActiveGenomicVariant());
@@ -381,6 +492,10 @@ AllelesDatabase::AllelesDatabase(ReferencesDatabase const * refDb, Configuration
 		idsToRebuild.insert(identifierType::CA);
 	if (pim->indexIdentifierPa.isNewDb())
 		idsToRebuild.insert(identifierType::PA);
+	if (pim->indexIdentifierTypes.isNewDb()) {
+		std::set<identifierType> const types = IndexIdentifierTypes::indexedTypes();
+		idsToRebuild.insert(types.begin(), types.end());
+	}
 	rebuildIndexes(idsToRebuild);
 }
 
@@ -395,9 +510,14 @@ void AllelesDatabase::rebuildIndexes(std::set<identifierType> const & idsTypes)
 {
 	if (idsTypes.empty()) return;
 
+	// types of identifiers marked in the bitmap index, their old bits are removed
+	std::set<identifierType> bitmapTypes;
+	for (auto t: IndexIdentifierTypes::indexedTypes()) if (idsTypes.count(t)) bitmapTypes.insert(t);
+	pim->indexIdentifierTypes.clear(bitmapTypes);
+
 	Stopwatch stopwatch;
 	std::cout << "====================> Rebuild indexes - table genomic" << std::endl;
-	auto visitor = [this,&stopwatch,&idsTypes](std::vector<RecordGenomicVariant*> & varRecords, bool lastCall)
+	auto visitor = [this,&stopwatch,&idsTypes,&bitmapTypes](std::vector<RecordGenomicVariant*> & varRecords, bool lastCall)
 	{
 		std::cout << varRecords.size() <<  " records fetched in " << stopwatch.get_time_sec() << "s" << std::endl;
 		stopwatch.restart();
@@ -417,6 +537,12 @@ void AllelesDatabase::rebuildIndexes(std::set<identifierType> const & idsTypes)
 			std::vector<RecordGenomicVariant const *> varRecords3(varRecords.begin(), varRecords.end());
 			pim->indexIdentifierCa.addIdentifiers(varRecords3);
 		}
+		// bitmaps of identifiers types
+		if ( ! bitmapTypes.empty() ) {
+			std::vector<RecordGenomicVariant const *> varRecords3(varRecords.begin(), varRecords.end());
+			pim->indexIdentifierTypes.addVariants(varRecords3, bitmapTypes);
+		}
+		pim->commitChanges();
 		std::cout << "indexes updated in " << stopwatch.get_time_sec() << "s" << std::endl;
 		stopwatch.restart();
 	};
@@ -424,7 +550,7 @@ void AllelesDatabase::rebuildIndexes(std::set<identifierType> const & idsTypes)
 	pim->tabGenomic.query(visitor, skip, 0, std::numeric_limits<uint32_t>::max(), 16*1024*1024);
 
 	std::cout << "====================> Rebuild indexes - table protein" << std::endl;
-	auto visitor2 = [this,&stopwatch,&idsTypes](std::vector<RecordProteinVariant*> & varRecords, bool lastCall)
+	auto visitor2 = [this,&stopwatch,&idsTypes,&bitmapTypes](std::vector<RecordProteinVariant*> & varRecords, bool lastCall)
 	{
 		std::cout << varRecords.size() <<  " records fetched in " << stopwatch.get_time_sec() << "s" << std::endl;
 		stopwatch.restart();
@@ -444,6 +570,12 @@ void AllelesDatabase::rebuildIndexes(std::set<identifierType> const & idsTypes)
 			std::vector<RecordProteinVariant const *> varRecords3(varRecords.begin(), varRecords.end());
 			pim->indexIdentifierPa.addIdentifiers(varRecords3);
 		}
+		// bitmaps of identifiers types
+		if ( ! bitmapTypes.empty() ) {
+			std::vector<RecordProteinVariant const *> varRecords3(varRecords.begin(), varRecords.end());
+			pim->indexIdentifierTypes.addVariants(varRecords3, bitmapTypes);
+		}
+		pim->commitChanges();
 		std::cout << "indexes updated in " << stopwatch.get_time_sec() << "s" << std::endl;
 		stopwatch.restart();
 	};
@@ -511,36 +643,64 @@ void AllelesDatabase::fetchVariantsByDefinitionAndAddIdentifiers(std::vector<Doc
 	pim->convertToVariantRecords(docs, true, genomicRecords, genomicRecordsIndices, proteinRecords, proteinRecordsIndices);
 	std::cout << " (conv=" << stopwatch.save_and_restart_sec() << "s" << std::flush;
 
-	std::map<identifierType, std::vector<std::pair<uint32_t,RecordVariantPtr>>> newIdentifiersUint32;
-	pim->tabGenomic.fetchAndAdd(genomicRecords, newIdentifiersUint32);
-	pim->tabProtein.fetchAndAdd(proteinRecords, newIdentifiersUint32);
-	std::cout << " fetch=" << stopwatch.save_and_restart_sec() << "s" << std::flush;
-
-	std::vector<RecordGenomicVariant const *> newGenomicRecords;
-	std::vector<RecordProteinVariant const *> newProteinRecords;
-	for (auto const & e: newIdentifiersUint32[identifierType::CA]) {
-		newGenomicRecords.push_back( e.second.asRecordGenomicVariantPtr() );
-	}
-	for (auto const & e: newIdentifiersUint32[identifierType::PA]) {
-		newProteinRecords.push_back( e.second.asRecordProteinVariantPtr() );
-	}
-	newIdentifiersUint32.erase(identifierType::CA);
-	newIdentifiersUint32.erase(identifierType::PA);
-
-	// TODO pim->indexGenomicComplex.addComplexDefinitions(newGenomicRecords);
-	// TODO - protein complex alleles
-	std::cout << " complex=" << stopwatch.save_and_restart_sec() << "s" << std::flush;
-
-	pim->indexIdentifierCa.addIdentifiers(newGenomicRecords);
-	pim->indexIdentifierPa.addIdentifiers(newProteinRecords);
-	std::cout << " CA/PA=" << stopwatch.save_and_restart_sec() << "s" << std::flush;
-
-	for (auto const & kv: newIdentifiersUint32) {
-		if (pim->indexIdentifierUInt32.count(kv.first)) {
-			pim->indexIdentifierUInt32[kv.first]->addIdentifiers(kv.second);
+	// tables and indexes are updated concurrently, each index is updated as soon as the tables it depends on are done
+	std::map<identifierType, std::vector<std::pair<uint32_t,RecordVariantPtr>>> newGenomicIdentifiers;
+	std::map<identifierType, std::vector<std::pair<uint32_t,RecordVariantPtr>>> newProteinIdentifiers;
+	StagesExecutor stages;
+	unsigned const genomic = stages.addStage("genomic", [this,&genomicRecords,&newGenomicIdentifiers]()
+	{
+		pim->tabGenomic.fetchAndAdd(genomicRecords, newGenomicIdentifiers);
+	});
+	unsigned const protein = stages.addStage("protein", [this,&proteinRecords,&newProteinIdentifiers]()
+	{
+		pim->tabProtein.fetchAndAdd(proteinRecords, newProteinIdentifiers);
+	});
+	stages.addStage("CA", [this,&newGenomicIdentifiers]()
+	{
+		// TODO pim->indexGenomicComplex.addComplexDefinitions(newGenomicRecords);
+		std::vector<RecordGenomicVariant const *> newGenomicRecords;
+		// the map is only read here, other stages read it concurrently
+		auto it = newGenomicIdentifiers.find(identifierType::CA);
+		if (it != newGenomicIdentifiers.end()) {
+			for (auto const & e: it->second) newGenomicRecords.push_back( e.second.asRecordGenomicVariantPtr() );
+		}
+		pim->indexIdentifierCa.addIdentifiers(newGenomicRecords);
+	}, {genomic});
+	stages.addStage("PA", [this,&newProteinIdentifiers]()
+	{
+		// TODO - protein complex alleles
+		std::vector<RecordProteinVariant const *> newProteinRecords;
+		// the map is only read here, other stages read it concurrently
+		auto it = newProteinIdentifiers.find(identifierType::PA);
+		if (it != newProteinIdentifiers.end()) {
+			for (auto const & e: it->second) newProteinRecords.push_back( e.second.asRecordProteinVariantPtr() );
 		}
+		pim->indexIdentifierPa.addIdentifiers(newProteinRecords);
+	}, {protein});
+	// records have final identifiers from the database, bits already set are not saved again
+	stages.addStage("typesG", [this,&genomicRecords]()
+	{
+		pim->indexIdentifierTypes.addVariants(std::vector<RecordGenomicVariant const *>(genomicRecords.begin(), genomicRecords.end()));
+	}, {genomic});
+	stages.addStage("typesP", [this,&proteinRecords]()
+	{
+		pim->indexIdentifierTypes.addVariants(std::vector<RecordProteinVariant const *>(proteinRecords.begin(), proteinRecords.end()));
+	}, {protein});
+	// the same identifier may be added to genomic and protein variants, so each index is updated once with both lists
+	for (auto const & kv: pim->indexIdentifierUInt32) {
+		identifierType const idType = kv.first;
+		IndexIdentifierUInt32 * index = kv.second;
+		stages.addStage(toString(idType), [idType,index,&newGenomicIdentifiers,&newProteinIdentifiers]()
+		{
+			std::vector<std::pair<uint32_t,RecordVariantPtr>> ids;
+			if (newGenomicIdentifiers.count(idType)) ids = newGenomicIdentifiers.at(idType);
+			if (newProteinIdentifiers.count(idType)) ids.insert(ids.end(), newProteinIdentifiers.at(idType).begin(), newProteinIdentifiers.at(idType).end());
+			if ( ! ids.empty() ) index->addIdentifiers(ids);
+		}, {genomic, protein});
 	}
-	std::cout << " ids=" << stopwatch.save_and_restart_sec() << "s" << std::flush;
+	stages.run();
+	pim->commitChanges();
+	std::cout << " updates=" << stopwatch.save_and_restart_sec() << "s [" << stages.timingsToString() << "]" << std::flush;
 
 	pim->overwriteIdentifiers(docs, genomicRecords, genomicRecordsIndices, proteinRecords, proteinRecordsIndices);
 	std::cout << " conv=" << stopwatch.save_and_restart_sec() << "s) " << std::flush;
@@ -567,6 +727,7 @@ void AllelesDatabase::fetchVariantsByDefinitionAndDeleteIdentifiers(std::vector<
 			pim->indexIdentifierUInt32[kv.first]->deleteIdentifiers(kv.second);
 		}
 	}
+	pim->commitChanges();
 
 	pim->overwriteIdentifiers(docs, genomicRecords, genomicRecordsIndices, proteinRecords, proteinRecordsIndices);
 
@@ -594,6 +755,7 @@ void AllelesDatabase::fetchVariantsByDefinitionAndDelete(std::vector<Document> &
 			pim->indexIdentifierUInt32[kv.first]->deleteIdentifiers(kv.second);
 		}
 	}
+	pim->commitChanges();
 
 	pim->overwriteIdentifiers(docs, genomicRecords, genomicRecordsIndices, proteinRecords, proteinRecordsIndices);
 
@@ -672,10 +834,57 @@ void AllelesDatabase::queryVariants(callbackSendChunk callback, std::vector<std:
 
 // query variants (with identifiers and revision) with given identifier
 void AllelesDatabase::queryVariants(callbackSendChunk callback, unsigned & recordsToSkip, std::vector<identifierType> const & idTypes, unsigned hintQuerySize)
+{
+	queryVariants(callback, ContinuationToken(), recordsToSkip, idTypes, hintQuerySize);
+}
+
+
+// query variants from given regions (with identifiers and revision)
+void AllelesDatabase::queryVariants(callbackSendChunk callback, unsigned & recordsToSkip, ReferenceId refId, uint32_t from, uint32_t to, unsigned minChunkSize, unsigned hintQuerySize)
+{
+	queryVariants(callback, ContinuationToken(), recordsToSkip, refId, from, to, minChunkSize, hintQuerySize);
+}
+
+
+// query all genomic variants
+void AllelesDatabase::queryGenomicVariants(callbackSendChunk callback, unsigned & recordsToSkip, unsigned minChunkSize)
+{
+	queryGenomicVariants(callback, ContinuationToken(), recordsToSkip, minChunkSize);
+}
+
+
+// query all protein variants
+void AllelesDatabase::queryProteinVariants(callbackSendChunk callback, unsigned & recordsToSkip, unsigned minChunkSize)
+{
+	queryProteinVariants(callback, ContinuationToken(), recordsToSkip, minChunkSize);
+}
+
+
+ContinuationToken ContinuationToken::fromString(std::string const & s)
+{
+	if (s.size() < 3 || s.size() > 11 || (s.substr(0,2) != "CA" && s.substr(0,2) != "PA")) {
+		throw ExceptionIncorrectRequest("Continuation token must be CA or PA ID of the last returned allele. Given value: '" + s + "'.");
+	}
+	for (unsigned i = 2; i < s.size(); ++i) if (s[i] < '0' || s[i] > '9') {
+		throw ExceptionIncorrectRequest("Continuation token must be CA or PA ID of the last returned allele. Given value: '" + s + "'.");
+	}
+	return ContinuationToken( s[0] == 'P', CanonicalId(boost::lexical_cast<uint32_t>(s.substr(2))) );
+}
+
+
+std::string ContinuationToken::toString() const
+{
+	if (isNull()) return "";
+	return (protein ? "PA" : "CA") + boost::lexical_cast<std::string>(id.value);
+}
+
+
+// query variants (with identifiers and revision) with given identifier, starting after the variant given by the token
+void AllelesDatabase::queryVariants(callbackSendChunk callback, ContinuationToken const & after, unsigned & recordsToSkip, std::vector<identifierType> const & idTypes, unsigned hintQuerySize)
 {
 	bool finished = false;
 
-	{ // ----- genomic
+	if ( ! after.protein ) { // ----- genomic
 		auto visitor = [this,callback,idTypes,&finished](std::vector<RecordGenomicVariant*> & varRecords, bool & lastCall)
 		{
 			if ( ! idTypes.empty() ) {
@@ -691,7 +900,18 @@ void AllelesDatabase::queryVariants(callbackSendChunk callback, unsigned & recor
 			std::vector<Document> docs = pim->convertToDocuments(varRecords);
 			callback(docs, finished);
 		};
-		pim->tabGenomic.query(visitor, recordsToSkip, hintQuerySize);
+		uint32_t const first = 0;
+		uint32_t const last = std::numeric_limits<uint32_t>::max();
+		std::unique_ptr<RecordGenomicVariant> lastRecord( after.isNull() ? nullptr : pim->fetchLastGenomicVariant(after) );
+		if ( ! idTypes.empty() ) {
+			// only blocks of the table with given identifiers are read
+			std::vector<std::pair<uint32_t,uint32_t>> keysRanges = pim->indexIdentifierTypes.genomicKeysRanges(idTypes);
+			pim->tabGenomic.query(visitor, keysRanges, (lastRecord ? &(lastRecord->definition) : nullptr), recordsToSkip, 1024, hintQuerySize);
+		} else if (after.isNull()) {
+			pim->tabGenomic.query(visitor, recordsToSkip, first, last, 1024, hintQuerySize);
+		} else {
+			pim->tabGenomic.query(visitor, lastRecord->definition, recordsToSkip, first, last, 1024, hintQuerySize);
+		}
 	}
 
 	if (finished) return;
@@ -712,13 +932,24 @@ void AllelesDatabase::queryVariants(callbackSendChunk callback, unsigned & recor
 			std::vector<Document> docs = pim->convertToDocuments(varRecords);
 			callback(docs, lastCall);
 		};
-		pim->tabProtein.query(visitor, recordsToSkip, hintQuerySize);
+		uint64_t const first = 0;
+		uint64_t const last = std::numeric_limits<uint64_t>::max();
+		std::unique_ptr<RecordProteinVariant> lastRecord( after.protein ? pim->fetchLastProteinVariant(after) : nullptr );
+		if ( ! idTypes.empty() ) {
+			// only blocks of the table with given identifiers are read
+			std::vector<std::pair<uint64_t,uint64_t>> keysRanges = pim->indexIdentifierTypes.proteinKeysRanges(idTypes);
+			pim->tabProtein.query(visitor, keysRanges, (lastRecord ? &(lastRecord->definition) : nullptr), recordsToSkip, 1024, hintQuerySize);
+		} else if ( ! after.protein ) {
+			pim->tabProtein.query(visitor, recordsToSkip, first, last, 1024, hintQuerySize);
+		} else {
+			pim->tabProtein.query(visitor, lastRecord->definition, recordsToSkip, first, last, 1024, hintQuerySize);
+		}
 	}
 }
 
 
-// query variants from given regions (with identifiers and revision)
-void AllelesDatabase::queryVariants(callbackSendChunk callback, unsigned & recordsToSkip, ReferenceId refId, uint32_t from, uint32_t to, unsigned minChunkSize, unsigned hintQuerySize)
+// query variants from given regions (with identifiers and revision), starting after the variant given by the token
+bool AllelesDatabase::queryVariants(callbackSendChunk callback, ContinuationToken const & after, unsigned & recordsToSkip, ReferenceId refId, uint32_t from, uint32_t to, unsigned minChunkSize, unsigned hintQuerySize)
 {
 	if (pim->refDb->isProteinReference(refId)) {
 		uint64_t keyFrom, keyTo;
@@ -730,7 +961,15 @@ void AllelesDatabase::queryVariants(callbackSendChunk callback, unsigned & recor
 			std::vector<Document> docs = pim->convertToDocuments(varRecords);
 			callback(docs, lastCall);
 		};
-		pim->tabProtein.query(visitor, recordsToSkip, keyFrom, keyTo, minChunkSize, hintQuerySize);
+		if (after.isNull()) {
+			pim->tabProtein.query(visitor, recordsToSkip, keyFrom, keyTo, minChunkSize, hintQuerySize);
+		} else {
+			if ( ! after.protein ) return false;
+			std::unique_ptr<RecordProteinVariant> lastRecord(pim->fetchLastProteinVariant(after));
+			uint64_t const key = lastRecord->definition.proteinAccIdAndFirstPosition();
+			if (key > keyTo || key + lastRecord->definition.raw()[0].lengthBefore <= keyFrom) return false;
+			pim->tabProtein.query(visitor, lastRecord->definition, recordsToSkip, keyFrom, keyTo, minChunkSize, hintQuerySize);
+		}
 	} else {
 		uint32_t keyFrom, keyTo;
 		pim->genomicCoordinates2Key(refId, from, keyFrom);
@@ -741,32 +980,53 @@ void AllelesDatabase::queryVariants(callbackSendChunk callback, unsigned & recor
 			std::vector<Document> docs = pim->convertToDocuments(varRecords);
 			callback(docs, lastCall);
 		};
-		pim->tabGenomic.query(visitor, recordsToSkip, keyFrom, keyTo, minChunkSize, hintQuerySize);
+		if (after.isNull()) {
+			pim->tabGenomic.query(visitor, recordsToSkip, keyFrom, keyTo, minChunkSize, hintQuerySize);
+		} else {
+			if (after.protein) return false;
+			std::unique_ptr<RecordGenomicVariant> lastRecord(pim->fetchLastGenomicVariant(after));
+			uint32_t const key = lastRecord->definition.firstPosition();
+			if (key > keyTo || key + lastRecord->definition.raw()[0].lengthBefore <= keyFrom) return false;
+			pim->tabGenomic.query(visitor, lastRecord->definition, recordsToSkip, keyFrom, keyTo, minChunkSize, hintQuerySize);
+		}
 	}
+	return true;
 }
 
 
-// query all genomic variants
-void AllelesDatabase::queryGenomicVariants(callbackSendChunk callback, unsigned & recordsToSkip, unsigned minChunkSize)
+// query all genomic variants, starting after the variant given by the token
+void AllelesDatabase::queryGenomicVariants(callbackSendChunk callback, ContinuationToken const & after, unsigned & recordsToSkip, unsigned minChunkSize)
 {
 	auto visitor = [this,callback](std::vector<RecordGenomicVariant*> & varRecords, bool & lastCall)
 	{
 		std::vector<Document> docs = pim->convertToDocuments(varRecords);
 		callback(docs, lastCall);
 	};
-	pim->tabGenomic.query(visitor, recordsToSkip, 0, std::numeric_limits<uint32_t>::max(), minChunkSize);
+	if (after.isNull()) {
+		pim->tabGenomic.query(visitor, recordsToSkip, 0, std::numeric_limits<uint32_t>::max(), minChunkSize);
+	} else {
+		if (after.protein) throw ExceptionIncorrectRequest("Continuation token with PA ID cannot be used in query for genomic alleles.");
+		std::unique_ptr<RecordGenomicVariant> lastRecord(pim->fetchLastGenomicVariant(after));
+		pim->tabGenomic.query(visitor, lastRecord->definition, recordsToSkip, 0, std::numeric_limits<uint32_t>::max(), minChunkSize);
+	}
 }
 
 
-// query all protein variants
-void AllelesDatabase::queryProteinVariants(callbackSendChunk callback, unsigned & recordsToSkip, unsigned minChunkSize)
+// query all protein variants, starting after the variant given by the token
+void AllelesDatabase::queryProteinVariants(callbackSendChunk callback, ContinuationToken const & after, unsigned & recordsToSkip, unsigned minChunkSize)
 {
 	auto visitor = [this,callback](std::vector<RecordProteinVariant*> & varRecords, bool & lastCall)
 	{
 		std::vector<Document> docs = pim->convertToDocuments(varRecords);
 		callback(docs, lastCall);
 	};
-	pim->tabProtein.query(visitor, recordsToSkip, 0, std::numeric_limits<uint64_t>::max(), minChunkSize);
+	if (after.isNull()) {
+		pim->tabProtein.query(visitor, recordsToSkip, 0, std::numeric_limits<uint64_t>::max(), minChunkSize);
+	} else {
+		if ( ! after.protein ) throw ExceptionIncorrectRequest("Continuation token with CA ID cannot be used in query for protein alleles.");
+		std::unique_ptr<RecordProteinVariant> lastRecord(pim->fetchLastProteinVariant(after));
+		pim->tabProtein.query(visitor, lastRecord->definition, recordsToSkip, 0, std::numeric_limits<uint64_t>::max(), minChunkSize);
+	}
 }
 
 
@@ -792,11 +1052,13 @@ void AllelesDatabase::deleteIdentifiers(identifierType idType, uint32_t from, ui
 		// delete identifiers from variant's records
 		pim->tabGenomic.deleteIdentifiers(genomicVars, idType);
 		pim->tabProtein.deleteIdentifiers(proteinVars, idType);
+		pim->commitChanges();
 		for (auto r: genomicVars) delete r;
 		for (auto r: proteinVars) delete r;
 	};
 
 	index->second->deleteEntries(deleteFunc, from, to, 512*1024);
+	pim->commitChanges();
 }
 
 
@@ -5,6 +5,22 @@
 #include "../referencesDatabase/referencesDatabase.hpp"
 #include <functional>
 
+
+// continuation token for queries (keyset pagination), it identifies the last variant returned by the previous query
+// the next query starts directly after this variant, so the cost of a page does not depend on the number of preceding pages
+struct ContinuationToken
+{
+	bool protein = false;  // PA ID if true, CA ID otherwise
+	CanonicalId id;        // null - start from the beginning
+	ContinuationToken() {}
+	ContinuationToken(bool pProtein, CanonicalId pId) : protein(pProtein), id(pId) {}
+	inline bool isNull() const { return id.isNull(); }
+	// the token has the form of CA/PA ID of the last returned variant, ExceptionIncorrectRequest is thrown for incorrect values
+	static ContinuationToken fromString(std::string const &);
+	std::string toString() const;
+};
+
+
 class AllelesDatabase
 {
 private:
@@ -48,6 +64,14 @@ public:
 	void queryGenomicVariants(callbackSendChunk, unsigned & recordsToSkip, unsigned minChunkSize = 32*1204);
 	// query all protein variants
 	void queryProteinVariants(callbackSendChunk, unsigned & recordsToSkip, unsigned minChunkSize = 32*1204);
+	// =============== query... methods with continuation token, the results start after the variant given by the token
+	// recordsToSkip is applied to the records following the token
+	void queryVariants(callbackSendChunk, ContinuationToken const & after, unsigned & recordsToSkip, std::vector<identifierType> const & idType = std::vector<identifierType>(), unsigned hintQuerySize = std::numeric_limits<unsigned>::max());
+	// returns false and calls nothing if the variant given by the token does not belong to the region
+	bool queryVariants(callbackSendChunk, ContinuationToken const & after, unsigned & recordsToSkip, ReferenceId refId, uint32_t from, uint32_t to
+						, unsigned minChunkSize = 32*1204, unsigned hintQuerySize = std::numeric_limits<unsigned>::max());
+	void queryGenomicVariants(callbackSendChunk, ContinuationToken const & after, unsigned & recordsToSkip, unsigned minChunkSize = 32*1204);
+	void queryProteinVariants(callbackSendChunk, ContinuationToken const & after, unsigned & recordsToSkip, unsigned minChunkSize = 32*1204);
 	// ================ delete an interval of keys from an index
 	// delete interval of short identifiers
 	void deleteIdentifiers(identifierType, uint32_t from = 0, uint32_t to = std::numeric_limits<uint32_t>::max());
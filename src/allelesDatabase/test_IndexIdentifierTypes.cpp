@@ -0,0 +1,150 @@
+#include "IndexIdentifierTypes.hpp"
+#include "../apiDb/TasksManager.hpp"
+#include <iostream>
+#include <map>
+
+
+unsigned const blockBits = IndexIdentifierTypes::blockBits;
+unsigned const blocksPerContainer = 4096;
+
+// blocks marked in the index: idType -> blocks
+std::map<identifierType,std::set<uint64_t>> genomicBlocks;
+std::map<identifierType,std::set<uint64_t>> proteinBlocks;
+
+
+// expected result of genomicKeysRanges()/proteinKeysRanges(), ranges separated by less than 4096 keys are merged
+std::vector<std::pair<uint64_t,uint64_t>> expectedRanges(std::map<identifierType,std::set<uint64_t>> const & blocks, std::vector<identifierType> const & idTypes)
+{
+	std::set<uint64_t> all;
+	for (auto idType: idTypes) if (blocks.count(idType)) all.insert(blocks.at(idType).begin(), blocks.at(idType).end());
+	std::vector<std::pair<uint64_t,uint64_t>> ranges;
+	for (auto block: all) {
+		uint64_t const first = (block << blockBits);
+		uint64_t const last = ((block + 1) << blockBits) - 1;
+		if ( (! ranges.empty()) && first <= ranges.back().second + 4096 ) {
+			ranges.back().second = last;
+		} else {
+			ranges.push_back( std::make_pair(first, last) );
+		}
+	}
+	return ranges;
+}
+
+
+template<typename tKey>
+void checkRanges(std::vector<std::pair<tKey,tKey>> const & ranges, std::vector<std::pair<uint64_t,uint64_t>> const & expected, std::string const & name)
+{
+	bool ok = (ranges.size() == expected.size());
+	for (unsigned i = 0; ok && i < ranges.size(); ++i) ok = (ranges[i].first == expected[i].first && ranges[i].second == expected[i].second);
+	if ( ! ok ) {
+		std::cerr << "ERROR: incorrect ranges (" << name << "): " << ranges.size() << " returned, " << expected.size() << " expected" << std::endl;
+		for (unsigned i = 0; i < ranges.size() && i < expected.size(); ++i) {
+			if (ranges[i].first == expected[i].first && ranges[i].second == expected[i].second) continue;
+			std::cerr << "first difference: [" << ranges[i].first << "," << ranges[i].second << "] != [" << expected[i].first << "," << expected[i].second << "]" << std::endl;
+			break;
+		}
+		throw std::logic_error("Incorrect ranges");
+	}
+}
+
+
+void checkAllRanges(IndexIdentifierTypes const & index, std::string const & name)
+{
+	std::vector<std::vector<identifierType>> const queries = { {identifierType::dbSNP}, {identifierType::ClinVarAllele}
+															 , {identifierType::dbSNP, identifierType::ClinVarAllele}, {identifierType::COSMIC} };
+	for (auto const & idTypes: queries) {
+		std::string const name2 = name + ", types: " + std::to_string(idTypes.size()) + "/" + std::to_string(static_cast<unsigned>(idTypes.front()));
+		checkRanges(index.genomicKeysRanges(idTypes), expectedRanges(genomicBlocks, idTypes), "genomic, " + name2);
+		checkRanges(index.proteinKeysRanges(idTypes), expectedRanges(proteinBlocks, idTypes), "protein, " + name2);
+	}
+}
+
+
+IdentifierShort identifierOfType(identifierType idType, uint64_t block)
+{
+	if (idType == identifierType::dbSNP) return Identifier_dbSNP(block);
+	return Identifier_ClinVarAllele(block);
+}
+
+
+// adds variants from given blocks (the key is in the middle of the block)
+void addGenomic(IndexIdentifierTypes & index, identifierType idType, std::vector<uint64_t> const & blocks)
+{
+	std::vector<RecordGenomicVariant*> records;
+	for (auto block: blocks) {
+		records.push_back( new RecordGenomicVariant( static_cast<uint32_t>((block << blockBits) + (block % 64)) ) );
+		records.back()->identifiers.add( identifierOfType(idType, block) );
+		genomicBlocks[idType].insert(block);
+	}
+	index.addVariants( std::vector<RecordGenomicVariant const *>(records.begin(), records.end()) );
+	for (auto r: records) delete r;
+}
+
+void addProtein(IndexIdentifierTypes & index, identifierType idType, std::vector<uint64_t> const & blocks)
+{
+	std::vector<RecordProteinVariant*> records;
+	for (auto block: blocks) {
+		records.push_back( new RecordProteinVariant( (block << blockBits) + (block % 64) ) );
+		records.back()->identifiers.add( identifierOfType(idType, block) );
+		proteinBlocks[idType].insert(block);
+	}
+	index.addVariants( std::vector<RecordProteinVariant const *>(records.begin(), records.end()) );
+	for (auto r: records) delete r;
+}
+
+
+// blocks from given ranges of offsets in the container
+std::vector<uint64_t> blocksOfContainer(uint64_t container, std::vector<std::pair<unsigned,unsigned>> const & offsets)
+{
+	std::vector<uint64_t> blocks;
+	for (auto const & r: offsets) for (unsigned o = r.first; o <= r.second; ++o) blocks.push_back(container * blocksPerContainer + o);
+	return blocks;
+}
+
+
+int main(int argc, char ** argv)
+{
+	TasksManager taskManager(1);
+	TasksManager taskManager2(1);
+	IndexIdentifierTypes * index = new IndexIdentifierTypes("./dbTest/", &taskManager, &taskManager2, 128);
+
+	// ----- genomic blocks: the container saved as a bitmap (clusters not aligned to bytes), the container saved as an array,
+	// the container switched from the array to the bitmap, the last block of 32-bit keys
+	addGenomic(*index, identifierType::dbSNP, blocksOfContainer(0, {{3,55}, {200,260}, {1000,1100}, {2000,2090}, {4000,4050}}));
+	addGenomic(*index, identifierType::dbSNP, blocksOfContainer(1, {{5,5}, {300,301}, {4000,4000}}));
+	addGenomic(*index, identifierType::ClinVarAllele, {7, 5000, 10000, 123456});
+	addGenomic(*index, identifierType::dbSNP, {(0xffffffffull >> blockBits)});
+	checkAllRanges(*index, "genomic containers");
+
+	// the container has exactly maxArraySize blocks (array), then one more (bitmap), then new blocks are added to the bitmap
+	addGenomic(*index, identifierType::dbSNP, blocksOfContainer(2, {{10,137}, {300,427}}));
+	checkAllRanges(*index, "array with 256 blocks");
+	addGenomic(*index, identifierType::dbSNP, blocksOfContainer(2, {{1001,1001}}));
+	checkAllRanges(*index, "bitmap with 257 blocks");
+	addGenomic(*index, identifierType::dbSNP, blocksOfContainer(2, {{2003,2003}, {4095,4095}}));
+	checkAllRanges(*index, "bitmap extended");
+
+	// ----- protein blocks: 64-bit keys (containers above 32 bits, the last block of 64-bit keys), the same types as genomic
+	addProtein(*index, identifierType::dbSNP, {(1ull << 34), (1ull << 34) + 4095, (0xfedcba9876543210ull >> blockBits)});
+	addProtein(*index, identifierType::dbSNP, blocksOfContainer((1ull << 45) + 3, {{100,200}, {700,900}}));
+	addProtein(*index, identifierType::ClinVarAllele, {(~0ull >> blockBits), 1, 2});
+	checkAllRanges(*index, "protein containers");
+
+	// ----- clear() removes bitmaps of given types only, they can be rebuilt
+	std::map<identifierType,std::set<uint64_t>> const genomicBefore = genomicBlocks;
+	std::map<identifierType,std::set<uint64_t>> const proteinBefore = proteinBlocks;
+	index->clear({identifierType::dbSNP});
+	genomicBlocks.erase(identifierType::dbSNP);
+	proteinBlocks.erase(identifierType::dbSNP);
+	checkAllRanges(*index, "after clear");
+	addGenomic(*index, identifierType::dbSNP, std::vector<uint64_t>(genomicBefore.at(identifierType::dbSNP).begin(), genomicBefore.at(identifierType::dbSNP).end()));
+	addProtein(*index, identifierType::dbSNP, std::vector<uint64_t>(proteinBefore.at(identifierType::dbSNP).begin(), proteinBefore.at(identifierType::dbSNP).end()));
+	if (genomicBlocks != genomicBefore || proteinBlocks != proteinBefore) throw std::logic_error("Assertion 1");
+	checkAllRanges(*index, "after rebuild");
+
+	delete index;
+
+	std::cout << "OK!" << std::endl;
+
+	return 0;
+}
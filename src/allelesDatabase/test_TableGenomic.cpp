@@ -99,6 +99,159 @@ int main(int argc, char ** argv)
 		}
 	}
 
+	// keyset pagination - pages must be consecutive parts of the full result
+	unsigned const pageSize = 10000;
+	for (unsigned i = 0; i < records4.size(); ) {
+		std::vector<RecordGenomicVariant*> page;
+		auto callbackPage = [&page,pageSize](std::vector<RecordGenomicVariant*> & records, bool & lastCall)
+		{
+			for (auto r: records) {
+				if (page.size() < pageSize) page.push_back(r);
+				else delete r;
+			}
+			records.clear();
+			if (page.size() == pageSize) lastCall = true;
+		};
+		skip = 0;
+		if (i == 0) tab->query(callbackPage, skip);
+		else tab->query(callbackPage, records4[i-1]->definition, skip);
+		if (page.empty()) {
+			std::cerr << "ERROR: empty page i=" << i << std::endl;
+			break;
+		}
+		for (auto r: page) {
+			if (i >= records4.size() || r->definition != records4[i]->definition) {
+				std::cerr << "ERROR: incorrect record in page i=" << i << std::endl;
+				i = records4.size();
+			}
+			++i;
+			delete r;
+		}
+	}
+
+	// query restricted to ranges of keys - the result must be the matching part of the full result; the variant to start
+	// after is not given, it is in the range or between ranges (then preceding ranges are skipped)
+	{
+		std::vector<std::pair<uint32_t,uint32_t>> const keysRanges = { {records4[1000]->key, records4[1999]->key}
+				, {records4[500000]->key, records4[500499]->key}, {records4[999900]->key, records4.back()->key} };
+		std::vector<RecordGenomicVariant const *> const afterRecords = { nullptr, records4[500200], records4[300000] };
+		for (unsigned iAfter = 0; iAfter < afterRecords.size(); ++iAfter) {
+			BinaryGenomicVariantDefinition const * after = (afterRecords[iAfter] == nullptr) ? nullptr : &(afterRecords[iAfter]->definition);
+			std::vector<RecordGenomicVariant const *> expected;
+			for (auto r: records4) {
+				if (after != nullptr && ! (*after < r->definition)) continue;
+				for (auto const & kr: keysRanges) if (kr.first <= r->key && r->key <= kr.second) expected.push_back(r);
+			}
+			std::vector<RecordGenomicVariant*> found;
+			auto callbackRanges = [&found](std::vector<RecordGenomicVariant*> & records, bool & lastCall)
+			{
+				found.insert( found.end(), records.begin(), records.end() );
+				records.clear();
+			};
+			skip = iAfter;
+			tab->query(callbackRanges, keysRanges, after, skip);
+			expected.erase(expected.begin(), expected.begin() + iAfter);
+			if (found.size() != expected.size()) {
+				std::cerr << "ERROR: incorrect records count in query with ranges: " << found.size() << " != " << expected.size() << " after=" << iAfter << std::endl;
+			}
+			for (unsigned i = 0; i < found.size() && i < expected.size(); ++i) {
+				if (found[i]->definition != expected[i]->definition || found[i]->identifiers != expected[i]->identifiers) {
+					std::cerr << "ERROR: incorrect record in query with ranges i=" << i << " after=" << iAfter << std::endl;
+					break;
+				}
+			}
+			for (auto r: found) delete r;
+		}
+	}
+
+	// many alleles with the same key (definitions are matched by the hash table of fingerprints), some of them are given
+	// three times with different identifiers - all duplicates must end up with the union of identifiers and the same CA ID
+	{
+		uint32_t const position = 2000000;
+		auto definitionOfAllele = [position](unsigned k)->BinaryGenomicVariantDefinition
+		{
+			std::vector<BinaryNucleotideSequenceModification> rawDef(1);
+			BinaryNucleotideSequenceModification & sr = rawDef.front();
+			sr.position = position;
+			sr.category = variantCategory::nonShiftable;
+			sr.lengthBefore = k + 1;
+			sr.lengthChangeOrSeqLength = 1;
+			sr.sequence = k % 4;
+			return BinaryGenomicVariantDefinition(rawDef);
+		};
+		std::map<BinaryGenomicVariantDefinition,BinaryIdentifiers> expectedIds;
+		std::map<BinaryGenomicVariantDefinition,uint32_t> caIds;
+		uint32_t nextId = 3000000;
+		// every third allele is given three times, next copies come after all alleles (after the switch to the hash table)
+		auto inputBatch = [&](unsigned allelesCount, identifierType idType)->std::vector<RecordGenomicVariant*>
+		{
+			std::vector<RecordGenomicVariant*> batch;
+			for (unsigned copy = 0; copy < 3; ++copy) {
+				for (unsigned k = 0; k < allelesCount; ++k) {
+					if (copy > 0 && k % 3 != 0) continue;
+					RecordGenomicVariant * r = new RecordGenomicVariant(definitionOfAllele(k));
+					if (idType == identifierType::dbSNP) r->identifiers.add( Identifier_dbSNP(nextId++) );
+					else r->identifiers.add( Identifier_ClinVarAllele(nextId++) );
+					expectedIds.emplace(r->definition, BinaryIdentifiers(identifierType::CA)).first->second.add(r->identifiers);
+					batch.push_back(r);
+				}
+			}
+			return batch;
+		};
+		// records must have all identifiers of their definition and CA IDs consistent with previous calls
+		auto checkRecords = [&](std::vector<RecordGenomicVariant*> const & records, std::string const & name)
+		{
+			for (auto r: records) {
+				if (r->identifiers.lastId() == CanonicalId::null.value) throw std::logic_error("Assertion 7 (" + name + ")");
+				if (caIds.emplace(r->definition, r->identifiers.lastId()).first->second != r->identifiers.lastId()) {
+					throw std::logic_error("Assertion 8 (" + name + ")");
+				}
+				if (r->identifiers.rawShort() != expectedIds.at(r->definition).rawShort()) {
+					std::cerr << "ERROR: incorrect identifiers (" << name << ") " << r->definition.toString() << std::endl;
+					throw std::logic_error("Assertion 9 (" + name + ")");
+				}
+			}
+			std::set<uint32_t> distinctCaIds;
+			for (auto const & kv: caIds) distinctCaIds.insert(kv.second);
+			if (distinctCaIds.size() != caIds.size()) throw std::logic_error("Assertion 10 (" + name + ")");
+		};
+
+		// ----- new alleles, duplicates are merged in the input
+		std::vector<RecordGenomicVariant*> batch1 = inputBatch(40, identifierType::dbSNP);
+		changesInIndexes.clear();
+		tab->fetchAndAdd(batch1, changesInIndexes);
+		if (changesInIndexes.size() != 2 || changesInIndexes.at(identifierType::CA).size() != 40) throw std::logic_error("Assertion 11");
+		if (changesInIndexes.at(identifierType::dbSNP).size() != batch1.size()) throw std::logic_error("Assertion 12");
+		checkRecords(batch1, "new alleles");
+
+		// ----- the same alleles and a few new ones, duplicates are merged in the input and with the database
+		std::vector<RecordGenomicVariant*> batch2 = inputBatch(46, identifierType::ClinVarAllele);
+		changesInIndexes.clear();
+		tab->fetchAndAdd(batch2, changesInIndexes);
+		if (changesInIndexes.size() != 2 || changesInIndexes.at(identifierType::CA).size() != 6) throw std::logic_error("Assertion 13");
+		if (changesInIndexes.at(identifierType::ClinVarAllele).size() != batch2.size()) throw std::logic_error("Assertion 14");
+		checkRecords(batch2, "existing alleles");
+
+		// ----- the database contains each allele once, with all identifiers
+		std::vector<RecordGenomicVariant*> found;
+		auto callbackKey = [&found](std::vector<RecordGenomicVariant*> & records, bool & lastCall)
+		{
+			found.insert( found.end(), records.begin(), records.end() );
+			records.clear();
+		};
+		skip = 0;
+		tab->query(callbackKey, std::vector<std::pair<uint32_t,uint32_t>>(1, std::make_pair(position,position)), nullptr, skip);
+		if (found.size() != expectedIds.size()) {
+			std::cerr << "ERROR: incorrect records count for the key with many alleles: " << found.size() << " != " << expectedIds.size() << std::endl;
+			throw std::logic_error("Assertion 15");
+		}
+		checkRecords(found, "records in the database");
+
+		for (auto r: batch1) delete r;
+		for (auto r: batch2) delete r;
+		for (auto r: found) delete r;
+	}
+
 	delete tab;
 
 	std::cout << "OK!" << std::endl;
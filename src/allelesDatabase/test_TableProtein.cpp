@@ -104,6 +104,41 @@ int main(int argc, char ** argv)
 		}
 	}
 
+	// query restricted to ranges of keys - the result must be the matching part of the full result; the variant to start
+	// after is not given, it is in the range or between ranges (then preceding ranges are skipped)
+	{
+		std::vector<std::pair<uint64_t,uint64_t>> const keysRanges = { {records4[1000]->key, records4[1999]->key}
+				, {records4[500000]->key, records4[500499]->key}, {records4[999900]->key, records4.back()->key} };
+		std::vector<RecordProteinVariant const *> const afterRecords = { nullptr, records4[500200], records4[300000] };
+		for (unsigned iAfter = 0; iAfter < afterRecords.size(); ++iAfter) {
+			BinaryProteinVariantDefinition const * after = (afterRecords[iAfter] == nullptr) ? nullptr : &(afterRecords[iAfter]->definition);
+			std::vector<RecordProteinVariant const *> expected;
+			for (auto r: records4) {
+				if (after != nullptr && ! (*after < r->definition)) continue;
+				for (auto const & kr: keysRanges) if (kr.first <= r->key && r->key <= kr.second) expected.push_back(r);
+			}
+			std::vector<RecordProteinVariant*> found;
+			auto callbackRanges = [&found](std::vector<RecordProteinVariant*> & records, bool & lastCall)
+			{
+				found.insert( found.end(), records.begin(), records.end() );
+				records.clear();
+			};
+			skip = iAfter;
+			tab->query(callbackRanges, keysRanges, after, skip);
+			expected.erase(expected.begin(), expected.begin() + iAfter);
+			if (found.size() != expected.size()) {
+				std::cerr << "ERROR: incorrect records count in query with ranges: " << found.size() << " != " << expected.size() << " after=" << iAfter << std::endl;
+			}
+			for (unsigned i = 0; i < found.size() && i < expected.size(); ++i) {
+				if (found[i]->definition != expected[i]->definition || found[i]->identifiers != expected[i]->identifiers) {
+					std::cerr << "ERROR: incorrect record in query with ranges i=" << i << " after=" << iAfter << std::endl;
+					break;
+				}
+			}
+			for (auto r: found) delete r;
+		}
+	}
+
 	delete tab;
 
 	std::cout << "OK!" << std::endl;
@@ -1,6 +1,11 @@
 
 #include "tools.hpp"
 #include <stdexcept>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NUCLEOTIDES_SIMD
+#endif
 
 // =================== amino-acid codes
 
@@ -65,23 +70,28 @@ inline char number2aminoAcid(unsigned const aa)
 }
 
 // save the sequence on LSBits, in the order from MS to LS
-uint32_t convertGenomicToBinary(std::string const & seq)
+uint32_t convertGenomicToBinary(char const * seq, unsigned length)
 {
 	uint32_t value = 0;
-	if (seq.size() > 16) throw std::logic_error("Sequence larger than 16 bp");
-	for (char c: seq) {
+	if (length > 16) throw std::logic_error("Sequence larger than 16 bp");
+	for (unsigned i = 0; i < length; ++i) {
 		value <<= 2;
-		switch (c) {
+		switch (seq[i]) {
 			case 'A': value += 0; break;
 			case 'C': value += 1; break;
 			case 'G': value += 2; break;
 			case 'T': value += 3; break;
-			default: throw std::logic_error("Incorrect genomic sequence: " + seq);
+			default: throw std::logic_error("Incorrect genomic sequence: " + std::string(seq, length));
 		}
 	}
 	return value;
 }
 
+uint32_t convertGenomicToBinary(std::string const & seq)
+{
+	return convertGenomicToBinary(seq.data(), seq.size());
+}
+
 // read the sequence from the unsigned integer, sequence is saved on LSBits, in the order from MS to LS
 std::string convertBinaryToGenomic(uint32_t value, unsigned length)
 {
@@ -101,6 +111,257 @@ std::string convertBinaryToGenomic(uint32_t value, unsigned length)
 }
 
 
+// =================== packed nucleotides (4 per byte)
+
+// 2-bit codes of nucleotides for all chars (0xff for incorrect chars)
+struct NucleotideCodes
+{
+	uint8_t code[256];
+	char bases[256][4];  // 4 nucleotides saved in a byte
+	NucleotideCodes()
+	{
+		for (unsigned i = 0; i < 256; ++i) code[i] = 0xff;
+		code[uint8_t('A')] = 0;
+		code[uint8_t('C')] = 1;
+		code[uint8_t('G')] = 2;
+		code[uint8_t('T')] = 3;
+		for (unsigned i = 0; i < 256; ++i) {
+			for (unsigned j = 0; j < 4; ++j) bases[i][j] = "ACGT"[(i >> (6 - 2*j)) & 3];
+		}
+	}
+};
+static NucleotideCodes const nucleotideCodes;
+
+// packs nucleotides from the position begin (multiple of 4), the whole sequence is reported in the exception
+static void packNucleotidesScalar(char const * seq, unsigned begin, unsigned length, uint8_t * out)
+{
+	for (unsigned i = begin; i < length; i += 4) {
+		unsigned byte = 0;
+		for (unsigned j = i; j < i + 4; ++j) {
+			byte <<= 2;
+			if (j >= length) continue;
+			unsigned const c = nucleotideCodes.code[uint8_t(seq[j])];
+			if (c > 3) throw std::logic_error("Incorrect genomic sequence: " + std::string(seq, length));
+			byte += c;
+		}
+		out[i / 4] = byte;
+	}
+}
+
+static void unpackNucleotidesScalar(uint8_t const * data, unsigned length, char * seq)
+{
+	unsigned i = 0;
+	for ( ;  i + 4 <= length;  i += 4) {
+		char const * bases = nucleotideCodes.bases[data[i / 4]];
+		seq[i] = bases[0];
+		seq[i+1] = bases[1];
+		seq[i+2] = bases[2];
+		seq[i+3] = bases[3];
+	}
+	for (unsigned j = 0; i < length; ++i, ++j) seq[i] = nucleotideCodes.bases[data[i / 4]][j];
+}
+
+#ifdef NUCLEOTIDES_SIMD
+
+// codes of 16 nucleotides are looked up by the low nibble of chars (A=1, C=3, G=7, T=4), incorrect chars are set in invalid
+__attribute__((target("sse4.1")))
+static inline __m128i codesOfNucleotides(__m128i chars, __m128i & invalid)
+{
+	__m128i const codes = _mm_setr_epi8(0,0,0,1, 3,0,0,2, 0,0,0,0, 0,0,0,0);
+	__m128i const bases = _mm_setr_epi8(0,'A',0,'C', 'T',0,0,'G', 0,0,0,0, 0,0,0,0);
+	__m128i const nibbles = _mm_and_si128(chars, _mm_set1_epi8(0x0f));
+	invalid = _mm_or_si128(invalid, _mm_xor_si128(chars, _mm_shuffle_epi8(bases, nibbles)));
+	return _mm_shuffle_epi8(codes, nibbles);
+}
+
+// 4 bases per 32-bit word: codes (c0,c1,c2,c3) -> c0*64+c1*16+c2*4+c3
+__attribute__((target("sse4.1")))
+static inline __m128i packCodes(__m128i codes)
+{
+	__m128i const pairs = _mm_maddubs_epi16(codes, _mm_set1_epi16(0x0104));
+	return _mm_madd_epi16(pairs, _mm_set1_epi32(0x00010010));
+}
+
+// nucleotides from 4 bytes replicated on 16 bytes (each byte 4 times)
+__attribute__((target("sse4.1")))
+static inline __m128i basesOfBytes(__m128i bytes)
+{
+	__m128i const highBits = _mm_setr_epi8(-1,-1,0,0, -1,-1,0,0, -1,-1,0,0, -1,-1,0,0);
+	__m128i const evenPositions = _mm_setr_epi8(-1,0,-1,0, -1,0,-1,0, -1,0,-1,0, -1,0,-1,0);
+	__m128i const basesOfHigh = _mm_setr_epi8('A','A','A','A', 'C','C','C','C', 'G','G','G','G', 'T','T','T','T');
+	__m128i const basesOfLow = _mm_setr_epi8('A','C','G','T', 'A','C','G','T', 'A','C','G','T', 'A','C','G','T');
+	__m128i const mask = _mm_set1_epi8(0x0f);
+	__m128i const nibbles = _mm_blendv_epi8(_mm_and_si128(bytes, mask), _mm_and_si128(_mm_srli_epi16(bytes, 4), mask), highBits);
+	return _mm_blendv_epi8(_mm_shuffle_epi8(basesOfLow, nibbles), _mm_shuffle_epi8(basesOfHigh, nibbles), evenPositions);
+}
+
+// returns number of processed nucleotides (multiple of 16), incorrect sequences are left for the scalar version
+__attribute__((target("sse4.1")))
+static unsigned packNucleotidesSse(char const * seq, unsigned length, uint8_t * out)
+{
+	__m128i invalid = _mm_setzero_si128();
+	unsigned i = 0;
+	for ( ;  i + 64 <= length;  i += 64) {
+		__m128i const q0 = packCodes(codesOfNucleotides(_mm_loadu_si128(reinterpret_cast<__m128i const *>(seq + i     )), invalid));
+		__m128i const q1 = packCodes(codesOfNucleotides(_mm_loadu_si128(reinterpret_cast<__m128i const *>(seq + i + 16)), invalid));
+		__m128i const q2 = packCodes(codesOfNucleotides(_mm_loadu_si128(reinterpret_cast<__m128i const *>(seq + i + 32)), invalid));
+		__m128i const q3 = packCodes(codesOfNucleotides(_mm_loadu_si128(reinterpret_cast<__m128i const *>(seq + i + 48)), invalid));
+		__m128i const bytes = _mm_packus_epi16(_mm_packs_epi32(q0, q1), _mm_packs_epi32(q2, q3));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i / 4), bytes);
+	}
+	for ( ;  i + 16 <= length;  i += 16) {
+		__m128i const q = packCodes(codesOfNucleotides(_mm_loadu_si128(reinterpret_cast<__m128i const *>(seq + i)), invalid));
+		int const bytes = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(q, q), q));
+		std::memcpy(out + i / 4, &bytes, 4);
+	}
+	return ( _mm_testz_si128(invalid, invalid) ? i : 0 );
+}
+
+__attribute__((target("sse4.1")))
+static unsigned unpackNucleotidesSse(uint8_t const * data, unsigned length, char * seq)
+{
+	__m128i const replicate0 = _mm_setr_epi8( 0, 0, 0, 0,  1, 1, 1, 1,  2, 2, 2, 2,  3, 3, 3, 3);
+	__m128i const four = _mm_set1_epi8(4);
+	unsigned i = 0;
+	for ( ;  i + 64 <= length;  i += 64) {
+		__m128i const bytes = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + i / 4));
+		__m128i replicate = replicate0;
+		for (unsigned j = 0; j < 64; j += 16) {
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(seq + i + j), basesOfBytes(_mm_shuffle_epi8(bytes, replicate)));
+			replicate = _mm_add_epi8(replicate, four);
+		}
+	}
+	for ( ;  i + 16 <= length;  i += 16) {
+		int bytes;
+		std::memcpy(&bytes, data + i / 4, 4);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(seq + i), basesOfBytes(_mm_shuffle_epi8(_mm_cvtsi32_si128(bytes), replicate0)));
+	}
+	return i;
+}
+
+// AVX2 versions work on 128-bit lanes in the same way, the rest is done by SSE versions
+__attribute__((target("avx2")))
+static inline __m256i codesOfNucleotides(__m256i chars, __m256i & invalid)
+{
+	__m256i const codes = _mm256_setr_epi8(0,0,0,1, 3,0,0,2, 0,0,0,0, 0,0,0,0, 0,0,0,1, 3,0,0,2, 0,0,0,0, 0,0,0,0);
+	__m256i const bases = _mm256_setr_epi8( 0,'A',0,'C', 'T',0,0,'G', 0,0,0,0, 0,0,0,0
+										  , 0,'A',0,'C', 'T',0,0,'G', 0,0,0,0, 0,0,0,0 );
+	__m256i const nibbles = _mm256_and_si256(chars, _mm256_set1_epi8(0x0f));
+	invalid = _mm256_or_si256(invalid, _mm256_xor_si256(chars, _mm256_shuffle_epi8(bases, nibbles)));
+	return _mm256_shuffle_epi8(codes, nibbles);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i packCodes(__m256i codes)
+{
+	__m256i const pairs = _mm256_maddubs_epi16(codes, _mm256_set1_epi16(0x0104));
+	return _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00010010));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i basesOfBytes(__m256i bytes)
+{
+	__m256i const highBits = _mm256_setr_epi8( -1,-1,0,0, -1,-1,0,0, -1,-1,0,0, -1,-1,0,0
+											 , -1,-1,0,0, -1,-1,0,0, -1,-1,0,0, -1,-1,0,0 );
+	__m256i const evenPositions = _mm256_setr_epi8( -1,0,-1,0, -1,0,-1,0, -1,0,-1,0, -1,0,-1,0
+												  , -1,0,-1,0, -1,0,-1,0, -1,0,-1,0, -1,0,-1,0 );
+	__m256i const basesOfHigh = _mm256_setr_epi8( 'A','A','A','A', 'C','C','C','C', 'G','G','G','G', 'T','T','T','T'
+												, 'A','A','A','A', 'C','C','C','C', 'G','G','G','G', 'T','T','T','T' );
+	__m256i const basesOfLow = _mm256_setr_epi8( 'A','C','G','T', 'A','C','G','T', 'A','C','G','T', 'A','C','G','T'
+											   , 'A','C','G','T', 'A','C','G','T', 'A','C','G','T', 'A','C','G','T' );
+	__m256i const mask = _mm256_set1_epi8(0x0f);
+	__m256i const nibbles = _mm256_blendv_epi8(_mm256_and_si256(bytes, mask), _mm256_and_si256(_mm256_srli_epi16(bytes, 4), mask), highBits);
+	return _mm256_blendv_epi8(_mm256_shuffle_epi8(basesOfLow, nibbles), _mm256_shuffle_epi8(basesOfHigh, nibbles), evenPositions);
+}
+
+__attribute__((target("avx2")))
+static unsigned packNucleotidesAvx2(char const * seq, unsigned length, uint8_t * out)
+{
+	// 32-bit words are in order q0[0-3] q1[0-3] q2[0-3] q3[0-3] | q0[4-7] q1[4-7] q2[4-7] q3[4-7] after packing
+	__m256i const order = _mm256_setr_epi32(0,4,1,5, 2,6,3,7);
+	__m256i invalid = _mm256_setzero_si256();
+	unsigned i = 0;
+	for ( ;  i + 128 <= length;  i += 128) {
+		__m256i const q0 = packCodes(codesOfNucleotides(_mm256_loadu_si256(reinterpret_cast<__m256i const *>(seq + i     )), invalid));
+		__m256i const q1 = packCodes(codesOfNucleotides(_mm256_loadu_si256(reinterpret_cast<__m256i const *>(seq + i + 32)), invalid));
+		__m256i const q2 = packCodes(codesOfNucleotides(_mm256_loadu_si256(reinterpret_cast<__m256i const *>(seq + i + 64)), invalid));
+		__m256i const q3 = packCodes(codesOfNucleotides(_mm256_loadu_si256(reinterpret_cast<__m256i const *>(seq + i + 96)), invalid));
+		__m256i const bytes = _mm256_packus_epi16(_mm256_packs_epi32(q0, q1), _mm256_packs_epi32(q2, q3));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i / 4), _mm256_permutevar8x32_epi32(bytes, order));
+	}
+	if ( ! _mm256_testz_si256(invalid, invalid) ) return 0;
+	unsigned const rest = packNucleotidesSse(seq + i, length - i, out + i / 4);
+	return ( (rest == 0 && length - i >= 16) ? 0 : (i + rest) );
+}
+
+__attribute__((target("avx2")))
+static unsigned unpackNucleotidesAvx2(uint8_t const * data, unsigned length, char * seq)
+{
+	// the first lane takes bytes 0-3, the second lane bytes 4-7 (8-11 and 12-15 in the next step)
+	__m256i const replicate0 = _mm256_setr_epi8( 0, 0, 0, 0,  1, 1, 1, 1,  2, 2, 2, 2,  3, 3, 3, 3
+											   , 4, 4, 4, 4,  5, 5, 5, 5,  6, 6, 6, 6,  7, 7, 7, 7 );
+	__m256i const replicate1 = _mm256_add_epi8(replicate0, _mm256_set1_epi8(8));
+	unsigned i = 0;
+	for ( ;  i + 64 <= length;  i += 64) {
+		__m256i const bytes = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<__m128i const *>(data + i / 4)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(seq + i     ), basesOfBytes(_mm256_shuffle_epi8(bytes, replicate0)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(seq + i + 32), basesOfBytes(_mm256_shuffle_epi8(bytes, replicate1)));
+	}
+	return ( i + unpackNucleotidesSse(data + i / 4, length - i, seq + i) );
+}
+
+#endif
+
+nucleotidesKernel bestNucleotidesKernel()
+{
+#ifdef NUCLEOTIDES_SIMD
+	static nucleotidesKernel const kernel = []()
+	{
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) return nucleotidesKernel::avx2;
+		if (__builtin_cpu_supports("sse4.1")) return nucleotidesKernel::sse41;
+		return nucleotidesKernel::scalar;
+	}();
+	return kernel;
+#else
+	return nucleotidesKernel::scalar;
+#endif
+}
+
+void convertGenomicToBinary(char const * seq, unsigned length, uint8_t * out, nucleotidesKernel kernel)
+{
+	unsigned done = 0;
+#ifdef NUCLEOTIDES_SIMD
+	// AVX2 loop processes 128 nucleotides, shorter sequences are processed faster by SSE version only
+	if (kernel == nucleotidesKernel::avx2 && length < 128) kernel = nucleotidesKernel::sse41;
+	if (kernel == nucleotidesKernel::avx2) done = packNucleotidesAvx2(seq, length, out);
+	if (kernel == nucleotidesKernel::sse41) done = packNucleotidesSse(seq, length, out);
+#endif
+	// the rest or the whole sequence if it is incorrect (to throw an exception)
+	packNucleotidesScalar(seq, done, length, out);
+}
+
+void convertGenomicToBinary(char const * seq, unsigned length, uint8_t * out)
+{
+	convertGenomicToBinary(seq, length, out, bestNucleotidesKernel());
+}
+
+void convertBinaryToGenomic(uint8_t const * data, unsigned length, char * seq, nucleotidesKernel kernel)
+{
+	unsigned done = 0;
+#ifdef NUCLEOTIDES_SIMD
+	if (kernel == nucleotidesKernel::avx2 && length < 64) kernel = nucleotidesKernel::sse41;
+	if (kernel == nucleotidesKernel::avx2) done = unpackNucleotidesAvx2(data, length, seq);
+	if (kernel == nucleotidesKernel::sse41) done = unpackNucleotidesSse(data, length, seq);
+#endif
+	if (done < length) unpackNucleotidesScalar(data + done / 4, length - done, seq + done);
+}
+
+void convertBinaryToGenomic(uint8_t const * data, unsigned length, char * seq)
+{
+	convertBinaryToGenomic(data, length, seq, bestNucleotidesKernel());
+}
+
 // returns number of bytes needed to save aa sequence
 unsigned lengthOfBinaryAminoAcidSequence(unsigned lengthInAA)
 {
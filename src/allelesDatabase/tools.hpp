@@ -7,10 +7,30 @@
 
 // save the sequence on LSBits, in the order from MS to LS
 uint32_t convertGenomicToBinary(std::string const & seq);
+uint32_t convertGenomicToBinary(char const * seq, unsigned length);
 
 // read the sequence from the unsigned integer, sequence is saved on LSBits, in the order from MS to LS
 std::string convertBinaryToGenomic(uint32_t value, unsigned length);
 
+// implementations of functions for packed nucleotides below, the best one supported by the CPU is chosen at runtime
+// (functions with the kernel parameter are for tests and benchmarks, the kernel must be supported by the CPU)
+enum class nucleotidesKernel : uint8_t
+{
+	  scalar
+	, sse41
+	, avx2
+};
+nucleotidesKernel bestNucleotidesKernel();
+
+// packs 4 nucleotides per byte, the first one on MSBits (16 nucleotides give the same bytes as convertGenomicToBinary() saved as
+// big-endian 32-bit integer), the last byte is filled with zeros if length is not a multiple of 4; out must have (length+3)/4 bytes
+void convertGenomicToBinary(char const * seq, unsigned length, uint8_t * out);
+void convertGenomicToBinary(char const * seq, unsigned length, uint8_t * out, nucleotidesKernel);
+
+// unpacks nucleotides saved by the function above, seq must have length chars
+void convertBinaryToGenomic(uint8_t const * data, unsigned length, char * seq);
+void convertBinaryToGenomic(uint8_t const * data, unsigned length, char * seq, nucleotidesKernel);
+
 // returns number of bytes needed to save aa sequence
 unsigned lengthOfBinaryAminoAcidSequence(unsigned lengthInAA);
 
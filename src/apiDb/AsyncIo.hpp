@@ -0,0 +1,42 @@
+#ifndef APIDB_ASYNCIO_HPP_
+#define APIDB_ASYNCIO_HPP_
+
+#include <vector>
+#include <cstdint>
+#include <sys/uio.h>
+
+// queue of asynchronous disk operations (Linux io_uring) shared by many databases
+// requests from all threads are submitted to the kernel in batches, completions are collected by reaper threads
+// if io_uring is not available, isSupported() returns false and databases use synchronous pread/pwrite
+class AsyncIo
+{
+private:
+	struct Pim;
+	Pim * pim;
+public:
+	// single request, all buffers are read/written in one vectored operation starting from the given offset
+	struct Request
+	{
+		bool write = false;
+		uint64_t offset = 0;
+		std::vector<iovec> buffers;
+	};
+	struct Statistics {
+		uint64_t submitCallsCount;   // number of system calls submitting requests
+		uint64_t requestsCount;      // number of requests sent to the kernel
+		uint64_t buffersCount;       // number of buffers in requests (one request may contain many adjacent pages)
+	};
+	// queueDepth - max number of requests submitted by one system call, reaperThreadsCount - number of threads collecting completions
+	AsyncIo(unsigned queueDepth = 256, unsigned reaperThreadsCount = 1);
+	// there must be no requests in progress
+	~AsyncIo();
+	bool isSupported() const;
+	// executes all requests on given file and returns when all of them are completed (it can be called in many threads)
+	// returns 0 or errno of the first failed request
+	int execute(int file, std::vector<Request> const & requests);
+	Statistics readAndResetStatistics();
+	// executes the request with pread/pwrite, the first bytesDone bytes are skipped, returns 0 or errno
+	static int executeSynchronously(int file, Request const & request, uint64_t bytesDone = 0);
+};
+
+#endif /* APIDB_ASYNCIO_HPP_ */
@@ -0,0 +1,43 @@
+#ifndef APIDB_CACHEBUDGET_HPP_
+#define APIDB_CACHEBUDGET_HPP_
+
+#include <cstdint>
+
+namespace flatDb {
+	class StorageWithCache;
+}
+
+// memory for caches shared by many databases, each cache has its minimum size (reserved for it), the rest of the memory
+// is moved between caches: it goes to the cache with the largest marginal hit rate - the number of misses of pages evicted
+// recently, these misses would be hits if the cache were larger by 1/16 of the budget, memory is moved in steps of 1/64 of the budget
+class CacheBudget
+{
+private:
+	struct Pim;
+	Pim * pim;
+public:
+	struct Statistics {
+		uint64_t rebalancesCount;    // number of calls of rebalance() that changed sizes of caches
+		uint64_t movedBytes;         // memory moved between caches (or given from the unassigned part of the budget)
+	};
+	// memory is rebalanced after each rebalanceInterval pages loaded by all caches
+	CacheBudget(uint64_t memoryInMegabytes, unsigned rebalanceInterval = 1024);
+	// registered caches cannot be used after the budget is deleted
+	~CacheBudget();
+	uint64_t memoryInBytes() const;
+	// memory not assigned to any cache
+	uint64_t freeMemoryInBytes() const;
+	// moves one step of memory to the cache with the largest marginal hit rate, returns true if sizes of caches were changed
+	bool rebalance();
+	Statistics readAndResetStatistics();
+
+	// ===== used by caches (synchronized)
+	// the cache gets its minimum size, std::runtime_error is thrown if the budget is too small
+	void registerCache(flatDb::StorageWithCache * cache, uint64_t minimumInMegabytes);
+	// the memory of the cache is returned to the budget
+	void unregisterCache(flatDb::StorageWithCache * cache);
+	// called after each page loaded by the cache from its storage, it may call rebalance()
+	void pageLoaded();
+};
+
+#endif /* APIDB_CACHEBUDGET_HPP_ */
@@ -0,0 +1,47 @@
+#ifndef APIDB_MEMORYARENA_HPP_
+#define APIDB_MEMORYARENA_HPP_
+
+#include <cstdint>
+
+// memory for buffers of caches, it is taken from the system in large regions (mmap) divided into slabs of the same size
+// (one slab = one page of the cache), regions are aligned to 2 MB and may be backed by huge pages, so large caches
+// do not fragment the heap and cause much less TLB misses; new slabs are taken from the region with the lowest address,
+// regions without used slabs are returned to the system (one of them is kept for next allocations)
+// if the machine has many NUMA nodes, memory of regions is interleaved between them (caches are used by all threads)
+class MemoryArena
+{
+private:
+	struct Pim;
+	Pim * pim;
+public:
+	enum class HugePages
+	{
+		  none            // regular pages (4 KB)
+		, transparent     // transparent huge pages are requested by madvise(), the kernel may use regular pages
+		, hugetlb         // explicit huge pages (they must be reserved in /proc/sys/vm/nr_hugepages), regions which cannot
+		                  // be allocated this way are backed by transparent huge pages
+	};
+	struct Statistics {
+		uint64_t mappedBytes;      // memory of all regions
+		uint64_t usedBytes;        // memory of allocated slabs
+		uint64_t hugeTlbBytes;     // memory of regions backed by explicit huge pages
+		unsigned regionsCount;
+		unsigned numaNodesCount;   // memory is interleaved between NUMA nodes if there are more than one
+	};
+	unsigned const slabSize;
+	HugePages const hugePages;
+	// regions have regionSizeInMegabytes MB (rounded up to the multiple of 2 MB and slabSize)
+	MemoryArena(unsigned slabSize, HugePages hugePages = HugePages::transparent, unsigned regionSizeInMegabytes = 32);
+	// all slabs must be freed before
+	~MemoryArena();
+
+	// ===== synchronized
+	// returns new slab (slabSize bytes, content is undefined), std::bad_alloc is thrown if there is no memory
+	uint8_t * allocate();
+	// the slab must be allocated by this arena
+	void free(uint8_t * slab);
+	// returns current state of the arena (values are not reset)
+	Statistics statistics() const;
+};
+
+#endif /* APIDB_MEMORYARENA_HPP_ */
@@ -0,0 +1,122 @@
+#ifndef APIDB_RECORDCODEC_HPP_
+#define APIDB_RECORDCODEC_HPP_
+
+#include "db.hpp"
+#include "../commonTools/assert.hpp"
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+	// Codecs translate records saved in the database to plain values and back, so hot paths can work on flat vectors
+	// of values instead of RecordT objects (no allocation of each record, no virtual calls and no dynamic_cast).
+	// Values are decoded directly from the data pages by readRawRecords()/writeRawRecords(), the codec is a class with:
+	//   typedef ... Key;     // type of the key
+	//   typedef ... Value;   // record without the key, it must have the default constructor
+	//   static unsigned dataLength(Value const &);                      // the same as RecordT::dataLength()
+	//   static void saveData(Value const &, uint8_t *& ptr);            // the same as RecordT::saveData()
+	//   static void loadData(Key, uint8_t const *& ptr, Value &);       // all fields of the value must be set (it is reused)
+
+
+	// decodes all views to values, the vector is resized (existing values are overwritten, so their buffers are reused)
+	template<typename tCodec>
+	void decodeRecords(std::vector<RecordViewT<typename tCodec::Key>> const & views, std::vector<typename tCodec::Value> & values)
+	{
+		values.resize(views.size());
+		for (unsigned i = 0; i < views.size(); ++i) {
+			uint8_t const * ptr = views[i].data;
+			tCodec::loadData(views[i].key, ptr, values[i]);
+			if (ptr != views[i].data + views[i].length) {
+				throw std::logic_error( "Record length do not match number of bytes read! Expected: " + std::to_string(views[i].length)
+									  + " Key: " + std::to_string(views[i].key) + " position: " + std::to_string(ptr - views[i].data) );
+			}
+		}
+	}
+
+
+	// encodes values to the space given by allocate function, views are replaced by views of new records
+	template<typename tCodec>
+	void encodeRecords( typename tCodec::Key key, std::vector<typename tCodec::Value> const & values
+					  , std::vector<RecordViewT<typename tCodec::Key>> & views, typename RecordT<typename tCodec::Key>::tAllocateRawRecordFunction allocate )
+	{
+		views.clear();
+		views.reserve(values.size());
+		for (auto const & value: values) {
+			RecordViewT<typename tCodec::Key> v;
+			v.key = key;
+			v.length = tCodec::dataLength(value);
+			uint8_t * ptr = allocate(v.length);
+			v.data = ptr;
+			tCodec::saveData(value, ptr);
+			ASSERT(ptr == v.data + v.length);
+			views.push_back(v);
+		}
+	}
+
+
+	// reads values with given keys from the database (or its snapshot), the visitor is called exactly once for each distinct key (concurrently for different keys)
+	template<typename tCodec, typename tDatabase>
+	void readValues( tDatabase const & db, std::vector<typename tCodec::Key> const & keys
+				   , std::function<void(typename tCodec::Key, std::vector<typename tCodec::Value> const &)> visitor )
+	{
+		typedef typename tCodec::Key Key;
+		auto rawVisitor = [&visitor](Key key, std::vector<RecordViewT<Key>> const & views)
+		{
+			static thread_local std::vector<typename tCodec::Value> values;
+			decodeRecords<tCodec>(views, values);
+			visitor(key, values);
+		};
+		db.readRawRecords(keys, rawVisitor);
+	}
+
+
+	// updates values with given keys, the visitor is called exactly once for each distinct key (concurrently for different keys)
+	// it can modify, add or remove values and returns true if they must be saved; records of keys without changes are not
+	// encoded again (their data is not copied)
+	template<typename tCodec, typename tDatabase>
+	void writeValues( tDatabase & db, std::vector<typename tCodec::Key> const & keys
+					, std::function<bool(typename tCodec::Key, std::vector<typename tCodec::Value> &)> visitor )
+	{
+		typedef typename tCodec::Key Key;
+		auto rawVisitor = [&visitor](Key key, std::vector<RecordViewT<Key>> & views, typename RecordT<Key>::tAllocateRawRecordFunction allocate)->bool
+		{
+			static thread_local std::vector<typename tCodec::Value> values;
+			decodeRecords<tCodec>(views, values);
+			if ( ! visitor(key, values) ) return false;
+			encodeRecords<tCodec>(key, values, views, allocate);
+			return true;
+		};
+		db.writeRawRecords(keys, rawVisitor);
+	}
+
+
+	// ===== tools to match values from the database with records given by user (records are pointers to objects with key field)
+
+	// sorts records by keys and returns sorted and unique keys, the order of records with the same key is preserved
+	template<typename tRecordPtr>
+	auto sortByKeys(std::vector<tRecordPtr> & records) -> std::vector<typename std::decay<decltype(records.front()->key)>::type>
+	{
+		typedef typename std::decay<decltype(records.front()->key)>::type Key;
+		std::stable_sort( records.begin(), records.end(), [](tRecordPtr r1, tRecordPtr r2)->bool{ return (r1->key < r2->key); } );
+		std::vector<Key> keys;
+		keys.reserve(records.size());
+		for (auto r: records) if (keys.empty() || keys.back() != r->key) keys.push_back(r->key);
+		return keys;
+	}
+
+
+	// returns the range of records with given key, records must be sorted by keys
+	template<typename tRecordPtr, typename tKey>
+	std::pair<typename std::vector<tRecordPtr>::const_iterator, typename std::vector<tRecordPtr>::const_iterator>
+		recordsWithKey(std::vector<tRecordPtr> const & records, tKey key)
+	{
+		auto it1 = std::lower_bound( records.begin(), records.end(), key, [](tRecordPtr r, tKey k)->bool{ return (r->key < k); } );
+		auto it2 = it1;
+		while (it2 != records.end() && (*it2)->key == key) ++it2;
+		return std::make_pair(it1, it2);
+	}
+
+#endif /* APIDB_RECORDCODEC_HPP_ */
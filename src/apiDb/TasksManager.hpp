@@ -2,18 +2,33 @@
 #define APIDB_TASKSMANAGER_HPP_
 
 #include <functional>
+#include <cstdint>
 
+// fixed pool of workers, each worker has its own queue, idle workers steal tasks from other workers
+// tasks with higher priority are executed first
 class TasksManager
 {
 private:
 	struct Pim;
 	Pim * pim;
 public:
+	struct Statistics {
+		uint64_t tasksCount;           // number of started tasks
+		uint64_t stolenTasksCount;     // number of tasks taken from queues of other workers
+		uint64_t queueDepth;           // current number of tasks waiting in queues
+		uint64_t maxQueueDepth;
+		uint64_t waitTimeUs;           // total time spent by tasks in queues
+		uint64_t maxWaitTimeUs;
+		uint64_t executionTimeUs;      // total execution time of tasks
+	};
 	unsigned const maxNumberOfConcurrentTasks;
 	TasksManager(unsigned numberOfTasks);
+	// waits until all tasks are completed
 	~TasksManager();
 	unsigned addTask(std::function<void()> task, unsigned priority = 1); // returns taskId
+	// returns when the task with given id is completed, it must not be called from the task itself
 	void joinTask(unsigned taskId);
+	Statistics readAndResetStatistics();
 	void printState();
 };
 
@@ -6,6 +6,11 @@
 #include <cstring>
 #include <ostream>
 #include <iostream>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <thread>
+#include <chrono>
 #include "db.hpp"
 
 
@@ -34,6 +39,58 @@ inline std::ostream& operator<<(std::ostream & str, TestRecord const & r)
 
 
 
+// modifications are committed in background, it waits until all of them are visible
+inline bool waitForRecordsCount(DatabaseT<> * db, uint64_t count)
+{
+	for (unsigned i = 0; i < 6000; ++i) {
+		if (db->getRecordsCount() == count) return true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	std::cerr << "Timeout, number of records: " << db->getRecordsCount() << ", expected: " << count << std::endl;
+	return false;
+}
+
+
+// reads all records in order (database or snapshot) and compares them with expected records [key, fData[0], fData[1]]
+// given in any order, the number of records returned by getRecordsCount() is checked too
+template<typename tReader>
+bool compareRecords(tReader const & reader, std::vector<std::array<uint64_t,3>> expected)
+{
+	std::vector<std::array<uint64_t,3>> found;
+	bool inOrder = true;
+	auto funcRead = [&found,&inOrder](std::vector<RecordT<uint32_t> const *> const & records, bool &)
+	{
+		for (auto rr: records) {
+			TestRecord const * r = dynamic_cast<TestRecord const *>(rr);
+			if ( ! found.empty() && found.back()[0] > r->key ) inOrder = false;
+			found.push_back( {{r->key, r->fData[0], r->fData[1]}} );
+		}
+	};
+	reader.readRecordsInOrder(funcRead);
+	if (! inOrder) {
+		std::cerr << "Records were not returned in the order of keys" << std::endl;
+		return false;
+	}
+	std::sort(found.begin(), found.end());
+	std::sort(expected.begin(), expected.end());
+	if (found != expected) {
+		std::cerr << "Incorrect records: " << found.size() << " read, " << expected.size() << " expected" << std::endl;
+		auto mismatch = std::mismatch(found.begin(), found.begin() + std::min(found.size(), expected.size()), expected.begin());
+		if (mismatch.first != found.end() && mismatch.second != expected.end()) {
+			std::cerr << "First difference, read: [" << (*mismatch.first)[0] << "->" << (*mismatch.first)[1] << "," << (*mismatch.first)[2] << "]";
+			std::cerr << ", expected: [" << (*mismatch.second)[0] << "->" << (*mismatch.second)[1] << "," << (*mismatch.second)[2] << "]" << std::endl;
+		}
+		return false;
+	}
+	if (reader.getRecordsCount() != expected.size()) {
+		std::cerr << "Incorrect number of records: " << reader.getRecordsCount() << ", expected: " << expected.size() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+
+
 /*
 inline std::ostream& operator<<(std::ostream & str, VariantRecord const & r)
 {
@@ -0,0 +1,58 @@
+#ifndef APIDB_WRITEAHEADLOG_HPP_
+#define APIDB_WRITEAHEADLOG_HPP_
+
+#include <string>
+#include <functional>
+#include <cstdint>
+
+// log shared by many databases, changes of all attached databases become durable together when commit() is called
+// (group commit - one fsync for all databases), files of databases are synchronized only during checkpoints
+class WriteAheadLog
+{
+private:
+	struct Pim;
+	Pim * pim;
+public:
+	enum class RecordType : uint8_t
+	{
+		  page = 1          // content of data page
+		, indexNode = 2     // changes of index node
+	};
+	// interface implemented by databases attached to the log
+	class Database
+	{
+	public:
+		// called after each commit, all changes appended so far are durable
+		virtual void afterCommit() = 0;
+		// save all appended changes to the database file and synchronize it, the log is truncated afterwards
+		virtual void checkpoint() = 0;
+		virtual ~Database() {}
+	};
+	// function called for each committed record of attached database (in the order of appending)
+	typedef std::function<void(RecordType, unsigned revision, unsigned pageId, uint8_t const * data, unsigned length)> tReplayFunction;
+
+	// the file is created if it does not exist, committed records are kept until the databases are attached
+	// the log is truncated (by checkpoint) when it is larger than given size
+	WriteAheadLog(std::string const & path, unsigned checkpointSizeInMegabytes = 1024);
+	~WriteAheadLog();
+
+	// makes all changes appended so far durable, saves checkpoint if the log is too large
+	void commit();
+
+	// makes all changes appended so far durable and saves checkpoint (the log is truncated), e.g. before shutdown
+	void checkpoint();
+
+	// returns true if the log contains committed changes that were not saved yet to files of databases by checkpoint
+	// (they are replayed when the log is opened), the file is not modified, false is returned if it does not exist
+	static bool hasCommittedChanges(std::string const & path);
+
+	// ===== methods used by databases
+	// attaches the database, committed records with given name are passed to the replay function
+	void attachDatabase(std::string const & name, Database *, tReplayFunction);
+	// records must be appended between beginAppend() and endAppend(), commit() waits until all appends are finished
+	void beginAppend();
+	void endAppend();
+	void append(Database *, RecordType, unsigned revision, unsigned pageId, void const * data, unsigned length);
+};
+
+#endif /* APIDB_WRITEAHEADLOG_HPP_ */
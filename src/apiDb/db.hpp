@@ -5,9 +5,25 @@
 #include <string>
 #include <functional>
 #include <limits>
+#include <memory>
 #include <cstdint>
 
 #include "TasksManager.hpp"
+#include "WriteAheadLog.hpp"
+#include "AsyncIo.hpp"
+#include "CacheBudget.hpp"
+#include "MemoryArena.hpp"
+
+
+	// read-only view of the record saved in the database, data points to the serialized record (without the length)
+	// it is valid only inside the visitor call, the page is kept in memory until the visitor returns
+	template<typename tKey>
+	struct RecordViewT
+	{
+		tKey key;
+		uint8_t const * data;
+		unsigned length;
+	};
 
 
 	template<typename tKey>
@@ -22,6 +38,10 @@
 		// records left in the vector are automatically deleted when the function returns, the rest of records must be deleted by user
 		typedef std::function<void(std::vector<RecordT<tKey> const *> const &, bool & lastCall)> tReadFromRangeFunction;
 
+		// the same as above but records are not created, the visitor gets views of raw data
+		// records can be created from the views by the visitor if needed (e.g. only these passing some filter)
+		typedef std::function<void(std::vector<RecordViewT<tKey>> const &, bool & lastCall)> tReadRawFromRangeFunction;
+
 		// function is called exactly once for each key value given by user
 		// first parameter: records already in the database, second parameter: subset of records given by user
 		// No records can be deleted
@@ -33,6 +53,18 @@
 		// Records from the DB side can be deleted/created if needed, these actions are mapped to DB operations
 		typedef std::function<bool(std::vector<RecordT<tKey>*> & currentRecords, std::vector<RecordT<tKey>*> const & newRecords)> tUpdateByKeyFunction;
 
+		// the same as tReadByKeyFunction but records are not created, the function is called exactly once for each distinct key
+		// given by user (concurrently for different keys), it gets views of raw data of records with the key
+		typedef std::function<void(tKey key, std::vector<RecordViewT<tKey>> const & currentRecords)> tReadRawByKeyFunction;
+
+		// allocates the place for data of a new record in the data page (length bytes), it is valid until the page is saved
+		typedef std::function<uint8_t*(unsigned length)> tAllocateRawRecordFunction;
+
+		// the same as tUpdateByKeyFunction but records are not created, the function is called exactly once for each distinct key
+		// given by user (concurrently for different keys), returns true if there are changes to save
+		// views can be removed from the vector or added to it, data of added views must be allocated by the given function
+		typedef std::function<bool(tKey key, std::vector<RecordViewT<tKey>> & currentRecords, tAllocateRawRecordFunction allocate)> tUpdateRawByKeyFunction;
+
 		// function required to create a new record
 		typedef std::function<RecordT<tKey>*(tKey key, uint8_t const *& ptr)> tCreateRecordFunction;
 	public:
@@ -55,6 +87,21 @@
 	}
 
 
+	// optional parameters of the database (see DatabaseT::DatabaseT), the same for all types of keys
+	struct DatabaseOptions
+	{
+		WriteAheadLog * wal = nullptr;
+		AsyncIo * asyncIo = nullptr;
+		unsigned keysFilterBitsPerKey = 0;
+		bool compressPages = false;
+		bool readOnly = false;
+		CacheBudget * cacheBudget = nullptr;
+		unsigned warmUpPagesPerSecond = 0;
+		MemoryArena * memoryArena = nullptr;
+		unsigned compactionPagesPerSecond = 0;
+	};
+
+
 	template<typename tKey = uint32_t, unsigned const globalKeySize = 4, unsigned dataPageSize = 8*1024>
 	class DatabaseT
 	{
@@ -65,22 +112,127 @@
 		// ===================================== LOW LEVEL FUNCTIONS FOR CONVERTIONS RECORD <-> BINARY DATA
 		typedef typename Record::tCreateRecordFunction tCreateRecord;
 		typedef typename Record::tReadFromRangeFunction tReadFunction;
+		typedef typename Record::tReadRawFromRangeFunction tReadRawFunction;
+		typedef RecordViewT<tKey> RecordView;
 		typedef typename Record::tReadByKeyFunction tReadByKeyFunction;
 		typedef typename Record::tUpdateByKeyFunction tUpdateByKeyFunction;
+		typedef typename Record::tReadRawByKeyFunction tReadRawByKeyFunction;
+		typedef typename Record::tUpdateRawByKeyFunction tUpdateRawByKeyFunction;
+		// function returning records for bulk load one by one, it returns nullptr at the end
+		typedef std::function<Record*()> tBulkLoadSourceFunction;
+		typedef DatabaseOptions Options;
+		// counters of operations on the database file and the cache
+		struct Statistics {
+			uint64_t synchCount = 0;
+			uint64_t synchTimeMs = 0;
+			uint64_t writesCount = 0;
+			uint64_t writesTimeMs = 0;
+			uint64_t readsCount = 0;
+			uint64_t readsTimeMs = 0;
+			uint64_t cacheHitsCount = 0;
+			uint64_t cacheMissesCount = 0;
+			uint64_t scanCacheHitsCount = 0;    // hits and misses of range scans (readRecordsInOrder), they are included in the counters above
+			uint64_t scanCacheMissesCount = 0;
+			uint64_t evictionsCount = 0;
+			uint64_t cacheSizeInBytes = 0;      // current maximum size of the cache (it is changed by CacheBudget, not reset)
+			uint64_t arenaMappedBytes = 0;      // memory of the arena with buffers of the cache (it may be shared with other databases, not reset)
+			uint64_t arenaUsedBytes = 0;        // the part of the arena used by buffers (the same)
+			uint64_t arenaHugeTlbBytes = 0;     // the part of the arena backed by explicit huge pages (the same)
+			uint64_t readsWithoutPageCount = 0;  // parts of readRecords answered without loading a page (all keys are out of the page range or rejected by the filter)
+			uint64_t bytesRead = 0;     // bytes read/written by operations on data pages (smaller than pages count * page size for compressed pages)
+			uint64_t bytesWritten = 0;
+			uint64_t readAheadPagesCount = 0;  // data pages read in advance by range scans (readRecordsInOrder)
+			uint64_t warmUpPagesCount = 0;     // data pages loaded to the cache by the warm-up
+			uint64_t compactionMovedPages = 0;      // data pages moved by compact()
+			uint64_t compactionReclaimedBytes = 0;  // bytes removed from the end of the file by compact()
+			uint64_t compactionPagesLeft = 0;       // data pages out of the order of keys found by the last step of compact() (not reset)
+		};
+
+		// consistent read view of the database, all reads made through the snapshot see the same committed version of the database
+		// (modifications committed later are not visible), the version and its data pages are kept until the snapshot is deleted
+		// long-living snapshots delay reuse of pages of modified data nodes (the file grows) and compact() cannot move them
+		// snapshots must be deleted before the database object
+		class Snapshot
+		{
+		private:
+			friend class DatabaseT;
+			struct Pim;
+			Pim * pim;
+			Snapshot(Pim * p) : pim(p) {}
+		public:
+			~Snapshot();
+			Snapshot(Snapshot const &) = delete;
+			Snapshot & operator=(Snapshot const &) = delete;
+			// the same as the methods of DatabaseT
+			void readRecordsInOrder(tReadFunction visitor, tKey first = 0, tKey last = std::numeric_limits<tKey>::max(), unsigned hintQuerySize = std::numeric_limits<unsigned>::max()) const;
+			void readRawRecordsInOrder(tReadRawFunction visitor, tKey first = 0, tKey last = std::numeric_limits<tKey>::max(), unsigned hintQuerySize = std::numeric_limits<unsigned>::max()) const;
+			void readRecords(std::vector<Record*> const & records, tReadByKeyFunction visitor) const;
+			void readRawRecords(std::vector<tKey> const & keys, tReadRawByKeyFunction visitor) const;
+			tKey getTheLargestKey() const;
+			uint64_t getRecordsCount() const;
+			// revision of the index node (it is increased by each commit)
+			unsigned revision() const;
+		};
 
 	private:
 		Pim * pim;
 	public:
 
 		// ===================================== METHODS
-		DatabaseT(TasksManager * cpuTaskManager, TasksManager * ioTaskManager,std::string const & dbFile, tCreateRecord, unsigned cacheSizeInMegabytes = 128);
+		// parameters from options:
+		// if the write-ahead log is given, changes become durable after commit() of the log
+		// if the queue of asynchronous operations is given (and io_uring is supported), it is used for all reads and writes of the file
+		// if keysFilterBitsPerKey > 0, a Bloom filter with keys is kept in memory for each data page (it is built when the page is
+		// created or read for the first time), readRecords does not load pages for keys rejected by filters
+		// if compressPages is set, data pages are compressed (LZ4) in the file and decompressed in the cache, the file is sparse
+		// (the option can be changed for existing database, pages saved in both ways are read correctly)
+		// if readOnly is set, the existing database file is mapped to memory and reads of uncompressed pages go directly to the mapping
+		// (without the cache and locks, the kernel manages the memory), writeRecords and bulkLoad throw exceptions, the write-ahead
+		// log cannot be used, many processes may open the same file in read-only mode
+		// if cacheBudget is given, the cache shares its memory with other databases, cacheSizeInMegabytes is its minimum size then
+		// if warmUpPagesPerSecond > 0, pages which were in the cache before restart (listed in the file dbFile + ".hot") are loaded
+		// in background with given rate, the list is saved every minute and in destructor also without the warm-up (not in read-only mode)
+		// if memoryArena is given, buffers of the cache are taken from it (slabs must have 256 KB), otherwise the cache has its own arena
+		// if compactionPagesPerSecond > 0, the file is compacted in background (like by compact() with given rate, not in read-only
+		// mode), when it is done, the order of data pages is checked every minute
+		DatabaseT(TasksManager * cpuTaskManager, TasksManager * ioTaskManager,std::string const & dbFile, tCreateRecord, unsigned cacheSizeInMegabytes = 128
+				, Options const & options = Options());
 		~DatabaseT();
+		// each call reads one committed version of the database (range scans are not affected by modifications committed during the scan)
+		// hintQuerySize > 1000 (default) marks a long scan, pages loaded by it are evicted from the cache before other pages
 		void readRecordsInOrder(tReadFunction visitor, tKey first = 0, tKey last = std::numeric_limits<tKey>::max(), unsigned hintQuerySize = std::numeric_limits<unsigned>::max()) const;
+		// zero-copy version of readRecordsInOrder, no records are created by the database
+		void readRawRecordsInOrder(tReadRawFunction visitor, tKey first = 0, tKey last = std::numeric_limits<tKey>::max(), unsigned hintQuerySize = std::numeric_limits<unsigned>::max()) const;
 		void readRecords(std::vector<Record*> const & records, tReadByKeyFunction visitor) const;
 		void writeRecords(std::vector<Record*> const & records, tUpdateByKeyFunction visitor);
+		// zero-copy versions of readRecords and writeRecords, no records are created by the database (see RecordCodec.hpp)
+		void readRawRecords(std::vector<tKey> const & keys, tReadRawByKeyFunction visitor) const;
+		void writeRawRecords(std::vector<tKey> const & keys, tUpdateRawByKeyFunction visitor);
+		// returns when all modifications made before the call are committed, with the write-ahead log they are appended to the log
+		// (they become durable after the next commit() of the log, so it must be called before the commit of the log)
+		void flushPendingChanges() const;
+		// returns the snapshot of the last committed version, any number of snapshots can be used concurrently with modifications
+		std::shared_ptr<Snapshot> createSnapshot() const;
+		// moves data pages to the beginning of the file in the order of keys (range scans read adjacent pages) and shrinks the file
+		// it runs online: reads are not blocked, writes are delayed only by commits of moved pages, at most pagesPerSecond pages
+		// are moved per second (0 - no limit), it returns when all pages are in order, progress is reported in statistics
+		void compact(unsigned pagesPerSecond = 64);
+		// loads large set of records given in any order (it is much faster than writeRecords for millions of records)
+		// records are sorted in runs saved in temporary files in tmpDir and merged, data pages are built directly from sorted records
+		// records returned by the source are deleted, the visitor is called once for each key like in writeRecords (new records
+		// are owned by the visitor, it must move them to currentRecords or delete them, also when it throws an exception)
+		// if the source or the visitor throws an exception, the bulk load is aborted (the database is not modified) and it is rethrown
+		// it must not be called concurrently with other modifications
+		void bulkLoad(tBulkLoadSourceFunction source, tUpdateByKeyFunction visitor, std::string const & tmpDir, unsigned memoryInMegabytes = 256);
 		tKey getTheLargestKey() const;
 		uint64_t getRecordsCount() const;
 		bool isNewDb() const;
+		// returns counters collected since the previous call
+		Statistics readAndResetStatistics() const;
+		// saves the list of pages being in the cache (to the file dbFile + ".hot"), it is loaded by the warm-up after restart
+		void saveHotPages() const;
+		// returns the number of pages still to load by the warm-up (0 - the warm-up is finished or disabled)
+		unsigned cacheWarmUpPagesLeft() const;
 	};
 
 
@@ -0,0 +1,212 @@
+#include "db.hpp"
+#include "TestRecord.hpp"
+#include "../commonTools/Stopwatch.hpp"
+#include <iostream>
+#include <fstream>
+#include <array>
+#include <algorithm>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/wait.h>
+
+std::vector<std::array<uint64_t,3>> data;
+uint64_t const dataShift = (1ull << 40);  // added to data of records written after the bulk load (input data are 32-bit)
+unsigned const recordsAddedAfterBulkLoad = 5000;  // records for the first keys of sorted input data
+
+
+bool funcUpdate(std::vector<RecordT<uint32_t>*> & currentRecords, std::vector<RecordT<uint32_t>*> const & newRecords)
+{
+	if (newRecords.empty()) throw std::logic_error("funcUpdate called for empty newRecords");
+	unsigned const key = newRecords.front()->key;
+	bool changes = false;
+	for (auto rr: newRecords) {
+		TestRecord *r = dynamic_cast<TestRecord*>(rr);
+		if (r->key != key) throw std::logic_error("Key does not match!!!!");
+		bool exist = false;
+		for (auto rr2: currentRecords) {
+			TestRecord *r2 = dynamic_cast<TestRecord*>(rr2);
+			if (r2->key != key) throw std::logic_error("Key does not match!!!!");
+			if (r2->fData[0] == r->fData[0] && r2->fData[1] == r->fData[1]) {
+				exist = true;
+				break;
+			}
+		}
+		if (exist) {
+			delete r;
+		} else {
+			changes = true;
+			currentRecords.push_back(rr);
+		}
+	}
+	return changes;
+}
+
+
+
+// records written after the bulk load, they have new data for the first keys of sorted data
+std::vector<RecordT<uint32_t>*> addedRecords(unsigned first, unsigned last)
+{
+	std::vector<RecordT<uint32_t>*> records;
+	for (unsigned j = first; j < last && j < recordsAddedAfterBulkLoad && j < data.size(); ++j) {
+		records.push_back( new TestRecord(data[j][0], data[j][1] + dataShift, data[j][2] + dataShift) );
+	}
+	return records;
+}
+
+void addToData(std::vector<RecordT<uint32_t>*> const & records)
+{
+	for (auto rr: records) {
+		TestRecord const * r = dynamic_cast<TestRecord const *>(rr);
+		data.push_back( {r->key, r->fData[0], r->fData[1]} );
+	}
+}
+
+
+// the database is never destroyed (it keeps the lock of the file), so it is created in a child process and reopened
+// by the parent; returns the exit code of the test
+int bulkLoadAndWrite(std::string const & database, unsigned memoryInMegabytes)
+{
+	TasksManager * tm = new TasksManager(4);
+	TasksManager * tm2 = new TasksManager(4);
+	DatabaseT<> * db = new DatabaseT<>(tm, tm2, database, createRecord<TestRecord>);
+	std::cout << "Bulk load data into database" << std::endl;
+	{
+		unsigned ir = 0;
+		std::vector<std::array<uint64_t,3>> const input = data;
+		auto source = [&ir,&input]()->RecordT<uint32_t>*
+		{
+			if (ir >= input.size()) return nullptr;
+			std::array<uint64_t,3> const & r = input[ir++];
+			return new TestRecord(r[0], r[1], r[2]);
+		};
+		std::string const tmpDir = (database.find('/') == std::string::npos) ? "." : database.substr(0, database.find_last_of('/'));
+		Stopwatch stopwatch;
+		db->bulkLoad(source, funcUpdate, tmpDir, memoryInMegabytes);
+		std::cout << "Bulk load time(ms): " << stopwatch.get_time_ms() <<  std::endl;
+	}
+	std::sort( data.begin(), data.end() );
+	data.erase( std::unique(data.begin(), data.end()), data.end() );  // duplicates are not added by funcUpdate
+
+	std::cout << "Read records from database:" << std::endl;
+	if (! compareRecords(*db, data)) return 4;
+
+	// the bulk load is aborted by the exception from the visitor, the database is not modified
+	std::cout << "Abort bulk load" << std::endl;
+	{
+		unsigned ir = 0;
+		auto source = [&ir]()->RecordT<uint32_t>*
+		{
+			if (ir >= data.size()) return nullptr;
+			std::array<uint64_t,3> const & r = data[ir++];
+			return new TestRecord(r[0], r[1] + dataShift, r[2] + dataShift);
+		};
+		unsigned callsCount = 0;
+		auto funcUpdateAndThrow = [&callsCount](std::vector<RecordT<uint32_t>*> & currentRecords, std::vector<RecordT<uint32_t>*> const & newRecords)->bool
+		{
+			if (++callsCount < data.size() / 2) return funcUpdate(currentRecords, newRecords);
+			for (auto r: newRecords) delete r;
+			throw std::runtime_error("bulk load aborted by the test");
+		};
+		std::string const tmpDir = (database.find('/') == std::string::npos) ? "." : database.substr(0, database.find_last_of('/'));
+		bool aborted = false;
+		try {
+			db->bulkLoad(source, funcUpdateAndThrow, tmpDir, memoryInMegabytes);
+		} catch (std::runtime_error const &) {
+			aborted = true;
+		}
+		if (! aborted) {
+			std::cerr << "The exception from the visitor was not rethrown by bulkLoad" << std::endl;
+			return 4;
+		}
+	}
+	if (! compareRecords(*db, data)) return 4;
+
+	// records are written in separate commits after the bulk load
+	std::cout << "Write records after bulk load" << std::endl;
+	unsigned const chunkSize = 1000;
+	unsigned const loadedCount = data.size();
+	for (unsigned i = 0; i < recordsAddedAfterBulkLoad && i < loadedCount; i += chunkSize) {
+		std::vector<RecordT<uint32_t>*> records = addedRecords(i, i + chunkSize);
+		addToData(records);
+		db->writeRecords(records, funcUpdate);
+		if (! waitForRecordsCount(db, data.size())) return 3;
+	}
+	std::sort( data.begin(), data.end() );
+	if (! compareRecords(*db, data)) return 4;
+	return 0;
+}
+
+
+int main(int argc, char ** argv)
+{
+	if (argc != 3 && argc != 4) {
+		std::cout << "Parameters: name_of_database(without_extension)  file_with_input_data  [memory_for_sorting_in_MB]" << std::endl;
+		return 1;
+	}
+
+	std::string database = argv[1];
+	std::string inputFile = argv[2];
+	unsigned memoryInMegabytes = (argc == 4) ? std::stoi(argv[3]) : 256;
+
+	// load data
+	{
+		std::cout << "Read input data" << std::endl;
+		std::ifstream file(inputFile);
+		if (file.fail()) {
+			std::cerr << "Cannot open file " << inputFile << std::endl;
+			return 2;
+		}
+		while (! file.eof()) {
+			std::array<uint64_t,3> r;
+			file >> r[0];
+			if (file.eof()) break;
+			file >> r[1] >> r[2];
+			if (file.fail()) {
+				std::cerr << "Error when reading from file after " << data.size() << " records" << std::endl;
+				return 2;
+			}
+			data.push_back(r);
+		}
+		std::cout << "Number of records: " << data.size() << std::endl;
+	}
+
+	// create database in the child process
+	std::cout.flush();
+	pid_t const child = fork();
+	if (child < 0) {
+		std::cerr << "fork() failed" << std::endl;
+		return 2;
+	}
+	if (child == 0) {
+		int const code = bulkLoadAndWrite(database, memoryInMegabytes);
+		std::cout.flush();
+		std::_Exit(code);
+	}
+	int status = 0;
+	if (waitpid(child, &status, 0) != child || ! WIFEXITED(status)) {
+		std::cerr << "The child process failed" << std::endl;
+		return 2;
+	}
+	if (WEXITSTATUS(status) != 0) return WEXITSTATUS(status);
+
+	// expected content of the database
+	std::sort( data.begin(), data.end() );
+	data.erase( std::unique(data.begin(), data.end()), data.end() );
+	std::vector<RecordT<uint32_t>*> records = addedRecords(0, recordsAddedAfterBulkLoad);
+	addToData(records);
+	for (auto r: records) delete r;
+	std::sort( data.begin(), data.end() );
+
+	// all commits made after the bulk load must be replayed from the journal
+	TasksManager * tm = new TasksManager(4);
+	TasksManager * tm2 = new TasksManager(4);
+	DatabaseT<> * db = new DatabaseT<>(tm, tm2, database, createRecord<TestRecord>);
+	std::cout << "Read records from reopened database:" << std::endl;
+	if (! compareRecords(*db, data)) return 4;
+
+	delete db;
+	delete tm;
+	delete tm2;
+	std::cout << "OK" << std::endl;
+	return 0;
+}
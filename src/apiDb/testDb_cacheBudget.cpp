@@ -0,0 +1,131 @@
+#include "db.hpp"
+#include "TestRecord.hpp"
+#include "../commonTools/Stopwatch.hpp"
+#include <iostream>
+#include <random>
+
+unsigned const recordsCount = 1000000;   // about 100 data pages in each database
+unsigned const budgetMB = 16;            // 64 pages for both databases
+unsigned const minimumMB = 2;            // 8 pages per database
+
+
+bool funcUpdate(std::vector<RecordT<uint32_t>*> & currentRecords, std::vector<RecordT<uint32_t>*> const & newRecords)
+{
+	for (auto r: currentRecords) delete r;
+	currentRecords = newRecords;
+	return true;
+}
+
+
+void writeData(DatabaseT<> * db)
+{
+	unsigned const chunkSize = 10000;
+	for (unsigned i = 0; i < recordsCount; i += chunkSize) {
+		std::vector<RecordT<uint32_t>*> records;
+		for (unsigned j = i; j < i + chunkSize; ++j) records.push_back( new TestRecord(4 * j, j, 2 * j) );
+		db->writeRecords(records, funcUpdate);
+	}
+}
+
+
+// reads random keys, returns false if some records are missing or incorrect
+bool readData(DatabaseT<> * db, unsigned callsCount, std::mt19937 & gen)
+{
+	bool ok = true;
+	for (unsigned i = 0; i < callsCount; ++i) {
+		std::vector<RecordT<uint32_t>*> records;
+		for (unsigned j = 0; j < 100; ++j) records.push_back( new TestRecord(4 * (gen() % recordsCount)) );
+		auto funcRead = [&ok](std::vector<RecordT<uint32_t> const *> const & currentRecords, std::vector<RecordT<uint32_t>*> const & queries)
+		{
+			if (currentRecords.size() != 1) {
+				ok = false;
+				return;
+			}
+			TestRecord const * r = dynamic_cast<TestRecord const *>(currentRecords.front());
+			if (r->fData[0] != r->key / 4 || r->fData[1] != r->key / 2) ok = false;
+		};
+		db->readRecords(records, funcRead);
+		for (auto r: records) delete r;
+	}
+	if (! ok) std::cerr << "Incorrect records" << std::endl;
+	return ok;
+}
+
+
+// checks sizes of caches, the cache expected to grow must be larger than its minimum
+bool checkSizes(DatabaseT<> * growing, DatabaseT<> * other, CacheBudget & budget)
+{
+	uint64_t const sizeGrowing = growing->readAndResetStatistics().cacheSizeInBytes;
+	uint64_t const sizeOther = other->readAndResetStatistics().cacheSizeInBytes;
+	CacheBudget::Statistics const s = budget.readAndResetStatistics();
+	std::cout << "Caches (MB): " << (sizeGrowing >> 20) << " and " << (sizeOther >> 20) << ", free: " << (budget.freeMemoryInBytes() >> 20);
+	std::cout << ", rebalances: " << s.rebalancesCount << ", moved (MB): " << (s.movedBytes >> 20) << std::endl;
+	if (sizeGrowing + sizeOther + budget.freeMemoryInBytes() != budget.memoryInBytes()) {
+		std::cerr << "Incorrect sum of caches sizes" << std::endl;
+		return false;
+	}
+	if (sizeGrowing <= 2 * (minimumMB << 20) || sizeOther < (minimumMB << 20)) {
+		std::cerr << "Incorrect sizes of caches" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+
+int main(int argc, char ** argv)
+{
+	if (argc != 2) {
+		std::cout << "Parameters: prefix_of_new_databases" << std::endl;
+		return 1;
+	}
+	std::string const prefix = argv[1];
+
+	TasksManager * tm = new TasksManager(4);
+	TasksManager * tm2 = new TasksManager(4);
+	CacheBudget budget(budgetMB, 32);  // rebalance after every 32 loaded pages
+	DatabaseT<>::Options options;
+	options.cacheBudget = &budget;
+	DatabaseT<> * db1 = new DatabaseT<>(tm, tm2, prefix + "1", createRecord<TestRecord>, minimumMB, options);
+	DatabaseT<> * db2 = new DatabaseT<>(tm, tm2, prefix + "2", createRecord<TestRecord>, minimumMB, options);
+
+	// the sum of minimal sizes cannot be larger than the budget
+	{
+		bool exception = false;
+		try {
+			DatabaseT<> db3(tm, tm2, prefix + "3", createRecord<TestRecord>, budgetMB, options);
+		} catch (std::runtime_error const & e) {
+			exception = true;
+		}
+		if (! exception) {
+			std::cerr << "The budget was exceeded" << std::endl;
+			return 3;
+		}
+	}
+
+	std::cout << "Write data" << std::endl;
+	writeData(db1);
+	writeData(db2);
+	if (! waitForRecordsCount(db1, recordsCount) || ! waitForRecordsCount(db2, recordsCount)) return 3;
+	db1->readAndResetStatistics();
+	db2->readAndResetStatistics();
+	budget.readAndResetStatistics();
+
+	// memory goes to the database being read ...
+	std::mt19937 gen(1);
+	Stopwatch stopwatch;
+	if (! readData(db1, 300, gen)) return 4;
+	std::cout << "Reads from the first database, time(ms): " << stopwatch.get_time_ms() << std::endl;
+	if (! checkSizes(db1, db2, budget)) return 5;
+
+	// ... and it is moved when the other database is used
+	stopwatch.reset_and_restart();
+	if (! readData(db2, 300, gen)) return 4;
+	std::cout << "Reads from the second database, time(ms): " << stopwatch.get_time_ms() << std::endl;
+	if (! checkSizes(db2, db1, budget)) return 5;
+
+	delete db1;
+	delete db2;
+	delete tm;
+	std::cout << "OK" << std::endl;
+	return 0;
+}
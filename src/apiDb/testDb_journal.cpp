@@ -0,0 +1,216 @@
+#include "db.hpp"
+#include "TestRecord.hpp"
+#include "../commonTools/bytesLevel.hpp"
+#include <iostream>
+#include <array>
+#include <functional>
+#include <cstdlib>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+unsigned const batchesCount = 10;       // batches committed before the crash
+unsigned const batchSize = 1000;
+
+// layout of the database file created by DatabaseT (two copies of the index node, the journal is referenced by them)
+unsigned const pageSize = 256*1024;
+unsigned const pagesPerIndexNode = 8;
+unsigned const indexNodeSize = pagesPerIndexNode * pageSize;
+
+
+bool funcUpdate(std::vector<RecordT<uint32_t>*> & currentRecords, std::vector<RecordT<uint32_t>*> const & newRecords)
+{
+	for (auto r: currentRecords) delete r;
+	currentRecords = newRecords;
+	return true;
+}
+
+
+// records of given batch, keys of all batches are different (multiplication by an odd number is a bijection),
+// the batch after the last one has a single record, so it is committed as one record of the journal
+std::vector<std::array<uint64_t,3>> batchData(unsigned batch)
+{
+	std::vector<std::array<uint64_t,3>> data;
+	unsigned const size = (batch == batchesCount) ? 1 : batchSize;
+	for (unsigned i = 0; i < size; ++i) {
+		uint32_t const key = (batch * batchSize + i) * 2654435761u;
+		data.push_back( {{key, batch, i}} );
+	}
+	return data;
+}
+
+std::vector<std::array<uint64_t,3>> batchesData(std::vector<unsigned> const & batches)
+{
+	std::vector<std::array<uint64_t,3>> data;
+	for (auto batch: batches) {
+		std::vector<std::array<uint64_t,3>> const d = batchData(batch);
+		data.insert(data.end(), d.begin(), d.end());
+	}
+	return data;
+}
+
+// each batch is committed separately, as a record of the journal
+void writeBatch(DatabaseT<> * db, unsigned batch)
+{
+	std::vector<RecordT<uint32_t>*> records;
+	for (auto const & r: batchData(batch)) records.push_back( new TestRecord(r[0], r[1], r[2]) );
+	db->writeRecords(records, funcUpdate);
+	db->flushPendingChanges();
+}
+
+
+// databases are never destroyed (they keep locks of files), so each step is run in a child process,
+// returns the exit code of the child or -1 if it was killed
+int runInChildProcess(std::function<int()> step)
+{
+	std::cout.flush();
+	pid_t const child = fork();
+	if (child < 0) {
+		std::cerr << "fork() failed" << std::endl;
+		return 2;
+	}
+	if (child == 0) {
+		int const code = step();
+		std::cout.flush();
+		std::_Exit(code);
+	}
+	int status = 0;
+	if (waitpid(child, &status, 0) != child) return 2;
+	if (WIFSIGNALED(status)) return -1;
+	return (WIFEXITED(status)) ? WEXITSTATUS(status) : 2;
+}
+
+
+// finds records of the journal referenced by the current copy of the index node (the correct one with the higher revision),
+// returns false if the file cannot be read or there is no journal; offsets are given from the beginning of the file
+bool findJournalRecords(std::string const & database, std::vector<std::pair<uint64_t,unsigned>> & offsetsAndLengths)
+{
+	offsetsAndLengths.clear();
+	int const fd = open(database.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	std::vector<uint8_t> buffer(indexNodeSize);
+	bool found = false;
+	unsigned revision = 0;
+	unsigned journalFirstPageId = 0;
+	unsigned journalPagesCount = 0;
+	for (unsigned copy = 0; copy < 2; ++copy) {
+		if (pread(fd, buffer.data(), indexNodeSize, uint64_t(copy) * indexNodeSize) != ssize_t(indexNodeSize)) {
+			close(fd);
+			return false;
+		}
+		uint8_t const * p = buffer.data();
+		if (readUnsignedInteger<4,unsigned>(p) != CRC32(p, indexNodeSize - 4)) continue;  // the copy was never saved
+		unsigned const r = readUnsignedInteger<4,unsigned>(p);
+		if (found && r < revision) continue;
+		found = true;
+		revision = r;
+		p = buffer.data() + indexNodeSize - 8;
+		journalFirstPageId = readUnsignedInteger<4,unsigned>(p);
+		journalPagesCount = readUnsignedInteger<4,unsigned>(p);
+	}
+	bool const ok = (journalPagesCount == pagesPerIndexNode) && pread(fd, buffer.data(), indexNodeSize, uint64_t(journalFirstPageId) * pageSize) == ssize_t(indexNodeSize);
+	close(fd);
+	if (! ok) return false;
+	// record: length(4), CRC32(4), baseRevision(4), revision(4), ... - records of the current generation have consecutive revisions
+	for (unsigned offset = 0; offset + 20 <= indexNodeSize; ) {
+		uint8_t const * p = buffer.data() + offset;
+		unsigned const length = readUnsignedInteger<4,unsigned>(p);
+		p += 4;
+		unsigned const baseRevision = readUnsignedInteger<4,unsigned>(p);
+		unsigned const recordRevision = readUnsignedInteger<4,unsigned>(p);
+		if (length < 20 || offset + length > indexNodeSize || baseRevision != revision || recordRevision != revision + offsetsAndLengths.size() + 1) break;
+		offsetsAndLengths.push_back( std::make_pair(uint64_t(journalFirstPageId) * pageSize + offset, length) );
+		offset += length;
+	}
+	return true;
+}
+
+
+int main(int argc, char ** argv)
+{
+	if (argc != 2) {
+		std::cout << "Parameters: name_of_new_database(without_extension)" << std::endl;
+		return 1;
+	}
+	std::string const database = argv[1];
+
+	std::vector<unsigned> committedBatches;
+	for (unsigned batch = 0; batch <= batchesCount; ++batch) committedBatches.push_back(batch);
+
+	// ===== all batches are committed to the journal, the process is killed (the index node is not saved at the end)
+	auto writeAndCrash = [&]()->int
+	{
+		DatabaseT<> * db = new DatabaseT<>(new TasksManager(4), new TasksManager(4), database, createRecord<TestRecord>);
+		for (unsigned batch = 0; batch <= batchesCount; ++batch) writeBatch(db, batch);
+		kill(getpid(), SIGKILL);
+		return 2;
+	};
+	std::cout << "Write " << (batchesCount + 1) << " batches, kill the process" << std::endl;
+	if (runInChildProcess(writeAndCrash) != -1) {
+		std::cerr << "The process was not killed" << std::endl;
+		return 2;
+	}
+
+	// the journal is partially filled, the last record is the last batch
+	std::vector<std::pair<uint64_t,unsigned>> journalRecords;
+	if ( ! findJournalRecords(database, journalRecords) ) {
+		std::cerr << "Cannot find the journal in the database file" << std::endl;
+		return 4;
+	}
+	std::cout << "Records in the journal: " << journalRecords.size() << std::endl;
+	if (journalRecords.size() < 2) {
+		std::cerr << "There are too few records in the journal" << std::endl;
+		return 4;
+	}
+
+	size_t const recordsCount = journalRecords.size();
+
+	// ===== commits are replayed from the journal when the database is opened
+	auto checkRecords = [&]()->int
+	{
+		DatabaseT<> * db = new DatabaseT<>(new TasksManager(4), new TasksManager(4), database, createRecord<TestRecord>);
+		std::cout << "Read records from reopened database" << std::endl;
+		return (compareRecords(*db, batchesData(committedBatches))) ? 0 : 4;
+	};
+	int code = runInChildProcess(checkRecords);
+	if (code != 0) return (code < 0) ? 2 : code;
+
+	// ===== the last record is torn (its second half is not written), it is ignored and the last batch is lost
+	std::cout << "Tear the last record of the journal" << std::endl;
+	{
+		std::pair<uint64_t,unsigned> const last = journalRecords.back();
+		std::vector<uint8_t> const zeros(last.second - last.second / 2, 0);
+		int const fd = open(database.c_str(), O_WRONLY);
+		bool const ok = (fd >= 0) && pwrite(fd, zeros.data(), zeros.size(), last.first + last.second / 2) == ssize_t(zeros.size());
+		if (fd >= 0) close(fd);
+		if (! ok) {
+			std::cerr << "Cannot modify the database file" << std::endl;
+			return 2;
+		}
+		committedBatches.pop_back();
+	}
+	code = runInChildProcess(checkRecords);
+	if (code != 0) return (code < 0) ? 2 : code;
+
+	// ===== new commits are appended in place of the torn record
+	auto writeAgain = [&]()->int
+	{
+		DatabaseT<> * db = new DatabaseT<>(new TasksManager(4), new TasksManager(4), database, createRecord<TestRecord>);
+		writeBatch(db, batchesCount);
+		std::cout << "Read records after the last batch is written again" << std::endl;
+		return (compareRecords(*db, batchesData(committedBatches))) ? 0 : 4;
+	};
+	committedBatches.push_back(batchesCount);
+	code = runInChildProcess(writeAgain);
+	if (code != 0) return (code < 0) ? 2 : code;
+	if ( ! findJournalRecords(database, journalRecords) || journalRecords.size() != recordsCount ) {
+		std::cerr << "The torn record was not replaced by the new one" << std::endl;
+		return 4;
+	}
+	code = runInChildProcess(checkRecords);
+	if (code != 0) return (code < 0) ? 2 : code;
+
+	std::cout << "OK" << std::endl;
+	return 0;
+}
@@ -0,0 +1,208 @@
+#include "db.hpp"
+#include "RecordCodec.hpp"
+#include "TestRecord.hpp"
+#include <iostream>
+#include <array>
+#include <map>
+#include <mutex>
+#include <cstring>
+
+unsigned const keysCount = 20000;
+
+// the same format as TestRecord
+struct TestCodec
+{
+	typedef uint32_t Key;
+	typedef std::array<uint64_t,2> Value;
+	static unsigned dataLength(Value const &) { return 16; }
+	static void saveData(Value const & v, uint8_t *& ptr) { std::memcpy(ptr, v.data(), 16); ptr += 16; }
+	static void loadData(Key, uint8_t const *& ptr, Value & v) { std::memcpy(v.data(), ptr, 16); ptr += 16; }
+};
+
+// expected content of the database: key -> values
+std::map<uint32_t,std::vector<TestCodec::Value>> expected;
+
+std::vector<std::array<uint64_t,3>> expectedRecords()
+{
+	std::vector<std::array<uint64_t,3>> records;
+	for (auto const & kv: expected) for (auto const & v: kv.second) records.push_back( {{kv.first, v[0], v[1]}} );
+	return records;
+}
+
+uint32_t keyOf(unsigned i) { return i * 7; }
+
+// visitors are called concurrently for different keys, calls are counted to check that each distinct key is visited once
+class CallsCounter
+{
+private:
+	std::mutex access;
+	std::map<uint32_t,unsigned> calls;
+public:
+	void add(uint32_t key)
+	{
+		std::lock_guard<std::mutex> synchAccess(access);
+		++calls[key];
+	}
+	// checks that all given keys (and no other keys) were visited exactly once
+	bool check(std::vector<uint32_t> keys)
+	{
+		std::sort(keys.begin(), keys.end());
+		keys.erase( std::unique(keys.begin(), keys.end()), keys.end() );
+		std::lock_guard<std::mutex> synchAccess(access);
+		if (calls.size() != keys.size()) {
+			std::cerr << "Incorrect number of visited keys: " << calls.size() << ", expected: " << keys.size() << std::endl;
+			return false;
+		}
+		for (auto key: keys) {
+			auto it = calls.find(key);
+			if (it == calls.end() || it->second != 1) {
+				std::cerr << "The key " << key << " was visited " << ((it == calls.end()) ? 0 : it->second) << " times" << std::endl;
+				return false;
+			}
+		}
+		calls.clear();
+		return true;
+	}
+};
+
+
+int main(int argc, char ** argv)
+{
+	if (argc != 2) {
+		std::cout << "Parameters: name_of_new_database(without_extension)" << std::endl;
+		return 1;
+	}
+	std::string const database = argv[1];
+
+	TasksManager * tm = new TasksManager(4);
+	TasksManager * tm2 = new TasksManager(4);
+	DatabaseT<> * db = new DatabaseT<>(tm, tm2, database, createRecord<TestRecord>);
+	CallsCounter counter;
+	std::mutex errorsAccess;
+	std::string error;   // the first error found by visitors
+	auto setError = [&errorsAccess,&error](std::string const & msg)
+	{
+		std::lock_guard<std::mutex> synchAccess(errorsAccess);
+		if (error.empty()) error = msg;
+	};
+	auto checkErrors = [&error]()->bool
+	{
+		if (error.empty()) return true;
+		std::cerr << error << std::endl;
+		return false;
+	};
+
+	// ===== empty list of keys, visitors are not called
+	std::cout << "Read and write an empty list of keys" << std::endl;
+	{
+		std::vector<uint32_t> const keys;
+		db->readRawRecords(keys, [&counter](uint32_t key, std::vector<RecordViewT<uint32_t>> const &) { counter.add(key); });
+		db->writeRawRecords(keys, [&counter](uint32_t key, std::vector<RecordViewT<uint32_t>> &, RecordT<uint32_t>::tAllocateRawRecordFunction)->bool
+		{
+			counter.add(key);
+			return true;
+		});
+		if (! counter.check(keys)) return 4;
+		if (! compareRecords(*db, expectedRecords())) return 4;
+	}
+
+	// ===== values are added by writeValues (views are added by allocate), each key is given twice
+	std::cout << "Add values, keys are duplicated" << std::endl;
+	{
+		std::vector<uint32_t> keys;
+		for (unsigned i = 0; i < keysCount; ++i) {
+			keys.push_back(keyOf(i));
+			std::vector<TestCodec::Value> & values = expected[keyOf(i)];
+			for (unsigned j = 0; j <= i % 3; ++j) values.push_back( {{i, j}} );
+		}
+		for (unsigned i = 0; i < keysCount; i += 2) keys.push_back(keyOf(i));
+		writeValues<TestCodec>(*db, keys, [&](uint32_t key, std::vector<TestCodec::Value> & values)->bool
+		{
+			counter.add(key);
+			if (! values.empty()) setError("Values found for the new key " + std::to_string(key));
+			values = expected.at(key);
+			return true;
+		});
+		if (! checkErrors() || ! counter.check(keys)) return 4;
+		if (! waitForRecordsCount(db, expectedRecords().size())) return 3;
+		if (! compareRecords(*db, expectedRecords())) return 4;
+	}
+
+	// ===== values are read by readValues, keys are duplicated, some of them are not in the database
+	std::cout << "Read values, keys are duplicated or missing" << std::endl;
+	{
+		std::vector<uint32_t> keys;
+		for (unsigned i = 0; i < keysCount; i += 3) keys.push_back(keyOf(i));
+		for (unsigned i = 0; i < keysCount; i += 6) keys.push_back(keyOf(i));
+		for (unsigned i = 0; i < 100; ++i) keys.push_back(keyOf(i) + 1);
+		readValues<TestCodec>(*db, keys, [&](uint32_t key, std::vector<TestCodec::Value> const & values)
+		{
+			counter.add(key);
+			auto it = expected.find(key);
+			if (values != ((it == expected.end()) ? std::vector<TestCodec::Value>() : it->second)) {
+				setError("Incorrect values read for the key " + std::to_string(key));
+			}
+		});
+		if (! checkErrors() || ! counter.check(keys)) return 4;
+	}
+
+	// ===== views are removed, rewritten, added or left untouched, keys are duplicated
+	std::cout << "Remove, rewrite and add views" << std::endl;
+	{
+		std::vector<uint32_t> keys;
+		for (unsigned i = 0; i < keysCount; i += 3) keys.push_back(keyOf(i));
+		for (unsigned i = 0; i < keysCount; i += 9) keys.push_back(keyOf(i));
+		std::map<uint32_t,std::vector<TestCodec::Value>> const before = expected;
+		for (unsigned i = 0; i < keysCount; i += 3) {
+			std::vector<TestCodec::Value> & values = expected[keyOf(i)];
+			switch ((i / 3) % 4) {
+				case 0: values.erase(values.begin()); break;
+				case 1: values[0][0] += keysCount; break;
+				case 2: values.push_back( {{i, 100}} ); break;
+			}
+			if (values.empty()) expected.erase(keyOf(i));
+		}
+		db->writeRawRecords(keys, [&](uint32_t key, std::vector<RecordViewT<uint32_t>> & views, RecordT<uint32_t>::tAllocateRawRecordFunction allocate)->bool
+		{
+			counter.add(key);
+			std::vector<TestCodec::Value> values;
+			decodeRecords<TestCodec>(views, values);
+			if (values != before.at(key)) setError("Incorrect views of the key " + std::to_string(key));
+			unsigned const i = key / 7;
+			RecordViewT<uint32_t> v;
+			uint8_t * ptr;
+			switch ((i / 3) % 4) {
+				case 0:
+					views.erase(views.begin());
+					return true;
+				case 1:
+					values[0][0] += keysCount;
+					v = views[0];
+					ptr = allocate(TestCodec::dataLength(values[0]));
+					v.data = ptr;
+					TestCodec::saveData(values[0], ptr);
+					views[0] = v;
+					return true;
+				case 2:
+					v.key = key;
+					v.length = TestCodec::dataLength(TestCodec::Value());
+					ptr = allocate(v.length);
+					v.data = ptr;
+					TestCodec::saveData( {{i, 100}}, ptr );
+					views.push_back(v);
+					return true;
+			}
+			return false;
+		});
+		if (! checkErrors() || ! counter.check(keys)) return 4;
+		if (! waitForRecordsCount(db, expectedRecords().size())) return 3;
+		// views not touched by visitors and records of other keys keep their bytes
+		if (! compareRecords(*db, expectedRecords())) return 4;
+	}
+
+	delete db;
+	delete tm;
+	delete tm2;
+	std::cout << "OK" << std::endl;
+	return 0;
+}
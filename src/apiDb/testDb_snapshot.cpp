@@ -0,0 +1,157 @@
+#include "db.hpp"
+#include "TestRecord.hpp"
+#include "../commonTools/Stopwatch.hpp"
+#include <iostream>
+#include <fstream>
+#include <array>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+std::vector<std::array<uint32_t,3>> data;
+uint64_t const dataShift = (1ull << 40);  // added to data of records saved after the snapshot (input data are 32-bit)
+
+
+bool funcUpdate(std::vector<RecordT<uint32_t>*> & currentRecords, std::vector<RecordT<uint32_t>*> const & newRecords)
+{
+	if (newRecords.empty()) throw std::logic_error("funcUpdate called for empty newRecords");
+	bool changes = false;
+	for (auto rr: newRecords) {
+		TestRecord *r = dynamic_cast<TestRecord*>(rr);
+		bool exist = false;
+		for (auto rr2: currentRecords) {
+			TestRecord *r2 = dynamic_cast<TestRecord*>(rr2);
+			if (r2->fData[0] == r->fData[0] && r2->fData[1] == r->fData[1]) {
+				exist = true;
+				break;
+			}
+		}
+		if (exist) {
+			delete r;
+		} else {
+			changes = true;
+			currentRecords.push_back(rr);
+		}
+	}
+	return changes;
+}
+
+
+void writeData(DatabaseT<> * db, uint64_t shift)
+{
+	unsigned const chunkSize = 1000;
+	for (unsigned i = 0; i < data.size(); i += chunkSize) {
+		std::vector<RecordT<uint32_t>*> records;
+		for (unsigned j = i; j < i + chunkSize && j < data.size(); ++j) {
+			records.push_back( new TestRecord(data[j][0], data[j][1] + shift, data[j][2] + shift) );
+		}
+		db->writeRecords(records, funcUpdate);
+	}
+}
+
+
+// expected records: data with given shifts of records' data
+std::vector<std::array<uint64_t,3>> expectedRecords(std::vector<uint64_t> const & shifts)
+{
+	std::vector<std::array<uint64_t,3>> expected;
+	for (auto const & r: data) {
+		for (auto shift: shifts) expected.push_back( {{r[0], r[1] + shift, r[2] + shift}} );
+	}
+	return expected;
+}
+
+
+// reads records by keys (every 97th key) and checks if there are no records saved after the snapshot
+bool compareByKeys(DatabaseT<>::Snapshot const & snapshot)
+{
+	std::vector<RecordT<uint32_t>*> records;
+	for (unsigned i = 0; i < data.size(); i += 97) records.push_back( new TestRecord(data[i][0]) );
+	bool ok = true;
+	auto funcRead = [&ok](std::vector<RecordT<uint32_t> const *> const & currentRecords, std::vector<RecordT<uint32_t>*> const &)
+	{
+		if (currentRecords.empty()) ok = false;
+		for (auto rr: currentRecords) {
+			TestRecord const * r = dynamic_cast<TestRecord const *>(rr);
+			if (r->fData[0] >= dataShift) ok = false;
+		}
+	};
+	snapshot.readRecords(records, funcRead);
+	for (auto r: records) delete r;
+	if (! ok) std::cerr << "Incorrect records read by keys from the snapshot" << std::endl;
+	return ok;
+}
+
+
+int main(int argc, char ** argv)
+{
+	if (argc != 3) {
+		std::cout << "Parameters: name_of_new_database(without_extension)  file_with_input_data" << std::endl;
+		return 1;
+	}
+
+	std::string database = argv[1];
+	std::string inputFile = argv[2];
+
+	// load data
+	{
+		std::cout << "Read input data" << std::endl;
+		std::ifstream file(inputFile);
+		if (file.fail()) {
+			std::cerr << "Cannot open file " << inputFile << std::endl;
+			return 2;
+		}
+		while (! file.eof()) {
+			std::array<uint32_t,3> r;
+			file >> r[0];
+			if (file.eof()) break;
+			file >> r[1] >> r[2];
+			if (file.fail()) {
+				std::cerr << "Error when reading from file after " << data.size() << " records" << std::endl;
+				return 2;
+			}
+			data.push_back(r);
+		}
+		std::sort( data.begin(), data.end() );
+		data.erase( std::unique(data.begin(), data.end()), data.end() );  // duplicates are not added by funcUpdate
+		std::cout << "Number of records: " << data.size() << std::endl;
+	}
+
+	// create database
+	TasksManager * tm = new TasksManager(4);
+	TasksManager * tm2 = new TasksManager(4);
+	DatabaseT<> * db = new DatabaseT<>(tm, tm2, database, createRecord<TestRecord>);
+	writeData(db, 0);
+	if (! waitForRecordsCount(db, data.size())) return 3;
+
+	// the snapshot is read concurrently with modifications
+	std::shared_ptr<DatabaseT<>::Snapshot> snapshot = db->createSnapshot();
+	std::cout << "Snapshot revision: " << snapshot->revision() << ", records: " << snapshot->getRecordsCount() << std::endl;
+	std::atomic<bool> writerDone(false);
+	std::thread writer( [db,&writerDone]() { writeData(db, dataShift); writerDone = true; } );
+	unsigned scansCount = 0;
+	bool ok = true;
+	Stopwatch stopwatch;
+	while (ok && ! writerDone) {
+		ok = compareRecords(*snapshot, expectedRecords({0})) && compareByKeys(*snapshot);
+		++scansCount;
+	}
+	writer.join();
+	std::cout << "Scans of the snapshot during modifications: " << scansCount << ", time(ms): " << stopwatch.get_time_ms() << std::endl;
+	if (! ok) return 4;
+
+	// new modifications are visible in the database and in new snapshots only
+	if (! waitForRecordsCount(db, 2 * data.size())) return 3;
+	if (! compareRecords(*db, expectedRecords({0,dataShift}))) return 4;
+	if (! compareRecords(*snapshot, expectedRecords({0}))) return 4;
+	std::shared_ptr<DatabaseT<>::Snapshot> snapshot2 = db->createSnapshot();
+	if (snapshot2->revision() == snapshot->revision() || ! compareRecords(*snapshot2, expectedRecords({0,dataShift}))) return 4;
+	std::cout << "Snapshot revision: " << snapshot2->revision() << ", records: " << snapshot2->getRecordsCount() << std::endl;
+	snapshot.reset();
+	snapshot2.reset();
+
+	delete db;
+	delete tm;
+	delete tm2;
+	std::cout << "OK" << std::endl;
+	return 0;
+}
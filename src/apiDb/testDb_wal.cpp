@@ -0,0 +1,157 @@
+#include "db.hpp"
+#include "TestRecord.hpp"
+#include <iostream>
+#include <array>
+#include <functional>
+#include <cstdlib>
+#include <csignal>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+unsigned const batchesCount = 10;       // batches committed before the crash
+unsigned const batchSize = 1000;
+
+
+bool funcUpdate(std::vector<RecordT<uint32_t>*> & currentRecords, std::vector<RecordT<uint32_t>*> const & newRecords)
+{
+	for (auto r: currentRecords) delete r;
+	currentRecords = newRecords;
+	return true;
+}
+
+
+// records of given batch, keys of all batches are different (multiplication by an odd number is a bijection)
+std::vector<std::array<uint64_t,3>> batchData(unsigned batch)
+{
+	std::vector<std::array<uint64_t,3>> data;
+	for (unsigned i = 0; i < batchSize; ++i) {
+		uint32_t const key = (batch * batchSize + i) * 2654435761u;
+		data.push_back( {{key, batch, i}} );
+	}
+	return data;
+}
+
+std::vector<std::array<uint64_t,3>> batchesData(unsigned batchesCount)
+{
+	std::vector<std::array<uint64_t,3>> data;
+	for (unsigned batch = 0; batch < batchesCount; ++batch) {
+		std::vector<std::array<uint64_t,3>> const d = batchData(batch);
+		data.insert(data.end(), d.begin(), d.end());
+	}
+	return data;
+}
+
+void writeBatch(DatabaseT<> * db, unsigned batch)
+{
+	std::vector<RecordT<uint32_t>*> records;
+	for (auto const & r: batchData(batch)) records.push_back( new TestRecord(r[0], r[1], r[2]) );
+	db->writeRecords(records, funcUpdate);
+}
+
+
+// databases are never destroyed (they keep locks of files), so each step is run in a child process,
+// returns the exit code of the child or -1 if it was killed
+int runInChildProcess(std::function<int()> step)
+{
+	std::cout.flush();
+	pid_t const child = fork();
+	if (child < 0) {
+		std::cerr << "fork() failed" << std::endl;
+		return 2;
+	}
+	if (child == 0) {
+		int const code = step();
+		std::cout.flush();
+		std::_Exit(code);
+	}
+	int status = 0;
+	if (waitpid(child, &status, 0) != child) return 2;
+	if (WIFSIGNALED(status)) return -1;
+	return (WIFEXITED(status)) ? WEXITSTATUS(status) : 2;
+}
+
+
+int main(int argc, char ** argv)
+{
+	if (argc != 2) {
+		std::cout << "Parameters: name_of_new_database(without_extension)" << std::endl;
+		return 1;
+	}
+	std::string const database = argv[1];
+	std::string const walPath = database + ".wal";
+
+	// ===== committed batches are durable, the last batch is appended to the log but not committed, the process is killed
+	auto writeAndCrash = [&]()->int
+	{
+		WriteAheadLog * wal = new WriteAheadLog(walPath);
+		DatabaseT<>::Options options;
+		options.wal = wal;
+		DatabaseT<> * db = new DatabaseT<>(new TasksManager(4), new TasksManager(4), database, createRecord<TestRecord>, 128, options);
+		for (unsigned batch = 0; batch < batchesCount; ++batch) {
+			writeBatch(db, batch);
+			db->flushPendingChanges();
+			wal->commit();
+		}
+		writeBatch(db, batchesCount);
+		db->flushPendingChanges();
+		kill(getpid(), SIGKILL);
+		return 2;
+	};
+	std::cout << "Write " << batchesCount << " committed batches and one not committed, kill the process" << std::endl;
+	if (runInChildProcess(writeAndCrash) != -1) {
+		std::cerr << "The process was not killed" << std::endl;
+		return 2;
+	}
+	if ( ! WriteAheadLog::hasCommittedChanges(walPath) ) {
+		std::cerr << "Committed changes were not found in the log" << std::endl;
+		return 4;
+	}
+
+	// ===== the database is recovered from the log, the last batch is written again and the log is truncated by the checkpoint
+	auto recoverAndCheckpoint = [&]()->int
+	{
+		WriteAheadLog * wal = new WriteAheadLog(walPath);
+		DatabaseT<>::Options options;
+		options.wal = wal;
+		DatabaseT<> * db = new DatabaseT<>(new TasksManager(4), new TasksManager(4), database, createRecord<TestRecord>, 128, options);
+		std::cout << "Read records after recovery" << std::endl;
+		if (! compareRecords(*db, batchesData(batchesCount))) return 4;
+		writeBatch(db, batchesCount);
+		db->flushPendingChanges();
+		wal->checkpoint();
+		return 0;
+	};
+	int const code = runInChildProcess(recoverAndCheckpoint);
+	if (code != 0) {
+		if (code < 0) std::cerr << "The process was killed" << std::endl;
+		return (code < 0) ? 2 : code;
+	}
+
+	// ===== after the checkpoint all changes are in the database file, the log contains only the header and names of databases
+	struct stat buf;
+	if (stat(walPath.c_str(), &buf) != 0) {
+		std::cerr << "Cannot check the size of the log" << std::endl;
+		return 2;
+	}
+	std::cout << "Size of the log after the checkpoint: " << buf.st_size << std::endl;
+	if (buf.st_size > 4096) {
+		std::cerr << "The log was not truncated by the checkpoint" << std::endl;
+		return 4;
+	}
+	if ( WriteAheadLog::hasCommittedChanges(walPath) ) {
+		std::cerr << "Committed changes were found in the log after the checkpoint" << std::endl;
+		return 4;
+	}
+	TasksManager * tm = new TasksManager(4);
+	TasksManager * tm2 = new TasksManager(4);
+	DatabaseT<> * db = new DatabaseT<>(tm, tm2, database, createRecord<TestRecord>);
+	std::cout << "Read records from the database file (without the log)" << std::endl;
+	if (! compareRecords(*db, batchesData(batchesCount + 1))) return 4;
+
+	delete db;
+	delete tm;
+	delete tm2;
+	std::cout << "OK" << std::endl;
+	return 0;
+}
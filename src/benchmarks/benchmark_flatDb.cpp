@@ -0,0 +1,465 @@
+#include "../apiDb/db.hpp"
+#include "../apiDb/TasksManager.hpp"
+#include "../commonTools/bytesLevel.hpp"
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <thread>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <functional>
+#include <memory>
+#include <boost/lexical_cast.hpp>
+
+// Benchmark of flatDb engine (the same DatabaseT<uint64_t,8> as used by protein table).
+// Phases: load (writeRecords with sequential keys), write, read (readRecords), miss (readRecords of absent keys), scan (readRecordsInOrder),
+// compact (compact() running in parallel with reads), hot (saveHotPages), warmup (waits for the end of the warm-up of the cache).
+// Output: one tab-separated line per phase with throughput, latency percentiles of single calls
+// and statistics of the storage (cache and disk operations).
+
+typedef DatabaseT<uint64_t,8> Database;
+typedef std::chrono::steady_clock Clock;
+
+
+class BenchmarkRecord : public RecordT<uint64_t>
+{
+public:
+	std::vector<uint8_t> data;
+	explicit BenchmarkRecord(uint64_t pKey) : RecordT<uint64_t>(pKey) {}
+	BenchmarkRecord(uint64_t pKey, unsigned size) : RecordT<uint64_t>(pKey), data(size)
+	{
+		for (unsigned i = 0; i < size; ++i) data[i] = static_cast<uint8_t>(pKey * 31 + i);
+	}
+	bool isCorrect() const
+	{
+		for (unsigned i = 0; i < data.size(); ++i) if (data[i] != static_cast<uint8_t>(key * 31 + i)) return false;
+		return true;
+	}
+	unsigned dataLength() const override { return 2 + data.size(); }
+	void saveData(uint8_t *& ptr) const override
+	{
+		writeUnsignedInteger<2>(ptr, data.size());
+		std::copy(data.begin(), data.end(), ptr);
+		ptr += data.size();
+	}
+	void loadData(uint8_t const *& ptr) override
+	{
+		data.resize( readUnsignedInteger<2,unsigned>(ptr) );
+		std::copy(ptr, ptr + data.size(), data.begin());
+		ptr += data.size();
+	}
+};
+
+
+struct Parameters
+{
+	std::string dbFile;
+	uint64_t keysCount = 1000000;      // number of keys loaded in the first phase, keys are i*keysStep for i from [0,keysCount)
+	unsigned keysStep = 1;             // distance between keys, with keysStep > 1 there are absent keys inside data pages
+	unsigned operationsCount = 200000; // number of records written/read in write and read phases
+	unsigned batchSize = 1000;         // number of records in single call
+	unsigned scansCount = 1000;        // number of calls in scan phase
+	unsigned scanLength = 1000;        // number of records read by single scan
+	unsigned recordSize = 32;          // size of record's data in bytes
+	unsigned cacheMB = 128;
+	unsigned threads = 4;              // number of client threads, the same number of threads is used by tasks managers
+	unsigned ioUring = 0;              // number of io_uring reaper threads, 0 - pread/pwrite are used
+	unsigned filterBitsPerKey = 0;     // size of filters with keys of data pages, 0 - filters are not used
+	bool compression = false;          // compression of data pages
+	bool readOnly = false;             // existing database is opened in read-only mode (phases 'read', 'miss' and 'scan' only)
+	unsigned compactRate = 0;          // pages moved per second in phase 'compact', 0 - no limit
+	unsigned hugePages = 1;            // memory of the cache: 0 - regular pages, 1 - transparent huge pages, 2 - explicit huge pages
+	unsigned warmUp = 0;               // pages per second loaded to the cache from the list saved in phase 'hot' by previous run
+	std::string distribution = "uniform"; // keys distribution: seq, uniform, zipf
+	double zipfTheta = 0.99;
+	unsigned seed = 1;
+	std::vector<std::string> phases = {"load", "write", "read", "scan"};
+};
+
+
+// generator of keys from [0,n), zipf distribution is implemented as in YCSB (Gray et al.), hot keys are scattered by hashing
+class KeysGenerator
+{
+private:
+	std::string fDistribution;
+	uint64_t fN;
+	uint64_t fNext;
+	uint64_t fStep;
+	double fTheta, fZetaN, fAlpha, fEta;
+	std::mt19937_64 fGen;
+	std::uniform_real_distribution<double> fUniform;
+	static double zeta(uint64_t n, double theta)
+	{
+		double sum = 0;
+		for (uint64_t i = 1; i <= n; ++i) sum += 1.0 / std::pow(static_cast<double>(i), theta);
+		return sum;
+	}
+public:
+	KeysGenerator(std::string const & distribution, uint64_t n, double theta, unsigned seed, uint64_t first, uint64_t step)
+	: fDistribution(distribution), fN(n), fNext(first), fStep(step), fTheta(theta), fZetaN(0), fAlpha(0), fEta(0), fGen(seed), fUniform(0.0, 1.0)
+	{
+		if (fDistribution == "zipf") {
+			fZetaN = zeta(fN, fTheta);
+			fAlpha = 1.0 / (1.0 - fTheta);
+			fEta = (1.0 - std::pow(2.0 / fN, 1.0 - fTheta)) / (1.0 - zeta(2, fTheta) / fZetaN);
+		} else if (fDistribution != "seq" && fDistribution != "uniform") {
+			throw std::runtime_error("Unknown keys distribution: " + fDistribution);
+		}
+	}
+	uint64_t next()
+	{
+		if (fDistribution == "seq") {
+			uint64_t const key = fNext % fN;
+			fNext += fStep;
+			return key;
+		}
+		if (fDistribution == "uniform") {
+			return std::uniform_int_distribution<uint64_t>(0, fN-1)(fGen);
+		}
+		double const u = fUniform(fGen);
+		double const uz = u * fZetaN;
+		uint64_t rank;
+		if (uz < 1.0) rank = 0;
+		else if (uz < 1.0 + std::pow(0.5, fTheta)) rank = 1;
+		else rank = static_cast<uint64_t>(fN * std::pow(fEta * u - fEta + 1.0, fAlpha));
+		if (rank >= fN) rank = fN - 1;
+		// FNV-1a hash of the rank
+		uint64_t h = 14695981039346656037ull;
+		for (unsigned i = 0; i < 8; ++i) {
+			h ^= (rank >> (8*i)) & 0xff;
+			h *= 1099511628211ull;
+		}
+		return h % fN;
+	}
+};
+
+
+bool funcUpdate(std::vector<RecordT<uint64_t>*> & currentRecords, std::vector<RecordT<uint64_t>*> const & newRecords)
+{
+	for (auto r: currentRecords) delete r;
+	currentRecords.clear();
+	BenchmarkRecord const * r = dynamic_cast<BenchmarkRecord const *>(newRecords.back());
+	currentRecords.push_back(new BenchmarkRecord(*r));
+	return true;
+}
+
+
+struct PhaseResult
+{
+	uint64_t recordsCount = 0;
+	uint64_t incorrectRecordsCount = 0;
+	std::vector<uint32_t> latenciesUs;  // latencies of single calls
+};
+
+
+// runs given function in parallel threads, the function gets the thread id and collects results
+PhaseResult runInThreads(unsigned threadsCount, std::function<void(unsigned,PhaseResult&)> func)
+{
+	std::vector<PhaseResult> results(threadsCount);
+	std::vector<std::thread> threads;
+	std::vector<std::string> errors(threadsCount);
+	for (unsigned i = 0; i < threadsCount; ++i) {
+		threads.push_back( std::thread( [i,&func,&results,&errors]()
+		{
+			try {
+				func(i, results[i]);
+			} catch (std::exception const & e) {
+				errors[i] = e.what();
+			}
+		} ) );
+	}
+	for (auto & t: threads) t.join();
+	PhaseResult r;
+	for (unsigned i = 0; i < threadsCount; ++i) {
+		if ( ! errors[i].empty() ) throw std::runtime_error("Thread " + boost::lexical_cast<std::string>(i) + " failed: " + errors[i]);
+		r.recordsCount += results[i].recordsCount;
+		r.incorrectRecordsCount += results[i].incorrectRecordsCount;
+		r.latenciesUs.insert(r.latenciesUs.end(), results[i].latenciesUs.begin(), results[i].latenciesUs.end());
+	}
+	return r;
+}
+
+
+inline uint32_t microsecondsSince(Clock::time_point const & start)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+}
+
+
+// calls writeRecords for records with given keys
+void writeBatch(Database & db, std::vector<uint64_t> const & keys, unsigned recordSize, PhaseResult & result)
+{
+	std::vector<RecordT<uint64_t>*> records;
+	records.reserve(keys.size());
+	for (auto k: keys) records.push_back(new BenchmarkRecord(k, recordSize));
+	Clock::time_point const start = Clock::now();
+	db.writeRecords(records, funcUpdate);
+	result.latenciesUs.push_back(microsecondsSince(start));
+	result.recordsCount += records.size();
+	for (auto r: records) delete r;
+}
+
+
+PhaseResult runPhase(Database & db, Parameters const & p, std::string const & phase)
+{
+	if (phase == "load") {
+		// all keys are written in sequential batches, every key has exactly one record
+		return runInThreads(p.threads, [&db,&p](unsigned threadId, PhaseResult & result)
+		{
+			uint64_t const batchesCount = (p.keysCount + p.batchSize - 1) / p.batchSize;
+			for (uint64_t iBatch = threadId; iBatch < batchesCount; iBatch += p.threads) {
+				std::vector<uint64_t> keys;
+				for (uint64_t k = iBatch * p.batchSize; k < std::min(p.keysCount, (iBatch+1) * p.batchSize); ++k) keys.push_back(k * p.keysStep);
+				writeBatch(db, keys, p.recordSize, result);
+			}
+		});
+	}
+	if (phase == "write") {
+		return runInThreads(p.threads, [&db,&p](unsigned threadId, PhaseResult & result)
+		{
+			KeysGenerator gen(p.distribution, p.keysCount, p.zipfTheta, p.seed + threadId, threadId * p.batchSize, 1);
+			for (unsigned i = threadId * p.batchSize; i < p.operationsCount; i += p.threads * p.batchSize) {
+				std::vector<uint64_t> keys;
+				for (unsigned j = 0; j < p.batchSize; ++j) keys.push_back(gen.next() * p.keysStep);
+				writeBatch(db, keys, p.recordSize, result);
+			}
+		});
+	}
+	if (phase == "read" || phase == "miss") {
+		// phase 'miss' reads keys between loaded keys (keysStep > 1 is required), no records should be found
+		bool const missing = (phase == "miss");
+		if (missing && p.keysStep < 2) throw std::runtime_error("Phase 'miss' requires keysStep > 1");
+		return runInThreads(p.threads, [&db,&p,missing](unsigned threadId, PhaseResult & result)
+		{
+			KeysGenerator gen(p.distribution, p.keysCount, p.zipfTheta, p.seed + 1000 + threadId, threadId * p.batchSize, 1);
+			for (unsigned i = threadId * p.batchSize; i < p.operationsCount; i += p.threads * p.batchSize) {
+				std::vector<RecordT<uint64_t>*> records;
+				for (unsigned j = 0; j < p.batchSize; ++j) records.push_back(new BenchmarkRecord(gen.next() * p.keysStep + (missing ? 1 : 0)));
+				std::atomic<uint64_t> incorrect(0);
+				auto visitor = [&incorrect,missing](std::vector<RecordT<uint64_t> const *> const & dbRecords, std::vector<RecordT<uint64_t>*> const &)
+				{
+					if (missing) {
+						if ( ! dbRecords.empty() ) ++incorrect;
+					} else if (dbRecords.size() != 1 || ! dynamic_cast<BenchmarkRecord const *>(dbRecords.front())->isCorrect()) ++incorrect;
+				};
+				Clock::time_point const start = Clock::now();
+				db.readRecords(records, visitor);
+				result.latenciesUs.push_back(microsecondsSince(start));
+				result.recordsCount += records.size();
+				result.incorrectRecordsCount += incorrect;
+				for (auto r: records) delete r;
+			}
+		});
+	}
+	if (phase == "scan") {
+		return runInThreads(p.threads, [&db,&p](unsigned threadId, PhaseResult & result)
+		{
+			KeysGenerator gen(p.distribution, p.keysCount, p.zipfTheta, p.seed + 2000 + threadId, threadId * p.scanLength, p.threads * p.scanLength);
+			for (unsigned i = threadId; i < p.scansCount; i += p.threads) {
+				uint64_t const first = gen.next() * p.keysStep;
+				uint64_t count = 0;
+				uint64_t incorrect = 0;
+				uint64_t expectedKey = first;
+				auto visitor = [&](std::vector<RecordT<uint64_t> const *> const & dbRecords, bool & lastCall)
+				{
+					for (auto r: dbRecords) {
+						if (r->key != expectedKey || ! dynamic_cast<BenchmarkRecord const *>(r)->isCorrect()) ++incorrect;
+						expectedKey = r->key + p.keysStep;
+						if (++count == p.scanLength) {
+							lastCall = true;
+							break;
+						}
+					}
+				};
+				Clock::time_point const start = Clock::now();
+				db.readRecordsInOrder(visitor, first, std::numeric_limits<uint64_t>::max(), p.scanLength);
+				result.latenciesUs.push_back(microsecondsSince(start));
+				result.recordsCount += count;
+				result.incorrectRecordsCount += incorrect;
+			}
+		});
+	}
+	if (phase == "compact") {
+		// the first thread compacts the file, the other threads read records until it is done
+		std::atomic<bool> done(false);
+		return runInThreads(p.threads, [&db,&p,&done](unsigned threadId, PhaseResult & result)
+		{
+			if (threadId == 0) {
+				try {
+					db.compact(p.compactRate);
+				} catch (...) {
+					done = true;
+					throw;
+				}
+				done = true;
+				return;
+			}
+			KeysGenerator gen(p.distribution, p.keysCount, p.zipfTheta, p.seed + 3000 + threadId, threadId * p.batchSize, 1);
+			while ( ! done ) {
+				std::vector<RecordT<uint64_t>*> records;
+				for (unsigned j = 0; j < p.batchSize; ++j) records.push_back(new BenchmarkRecord(gen.next() * p.keysStep));
+				std::atomic<uint64_t> incorrect(0);
+				auto visitor = [&incorrect](std::vector<RecordT<uint64_t> const *> const & dbRecords, std::vector<RecordT<uint64_t>*> const &)
+				{
+					if (dbRecords.size() != 1 || ! dynamic_cast<BenchmarkRecord const *>(dbRecords.front())->isCorrect()) ++incorrect;
+				};
+				Clock::time_point const start = Clock::now();
+				db.readRecords(records, visitor);
+				result.latenciesUs.push_back(microsecondsSince(start));
+				result.recordsCount += records.size();
+				result.incorrectRecordsCount += incorrect;
+				for (auto r: records) delete r;
+			}
+		});
+	}
+	if (phase == "hot") {
+		db.saveHotPages();
+		return PhaseResult();
+	}
+	if (phase == "warmup") {
+		while (db.cacheWarmUpPagesLeft() > 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		return PhaseResult();
+	}
+	throw std::runtime_error("Unknown phase: " + phase);
+}
+
+
+void printHeader()
+{
+	std::cout << "phase\tdistribution\tthreads\tbatch\trecordSize\tcacheMB\tioUring\tfilter\tcompression\treadOnly\tcalls\trecords\tincorrect\tseconds\trecordsPerSec"
+			  << "\tp50Us\tp90Us\tp99Us\tp999Us\tmaxUs"
+			  << "\tcacheHits\tcacheMisses\tevictions\treadsWithoutPage\treads\treadsMs\twrites\twritesMs\tsynchs\tsynchsMs\tbytesRead\tbytesWritten\treadAhead\tscanCacheHits\tscanCacheMisses"
+			  << "\tcompactionMovedPages\tcompactionReclaimedBytes\tcompactionPagesLeft\twarmUpPages\tarenaMapped\tarenaUsed\tarenaHugeTlb" << std::endl;
+}
+
+
+void printResult(Parameters const & p, std::string const & phase, PhaseResult & r, double seconds, Database::Statistics const & s)
+{
+	std::sort(r.latenciesUs.begin(), r.latenciesUs.end());
+	auto percentile = [&r](double q)->uint32_t
+	{
+		if (r.latenciesUs.empty()) return 0;
+		return r.latenciesUs[ std::min<size_t>(r.latenciesUs.size() - 1, static_cast<size_t>(q * r.latenciesUs.size())) ];
+	};
+	std::cout << phase << "\t" << p.distribution << "\t" << p.threads << "\t" << p.batchSize << "\t" << p.recordSize << "\t" << p.cacheMB << "\t" << p.ioUring << "\t" << p.filterBitsPerKey << "\t" << p.compression << "\t" << p.readOnly
+			  << "\t" << r.latenciesUs.size() << "\t" << r.recordsCount << "\t" << r.incorrectRecordsCount
+			  << "\t" << seconds << "\t" << static_cast<uint64_t>((seconds > 0) ? (r.recordsCount / seconds) : 0)
+			  << "\t" << percentile(0.5) << "\t" << percentile(0.9) << "\t" << percentile(0.99) << "\t" << percentile(0.999)
+			  << "\t" << (r.latenciesUs.empty() ? 0 : r.latenciesUs.back())
+			  << "\t" << s.cacheHitsCount << "\t" << s.cacheMissesCount << "\t" << s.evictionsCount << "\t" << s.readsWithoutPageCount
+			  << "\t" << s.readsCount << "\t" << s.readsTimeMs << "\t" << s.writesCount << "\t" << s.writesTimeMs
+			  << "\t" << s.synchCount << "\t" << s.synchTimeMs << "\t" << s.bytesRead << "\t" << s.bytesWritten << "\t" << s.readAheadPagesCount
+			  << "\t" << s.scanCacheHitsCount << "\t" << s.scanCacheMissesCount
+			  << "\t" << s.compactionMovedPages << "\t" << s.compactionReclaimedBytes << "\t" << s.compactionPagesLeft << "\t" << s.warmUpPagesCount
+			  << "\t" << s.arenaMappedBytes << "\t" << s.arenaUsedBytes << "\t" << s.arenaHugeTlbBytes << std::endl;
+}
+
+
+int main(int argc, char ** argv)
+{
+	if (argc < 2) {
+		std::cerr << "Parameters: database_file [parameter=value ...]\n";
+		std::cerr << "Available parameters (with default values):\n";
+		std::cerr << "\tkeys=1000000       number of keys loaded in phase 'load'\n";
+		std::cerr << "\tkeysStep=1         distance between loaded keys (phase 'miss' reads keys between them)\n";
+		std::cerr << "\toperations=200000  number of records written/read in phases 'write' and 'read'\n";
+		std::cerr << "\tbatch=1000         number of records in single call of writeRecords/readRecords\n";
+		std::cerr << "\tscans=1000         number of calls of readRecordsInOrder in phase 'scan'\n";
+		std::cerr << "\tscanLength=1000    number of records read by single scan\n";
+		std::cerr << "\trecordSize=32      size of record's data in bytes\n";
+		std::cerr << "\tcache=128          size of cache in MB\n";
+		std::cerr << "\tthreads=4          number of client threads and threads of tasks managers\n";
+		std::cerr << "\tioUring=0          number of threads collecting io_uring completions, 0 - pread/pwrite are used\n";
+		std::cerr << "\tfilter=0           bits per key in filters of data pages, 0 - filters are not used\n";
+		std::cerr << "\tcompression=0      compression of data pages (0/1)\n";
+		std::cerr << "\treadOnly=0         open existing database in read-only mode (0/1), it must be created by previous run with phase 'load'\n";
+		std::cerr << "\tcompactRate=0      pages moved per second in phase 'compact', 0 - no limit\n";
+		std::cerr << "\thugePages=1        memory of the cache: 0 - regular pages, 1 - transparent huge pages, 2 - explicit huge pages\n";
+		std::cerr << "\twarmUp=0           pages per second loaded to the cache from the list saved by previous run in phase 'hot', 0 - no warm-up\n";
+		std::cerr << "\tdistribution=uniform  keys distribution in phases 'write', 'read', 'scan': seq, uniform, zipf\n";
+		std::cerr << "\ttheta=0.99         parameter of zipf distribution\n";
+		std::cerr << "\tseed=1\n";
+		std::cerr << "\tphases=load,write,read,scan (available also: miss, compact - compaction of the file with reads in other threads,\n";
+		std::cerr << "\t                   hot - saving the list of pages in the cache, warmup - waiting for the end of the warm-up)\n";
+		return 1;
+	}
+
+	Parameters p;
+	p.dbFile = argv[1];
+	try {
+		for (int i = 2; i < argc; ++i) {
+			std::string const arg = argv[i];
+			std::string::size_type const pos = arg.find('=');
+			if (pos == std::string::npos) throw std::runtime_error("Incorrect parameter: " + arg);
+			std::string const name = arg.substr(0, pos);
+			std::string const value = arg.substr(pos + 1);
+			if (name == "keys") p.keysCount = boost::lexical_cast<uint64_t>(value);
+			else if (name == "keysStep") p.keysStep = boost::lexical_cast<unsigned>(value);
+			else if (name == "operations") p.operationsCount = boost::lexical_cast<unsigned>(value);
+			else if (name == "batch") p.batchSize = boost::lexical_cast<unsigned>(value);
+			else if (name == "scans") p.scansCount = boost::lexical_cast<unsigned>(value);
+			else if (name == "scanLength") p.scanLength = boost::lexical_cast<unsigned>(value);
+			else if (name == "recordSize") p.recordSize = boost::lexical_cast<unsigned>(value);
+			else if (name == "cache") p.cacheMB = boost::lexical_cast<unsigned>(value);
+			else if (name == "threads") p.threads = boost::lexical_cast<unsigned>(value);
+			else if (name == "ioUring") p.ioUring = boost::lexical_cast<unsigned>(value);
+			else if (name == "filter") p.filterBitsPerKey = boost::lexical_cast<unsigned>(value);
+			else if (name == "compression") p.compression = boost::lexical_cast<bool>(value);
+			else if (name == "compactRate") p.compactRate = boost::lexical_cast<unsigned>(value);
+			else if (name == "hugePages") p.hugePages = boost::lexical_cast<unsigned>(value);
+			else if (name == "warmUp") p.warmUp = boost::lexical_cast<unsigned>(value);
+			else if (name == "readOnly") p.readOnly = boost::lexical_cast<bool>(value);
+			else if (name == "distribution") p.distribution = value;
+			else if (name == "theta") p.zipfTheta = boost::lexical_cast<double>(value);
+			else if (name == "seed") p.seed = boost::lexical_cast<unsigned>(value);
+			else if (name == "phases") {
+				p.phases.clear();
+				for (std::string::size_type b = 0; b <= value.size(); ) {
+					std::string::size_type e = value.find(',', b);
+					if (e == std::string::npos) e = value.size();
+					p.phases.push_back(value.substr(b, e - b));
+					b = e + 1;
+				}
+			} else throw std::runtime_error("Unknown parameter: " + name);
+		}
+		if (p.keysCount == 0 || p.keysStep == 0 || p.batchSize == 0 || p.threads == 0 || p.recordSize > 60000 || p.hugePages > 2) throw std::runtime_error("Incorrect values of parameters");
+
+		TasksManager tmCpu(p.threads);
+		TasksManager tmIo(p.threads);
+		std::unique_ptr<AsyncIo> asyncIo;
+		if (p.ioUring > 0) {
+			asyncIo.reset(new AsyncIo(256, p.ioUring));
+			if ( ! asyncIo->isSupported() ) throw std::runtime_error("io_uring is not supported");
+		}
+		MemoryArena::HugePages const hugePages[] = { MemoryArena::HugePages::none, MemoryArena::HugePages::transparent, MemoryArena::HugePages::hugetlb };
+		MemoryArena arena(256*1024, hugePages[p.hugePages]);
+		Database::Options options;
+		options.asyncIo = asyncIo.get();
+		options.keysFilterBitsPerKey = p.filterBitsPerKey;
+		options.compressPages = p.compression;
+		options.readOnly = p.readOnly;
+		options.warmUpPagesPerSecond = p.warmUp;
+		options.memoryArena = &arena;
+		Database db(&tmCpu, &tmIo, p.dbFile, createRecord<BenchmarkRecord>, p.cacheMB, options);
+		db.readAndResetStatistics();
+
+		printHeader();
+		for (auto const & phase: p.phases) {
+			Clock::time_point const start = Clock::now();
+			PhaseResult r = runPhase(db, p, phase);
+			double const seconds = microsecondsSince(start) / 1000000.0;
+			printResult(p, phase, r, seconds, db.readAndResetStatistics());
+		}
+	} catch (std::exception const & e) {
+		std::cerr << "EXCEPTION: " << e.what() << std::endl;
+		return 2;
+	}
+
+	return 0;
+}
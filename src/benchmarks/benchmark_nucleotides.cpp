@@ -0,0 +1,149 @@
+#include "../allelesDatabase/tools.hpp"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <boost/lexical_cast.hpp>
+
+// Micro-benchmark of packing/unpacking of nucleotides (2 bits per nucleotide) used by TableSequence.
+// Implementations: segments (convertGenomicToBinary()/convertBinaryToGenomic() called for each 16 nucleotides, the way
+// TableSequence worked before bulk functions), scalar, sse41 and avx2 (kernels of bulk functions, only supported ones are run).
+// Output: one tab-separated line per implementation and operation (pack/unpack) with throughput and speedup over segments.
+
+typedef std::chrono::steady_clock Clock;
+
+
+struct Parameters
+{
+	unsigned length = 100;           // number of nucleotides in a sequence
+	unsigned sequencesCount = 10000; // number of different sequences
+	unsigned repeats = 100;          // number of passes over all sequences
+	unsigned seed = 1;
+};
+
+
+struct Result
+{
+	double seconds = 0;
+	unsigned incorrect = 0;
+};
+
+
+static double secondsSince(Clock::time_point start)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count() / 1000000.0;
+}
+
+
+// packed sequence in 16-nucleotide segments saved as big-endian integers (the same bytes as in bulk functions)
+static void packSegments(std::string const & seq, uint8_t * out)
+{
+	unsigned const countOfFullSegments = seq.size() / 16;
+	for (unsigned i = 0; i < countOfFullSegments; ++i) {
+		uint32_t const v = convertGenomicToBinary(seq.substr(i*16,16));
+		for (unsigned j = 0; j < 4; ++j) *(out++) = (v >> (24 - 8*j)) & 255;
+	}
+	std::string const rest = seq.substr(countOfFullSegments*16);
+	uint32_t const v = convertGenomicToBinary(rest) << (2 * (16 - rest.size()));
+	for (unsigned j = 0; j < (rest.size() + 3) / 4; ++j) *(out++) = (v >> (24 - 8*j)) & 255;
+}
+
+static void unpackSegments(uint8_t const * data, std::string & seq)
+{
+	unsigned const countOfFullSegments = seq.size() / 16;
+	for (unsigned i = 0; i <= countOfFullSegments; ++i) {
+		unsigned const length = std::min(16u, static_cast<unsigned>(seq.size()) - i*16);
+		if (length == 0) break;
+		uint32_t v = 0;
+		for (unsigned j = 0; j < 4; ++j) v = (v << 8) + ((j < (length + 3) / 4) ? data[i*4+j] : 0);
+		seq.replace( i*16, length, convertBinaryToGenomic(v >> (2 * (16 - length)), length) );
+	}
+}
+
+
+int main(int argc, char ** argv)
+{
+	Parameters p;
+	try {
+		for (int i = 1; i < argc; ++i) {
+			std::string const arg = argv[i];
+			std::string::size_type const pos = arg.find('=');
+			if (pos == std::string::npos) {
+				std::cerr << "Available parameters (with default values):\n";
+				std::cerr << "\tlength=100         number of nucleotides in a sequence\n";
+				std::cerr << "\tsequences=10000    number of different sequences\n";
+				std::cerr << "\trepeats=100        number of passes over all sequences\n";
+				std::cerr << "\tseed=1\n";
+				return 1;
+			}
+			std::string const name = arg.substr(0, pos);
+			std::string const value = arg.substr(pos + 1);
+			if (name == "length") p.length = boost::lexical_cast<unsigned>(value);
+			else if (name == "sequences") p.sequencesCount = boost::lexical_cast<unsigned>(value);
+			else if (name == "repeats") p.repeats = boost::lexical_cast<unsigned>(value);
+			else if (name == "seed") p.seed = boost::lexical_cast<unsigned>(value);
+			else throw std::runtime_error("Unknown parameter: " + name);
+		}
+		if (p.sequencesCount == 0 || p.repeats == 0) throw std::runtime_error("Incorrect values of parameters");
+
+		std::mt19937 gen(p.seed);
+		std::vector<std::string> sequences(p.sequencesCount, std::string(p.length, 'A'));
+		for (auto & s: sequences) for (auto & c: s) c = "ACGT"[gen() % 4];
+		unsigned const bytesPerSequence = (p.length + 3) / 4;
+		std::vector<uint8_t> expected(bytesPerSequence * p.sequencesCount);
+		for (unsigned i = 0; i < p.sequencesCount; ++i) convertGenomicToBinary(sequences[i].data(), p.length, &expected[i * bytesPerSequence], nucleotidesKernel::scalar);
+
+		std::vector<std::string> const names = { "segments", "scalar", "sse41", "avx2" };
+		nucleotidesKernel const kernels[] = { nucleotidesKernel::scalar, nucleotidesKernel::scalar, nucleotidesKernel::sse41, nucleotidesKernel::avx2 };
+		std::cout << "implementation\toperation\tlength\tsequences\trepeats\tincorrect\tseconds\tmegaBasesPerSec\tspeedup\n";
+		double segmentsSeconds[2] = {0, 0};
+		for (unsigned impl = 0; impl < names.size(); ++impl) {
+			if (impl > 0 && kernels[impl] > bestNucleotidesKernel()) continue;
+			std::vector<uint8_t> packed(expected.size());
+			std::vector<std::string> unpacked(sequences.size(), std::string(p.length, '?'));
+			Result r[2];
+			// pack
+			Clock::time_point start = Clock::now();
+			for (unsigned rep = 0; rep < p.repeats; ++rep) {
+				for (unsigned i = 0; i < p.sequencesCount; ++i) {
+					if (impl == 0) {
+						packSegments(sequences[i], &packed[i * bytesPerSequence]);
+					} else {
+						convertGenomicToBinary(sequences[i].data(), p.length, &packed[i * bytesPerSequence], kernels[impl]);
+					}
+				}
+			}
+			r[0].seconds = secondsSince(start);
+			for (unsigned i = 0; i < packed.size(); ++i) if (packed[i] != expected[i]) ++(r[0].incorrect);
+			// unpack
+			start = Clock::now();
+			for (unsigned rep = 0; rep < p.repeats; ++rep) {
+				for (unsigned i = 0; i < p.sequencesCount; ++i) {
+					if (impl == 0) {
+						unpackSegments(&expected[i * bytesPerSequence], unpacked[i]);
+					} else {
+						convertBinaryToGenomic(&expected[i * bytesPerSequence], p.length, &(unpacked[i][0]), kernels[impl]);
+					}
+				}
+			}
+			r[1].seconds = secondsSince(start);
+			for (unsigned i = 0; i < p.sequencesCount; ++i) if (unpacked[i] != sequences[i]) ++(r[1].incorrect);
+			// results
+			for (unsigned op = 0; op < 2; ++op) {
+				if (impl == 0) segmentsSeconds[op] = r[op].seconds;
+				double const megaBases = static_cast<double>(p.length) * p.sequencesCount * p.repeats / 1000000.0;
+				std::cout << names[impl] << "\t" << ((op == 0) ? "pack" : "unpack") << "\t" << p.length << "\t" << p.sequencesCount << "\t" << p.repeats
+						  << "\t" << r[op].incorrect << "\t" << r[op].seconds << "\t" << (megaBases / r[op].seconds)
+						  << "\t" << (segmentsSeconds[op] / r[op].seconds) << "\n";
+			}
+		}
+	} catch (std::exception const & e) {
+		std::cerr << "EXCEPTION: " << e.what() << std::endl;
+		return 2;
+	}
+
+	return 0;
+}
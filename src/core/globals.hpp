@@ -20,6 +20,13 @@ struct Configuration {
 	std::string allelesDatabase_path = "";
 	unsigned    allelesDatabase_threads = 1;
 	unsigned    allelesDatabase_ioTasks = 1;
+	unsigned    allelesDatabase_walCheckpoint = 1024;  // in MB, 0 - write-ahead log is not used
+	unsigned    allelesDatabase_ioUring = 0;           // number of threads collecting completions of io_uring, 0 - pread/pwrite are used
+	unsigned    allelesDatabase_readOnly = 0;          // 1 - files are mapped to memory and never modified (read-only mirror)
+	unsigned    allelesDatabase_cacheBudget = 0;       // in MB, memory shared by caches of all tables, 0 - caches have fixed sizes
+	unsigned    allelesDatabase_hugePages = 1;         // memory of caches: 0 - regular pages, 1 - transparent huge pages, 2 - explicit huge pages
+	unsigned    allelesDatabase_warmUp = 0;            // pages per second loaded to caches after restart, 0 - caches are not warmed up
+	unsigned    allelesDatabase_compaction = 0;        // pages per second moved by compaction of files in background, 0 - files are not compacted
 	unsigned    allelesDatabase_cache_genomic = 128;
 	unsigned    allelesDatabase_cache_protein = 128;
 	unsigned    allelesDatabase_cache_sequence = 128;
@@ -29,6 +36,18 @@ struct Configuration {
 	unsigned    allelesDatabase_cache_idClinVarVariant = 128;
 	unsigned    allelesDatabase_cache_idDbSnp = 128;
 	unsigned    allelesDatabase_cache_idPa = 128;
+	unsigned    allelesDatabase_cache_idTypes = 16;
+	// compression of data pages (0/1) per each table/index
+	unsigned    allelesDatabase_compression_genomic = 0;
+	unsigned    allelesDatabase_compression_protein = 0;
+	unsigned    allelesDatabase_compression_sequence = 0;
+	unsigned    allelesDatabase_compression_idCa = 0;
+	unsigned    allelesDatabase_compression_idClinVarAllele = 0;
+	unsigned    allelesDatabase_compression_idClinVarRCV = 0;
+	unsigned    allelesDatabase_compression_idClinVarVariant = 0;
+	unsigned    allelesDatabase_compression_idDbSnp = 0;
+	unsigned    allelesDatabase_compression_idPa = 0;
+	unsigned    allelesDatabase_compression_idTypes = 0;
 	std::vector<std::string> genboree_allowedHostnames;
 	std::string logFile_path = "";
 	MySqlConnectionParameters genboree_db;
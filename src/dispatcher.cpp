@@ -236,6 +236,14 @@ public:
 					return false;
 				}
 			}
+			if (kv.first == "after") {
+				if (fPagination) {
+					matchedParams.fRange.after = ContinuationToken::fromString(kv.second);
+					continue;
+				} else {
+					return false;
+				}
+			}
 			bool found = false;
 			for (auto & p: matchedParams.params) {
 				if (p.fName == kv.first) {
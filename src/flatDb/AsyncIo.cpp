@@ -0,0 +1,332 @@
+#include "../apiDb/AsyncIo.hpp"
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+#include <stdexcept>
+#include <condition_variable>
+// -------- low level file access
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <errno.h>
+
+
+	// io_uring is used directly by system calls (there is no dependency on liburing)
+	static int sysIoUringSetup(unsigned entries, io_uring_params * params)
+	{
+		return syscall(__NR_io_uring_setup, entries, params);
+	}
+
+	static int sysIoUringEnter(int ring, unsigned toSubmit, unsigned minComplete, unsigned flags)
+	{
+		return syscall(__NR_io_uring_enter, ring, toSubmit, minComplete, flags, nullptr, 0);
+	}
+
+
+	struct AsyncIo::Pim
+	{
+		// requests submitted by single call of execute(), the object is on the stack of the calling thread
+		struct Batch
+		{
+			std::mutex access;
+			std::condition_variable completed;
+			unsigned completedCount = 0;
+			std::vector<int64_t> results;   // number of bytes or -errno
+		};
+		// user_data of the request points to this structure, user_data = 0 is used to stop reaper threads
+		struct Slot
+		{
+			Batch * batch;
+			unsigned index;
+		};
+		int ring = -1;
+		unsigned queueDepth = 0;
+		// ----- memory shared with the kernel
+		void * sqRing = MAP_FAILED;
+		void * cqRing = MAP_FAILED;
+		size_t sqRingSize = 0;
+		size_t cqRingSize = 0;
+		io_uring_sqe * sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+		size_t sqesSize = 0;
+		unsigned * sqHead = nullptr;
+		unsigned * sqTail = nullptr;
+		unsigned sqMask = 0;
+		unsigned sqEntries = 0;
+		unsigned * cqHead = nullptr;
+		unsigned * cqTail = nullptr;
+		unsigned cqMask = 0;
+		io_uring_cqe * cqes = nullptr;
+		// ----- threads
+		std::mutex submitAccess;
+		std::mutex completionAccess;
+		std::vector<std::thread> reapers;
+		std::atomic<bool> stopping;
+		std::atomic<unsigned> reapersRunning;
+		// ----- measurements
+		std::atomic<uint64_t> countOfSubmitCalls;
+		std::atomic<uint64_t> countOfRequests;
+		std::atomic<uint64_t> countOfBuffers;
+		Pim() : stopping(false), reapersRunning(0), countOfSubmitCalls(0), countOfRequests(0), countOfBuffers(0) {}
+		bool setup(unsigned entries)
+		{
+			io_uring_params params;
+			std::memset(&params, 0, sizeof(params));
+			ring = sysIoUringSetup(entries, &params);
+			if (ring < 0) return false;
+			// without IORING_FEAT_NODROP completions may be lost when there are too many requests in progress
+			if ( (params.features & IORING_FEAT_NODROP) == 0 ) return false;
+			sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+			cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+			bool const singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP);
+			if (singleMmap) sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+			sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+			if (sqRing == MAP_FAILED) return false;
+			if (singleMmap) {
+				cqRing = sqRing;
+			} else {
+				cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+				if (cqRing == MAP_FAILED) return false;
+			}
+			sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+			sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES));
+			if (sqes == MAP_FAILED) return false;
+			uint8_t * sq = static_cast<uint8_t*>(sqRing);
+			uint8_t * cq = static_cast<uint8_t*>(cqRing);
+			sqHead    = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+			sqTail    = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+			sqMask    = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+			sqEntries = params.sq_entries;
+			cqHead    = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+			cqTail    = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+			cqMask    = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+			cqes      = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+			// entries in the submission queue always point to the entries with the same index
+			unsigned * sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+			for (unsigned i = 0; i < sqEntries; ++i) sqArray[i] = i;
+			queueDepth = sqEntries;
+			return true;
+		}
+		void release()
+		{
+			if (sqes != MAP_FAILED) munmap(sqes, sqesSize);
+			if (cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+			if (sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+			if (ring >= 0) close(ring);
+			ring = -1;
+		}
+		// ----- submission queue, it must be called inside submitAccess
+		unsigned freeEntries() const
+		{
+			return sqEntries - (*sqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE));
+		}
+		void addEntry(uint8_t opcode, int file, uint64_t offset, iovec const * buffers, unsigned buffersCount, Slot * slot)
+		{
+			unsigned const tail = *sqTail;
+			io_uring_sqe & sqe = sqes[tail & sqMask];
+			std::memset(&sqe, 0, sizeof(sqe));
+			sqe.opcode = opcode;
+			sqe.fd = file;
+			sqe.off = offset;
+			sqe.addr = reinterpret_cast<uint64_t>(buffers);
+			sqe.len = buffersCount;
+			sqe.user_data = reinterpret_cast<uint64_t>(slot);
+			__atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+		}
+		// returns false if the entries could not be submitted, they are removed from the queue then
+		bool submit(unsigned & count)
+		{
+			while (count > 0) {
+				int const r = sysIoUringEnter(ring, count, 0, 0);
+				if (r >= 0) {
+					++countOfSubmitCalls;
+					count -= r;
+				} else if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+					// too many completions waiting for reapers
+					std::this_thread::yield();
+				} else {
+					__atomic_store_n(sqTail, *sqTail - count, __ATOMIC_RELEASE);
+					return false;
+				}
+			}
+			return true;
+		}
+		// ----- completion queue
+		void reaperThread()
+		{
+			while (true) {
+				int const r = sysIoUringEnter(ring, 0, 1, IORING_ENTER_GETEVENTS);
+				if (r < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) break;
+				std::lock_guard<std::mutex> synchAccess(completionAccess);
+				unsigned head = *cqHead;
+				unsigned const tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+				for ( ;  head != tail;  ++head ) {
+					io_uring_cqe const & cqe = cqes[head & cqMask];
+					Slot * slot = reinterpret_cast<Slot*>(cqe.user_data);
+					if (slot == nullptr) continue;  // wake up request
+					Batch & batch = *(slot->batch);
+					std::lock_guard<std::mutex> synchAccess2(batch.access);
+					batch.results[slot->index] = cqe.res;
+					++(batch.completedCount);
+					batch.completed.notify_all();
+				}
+				__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+				if (stopping.load()) break;
+			}
+			--reapersRunning;
+		}
+	};
+
+
+	AsyncIo::AsyncIo(unsigned queueDepth, unsigned reaperThreadsCount) : pim(new Pim)
+	{
+		if ( ! pim->setup(std::max(1u,queueDepth)) ) {
+			pim->release();
+			return;
+		}
+		reaperThreadsCount = std::max(1u, reaperThreadsCount);
+		pim->reapersRunning = reaperThreadsCount;
+		for (unsigned i = 0; i < reaperThreadsCount; ++i) {
+			pim->reapers.push_back( std::thread( [this](){ this->pim->reaperThread(); } ) );
+		}
+	}
+
+
+	AsyncIo::~AsyncIo()
+	{
+		if (pim->ring >= 0) {
+			pim->stopping = true;
+			// each wake up request ends one of the blocked reapers
+			while (pim->reapersRunning.load() > 0) {
+				{
+					std::lock_guard<std::mutex> synchAccess(pim->submitAccess);
+					if (pim->freeEntries() > 0) {
+						unsigned count = 1;
+						pim->addEntry(IORING_OP_NOP, -1, 0, nullptr, 0, nullptr);
+						pim->submit(count);
+					}
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			for (auto & t: pim->reapers) t.join();
+		}
+		pim->release();
+		delete pim;
+	}
+
+
+	bool AsyncIo::isSupported() const
+	{
+		return (pim->ring >= 0);
+	}
+
+
+	int AsyncIo::execute(int file, std::vector<Request> const & requests)
+	{
+		if (requests.empty()) return 0;
+		if ( ! isSupported() ) throw std::logic_error("AsyncIo::execute() called, but io_uring is not supported");
+
+		Pim::Batch batch;
+		batch.results.resize(requests.size(), 0);
+		std::vector<Pim::Slot> slots(requests.size());
+		unsigned submittedCount = 0;
+
+		// ===== add requests to the submission queue, they are submitted together (or in chunks of the queue size)
+		{
+			std::lock_guard<std::mutex> synchAccess(pim->submitAccess);
+			unsigned pendingCount = 0;
+			bool failure = false;
+			for (unsigned i = 0; i < requests.size() && ! failure; ++i) {
+				if (pim->freeEntries() == 0) {
+					unsigned const count = pendingCount;
+					failure = ! pim->submit(pendingCount);
+					submittedCount += count - pendingCount;
+					pendingCount = 0;
+					if (failure) break;
+				}
+				Request const & r = requests[i];
+				slots[i].batch = &batch;
+				slots[i].index = i;
+				pim->addEntry( (r.write ? IORING_OP_WRITEV : IORING_OP_READV), file, r.offset, r.buffers.data(), r.buffers.size(), &(slots[i]) );
+				++pendingCount;
+				++(pim->countOfRequests);
+				pim->countOfBuffers += r.buffers.size();
+			}
+			if ( ! failure ) {
+				unsigned const count = pendingCount;
+				pim->submit(pendingCount);
+				submittedCount += count - pendingCount;
+			}
+		}
+
+		// ===== wait for completions
+		{
+			std::unique_lock<std::mutex> synchAccess(batch.access);
+			batch.completed.wait( synchAccess, [&batch,submittedCount]()->bool{ return batch.completedCount == submittedCount; } );
+		}
+
+		// ===== check results, short reads/writes and requests not submitted are finished synchronously
+		int errnum = 0;
+		for (unsigned i = 0; i < requests.size(); ++i) {
+			int64_t const result = batch.results[i];
+			if (result < 0) {
+				if (errnum == 0) errnum = -result;
+				continue;
+			}
+			uint64_t length = 0;
+			for (auto const & b: requests[i].buffers) length += b.iov_len;
+			if (static_cast<uint64_t>(result) < length || i >= submittedCount) {
+				int const e = executeSynchronously(file, requests[i], (i < submittedCount) ? result : 0);
+				if (errnum == 0) errnum = e;
+			}
+		}
+		return errnum;
+	}
+
+
+	AsyncIo::Statistics AsyncIo::readAndResetStatistics()
+	{
+		Statistics s;
+		s.submitCallsCount = pim->countOfSubmitCalls.exchange(0);
+		s.requestsCount    = pim->countOfRequests.exchange(0);
+		s.buffersCount     = pim->countOfBuffers.exchange(0);
+		return s;
+	}
+
+
+	int AsyncIo::executeSynchronously(int file, Request const & request, uint64_t bytesDone)
+	{
+		std::vector<iovec> buffers = request.buffers;
+		uint64_t offset = request.offset;
+		auto iB = buffers.begin();
+		while (iB != buffers.end()) {
+			// skip bytes already done
+			if (bytesDone >= iB->iov_len) {
+				bytesDone -= iB->iov_len;
+				offset += iB->iov_len;
+				++iB;
+				continue;
+			}
+			iB->iov_base = static_cast<uint8_t*>(iB->iov_base) + bytesDone;
+			iB->iov_len -= bytesDone;
+			offset += bytesDone;
+			ssize_t const result = (request.write)
+					? pwritev(file, &(*iB), std::min<size_t>(buffers.end() - iB, IOV_MAX), offset)
+					: preadv (file, &(*iB), std::min<size_t>(buffers.end() - iB, IOV_MAX), offset);
+			if (result < 0) {
+				if (errno == EINTR) {
+					bytesDone = 0;
+					continue;
+				}
+				return errno;
+			}
+			if (result == 0) return EIO;  // unexpected end of file
+			bytesDone = result;
+		}
+		return 0;
+	}
@@ -0,0 +1,151 @@
+#include "../apiDb/CacheBudget.hpp"
+#include "StorageWithCache.hpp"
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "../commonTools/assert.hpp"
+
+
+	struct CacheBudget::Pim
+	{
+		struct Cache
+		{
+			flatDb::StorageWithCache * storage;
+			uint64_t minimum;            // in bytes
+			uint64_t size;               // in bytes
+			uint64_t marginalHits = 0;   // ghost hits of the cache, older measurements have smaller weights
+		};
+		std::mutex access;
+		uint64_t const memory;
+		unsigned const rebalanceInterval;
+		uint64_t assigned = 0;       // sum of sizes of caches
+		std::vector<Cache> caches;
+		std::atomic<uint64_t> loadsCount;
+		// ---- statistics
+		uint64_t rebalancesCount = 0;
+		uint64_t movedBytes = 0;
+		Pim(uint64_t memoryInMegabytes, unsigned pRebalanceInterval)
+		: memory(memoryInMegabytes * 1024 * 1024), rebalanceInterval(std::max(1u, pRebalanceInterval)), loadsCount(0) {}
+		// memory moved by single step of rebalancing (1/64 of the budget, at least one page)
+		uint64_t step(Cache const & c) const
+		{
+			uint64_t const pageSize = c.storage->pageSize;
+			return std::max(pageSize, memory / 64 / pageSize * pageSize);
+		}
+		// marginal hit rates are measured as ghost hits for the same amount of memory in all caches (4 steps of rebalancing)
+		uint64_t ghostMemory(Cache const & c) const
+		{
+			uint64_t const pageSize = c.storage->pageSize;
+			return std::max(pageSize, memory / 16 / pageSize * pageSize);
+		}
+		void setSize(Cache & c, uint64_t size)
+		{
+			assigned = assigned - c.size + size;
+			c.size = size;
+			unsigned const pageSize = c.storage->pageSize;
+			c.storage->setCacheSizeInPages(size / pageSize, ghostMemory(c) / pageSize);
+		}
+	};
+
+
+	CacheBudget::CacheBudget(uint64_t memoryInMegabytes, unsigned rebalanceInterval)
+	: pim(new Pim(memoryInMegabytes, rebalanceInterval))
+	{}
+
+
+	CacheBudget::~CacheBudget()
+	{
+		delete pim;
+	}
+
+
+	uint64_t CacheBudget::memoryInBytes() const
+	{
+		return pim->memory;
+	}
+
+
+	uint64_t CacheBudget::freeMemoryInBytes() const
+	{
+		std::lock_guard<std::mutex> synch(pim->access);
+		return (pim->memory - pim->assigned);
+	}
+
+
+	bool CacheBudget::rebalance()
+	{
+		std::lock_guard<std::mutex> synch(pim->access);
+		// ===== the cache with the largest marginal hit rate gets the memory
+		Pim::Cache * receiver = nullptr;
+		for (auto & c: pim->caches) {
+			c.marginalHits = c.marginalHits / 2 + c.storage->readAndResetGhostHitsCount();
+			if (c.marginalHits > 0 && (receiver == nullptr || c.marginalHits > receiver->marginalHits)) receiver = &c;
+		}
+		if (receiver == nullptr) return false;
+		uint64_t const step = pim->step(*receiver);
+		if (pim->memory - pim->assigned < step) {
+			// ===== there is no free memory, it is taken from the cache with the smallest marginal hit rate
+			Pim::Cache * donor = nullptr;
+			for (auto & c: pim->caches) {
+				uint64_t const pageSize = c.storage->pageSize;
+				uint64_t const donorStep = (step + pageSize - 1) / pageSize * pageSize;
+				if (&c == receiver || c.size < c.minimum + donorStep) continue;
+				if (donor == nullptr || c.marginalHits < donor->marginalHits) donor = &c;
+			}
+			// measurements are not exact, small differences would cause moving the same memory back and forth
+			if (donor == nullptr || receiver->marginalHits <= 2 * donor->marginalHits) return false;
+			uint64_t const pageSize = donor->storage->pageSize;
+			pim->setSize(*donor, donor->size - (step + pageSize - 1) / pageSize * pageSize);
+		}
+		pim->setSize(*receiver, receiver->size + step);
+		++(pim->rebalancesCount);
+		pim->movedBytes += step;
+		return true;
+	}
+
+
+	CacheBudget::Statistics CacheBudget::readAndResetStatistics()
+	{
+		std::lock_guard<std::mutex> synch(pim->access);
+		Statistics r;
+		r.rebalancesCount = pim->rebalancesCount;
+		r.movedBytes = pim->movedBytes;
+		pim->rebalancesCount = 0;
+		pim->movedBytes = 0;
+		return r;
+	}
+
+
+	void CacheBudget::registerCache(flatDb::StorageWithCache * cache, uint64_t minimumInMegabytes)
+	{
+		std::lock_guard<std::mutex> synch(pim->access);
+		Pim::Cache c;
+		c.storage = cache;
+		c.minimum = minimumInMegabytes * 1024 * 1024 / cache->pageSize * cache->pageSize;
+		c.size = 0;
+		if (pim->assigned + c.minimum > pim->memory) {
+			throw std::runtime_error("The cache budget (" + std::to_string(pim->memory >> 20) + " MB) is smaller than the sum of minimal sizes of caches");
+		}
+		pim->caches.push_back(c);
+		pim->setSize(pim->caches.back(), c.minimum);
+	}
+
+
+	void CacheBudget::unregisterCache(flatDb::StorageWithCache * cache)
+	{
+		std::lock_guard<std::mutex> synch(pim->access);
+		auto it = std::find_if(pim->caches.begin(), pim->caches.end(), [cache](Pim::Cache const & c){ return (c.storage == cache); });
+		ASSERT(it != pim->caches.end());
+		pim->assigned -= it->size;
+		pim->caches.erase(it);
+	}
+
+
+	void CacheBudget::pageLoaded()
+	{
+		if (++(pim->loadsCount) % pim->rebalanceInterval == 0) rebalance();
+	}
@@ -2,6 +2,7 @@
 #include "Scheduler.hpp"
 #include "../commonTools/assert.hpp"
 #include "../commonTools/bytesLevel.hpp"
+#include <algorithm>
 
 
 #define XX DataNodeT<tKey>
@@ -11,15 +12,16 @@ namespace flatDb {
 
 
 	template<typename tKey>
-	std::vector<std::pair<tKey,uint8_t const*>> XX::readRawRecordsFromPage() const
+	std::vector<std::pair<tKey,uint8_t const*>> XX::readRawRecordsFromPage(uint8_t const * rawData, tKey lastKey) const
 	{
 		std::vector<std::pair<tKey,uint8_t const*>> target;
 		target.reserve( bin.recordsCount );
-		uint8_t const * ptr = fRawData;
+		uint8_t const * ptr = rawData;
 		unsigned const bytesPerKey = bin.bytesPerKey();
 		for (unsigned i = 0; i < bin.recordsCount; ++i) {
 			// read the key
 			tKey const key = bin.firstKey + readUnsignedInteger<tKey>(ptr, bytesPerKey);
+			if (key > lastKey) break;
 			// save the record
 			target.push_back( std::make_pair(key,ptr) );
 			// read the record data size
@@ -31,6 +33,30 @@ namespace flatDb {
 	}
 
 
+	template<typename tKey>
+	std::shared_ptr<typename XX::KeysFilter const> XX::createKeysFilter(std::vector<std::pair<tKey,uint8_t const*>> const & records) const
+	{
+		if (scheduler->keysFilterBitsPerKey == 0 || records.empty()) return nullptr;
+		std::shared_ptr<KeysFilter> filter(new KeysFilter(records.size(), scheduler->keysFilterBitsPerKey));
+		for (auto const & kv: records) filter->add(kv.first);
+		return filter;
+	}
+
+
+	template<typename tKey>
+	bool XX::canBeProcessedWithoutPage(typename SubProcedure::SP const & subproc) const
+	{
+		SubProcedureReadRecordsByKeys const * sp = dynamic_cast<SubProcedureReadRecordsByKeys const *>(subproc.get());
+		if (sp == nullptr) return false;
+		for (tKey const key: sp->keys()) {
+			// all keys in the page are in the range of the bin (there are no keys in the empty node)
+			if (bin.recordsCount == 0 || key < bin.firstKey || key > bin.lastKey()) continue;
+			if (fKeysFilter == nullptr || fKeysFilter->mayContain(key)) return false;
+		}
+		return true;
+	}
+
+
 	template<typename tKey>
 	typename XX::SP XX::createEmpty(Scheduler* scheduler, tKey firstKey)
 	{
@@ -50,7 +76,7 @@ namespace flatDb {
 
 
 	template<typename tKey>
-	typename XX::SP XX::createNew(Scheduler* scheduler, std::vector<std::pair<tKey,uint8_t const*>> & records)
+	typename XX::SP XX::createNew(Scheduler* scheduler, std::vector<std::pair<tKey,uint8_t const*>> & records, std::vector<unsigned> & pagesToSave)
 	{
 		ASSERT( ! records.empty() );
 
@@ -78,15 +104,13 @@ namespace flatDb {
 			std::memcpy(ptr, src, recordLength);
 			ptr += recordLength;
 		}
-		records.clear();
-
-		// ----- send page to storage and unlock it from the cache
-		scheduler->storage->savePageToStorage(pageId);
-		scheduler->storage->unlockPage(pageId);
+		pagesToSave.push_back(pageId);
 
 		// ----- create object
 		SP obj(new DataNodeT<tKey>(scheduler,b,pageId));
 		obj->fThis = obj;
+		obj->fKeysFilter = obj->createKeysFilter(records);
+		records.clear();
 		return obj;
 	}
 
@@ -100,12 +124,30 @@ namespace flatDb {
 	}
 
 
+	template<typename tKey>
+	typename XX::SP XX::createRelocated(Scheduler* scheduler, DataNodeT & source, unsigned pageId, std::vector<unsigned> & pagesToSave)
+	{
+		// ----- copy the page (the content of the page never changes, so the source does not have to be locked)
+		uint8_t* ptr;
+		scheduler->storage->lockPage_createEmpty(pageId, ptr);
+		if (source.bin.recordsCount > 0) scheduler->storage->readPageContent(source.pageId, ptr);
+		pagesToSave.push_back(pageId);
+
+		// ----- create object
+		SP obj(new DataNodeT<tKey>(scheduler,source.bin,pageId));
+		obj->fThis = obj;
+		std::lock_guard<std::mutex> lockGuard(source.fAccessToDataNode);
+		obj->fKeysFilter = source.fKeysFilter;
+		return obj;
+	}
+
+
 	template<typename tKey>
 	XX::~DataNodeT()
 	{
 		std::lock_guard<std::mutex> lockGuard(fAccessToDataNode);
 		if (fRawData != nullptr) scheduler->storage->unlockPage(pageId);
-		if (fState == DataState::obsolete) scheduler->storage->releasePages(std::vector<unsigned>(1,pageId));
+		if (fState == DataState::obsolete) scheduler->releasePages(std::vector<unsigned>(1,pageId));
 	}
 
 
@@ -114,7 +156,36 @@ namespace flatDb {
 	{
 		bool const isUpdate = ! subproc->isReadOnly();
 
-		std::lock_guard<std::mutex> lockGuard(fAccessToDataNode);
+		// ===== in read-only mode uncompressed pages are read directly from the file mapped to memory (no locks, no cache)
+		if ( ! isUpdate && scheduler->storage->readOnly ) {
+			uint8_t const * page = (bin.recordsCount == 0) ? nullptr : scheduler->storage->mappedPage(pageId);
+			if (bin.recordsCount == 0 || page != nullptr) {
+				SubProcedureReadRecordsByKeys const * sp = dynamic_cast<SubProcedureReadRecordsByKeys const *>(subproc.get());
+				if (sp != nullptr) {
+					// reads by keys are processed at once, records after the last key are not needed (keys are sorted)
+					tKey const lastKey = sp->keys().empty() ? bin.firstKey : sp->keys().back();
+					subproc->process( (page == nullptr) ? std::vector<std::pair<tKey,uint8_t const*>>() : readRawRecordsFromPage(page, lastKey) );
+				} else {
+					// reads from range are processed by CPU task, because the procedure schedules the next subprocedure
+					// when the current one is deleted (it would be a recursion here)
+					SP thisSP = fThis.lock();
+					auto processTask = [thisSP,subproc,page]()->void { subproc->process( thisSP->readRawRecordsFromPage(page) ); };
+					scheduler->cpuTasksManager->addTask(processTask, subproc->priority);
+				}
+				return;
+			}
+			// the page is compressed, it is loaded to the cache
+		}
+
+		std::unique_lock<std::mutex> lockGuard(fAccessToDataNode);
+
+		// ===== reads of keys absent in the page are processed at once (no IO and CPU tasks are needed)
+		if ( ! isUpdate && canBeProcessedWithoutPage(subproc) ) {
+			lockGuard.unlock();
+			scheduler->registerReadWithoutPage();
+			subproc->process( std::vector<std::pair<tKey,uint8_t const*>>() );
+			return;
+		}
 
 		// ===== add subprocedure
 		bool requireRawData = false;
@@ -131,10 +202,11 @@ namespace flatDb {
 		if ( requireRawData ) {
 			switch (fCacheState) {
 			case CacheState::notCached:
-				if (scheduler->storage->lockPage_loadFromCache(pageId, fRawData)) {
+				if (scheduler->storage->lockPage_loadFromCache(pageId, fRawData, subproc->accessType())) {
 					fCacheState = CacheState::cached;
 				} else {
 					fIoPriority = subproc->priority;
+					fAccessType = subproc->accessType();
 					// TODO scheduler->ioTasksManager->updatePriority(fIoTaskId, fIoPriority);
 					SP thisSP = fThis.lock();
 					auto readTask = [thisSP]()->void { thisSP->read(); };
@@ -144,6 +216,7 @@ namespace flatDb {
 				}
 				break;
 			case CacheState::scheduledForRead:
+				fAccessType = std::min(fAccessType, subproc->accessType());
 				if (fIoPriority < subproc->priority) {
 					fIoPriority = subproc->priority;
 					// TODO scheduler->ioTasksManager->updatePriority(fIoTaskId, fIoPriority);
@@ -191,15 +264,25 @@ namespace flatDb {
 	template<typename tKey>
 	void XX::read()
 	{
+		StorageWithCache::AccessType accessType;
 		{
 			std::lock_guard<std::mutex> lockGuard(fAccessToDataNode);
 			if (fCacheState != CacheState::scheduledForRead) return; // this task is no longer needed
 			fCacheState = CacheState::duringReadExecution;
+			accessType = fAccessType;
 		}
 
 		// ===== read data from storage
 		uint8_t * page;
-		if ( ! scheduler->storage->lockPage_loadFromStorage( pageId, page ) ) {
+		if ( ! scheduler->storage->lockPage_loadFromStorage( pageId, page, accessType ) ) {
+			{
+				// ---- the page was only read ahead, it is not needed now
+				std::lock_guard<std::mutex> lockGuard(fAccessToDataNode);
+				if (fReadsToDo.empty() && fUpdatesToDo.empty()) {
+					fCacheState = CacheState::notCached;
+					return;
+				}
+			}
 			// ---- schedule reorganize to free cache
 			scheduler->scheduleToReorganize(nullptr, 1000); // TODO - hardcoded value
 			// ---- reschedule read() task
@@ -248,6 +331,30 @@ namespace flatDb {
 	}
 
 
+	template<typename tKey>
+	bool XX::prefetch(unsigned priority, StorageWithCache::AccessType accessType)
+	{
+		std::lock_guard<std::mutex> lockGuard(fAccessToDataNode);
+		if (bin.recordsCount == 0 || fCacheState != CacheState::notCached || scheduler->storage->isPageInCache(pageId)) return false;
+		// the same IO task as for subprocedures, the page is unlocked by process() when there is nothing to do
+		fIoPriority = priority;
+		fAccessType = accessType;
+		SP thisSP = fThis.lock();
+		auto readTask = [thisSP]()->void { thisSP->read(); };
+		fIoTaskId = scheduler->ioTasksManager->addTask(readTask, fIoPriority);
+		fCacheState = CacheState::scheduledForRead;
+		return true;
+	}
+
+
+	template<typename tKey>
+	bool XX::isWaitingForRead()
+	{
+		std::lock_guard<std::mutex> lockGuard(fAccessToDataNode);
+		return (fCacheState == CacheState::scheduledForRead || fCacheState == CacheState::duringReadExecution);
+	}
+
+
 	template<typename tKey>
 	void XX::process()
 	{
@@ -315,7 +422,13 @@ namespace flatDb {
 			// ----- process read subprocedures
 			if ( ! reads.empty() ) {
 				if (dataRaw.empty()) {
-					dataRaw = readRawRecordsFromPage();
+					dataRaw = readRawRecordsFromPage(fRawData);
+					// the filter is set only here and in createNew(), so it can be checked without the lock
+					if (fKeysFilter == nullptr && scheduler->keysFilterBitsPerKey > 0) {
+						std::shared_ptr<KeysFilter const> filter = createKeysFilter(dataRaw);
+						std::lock_guard<std::mutex> lockGuard(fAccessToDataNode);
+						fKeysFilter = filter;
+					}
 				}
 				for (auto sp: reads) {
 					sp->process(dataRaw);
@@ -327,7 +440,7 @@ namespace flatDb {
 				// prepare fNewContent is needed
 				if ( ! (wasModified || fState == DataState::modified) ) {
 					if (dataRaw.empty()) {
-						dataRaw = readRawRecordsFromPage();
+						dataRaw = readRawRecordsFromPage(fRawData);
 					}
 					fNewContent.swap(dataRaw);
 				}
@@ -366,11 +479,12 @@ namespace flatDb {
 				return false;
 			case CacheState::notCached:
 				if ( ! scheduler->storage->lockPage_loadFromCache(pageId,ptr) ) return false;
-				fNewContent = readRawRecordsFromPage();
+				fRawData = ptr;
+				fNewContent = readRawRecordsFromPage(fRawData);
 				fCacheState = CacheState::cached;
 				break;
 			case CacheState::cached:
-				fNewContent = readRawRecordsFromPage();
+				fNewContent = readRawRecordsFromPage(fRawData);
 				break;
 			}
 			// data was successfully loaded, now the data node may be treated as "modified"
@@ -415,6 +529,48 @@ namespace flatDb {
 	}
 
 
+	template<typename tKey>
+	bool XX::tryToPrepareForRelocation()
+	{
+		std::lock_guard<std::mutex> lockGuard(fAccessToDataNode);
+		if ( fState != DataState::unmodified || ! fUpdatesToDo.empty() || fTasksState == TasksState::duringUpdateProcessing ) return false;
+		fState = DataState::reorganized;
+		return true;
+	}
+
+
+	template<typename tKey>
+	bool XX::isUnmodified()
+	{
+		std::lock_guard<std::mutex> lockGuard(fAccessToDataNode);
+		return ( fState == DataState::unmodified && fUpdatesToDo.empty() && fTasksState != TasksState::duringUpdateProcessing );
+	}
+
+
+	template<typename tKey>
+	void XX::prepareForBulkLoad(std::vector<std::pair<tKey,uint8_t const*>> & out, uint8_t * buffer)
+	{
+		std::lock_guard<std::mutex> lockGuard(fAccessToDataNode);
+		ASSERT( fState == DataState::unmodified );
+		ASSERT( fUpdatesToDo.empty() );
+		if (bin.recordsCount > 0) {
+			scheduler->storage->readPageContent(pageId, buffer);
+			std::vector<std::pair<tKey,uint8_t const*>> records = readRawRecordsFromPage(buffer);
+			out.insert(out.end(), records.begin(), records.end());
+		}
+		fState = DataState::reorganized;
+	}
+
+
+	template<typename tKey>
+	void XX::cancelBulkLoad()
+	{
+		std::lock_guard<std::mutex> lockGuard(fAccessToDataNode);
+		ASSERT( fState == DataState::reorganized );
+		fState = DataState::unmodified;
+	}
+
+
 	template class DataNodeT<uint32_t>;
 	template class DataNodeT<uint64_t>;
 }
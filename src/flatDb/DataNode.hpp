@@ -6,7 +6,9 @@
 #include <stack>
 #include <memory>
 #include <mutex>
+#include <limits>
 #include "Bin.hpp"
+#include "KeysFilter.hpp"
 #include "SubProcedure.hpp"
 #include "../commonTools/assert.hpp"
 
@@ -53,6 +55,7 @@ namespace flatDb {
 		typedef RecordT<tKey> Record;
 		typedef BinT<tKey> Bin;
 		typedef SchedulerT<tKey> Scheduler;
+		typedef KeysFilterT<tKey> KeysFilter;
 		Scheduler* const scheduler;
 		Bin const bin;
 		unsigned const pageId;        // page id in the file
@@ -86,7 +89,12 @@ namespace flatDb {
 		unsigned fIoPriority = 0;
 		unsigned fCpuPriority = 0;
 		unsigned fReorganizePriority = 0;
+		// the strongest type of access of subprocedures waiting for the page (point > scan > scanLowPriority), used when it is loaded
+		StorageWithCache::AccessType fAccessType = StorageWithCache::AccessType::scanLowPriority;
 		uint8_t * fRawData = nullptr;
+		// filter with keys saved in the page (optional), it is built when the content of the page is available
+		// (the node is created or the page is read), the content of the page never changes so it is never updated
+		std::shared_ptr<KeysFilter const> fKeysFilter;
 		// subprocedures to process
 		std::vector<typename SubProcedure::SP> fReadsToDo;
 		std::vector<typename SubProcedure::SP> fUpdatesToDo;
@@ -94,23 +102,45 @@ namespace flatDb {
 		std::vector<typename SubProcedure::SP> fWaitingForCommit;
 		// modified content of the DataNode
 		std::vector<std::pair<tKey,uint8_t const*>> fNewContent; // organized by keys
-		std::vector<std::pair<tKey,uint8_t const*>> readRawRecordsFromPage() const;
+		// records with keys larger than lastKey are skipped (the page is parsed only to the last needed record)
+		std::vector<std::pair<tKey,uint8_t const*>> readRawRecordsFromPage(uint8_t const * rawData, tKey lastKey = std::numeric_limits<tKey>::max()) const;
+		// returns nullptr if filters are not used
+		std::shared_ptr<KeysFilter const> createKeysFilter(std::vector<std::pair<tKey,uint8_t const*>> const & records) const;
+		// returns true if the subprocedure reads only keys that are not in the page for sure (it can be processed without the page)
+		bool canBeProcessedWithoutPage(typename SubProcedure::SP const &) const;
 		DataNodeT(Scheduler * pScheduler, Bin const & pBin, unsigned pPageId)
 		: scheduler(pScheduler), bin(pBin), pageId(pPageId), fMemoryForNewContent(64*1024) {} // TODO - should depend on data page size?
 	public:
 		// constructors
 		static SP createEmpty(Scheduler*, tKey firstKey);
-		static SP createNew(Scheduler*, std::vector<std::pair<tKey,uint8_t const*>> & records); // records are deleted !
+		// records are deleted ! the page is not saved, it is left locked in the cache and its id is appended to pagesToSave
+		static SP createNew(Scheduler*, std::vector<std::pair<tKey,uint8_t const*>> & records, std::vector<unsigned> & pagesToSave);
 		static SP createFromStorage(Scheduler*, unsigned pageId, Bin bin);
+		// copy of the data node saved in the given (allocated) page, the page is left locked in the cache and its id is appended
+		// to pagesToSave (like in createNew), the source is not modified
+		static SP createRelocated(Scheduler*, DataNodeT & source, unsigned pageId, std::vector<unsigned> & pagesToSave);
 		// destructor - synchronized
 		~DataNodeT();
 		// synchronized access
 		void schedule(typename SubProcedure::SP);
 		void process();
 		void read();
+		// the page is loaded to the cache in background if it is not there (read-ahead), it is not kept locked when there is
+		// nothing to process, returns false if the page is empty, cached or already being read, accessType is used by the cache
+		bool prefetch(unsigned priority, StorageWithCache::AccessType accessType);
+		// returns true if the page is being read from the storage (a subprocedure scheduled now would wait for it)
+		bool isWaitingForRead();
 		bool tryToPrepareForReorganize(std::vector<std::pair<tKey,uint8_t const*>> & out); // move current content to out (append it to out, it is deleted from the object)
 		void freeMemory();
 		void markAsObsolete();
+		// marks unmodified node without pending updates as reorganized (it is replaced by the relocated copy), returns false otherwise
+		bool tryToPrepareForRelocation();
+		// ----- bulk load (there must be no other modifications in progress)
+		bool isUnmodified();
+		// content is read from the storage to given buffer (page size) and appended to out, the node is marked as reorganized
+		void prepareForBulkLoad(std::vector<std::pair<tKey,uint8_t const*>> & out, uint8_t * buffer);
+		// reverts prepareForBulkLoad() when the bulk load is aborted, the node stays in the database
+		void cancelBulkLoad();
 	};
 
 }
@@ -0,0 +1,185 @@
+#include "ExternalSorter.hpp"
+#include "../commonTools/bytesLevel.hpp"
+#include "../commonTools/assert.hpp"
+#include <algorithm>
+#include <queue>
+#include <memory>
+#include <stdexcept>
+#include <cstdio>
+#include <cstring>
+
+
+#define XX ExternalSorterT<tKey>
+
+
+namespace flatDb {
+
+	// record in the file with run: key(sizeof(tKey)), length of data with length(4), data with length
+	static unsigned const runIoBufferSize = 4*1024*1024;
+	static uint64_t const maxChunkSize = 16*1024*1024;
+
+
+	template<typename tKey>
+	struct XX::Pim
+	{
+		std::string pathPrefix;
+		uint64_t memoryLimit;
+		// ----- current run (in memory)
+		std::vector<uint8_t> buffer;                    // records' data with length
+		std::vector<std::pair<tKey,uint64_t>> records;  // key & offset in the buffer
+		unsigned nextRecord = 0;                        // used when there is no runs in files
+		// ----- runs saved in files
+		struct Run
+		{
+			std::string path;
+			FILE * file = nullptr;
+			std::vector<char> ioBuffer;
+			tKey key = 0;
+			std::vector<uint8_t> record;
+			~Run() { if (file != nullptr) fclose(file); std::remove(path.c_str()); }
+			// returns false if there is no more records
+			bool readNext()
+			{
+				uint8_t header[sizeof(tKey)+4];
+				size_t const count = fread(header, 1, sizeof(header), file);
+				if (count == 0 && feof(file)) return false;
+				if (count != sizeof(header)) throw std::runtime_error("Cannot read the temporary file " + path);
+				uint8_t const * ptr = header;
+				key = readUnsignedInteger<sizeof(tKey),tKey>(ptr);
+				unsigned const length = readUnsignedInteger<4,unsigned>(ptr);
+				record.resize(length);
+				if (fread(record.data(), 1, length, file) != length) throw std::runtime_error("Cannot read the temporary file " + path);
+				return true;
+			}
+		};
+		std::vector<std::unique_ptr<Run>> runs;
+		// ----- merge, the top element is the run with the smallest key (the first run for the same keys)
+		bool merging = false;
+		std::priority_queue<std::pair<tKey,unsigned>, std::vector<std::pair<tKey,unsigned>>, std::greater<std::pair<tKey,unsigned>>> queue;
+		std::vector<uint8_t> chunkBuffer;
+
+		void sortCurrentRun()
+		{
+			std::stable_sort( records.begin(), records.end()
+							, [](std::pair<tKey,uint64_t> const & r1, std::pair<tKey,uint64_t> const & r2)->bool{ return (r1.first < r2.first); } );
+		}
+
+		void saveCurrentRun()
+		{
+			sortCurrentRun();
+			std::unique_ptr<Run> run(new Run);
+			run->path = pathPrefix + ".run" + std::to_string(runs.size());
+			run->file = fopen(run->path.c_str(), "w+b");
+			if (run->file == nullptr) throw std::runtime_error("Cannot create the temporary file " + run->path);
+			run->ioBuffer.resize(runIoBufferSize);
+			setvbuf(run->file, run->ioBuffer.data(), _IOFBF, run->ioBuffer.size());
+			for (auto const & r: records) {
+				uint8_t const * ptr = buffer.data() + r.second;
+				unsigned const recordLength = readUnsignedIntVarSize<1,1,unsigned>(ptr);
+				unsigned const length = (ptr - buffer.data() - r.second) + recordLength;
+				uint8_t header[sizeof(tKey)+4];
+				uint8_t * p = header;
+				writeUnsignedInteger<sizeof(tKey)>(p, r.first);
+				writeUnsignedInteger<4>(p, length);
+				if ( fwrite(header, 1, sizeof(header), run->file) != sizeof(header)
+						|| fwrite(buffer.data() + r.second, 1, length, run->file) != length )
+				{
+					throw std::runtime_error("Cannot write to the temporary file " + run->path);
+				}
+			}
+			if (fflush(run->file) != 0) throw std::runtime_error("Cannot write to the temporary file " + run->path);
+			runs.push_back(std::move(run));
+			records.clear();
+			buffer.clear();
+		}
+	};
+
+
+	template<typename tKey>
+	XX::ExternalSorterT(std::string const & pathPrefix, uint64_t memoryInBytes) : pim(new Pim)
+	{
+		pim->pathPrefix = pathPrefix;
+		pim->memoryLimit = memoryInBytes;
+	}
+
+
+	template<typename tKey>
+	XX::~ExternalSorterT()
+	{
+		delete pim;
+	}
+
+
+	template<typename tKey>
+	void XX::add(Record const * record)
+	{
+		if (pim->merging) throw std::logic_error("ExternalSorter::add(): records cannot be added after reading");
+		unsigned const recordSize = record->dataLength();
+		unsigned const recordLengthSize = lengthUnsignedIntVarSize<1,1,unsigned>(recordSize);
+		uint64_t const offset = pim->buffer.size();
+		pim->buffer.resize(offset + recordLengthSize + recordSize);
+		uint8_t * ptr = pim->buffer.data() + offset;
+		writeUnsignedIntVarSize<1,1,unsigned>(ptr, recordSize);
+		record->saveData(ptr);
+		ASSERT( ptr == pim->buffer.data() + pim->buffer.size() );
+		pim->records.push_back( std::make_pair(record->key, offset) );
+		if (pim->buffer.size() >= pim->memoryLimit) pim->saveCurrentRun();
+	}
+
+
+	template<typename tKey>
+	bool XX::readNextChunk(std::vector<std::pair<tKey,uint8_t const*>> & out)
+	{
+		out.clear();
+		uint64_t const chunkSize = std::min(maxChunkSize, pim->memoryLimit);
+
+		// ===== prepare runs for merging
+		if ( ! pim->merging ) {
+			pim->merging = true;
+			if (pim->runs.empty()) {
+				pim->sortCurrentRun();
+			} else {
+				if ( ! pim->records.empty() ) pim->saveCurrentRun();
+				std::vector<uint8_t>().swap(pim->buffer);
+				for (unsigned i = 0; i < pim->runs.size(); ++i) {
+					typename Pim::Run & run = *(pim->runs[i]);
+					if (fseek(run.file, 0, SEEK_SET) != 0) throw std::runtime_error("Cannot read the temporary file " + run.path);
+					if (run.readNext()) pim->queue.push( std::make_pair(run.key, i) );
+				}
+			}
+		}
+
+		// ===== all records are in memory
+		if (pim->runs.empty()) {
+			uint64_t size = 0;
+			while ( pim->nextRecord < pim->records.size() ) {
+				std::pair<tKey,uint64_t> const & r = pim->records[pim->nextRecord];
+				if (size >= chunkSize && r.first != out.back().first) break;
+				uint8_t const * ptr = pim->buffer.data() + r.second;
+				out.push_back( std::make_pair(r.first, ptr) );
+				size += readUnsignedIntVarSize<1,1,unsigned>(ptr);
+				++(pim->nextRecord);
+			}
+			return ( ! out.empty() );
+		}
+
+		// ===== merge runs
+		std::vector<std::pair<tKey,uint64_t>> offsets;
+		pim->chunkBuffer.clear();
+		while ( ! pim->queue.empty() ) {
+			unsigned const runId = pim->queue.top().second;
+			typename Pim::Run & run = *(pim->runs[runId]);
+			if (pim->chunkBuffer.size() >= chunkSize && run.key != offsets.back().first) break;
+			pim->queue.pop();
+			offsets.push_back( std::make_pair(run.key, pim->chunkBuffer.size()) );
+			pim->chunkBuffer.insert(pim->chunkBuffer.end(), run.record.begin(), run.record.end());
+			if (run.readNext()) pim->queue.push( std::make_pair(run.key, runId) );
+		}
+		for (auto const & kv: offsets) out.push_back( std::make_pair(kv.first, pim->chunkBuffer.data() + kv.second) );
+		return ( ! out.empty() );
+	}
+
+
+	template class ExternalSorterT<uint32_t>;
+	template class ExternalSorterT<uint64_t>;
+}
@@ -0,0 +1,35 @@
+#ifndef FLATDB_EXTERNALSORTER_HPP_
+#define FLATDB_EXTERNALSORTER_HPP_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "../apiDb/db.hpp"
+
+namespace flatDb {
+
+	// sorts records by keys, records are serialized and saved in sorted runs in temporary files, the runs are merged at the end
+	// the order of records with the same key is preserved
+	template<typename tKey>
+	class ExternalSorterT
+	{
+	private:
+		struct Pim;
+		Pim * pim;
+	public:
+		typedef RecordT<tKey> Record;
+		// temporary files are created with given prefix, memoryInBytes is the size of run sorted in memory
+		ExternalSorterT(std::string const & pathPrefix, uint64_t memoryInBytes);
+		// temporary files are removed
+		~ExternalSorterT();
+		// saves the record (it is not deleted)
+		void add(Record const *);
+		// returns the next chunk of sorted records (key, data with length), it returns false at the end
+		// records with the same key are in the same chunk, the chunk is valid until the next call
+		// no records can be added after the first call
+		bool readNextChunk(std::vector<std::pair<tKey,uint8_t const*>> & records);
+	};
+
+}
+
+#endif /* FLATDB_EXTERNALSORTER_HPP_ */
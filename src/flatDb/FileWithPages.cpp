@@ -1,14 +1,19 @@
 #include "FileWithPages.hpp"
+#include "../apiDb/AsyncIo.hpp"
 #include <map>
 #include <list>
 #include <memory>
 #include <cstring>
 #include <atomic>
+#include <algorithm>
+#include <stdexcept>
 // -------- low level file access
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/file.h>
+#include <sys/mman.h>
 #include <fcntl.h>
+#include <linux/falloc.h>
 #include <unistd.h>
 
 namespace flatDb {
@@ -21,6 +26,9 @@ namespace flatDb {
 		std::map<unsigned,unsigned> freePages;       // page->id => number of pages
 		std::map<unsigned,std::list<unsigned>> freePagesBySize; // number of pages => pageId
 		std::atomic<bool> fileWasResized;
+		AsyncIo * asyncIo = nullptr;  // nullptr - pread/pwrite are used
+		uint8_t * mapping = nullptr;  // the whole file mapped in read-only mode
+		size_t mappingSize = 0;
 		Pim() { fileWasResized = false; }
 		void throw_error(std::string const & msg)
 		{
@@ -32,15 +40,55 @@ namespace flatDb {
 			if (buf == nullptr) throw_error(msg);
 			throw_error(msg + std::string(buf));
 		}
+		// creates one request for each range of adjacent parts of pages (parts must be sorted)
+		// parts shorter than the page end the request
+		std::vector<AsyncIo::Request> createRequests(bool write, std::vector<PagePart> const & parts, unsigned pageSize) const
+		{
+			std::vector<AsyncIo::Request> requests;
+			for (unsigned i = 0; i < parts.size(); ++i) {
+				if (i == 0 || parts[i-1].pageId + 1 != parts[i].pageId || parts[i-1].length != pageSize) {
+					requests.push_back(AsyncIo::Request());
+					requests.back().write = write;
+					requests.back().offset = parts[i].pageId * static_cast<uint64_t>(pageSize);
+				}
+				iovec b;
+				b.iov_base = parts[i].buffer;
+				b.iov_len = parts[i].length;
+				requests.back().buffers.push_back(b);
+			}
+			return requests;
+		}
+		template<typename tBuffer>
+		static std::vector<PagePart> createParts(std::vector<std::pair<unsigned,tBuffer>> const & pages, unsigned pageSize)
+		{
+			std::vector<PagePart> parts;
+			parts.reserve(pages.size());
+			for (auto const & p: pages) {
+				parts.push_back( PagePart{p.first, pageSize, const_cast<void*>(static_cast<void const*>(p.second))} );
+			}
+			return parts;
+		}
+		// returns 0 or errno
+		int execute(std::vector<AsyncIo::Request> const & requests)
+		{
+			if (asyncIo != nullptr) return asyncIo->execute(file, requests);
+			for (auto const & r: requests) {
+				int const errnum = AsyncIo::executeSynchronously(file, r);
+				if (errnum != 0) return errnum;
+			}
+			return 0;
+		}
 	};
 
 
-	FileWithPages::FileWithPages(std::string const & path, unsigned pPageSize, bool synchronized) : pim(new Pim), pageSize(pPageSize)
+	FileWithPages::FileWithPages(std::string const & path, unsigned pPageSize, bool synchronized, AsyncIo * asyncIo, bool readOnly)
+	: pim(new Pim), pageSize(pPageSize)
 	{
 		std::unique_ptr<Pim> scopedPtr(pim);
 		pim->path = path;
-		int flags = O_RDWR | O_CREAT | O_NOATIME;
-		if (synchronized) flags |= O_SYNC;
+		if (asyncIo != nullptr && asyncIo->isSupported()) pim->asyncIo = asyncIo;
+		int flags = (readOnly ? O_RDONLY : (O_RDWR | O_CREAT)) | O_NOATIME;
+		if (synchronized && ! readOnly) flags |= O_SYNC;
 		pim->file = open(path.c_str(), flags, S_IRUSR | S_IWUSR );
 		if (pim->file < 0) {
 			int errnum = errno;
@@ -52,7 +100,7 @@ namespace flatDb {
 			close(pim->file);
 			pim->throw_error("Cannot check the size of the file. Error returned by fstat(): ", errnum);
 		}
-		if (flock(pim->file, LOCK_EX | LOCK_NB ) != 0) {
+		if (flock(pim->file, (readOnly ? LOCK_SH : LOCK_EX) | LOCK_NB ) != 0) {
 			int errnum = errno;
 			close(pim->file);
 			pim->throw_error("Cannot lock the file. Error returned by flock(): ", errnum);
@@ -63,12 +111,23 @@ namespace flatDb {
 			close(pim->file);
 			pim->throw_error("The size of the file is not a multiplication of the page size.");
 		}
+		if (readOnly && file_size > 0) {
+			void * ptr = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, pim->file, 0);
+			if (ptr == MAP_FAILED) {
+				int errnum = errno;
+				close(pim->file);
+				pim->throw_error("Cannot map the file to memory. Error returned by mmap(): ", errnum);
+			}
+			pim->mapping = static_cast<uint8_t*>(ptr);
+			pim->mappingSize = file_size;
+		}
 		scopedPtr.release();
 	}
 
 
 	FileWithPages::~FileWithPages()
 	{
+		if (pim->mapping != nullptr) munmap(pim->mapping, pim->mappingSize);
 		close(pim->file);
 		delete pim;
 	}
@@ -161,8 +220,62 @@ namespace flatDb {
 	}
 
 
+	bool FileWithPages::allocateGivenPages(unsigned pageId, unsigned numberOfPages)
+	{
+		auto it = pim->freePages.upper_bound(pageId);
+		if (it == pim->freePages.begin()) return false;
+		--it;
+		unsigned const rangeFirst = it->first;
+		unsigned const rangeSize = it->second;
+		if (rangeFirst + rangeSize < pageId + numberOfPages) return false;
+		// --- remove the range and add back its parts before and after given pages
+		pim->freePagesBySize[rangeSize].remove(rangeFirst);
+		if (pim->freePagesBySize[rangeSize].empty()) pim->freePagesBySize.erase(rangeSize);
+		pim->freePages.erase(it);
+		if (rangeFirst < pageId) {
+			pim->freePages[rangeFirst] = pageId - rangeFirst;
+			pim->freePagesBySize[pageId - rangeFirst].push_front(rangeFirst);
+		}
+		if (pageId + numberOfPages < rangeFirst + rangeSize) {
+			unsigned const restSize = rangeFirst + rangeSize - pageId - numberOfPages;
+			pim->freePages[pageId + numberOfPages] = restSize;
+			pim->freePagesBySize[restSize].push_front(pageId + numberOfPages);
+		}
+		return true;
+	}
+
+
+	unsigned FileWithPages::truncateFreeTail()
+	{
+		if (pim->freePages.empty()) return 0;
+		auto it = pim->freePages.end();
+		--it;
+		if (it->first + it->second != pim->pagesCount) return 0;
+		unsigned const rangeFirst = it->first;
+		unsigned const rangeSize = it->second;
+		if ( ftruncate64(pim->file, rangeFirst * static_cast<uint64_t>(pageSize)) != 0 ) {
+			pim->throw_error("ftruncate64() failed: ", errno);
+		}
+		pim->freePagesBySize[rangeSize].remove(rangeFirst);
+		if (pim->freePagesBySize[rangeSize].empty()) pim->freePagesBySize.erase(rangeSize);
+		pim->freePages.erase(it);
+		pim->fileWasResized.store(true);
+		pim->pagesCount = rangeFirst;
+		return rangeSize;
+	}
+
+
 	void FileWithPages::writePages(unsigned pageId, unsigned pagesCount, void const * buf)
 	{
+		if (pim->asyncIo != nullptr) {
+			std::vector<AsyncIo::Request> requests(1);
+			requests[0].write = true;
+			requests[0].offset = pageId * static_cast<uint64_t>(pageSize);
+			requests[0].buffers.push_back( iovec{const_cast<void*>(buf), pagesCount * static_cast<size_t>(pageSize)} );
+			int const errnum = pim->asyncIo->execute(pim->file, requests);
+			if (errnum != 0) pim->throw_error("Cannot write to the file: ", errnum);
+			return;
+		}
 		uint64_t const pageSize64 = static_cast<int64_t>(pageSize);
 		uint64_t offsetBegin = pageId*pageSize64;
 		uint64_t const offsetEnd = offsetBegin + pagesCount*pageSize64;
@@ -177,6 +290,14 @@ namespace flatDb {
 
 	void FileWithPages::readPages(unsigned pageId, unsigned pagesCount, void * buf)
 	{
+		if (pim->asyncIo != nullptr) {
+			std::vector<AsyncIo::Request> requests(1);
+			requests[0].offset = pageId * static_cast<uint64_t>(pageSize);
+			requests[0].buffers.push_back( iovec{buf, pagesCount * static_cast<size_t>(pageSize)} );
+			int const errnum = pim->asyncIo->execute(pim->file, requests);
+			if (errnum != 0) pim->throw_error("Cannot read() on the file: ", errnum);
+			return;
+		}
 		uint64_t const pageSize64 = static_cast<int64_t>(pageSize);
 		uint64_t offsetBegin = pageId*pageSize64;
 		uint64_t const offsetEnd = offsetBegin + pagesCount*pageSize64;
@@ -188,6 +309,57 @@ namespace flatDb {
 		}
 	}
 
+	void FileWithPages::writePages(std::vector<std::pair<unsigned,void const*>> pages)
+	{
+		std::sort(pages.begin(), pages.end());
+		int const errnum = pim->execute( pim->createRequests(true, Pim::createParts(pages, pageSize), pageSize) );
+		if (errnum != 0) pim->throw_error("Cannot write to the file: ", errnum);
+	}
+
+
+	void FileWithPages::readPages(std::vector<std::pair<unsigned,void*>> pages)
+	{
+		std::sort(pages.begin(), pages.end());
+		int const errnum = pim->execute( pim->createRequests(false, Pim::createParts(pages, pageSize), pageSize) );
+		if (errnum != 0) pim->throw_error("Cannot read() on the file: ", errnum);
+	}
+
+
+	void FileWithPages::writePagesParts(std::vector<PagePart> parts)
+	{
+		std::sort(parts.begin(), parts.end(), [](PagePart const & a, PagePart const & b)->bool{ return (a.pageId < b.pageId); });
+		int const errnum = pim->execute( pim->createRequests(true, parts, pageSize) );
+		if (errnum != 0) pim->throw_error("Cannot write to the file: ", errnum);
+		// release the rest of pages, errors are ignored (then the space is just not released)
+		for (auto const & p: parts) {
+			if (p.length >= pageSize) continue;
+			uint64_t const offset = p.pageId * static_cast<uint64_t>(pageSize) + p.length;
+			fallocate(pim->file, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, pageSize - p.length);
+		}
+	}
+
+
+	void FileWithPages::readPagesParts(std::vector<PagePart> parts)
+	{
+		std::sort(parts.begin(), parts.end(), [](PagePart const & a, PagePart const & b)->bool{ return (a.pageId < b.pageId); });
+		int const errnum = pim->execute( pim->createRequests(false, parts, pageSize) );
+		if (errnum != 0) pim->throw_error("Cannot read() on the file: ", errnum);
+	}
+
+
+	uint8_t const * FileWithPages::mappedPage(unsigned pageId) const
+	{
+		return (pim->mapping + pageId * static_cast<uint64_t>(pageSize));
+	}
+
+
+	void FileWithPages::adviseWillNeed(unsigned pageId, unsigned pagesCount) const
+	{
+		// it is only a hint, errors are ignored
+		madvise(pim->mapping + pageId * static_cast<uint64_t>(pageSize), pagesCount * static_cast<size_t>(pageSize), MADV_WILLNEED);
+	}
+
+
 	void FileWithPages::flush()
 	{
 		if (pim->fileWasResized.exchange(false)) {
@@ -3,6 +3,10 @@
 
 #include <string>
 #include <map>
+#include <vector>
+#include <cstdint>
+
+class AsyncIo;
 
 namespace flatDb {
 
@@ -16,7 +20,10 @@ namespace flatDb {
 		unsigned const pageSize;
 		// all these are not synchronized
 		// at the beginning all pages in the file are marked as allocated (not free)
-		FileWithPages(std::string const & path, unsigned pageSize, bool synchronized);
+		// if the queue of asynchronous operations is given (and supported), reads and writes are executed by io_uring
+		// if readOnly is set, the existing file is opened without write access (with shared lock) and the whole file is mapped
+		// to memory, pages can be accessed directly by mappedPage(), routines modifying the file must not be called
+		FileWithPages(std::string const & path, unsigned pageSize, bool synchronized, AsyncIo * asyncIo = nullptr, bool readOnly = false);
 		~FileWithPages();
 		// shrink file to given number of pages and overwrite the set of free pages (free = not allocated)
 		void     setFreePages(unsigned newNumberOfPages, std::map<unsigned,unsigned> const & freePages);
@@ -26,10 +33,32 @@ namespace flatDb {
 		unsigned allocatePages(unsigned pagesCount);
 		// releases (mark as free) given range of pages, adjust file size if needed
 		void     releasePages(unsigned pageId, unsigned pagesCount);
+		// allocates given range of pages, returns false (and does nothing) if any of them is not free
+		bool     allocateGivenPages(unsigned pageId, unsigned pagesCount);
+		// shrinks the file by the range of free pages at its end, returns the number of removed pages
+		unsigned truncateFreeTail();
 		// write/read are delegated to system routines, they can be called in many threads
 		// these methods do not check if given pages are allocated or free
 		void     writePages(unsigned pageId, unsigned pagesCount, void const *);
 		void     readPages (unsigned pageId, unsigned pagesCount, void *);
+		// the same for many single pages (pageId -> buffer), adjacent pages are joined into one vectored request
+		// all requests are submitted together when asynchronous operations are used
+		void     writePages(std::vector<std::pair<unsigned,void const*>> pages);
+		void     readPages (std::vector<std::pair<unsigned,void*>> pages);
+		// the same for beginnings of pages (used for compressed pages), length must be a multiple of 4 KB or equal to the page size
+		// the rest of each written page is released (the hole is punched in the file, if the file system supports it)
+		struct PagePart
+		{
+			unsigned pageId;
+			unsigned length;
+			void * buffer;
+		};
+		void     writePagesParts(std::vector<PagePart> parts);
+		void     readPagesParts (std::vector<PagePart> parts);
+		// read-only mode only: returns pointer to the page in the memory mapping (the kernel loads it on the first access)
+		uint8_t const * mappedPage(unsigned pageId) const;
+		// read-only mode only: tells the kernel that given pages will be read soon (they are read ahead in background)
+		void     adviseWillNeed(unsigned pageId, unsigned pagesCount) const;
 		void flush();
 	};
 
@@ -4,8 +4,13 @@
 #include "Procedure.hpp"
 #include "Scheduler.hpp"
 #include "StorageWithCache.hpp"
+#include "ExternalSorter.hpp"
 #include <map>
 #include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <thread>
 
 
 #define XX DatabaseT<tKey, globalKeySize, unusedVar>
@@ -19,6 +24,14 @@
 		flatDb::StorageWithCache * storage;
 		tCreateRecord callbackCreateRecord;
 		bool newDatabaseWasCreated;
+		std::string name;
+	};
+
+	templateXX
+	struct XX::Snapshot::Pim
+	{
+		flatDb::SchedulerT<tKey> * scheduler;
+		std::shared_ptr<flatDb::IndexNodeT<tKey>> indexNode;
 	};
 
 	struct ScopeTimesLogger {
@@ -28,7 +41,6 @@
 		ScopeTimesLogger(flatDb::StorageWithCache* storage, std::string const & prefix)
 		: fStorage(storage), fPrefix(prefix)
 		{
-			fStorage->readAndResetStatistics();
 			fStopwatch.reset_and_restart();
 		}
 		~ScopeTimesLogger()
@@ -49,6 +61,13 @@
 		return 100;
 	}
 
+	// pages loaded by long scans (or scans of unknown size) are evicted from the cache before pages used by other queries
+	static flatDb::StorageWithCache::AccessType calcScanAccessType(unsigned const recordsCount)
+	{
+		if (recordsCount <= 1000) return flatDb::StorageWithCache::AccessType::scan;
+		return flatDb::StorageWithCache::AccessType::scanLowPriority;
+	}
+
 
 	templateXX
 	XX::DatabaseT
@@ -57,13 +76,18 @@
 		, std::string const & dbFile
 		, tCreateRecord funcLoadData
 		, unsigned cacheSizeInMegabytes
+		, Options const & options
 		)
 	: pim(new Pim)
 	{
 		pim->callbackCreateRecord = funcLoadData;
-		pim->storage = new flatDb::StorageWithCache(dbFile, 256*1024, cacheSizeInMegabytes);  // page size = 256 KB
+		pim->storage = new flatDb::StorageWithCache(dbFile, 256*1024, cacheSizeInMegabytes, 0, options.asyncIo, options.compressPages, options.readOnly, options.cacheBudget, options.memoryArena);  // page size = 256 KB
 		pim->newDatabaseWasCreated = (pim->storage->numberOfPages() == 0);
-		pim->scheduler = new flatDb::SchedulerT<tKey>( globalKeySize, 8, cpuTaskManager, ioTaskManager, pim->storage, pim->callbackCreateRecord ); // index page size = 2 MB
+		// databases attached to the same log are identified by names of their files
+		pim->name = dbFile.substr(dbFile.find_last_of('/') + 1);
+		pim->scheduler = new flatDb::SchedulerT<tKey>( globalKeySize, 8, cpuTaskManager, ioTaskManager, pim->storage, pim->callbackCreateRecord, options.wal, pim->name, options.keysFilterBitsPerKey ); // index page size = 2 MB
+		if (options.warmUpPagesPerSecond > 0) pim->storage->startWarmUp(options.warmUpPagesPerSecond);
+		if (options.compactionPagesPerSecond > 0 && ! options.readOnly) pim->scheduler->startCompaction(options.compactionPagesPerSecond);
 	}
 
 
@@ -71,6 +95,14 @@
 	XX::~DatabaseT()
 	{
 		// TODO - how to check the list of existing tasks ?
+		// the storage is not deleted, so the list of hot pages is saved here (unless the warm-up was interrupted)
+		if ( ! pim->storage->readOnly && pim->storage->warmUpPagesLeft() == 0 ) {
+			try {
+				pim->storage->saveHotPages();
+			} catch (std::exception const &) {
+				// the list is used only to warm up the cache
+			}
+		}
 	}
 
 
@@ -80,6 +112,20 @@
 		ScopeTimesLogger logger(pim->storage, "readRecordsInOrder");
 		typedef flatDb::ProcedureReadRecordsFromRangeT<tKey> Proc;
 		Proc * proc = new Proc(pim->scheduler, calcPriority(hintQuerySize), visitor, first, last);
+		proc->accessType = calcScanAccessType(hintQuerySize);
+		pim->scheduler->schedule(proc);
+		proc->waitUntilCompleted();
+		delete proc;
+	}
+
+
+	templateXX
+	void XX::readRawRecordsInOrder(tReadRawFunction visitor, tKey first, tKey last, unsigned hintQuerySize) const
+	{
+		ScopeTimesLogger logger(pim->storage, "readRawRecordsInOrder");
+		typedef flatDb::ProcedureReadRecordsFromRangeT<tKey> Proc;
+		Proc * proc = new Proc(pim->scheduler, calcPriority(hintQuerySize), visitor, first, last);
+		proc->accessType = calcScanAccessType(hintQuerySize);
 		pim->scheduler->schedule(proc);
 		proc->waitUntilCompleted();
 		delete proc;
@@ -98,9 +144,35 @@
 	}
 
 
+	templateXX
+	void XX::readRawRecords(std::vector<tKey> const & keys, tReadRawByKeyFunction visitor) const
+	{
+		ScopeTimesLogger logger(pim->storage, "readRawRecords");
+		typedef flatDb::ProcedureReadRecordsByKeysT<tKey> Proc;
+		Proc * proc = new Proc(pim->scheduler, calcPriority(keys.size()), visitor, keys);
+		pim->scheduler->schedule(proc);
+		proc->waitUntilCompleted();
+		delete proc;
+	}
+
+
+	templateXX
+	void XX::writeRawRecords(std::vector<tKey> const & keys, tUpdateRawByKeyFunction visitor)
+	{
+		if (pim->storage->readOnly) throw std::logic_error("writeRawRecords() called for the database " + pim->name + " opened in read-only mode");
+		ScopeTimesLogger logger(pim->storage, "writeRawRecords");
+		typedef flatDb::ProcedureUpdateRecordsByKeysT<tKey> Proc;
+		Proc * proc = new Proc(pim->scheduler, calcPriority(keys.size()), visitor, keys);
+		pim->scheduler->schedule(proc);
+		proc->waitUntilCompleted();
+		delete proc;
+	}
+
+
 	templateXX
 	void XX::writeRecords(std::vector<Record*> const & pRecords, tUpdateByKeyFunction visitor)
 	{
+		if (pim->storage->readOnly) throw std::logic_error("writeRecords() called for the database " + pim->name + " opened in read-only mode");
 		ScopeTimesLogger logger(pim->storage, "writeRecords");
 		typedef flatDb::ProcedureUpdateRecordsByKeysT<tKey> Proc;
 		Proc * proc = new Proc(pim->scheduler, calcPriority(pRecords.size()), visitor, pRecords);
@@ -114,6 +186,63 @@
 	}
 
 
+	templateXX
+	void XX::flushPendingChanges() const
+	{
+		pim->scheduler->waitForPendingChanges();
+	}
+
+
+	templateXX
+	std::shared_ptr<typename XX::Snapshot> XX::createSnapshot() const
+	{
+		typename Snapshot::Pim * snapshotPim = new typename Snapshot::Pim;
+		snapshotPim->scheduler = pim->scheduler;
+		snapshotPim->indexNode = pim->scheduler->getCommittedIndexNode();
+		return std::shared_ptr<Snapshot>(new Snapshot(snapshotPim));
+	}
+
+
+	templateXX
+	void XX::bulkLoad(tBulkLoadSourceFunction source, tUpdateByKeyFunction visitor, std::string const & tmpDir, unsigned memoryInMegabytes)
+	{
+		if (pim->storage->readOnly) throw std::logic_error("bulkLoad() called for the database " + pim->name + " opened in read-only mode");
+		ScopeTimesLogger logger(pim->storage, "bulkLoad");
+		std::string prefix = tmpDir;
+		if ( (! prefix.empty()) && prefix.back() != '/') prefix += "/";
+		flatDb::ExternalSorterT<tKey> sorter(prefix + pim->name + ".bulkLoad", uint64_t(memoryInMegabytes) * 1024 * 1024);
+		for (Record * r = source();  r != nullptr;  r = source()) {
+			sorter.add(r);
+			delete r;
+		}
+		auto nextChunk = [&sorter](std::vector<std::pair<tKey,uint8_t const*>> & records)->bool { return sorter.readNextChunk(records); };
+		pim->scheduler->bulkLoad(nextChunk, visitor);
+	}
+
+
+	templateXX
+	void XX::compact(unsigned pagesPerSecond)
+	{
+		if (pim->storage->readOnly) throw std::logic_error("compact() called for the database " + pim->name + " opened in read-only mode");
+		// pages are moved in small groups, each group is committed separately
+		unsigned const pagesPerStep = (pagesPerSecond == 0) ? 64 : std::max(1u, std::min(64u, pagesPerSecond / 8));
+		unsigned stepsWithoutProgress = 0;
+		while (true) {
+			std::chrono::steady_clock::time_point const start = std::chrono::steady_clock::now();
+			unsigned movedPages = 0;
+			if (pim->scheduler->compactionStep(pagesPerStep, movedPages)) break;
+			// pages of replaced data nodes may be still in use (by readers or until the commit of the write-ahead log)
+			if (movedPages == 0) {
+				if (++stepsWithoutProgress > 1000) break;
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				continue;
+			}
+			stepsWithoutProgress = 0;
+			if (pagesPerSecond > 0) std::this_thread::sleep_until(start + std::chrono::microseconds(uint64_t(movedPages) * 1000000 / pagesPerSecond));
+		}
+	}
+
+
 	templateXX
 	tKey XX::getTheLargestKey() const
 	{
@@ -132,6 +261,134 @@
 		return pim->newDatabaseWasCreated;
 	}
 
+
+	templateXX
+	typename XX::Statistics XX::readAndResetStatistics() const
+	{
+		flatDb::StorageWithCache::Statistics const s = pim->storage->readAndResetStatistics();
+		Statistics r;
+		r.synchCount       = s.synchCount;
+		r.synchTimeMs      = s.synchTimeMs;
+		r.writesCount      = s.writesCount;
+		r.writesTimeMs     = s.writesTimeMs;
+		r.readsCount       = s.readsCount;
+		r.readsTimeMs      = s.readsTimeMs;
+		r.cacheHitsCount   = s.cacheHitsCount;
+		r.cacheMissesCount = s.cacheMissesCount;
+		r.scanCacheHitsCount   = s.scanCacheHitsCount;
+		r.scanCacheMissesCount = s.scanCacheMissesCount;
+		r.evictionsCount   = s.evictionsCount;
+		r.cacheSizeInBytes = uint64_t(pim->storage->cacheSizeInPages()) * pim->storage->pageSize;
+		MemoryArena::Statistics const a = pim->storage->memoryArena().statistics();
+		r.arenaMappedBytes = a.mappedBytes;
+		r.arenaUsedBytes = a.usedBytes;
+		r.arenaHugeTlbBytes = a.hugeTlbBytes;
+		r.readsWithoutPageCount = pim->scheduler->readAndResetReadsWithoutPageCount();
+		r.bytesRead        = s.bytesRead;
+		r.bytesWritten     = s.bytesWritten;
+		r.readAheadPagesCount = pim->scheduler->readAndResetReadAheadPagesCount();
+		pim->scheduler->readAndResetCompactionStatistics(r.compactionMovedPages, r.compactionReclaimedBytes, r.compactionPagesLeft);
+		r.warmUpPagesCount = s.warmUpPagesCount;
+		return r;
+	}
+
+
+	templateXX
+	void XX::saveHotPages() const
+	{
+		pim->storage->saveHotPages();
+	}
+
+
+	templateXX
+	unsigned XX::cacheWarmUpPagesLeft() const
+	{
+		return pim->storage->warmUpPagesLeft();
+	}
+
+	// ===================================== SNAPSHOT
+
+	templateXX
+	XX::Snapshot::~Snapshot()
+	{
+		delete pim;
+	}
+
+
+	templateXX
+	void XX::Snapshot::readRecordsInOrder(tReadFunction visitor, tKey first, tKey last, unsigned hintQuerySize) const
+	{
+		typedef flatDb::ProcedureReadRecordsFromRangeT<tKey> Proc;
+		Proc * proc = new Proc(pim->scheduler, calcPriority(hintQuerySize), visitor, first, last);
+		proc->accessType = calcScanAccessType(hintQuerySize);
+		proc->indexNode = pim->indexNode;
+		pim->scheduler->schedule(proc);
+		proc->waitUntilCompleted();
+		delete proc;
+	}
+
+
+	templateXX
+	void XX::Snapshot::readRawRecordsInOrder(tReadRawFunction visitor, tKey first, tKey last, unsigned hintQuerySize) const
+	{
+		typedef flatDb::ProcedureReadRecordsFromRangeT<tKey> Proc;
+		Proc * proc = new Proc(pim->scheduler, calcPriority(hintQuerySize), visitor, first, last);
+		proc->accessType = calcScanAccessType(hintQuerySize);
+		proc->indexNode = pim->indexNode;
+		pim->scheduler->schedule(proc);
+		proc->waitUntilCompleted();
+		delete proc;
+	}
+
+
+	templateXX
+	void XX::Snapshot::readRecords(std::vector<Record*> const & pRecords, tReadByKeyFunction visitor) const
+	{
+		typedef flatDb::ProcedureReadRecordsByKeysT<tKey> Proc;
+		Proc * proc = new Proc(pim->scheduler, calcPriority(pRecords.size()), visitor, pRecords);
+		proc->indexNode = pim->indexNode;
+		pim->scheduler->schedule(proc);
+		proc->waitUntilCompleted();
+		delete proc;
+	}
+
+
+	templateXX
+	void XX::Snapshot::readRawRecords(std::vector<tKey> const & keys, tReadRawByKeyFunction visitor) const
+	{
+		typedef flatDb::ProcedureReadRecordsByKeysT<tKey> Proc;
+		Proc * proc = new Proc(pim->scheduler, calcPriority(keys.size()), visitor, keys);
+		proc->indexNode = pim->indexNode;
+		pim->scheduler->schedule(proc);
+		proc->waitUntilCompleted();
+		delete proc;
+	}
+
+
+	templateXX
+	tKey XX::Snapshot::getTheLargestKey() const
+	{
+		if ( pim->indexNode->entries.empty() ) return 0;
+		return (pim->indexNode->entries.back()->bin.lastKey());
+	}
+
+
+	templateXX
+	uint64_t XX::Snapshot::getRecordsCount() const
+	{
+		uint64_t r = 0;
+		for (auto const & e: pim->indexNode->entries) r += e->bin.recordsCount;
+		return r;
+	}
+
+
+	templateXX
+	unsigned XX::Snapshot::revision() const
+	{
+		return pim->indexNode->revision;
+	}
+
+
 	template class DatabaseT<uint32_t,4,8192>;
 	template class DatabaseT<uint64_t,8,8192>;
 
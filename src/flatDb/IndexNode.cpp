@@ -1,10 +1,12 @@
 #include "IndexNode.hpp"
+#include "Scheduler.hpp"
 
 #include "../commonTools/assert.hpp"
 #include "../commonTools/bytesLevel.hpp"
 
 #include <cstring>
 #include <list>
+#include <iostream>
 
 
 #define XX IndexNodeT<tKey>
@@ -92,6 +94,39 @@ namespace flatDb {
 	}
 
 
+	template<typename tKey>
+	void XX::createDataNodes(std::vector<std::pair<tKey,uint8_t const*>> & allRecords, std::vector<typename XX::DataNode::SP> & newEntries) const
+	{
+		// calculate key page bins
+		std::vector<Bin> keyBins;
+		calculateKeyBinsFromContent( allRecords, keyBins );
+		std::vector<Bin> pageBins = divideIntoPages(keyBins);
+		// build new DataNodes, their pages are saved in groups (adjacent pages are written by single requests)
+		// pages are locked in the cache until they are saved, so the size of the group is limited
+		unsigned const maxPagesToSave = 64;
+		std::vector<unsigned> pagesToSave;
+		auto savePages = [this,&pagesToSave]()
+		{
+			scheduler->storage->savePagesToStorage(pagesToSave);
+			for (auto pageId: pagesToSave) scheduler->storage->unlockPage(pageId);
+			pagesToSave.clear();
+		};
+		auto iR = allRecords.begin();
+		for (Bin const & b: pageBins) {
+			auto iR2 = std::upper_bound(iR, allRecords.end(), b.lastKey(), [](tKey const& k,std::pair<tKey,uint8_t const*> const& r)->bool{return (k<r.first);} );
+			std::vector<std::pair<tKey,uint8_t const*>> records;
+			records.reserve(iR2-iR);
+			records.assign(iR,iR2);
+			newEntries.push_back( DataNode::createNew(scheduler,records,pagesToSave) );
+			ASSERT( newEntries.back()->bin == b );
+			iR = iR2;
+			if (pagesToSave.size() >= maxPagesToSave) savePages();
+		}
+		allRecords.clear();
+		savePages();
+	}
+
+
 	template<typename tKey>
 	typename XX::SP XX::createEmpty(XX::Scheduler* scheduler, unsigned keySize, unsigned dataPageSize, unsigned indexPageSize)
 	{
@@ -101,9 +136,40 @@ namespace flatDb {
 
 
 	template<typename tKey>
-	typename XX::SP XX::createFromBuffer(XX::Scheduler* scheduler, unsigned keySize, unsigned dataPageSize, unsigned indexPageSize, bool firstCopy, void const * ptr)
+	void XX::writeEntry(uint8_t *& p, DataNode const & dn) const
+	{
+		writeUnsignedInteger(p, dn.bin.firstKey, keySize);
+		writeUnsignedInteger(p, dn.bin.lastKey(), keySize);
+		uint64_t recordsCount_bytesCount_pageId = dn.bin.recordsCount; // 19 bits
+		recordsCount_bytesCount_pageId <<= 19;
+		recordsCount_bytesCount_pageId += dn.bin.bytesCount; // 19 bits
+		recordsCount_bytesCount_pageId <<= 18;
+		recordsCount_bytesCount_pageId += dn.pageId; // 18 bits
+		writeUnsignedInteger<7>(p, recordsCount_bytesCount_pageId);
+	}
+
+
+	template<typename tKey>
+	typename XX::DataNode::SP XX::readEntry(XX::Scheduler* scheduler, unsigned keySize, uint8_t const *& p)
+	{
+		Bin bin;
+		bin.firstKey = readUnsignedInteger<tKey>(p, keySize);
+		bin.maxKeyOffset = readUnsignedInteger<tKey>(p, keySize) - bin.firstKey;
+		uint64_t recordsCount_bytesCount_pageId = readUnsignedInteger<7,uint64_t>(p);
+		unsigned const pageId = recordsCount_bytesCount_pageId % (1u << 18);
+		if (pageId == 0) return nullptr;
+		recordsCount_bytesCount_pageId >>= 18;
+		bin.bytesCount = recordsCount_bytesCount_pageId % (1u << 19);
+		recordsCount_bytesCount_pageId >>= 19;
+		bin.recordsCount = recordsCount_bytesCount_pageId;
+		return DataNode::createFromStorage(scheduler,pageId,bin);
+	}
+
+
+	template<typename tKey>
+	typename XX::SP XX::createFromBuffer(XX::Scheduler* scheduler, unsigned keySize, unsigned dataPageSize, unsigned indexPageSize, bool firstCopy, void const * ptr
+										, unsigned & journalFirstPageId, unsigned & journalPagesCount)
 	{
-		unsigned const maxNumberOfDataNodes = (indexPageSize - 8) / (2 * keySize + 7);
 		uint8_t const * p = reinterpret_cast<uint8_t const *>(ptr);
 
 		// parse
@@ -113,18 +179,18 @@ namespace flatDb {
 		}
 		unsigned const revision = readUnsignedInteger<4,unsigned>(p);
 		std::vector<typename DataNode::SP> entries;
-		for (unsigned i = 0; i < maxNumberOfDataNodes; ++i) {
-			Bin bin;
-			bin.firstKey = readUnsignedInteger<tKey>(p, keySize);
-			bin.maxKeyOffset = readUnsignedInteger<tKey>(p, keySize) - bin.firstKey;
-			uint64_t recordsCount_bytesCount_pageId = readUnsignedInteger<7,uint64_t>(p);
-			unsigned const pageId = recordsCount_bytesCount_pageId % (1u << 18);
-			if (pageId == 0) break;
-			recordsCount_bytesCount_pageId >>= 18;
-			bin.bytesCount = recordsCount_bytesCount_pageId % (1u << 19);
-			recordsCount_bytesCount_pageId >>= 19;
-			bin.recordsCount = recordsCount_bytesCount_pageId;
-			entries.push_back( DataNode::createFromStorage(scheduler,pageId,bin) );
+		for (unsigned i = 0; i < maxNumberOfEntries(keySize,indexPageSize); ++i) {
+			typename DataNode::SP dn = readEntry(scheduler, keySize, p);
+			if (dn == nullptr) break;
+			entries.push_back(dn);
+		}
+
+		// location of the journal is saved at the end of the page (zeros in the old format)
+		journalFirstPageId = journalPagesCount = 0;
+		if (entries.size() <= maxNumberOfEntriesWithJournal(keySize,indexPageSize)) {
+			p = reinterpret_cast<uint8_t const *>(ptr) + indexPageSize - 8;
+			journalFirstPageId = readUnsignedInteger<4,unsigned>(p);
+			journalPagesCount = readUnsignedInteger<4,unsigned>(p);
 		}
 
 		SP obj(new IndexNodeT<tKey>( scheduler, keySize, dataPageSize, indexPageSize, revision, firstCopy ));
@@ -133,6 +199,46 @@ namespace flatDb {
 	}
 
 
+	template<typename tKey>
+	typename XX::SP XX::createFromJournalRecord(XX::SP const & previous, unsigned baseRevision, void const * ptr, unsigned maxLength, unsigned & recordLength)
+	{
+		// record: length(4), CRC32(4), baseRevision(4), revision(4), changesCount(4), changes
+		// change: first(4), removedCount(4), addedCount(4), added entries
+		recordLength = 0;
+		if (maxLength < 20) return nullptr;
+		uint8_t const * p = reinterpret_cast<uint8_t const *>(ptr);
+		unsigned const length = readUnsignedInteger<4,unsigned>(p);
+		if (length < 20 || length > maxLength) return nullptr;
+		unsigned const crc32 = readUnsignedInteger<4,unsigned>(p);
+		if (crc32 != CRC32(p, length-8)) return nullptr;
+		if (readUnsignedInteger<4,unsigned>(p) != baseRevision) return nullptr;  // record from older generation of the journal
+		unsigned const revision = readUnsignedInteger<4,unsigned>(p);
+		if (revision != previous->revision + 1) return nullptr;
+
+		SP obj(new IndexNodeT<tKey>( previous->scheduler, previous->keySize, previous->dataPageSize, previous->indexPageSize, revision, previous->firstCopy ));
+		obj->entries = previous->entries;
+		unsigned const changesCount = readUnsignedInteger<4,unsigned>(p);
+		for (unsigned i = 0; i < changesCount; ++i) {
+			unsigned const first = readUnsignedInteger<4,unsigned>(p);
+			unsigned const removedCount = readUnsignedInteger<4,unsigned>(p);
+			unsigned const addedCount = readUnsignedInteger<4,unsigned>(p);
+			if (first + removedCount > obj->entries.size()) throw std::runtime_error("Incorrect record in the journal of index page");
+			std::vector<typename DataNode::SP> added;
+			for (unsigned j = 0; j < addedCount; ++j) {
+				added.push_back( readEntry(previous->scheduler, previous->keySize, p) );
+				if (added.back() == nullptr) throw std::runtime_error("Incorrect record in the journal of index page");
+			}
+			auto it = obj->entries.erase( obj->entries.begin() + first, obj->entries.begin() + first + removedCount );
+			obj->entries.insert( it, added.begin(), added.end() );
+		}
+		if (p != reinterpret_cast<uint8_t const *>(ptr) + length) throw std::runtime_error("Incorrect size of the record in the journal of index page");
+		if (obj->entries.empty() || obj->entries.size() > maxNumberOfEntries(obj->keySize,obj->indexPageSize)) throw std::runtime_error("Incorrect record in the journal of index page");
+
+		recordLength = length;
+		return obj;
+	}
+
+
 	template<typename tKey>
 	typename XX::SP XX::createSecondCopy() const
 	{
@@ -143,33 +249,65 @@ namespace flatDb {
 
 
 	template<typename tKey>
-	void XX::writeToBuffer(void * ptr) const
+	void XX::writeToBuffer(void * ptr, unsigned journalFirstPageId, unsigned journalPagesCount) const
 	{
-		unsigned const maxNumberOfDataNodes = (indexPageSize - 8) / (2 * keySize + 7);
-		ASSERT(maxNumberOfDataNodes >= entries.size());
+		ASSERT(maxNumberOfEntries(keySize,indexPageSize) >= entries.size());
 
 		// write page but CRC
 		uint8_t * pBegin = reinterpret_cast<uint8_t*>(ptr);
 		uint8_t * p = pBegin + 4;
 		writeUnsignedInteger<4>(p, revision);
-		for (auto dn: entries) {
-			writeUnsignedInteger(p, dn->bin.firstKey, keySize);
-			writeUnsignedInteger(p, dn->bin.lastKey(), keySize);
-			uint64_t recordsCount_bytesCount_pageId = dn->bin.recordsCount; // 19 bits
-			recordsCount_bytesCount_pageId <<= 19;
-			recordsCount_bytesCount_pageId += dn->bin.bytesCount; // 19 bits
-			recordsCount_bytesCount_pageId <<= 18;
-			recordsCount_bytesCount_pageId += dn->pageId; // 18 bits
-			writeUnsignedInteger<7>(p, recordsCount_bytesCount_pageId);
-		}
+		for (auto dn: entries) writeEntry(p, *dn);
 		std::memset(p, 0, pBegin + indexPageSize - p);
 
+		// write location of the journal
+		if (canReferenceJournal()) {
+			p = pBegin + indexPageSize - 8;
+			writeUnsignedInteger<4>(p, journalFirstPageId);
+			writeUnsignedInteger<4>(p, journalPagesCount);
+		}
+
 		// write CRC32
 		unsigned const crc32 = CRC32( pBegin+4, indexPageSize-4 );
 		writeUnsignedInteger<4>(pBegin, crc32);
 	}
 
 
+	template<typename tKey>
+	unsigned XX::journalRecordLength() const
+	{
+		unsigned length = 20 + 12 * changes.size();
+		for (auto const & c: changes) length += c.addedCount * (2 * keySize + 7);
+		return length;
+	}
+
+
+	template<typename tKey>
+	void XX::writeJournalRecord(void * ptr, unsigned baseRevision) const
+	{
+		unsigned const length = journalRecordLength();
+		uint8_t * pBegin = reinterpret_cast<uint8_t*>(ptr);
+		uint8_t * p = pBegin;
+		writeUnsignedInteger<4>(p, length);
+		p += 4; // CRC
+		writeUnsignedInteger<4>(p, baseRevision);
+		writeUnsignedInteger<4>(p, revision);
+		writeUnsignedInteger<4>(p, changes.size());
+		// entries are replayed in the same order, so indexes of entries correspond to current state of the vector
+		for (auto const & c: changes) {
+			writeUnsignedInteger<4>(p, c.first);
+			writeUnsignedInteger<4>(p, c.removedCount);
+			writeUnsignedInteger<4>(p, c.addedCount);
+			for (unsigned i = 0; i < c.addedCount; ++i) writeEntry(p, *(entries[c.first+i]));
+		}
+		ASSERT( p == pBegin + length );
+		// write CRC32
+		unsigned const crc32 = CRC32( pBegin+8, length-8 );
+		p = pBegin + 4;
+		writeUnsignedInteger<4>(p, crc32);
+	}
+
+
 	template<typename tKey>
 	std::vector<typename XX::DataNode::SP> XX::reorganize( std::vector<std::pair<unsigned,unsigned>> dataNodesIds )
 	{
@@ -205,22 +343,12 @@ namespace flatDb {
 			nextDataNodeToCopy = last + 1;
 
 			// ----- create new nodes
-			// calculate key page bins
-			std::vector<Bin> keyBins;
-			calculateKeyBinsFromContent( allRecords, keyBins );
-			std::vector<Bin> pageBins = divideIntoPages(keyBins);
-			// build new DataNodes
-			auto iR = allRecords.begin();
-			for (Bin const & b: pageBins) {
-				auto iR2 = std::upper_bound(iR, allRecords.end(), b.lastKey(), [](tKey const& k,std::pair<tKey,uint8_t const*> const& r)->bool{return (k<r.first);} );
-				std::vector<std::pair<tKey,uint8_t const*>> records;
-				records.reserve(iR2-iR);
-				records.assign(iR,iR2);
-				newEntries.push_back( DataNode::createNew(scheduler,records) );
-				ASSERT( newEntries.back()->bin == b );
-				iR = iR2;
-			}
-			allRecords.clear();
+			EntriesChange change;
+			change.first = newEntries.size();
+			change.removedCount = last - first + 1;
+			createDataNodes( allRecords, newEntries );
+			change.addedCount = newEntries.size() - change.first;
+			changes.push_back(change);
 
 			// ----- update removed nodes
 			for ( unsigned i = first;  i <= last;  ++i ) {
@@ -236,6 +364,170 @@ namespace flatDb {
 		// ===== the case when database is empty now
 		if (newEntries.empty()) {
 			newEntries.push_back( DataNode::createEmpty(this->scheduler,0) );
+			EntriesChange change;
+			change.first = change.removedCount = 0;
+			change.addedCount = 1;
+			changes.push_back(change);
+		}
+
+		// ===== replace entries with new one & return removed nodes
+		entries.swap(newEntries);
+		return removedDataNodes;
+	}
+
+
+	template<typename tKey>
+	std::vector<typename XX::DataNode::SP> XX::bulkLoad( tNextChunkFunction nextChunk, typename Record::tUpdateByKeyFunction visitor )
+	{
+		for (auto dn: entries) {
+			if ( ! dn->isUnmodified() ) throw std::logic_error("Bulk load cannot be run concurrently with other modifications");
+		}
+
+		std::vector<typename DataNode::SP> newEntries;
+		newEntries.reserve(entries.size());
+		std::vector<typename DataNode::SP> removedDataNodes;
+
+		// ----- sorted records waiting for new data nodes, they are saved when their size exceeds the limit
+		MemoryManager memory(dataPageSize);
+		std::vector<std::pair<tKey,uint8_t const*>> output;
+		uint64_t outputSize = 0;
+		uint64_t const outputMaxSize = 64 * uint64_t(dataPageSize);
+		auto addToOutput = [&memory,&output,&outputSize](tKey key, uint8_t const * src)
+		{
+			uint8_t const * ptr = src;
+			unsigned const recordLength = readUnsignedIntVarSize<1,1,unsigned>(ptr);
+			unsigned const size = (ptr - src) + recordLength;
+			uint8_t * buf = memory.allocateBuffer(size);
+			std::memcpy(buf, src, size);
+			output.push_back( std::make_pair(key, buf) );
+			outputSize += size;
+		};
+		std::vector<unsigned> newPages;  // pages of new data nodes, they are released when the bulk load is aborted
+		auto saveOutput = [this,&memory,&output,&outputSize,&newEntries,&newPages]()
+		{
+			unsigned const first = newEntries.size();
+			createDataNodes(output, newEntries);
+			for (unsigned i = first; i < newEntries.size(); ++i) newPages.push_back(newEntries[i]->pageId);
+			memory.clear();
+			outputSize = 0;
+		};
+
+		// ----- new records
+		std::vector<std::pair<tKey,uint8_t const*>> chunk;
+		unsigned iChunk = 0;
+		bool endOfData = false;
+		auto nextRecordExists = [&]()->bool
+		{
+			while ( ! endOfData && iChunk == chunk.size() ) {
+				chunk.clear();
+				iChunk = 0;
+				endOfData = ! nextChunk(chunk);
+			}
+			return ( ! endOfData );
+		};
+
+		// ----- go through data nodes, when an exception is thrown the bulk load is aborted (the database is not modified)
+		std::vector<uint8_t> pageBuffer(dataPageSize);
+		EntriesChange change;
+		bool changeInProgress = false;
+		try {
+			for (unsigned i = 0; i < entries.size(); ++i) {
+				bool const lastEntry = (i + 1 == entries.size());
+				tKey const nextFirstKey = (lastEntry) ? 0 : entries[i+1]->bin.firstKey;
+				// ----- data node without new records is copied
+				if ( ! nextRecordExists() || ( ! lastEntry && chunk[iChunk].first >= nextFirstKey ) ) {
+					if (changeInProgress) {
+						saveOutput();
+						change.addedCount = newEntries.size() - change.first;
+						changes.push_back(change);
+						changeInProgress = false;
+					}
+					newEntries.push_back(entries[i]);
+					continue;
+				}
+				// ----- data node is replaced
+				if ( ! changeInProgress ) {
+					change.first = newEntries.size();
+					change.removedCount = 0;
+					changeInProgress = true;
+				}
+				++change.removedCount;
+				std::vector<std::pair<tKey,uint8_t const*>> current;
+				entries[i]->prepareForBulkLoad(current, pageBuffer.data());
+				entries[i]->freeMemory();
+				removedDataNodes.push_back(entries[i]);
+				auto iC = current.begin();
+				while ( nextRecordExists() && ( lastEntry || chunk[iChunk].first < nextFirstKey ) ) {
+					tKey const key = chunk[iChunk].first;
+					// ----- records with smaller keys
+					for ( ;  iC != current.end() && iC->first < key;  ++iC ) addToOutput(iC->first, iC->second);
+					// ----- records from DB and new records, new records are owned by the visitor (like in writeRecords), it moves
+					// them to dbTemp or deletes them, records in dbTemp are deleted here (also when an exception is thrown)
+					std::vector<Record*> dbTemp;
+					std::vector<Record*> userTemp;
+					auto deleteRecords = [&dbTemp]()
+					{
+						for ( ;  ! dbTemp.empty();  dbTemp.pop_back() ) delete dbTemp.back();
+					};
+					try {
+						auto const iCBegin = iC;
+						for ( ;  iC != current.end() && iC->first == key;  ++iC ) {
+							uint8_t const * ptr = iC->second;
+							unsigned const recordSize = readUnsignedIntVarSize<1,1,unsigned>(ptr);
+							uint8_t const * const prevPtr = ptr;
+							dbTemp.push_back( scheduler->callbackCreateRecord(key,ptr) );
+							if (prevPtr + recordSize != ptr) throw std::logic_error("Record length do not match number of bytes read! (bulk load)");
+						}
+						for ( ;  iChunk < chunk.size() && chunk[iChunk].first == key;  ++iChunk ) {
+							uint8_t const * ptr = chunk[iChunk].second;
+							readUnsignedIntVarSize<1,1,unsigned>(ptr);
+							userTemp.push_back( scheduler->callbackCreateRecord(key,ptr) );
+						}
+						// ----- call visitor
+						if (visitor(dbTemp, userTemp)) {
+							for (auto r: dbTemp) {
+								unsigned const recordSize = r->dataLength();
+								unsigned const recordLengthSize = lengthUnsignedIntVarSize<1,1,unsigned>(recordSize);
+								uint8_t * ptr = memory.allocateBuffer(recordLengthSize + recordSize);
+								uint8_t * const buf = ptr;
+								writeUnsignedIntVarSize<1,1,unsigned>(ptr, recordSize);
+								r->saveData(ptr);
+								ASSERT( ptr - buf == recordLengthSize + recordSize );
+								output.push_back( std::make_pair(key,buf) );
+								outputSize += recordLengthSize + recordSize;
+							}
+						} else {
+							for (auto iC2 = iCBegin;  iC2 != iC;  ++iC2) addToOutput(iC2->first, iC2->second);
+						}
+					} catch (...) {
+						deleteRecords();
+						throw;
+					}
+					deleteRecords();
+					// ----- save full pages
+					if (outputSize >= outputMaxSize) saveOutput();
+				}
+				// ----- the rest of records from DB
+				for ( ;  iC != current.end();  ++iC ) addToOutput(iC->first, iC->second);
+			}
+			if (changeInProgress) {
+				saveOutput();
+				change.addedCount = newEntries.size() - change.first;
+				changes.push_back(change);
+			}
+		} catch (...) {
+			for (auto dn: removedDataNodes) dn->cancelBulkLoad();
+			scheduler->storage->releasePages(newPages);
+			throw;
+		}
+
+		// ===== the case when database is empty now
+		if (newEntries.empty()) {
+			newEntries.push_back( DataNode::createEmpty(this->scheduler,0) );
+			EntriesChange change;
+			change.first = change.removedCount = 0;
+			change.addedCount = 1;
+			changes.push_back(change);
 		}
 
 		// ===== replace entries with new one & return removed nodes
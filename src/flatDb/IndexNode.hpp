@@ -17,6 +17,8 @@ namespace flatDb {
 		typedef IndexNodeT<tKey> IndexNode;
 		typedef SubProcedureUpdateRecordsByKeysT<tKey> SubProcedureUpdateRecordsByKeys;
 		typedef SchedulerT<tKey> Scheduler;
+		// returns the next chunk of sorted records (key, data with length), false means the end of data
+		typedef std::function<bool(std::vector<std::pair<tKey,uint8_t const*>> &)> tNextChunkFunction;
 		std::vector<typename DataNode::SP> entries;
 		Scheduler * const scheduler;
 		unsigned const keySize;
@@ -24,24 +26,53 @@ namespace flatDb {
 		unsigned const indexPageSize;
 		unsigned const revision;
 		bool     const firstCopy;
+		// changes of entries made by reorganize() since the node was created, they are saved as journal's record
+		// first = index of the first replaced entry in the new vector of entries
+		struct EntriesChange
+		{
+			unsigned first;
+			unsigned removedCount;
+			unsigned addedCount;
+		};
+		std::vector<EntriesChange> changes;
 	private:
 		// outputBins is overwritten (bins are ordered according to keys values)
 		void calculateKeyBinsFromContent(std::vector<std::pair<tKey,uint8_t const*>> const & content, std::vector<Bin> & outputBins) const;
 		// ----
 		std::vector<Bin> divideIntoPages(std::vector<Bin> const & bins) const;
+		// creates new data nodes from sorted records and appends them to the vector (records are deleted !)
+		void createDataNodes(std::vector<std::pair<tKey,uint8_t const*>> & records, std::vector<typename DataNode::SP> & newEntries) const;
+		// ---- single entry of index node (2*keySize+7 bytes)
+		void writeEntry(uint8_t *& ptr, DataNode const & dataNode) const;
+		static typename DataNode::SP readEntry(Scheduler*, unsigned keySize, uint8_t const *& ptr);
+		// ---- max number of entries in the index node, the second value leaves place for the reference to the journal
+		static unsigned maxNumberOfEntries(unsigned keySize, unsigned indexPageSize) { return (indexPageSize - 8) / (2 * keySize + 7); }
+		static unsigned maxNumberOfEntriesWithJournal(unsigned keySize, unsigned indexPageSize) { return (indexPageSize - 16) / (2 * keySize + 7) - 1; }
 		// --- constructor
 		IndexNodeT(Scheduler* s, unsigned pKeySize, unsigned pDataPageSize, unsigned pIndexPageSize, unsigned rev, bool pFirstCopy)
 		: scheduler(s), keySize(pKeySize), dataPageSize(pDataPageSize), indexPageSize(pIndexPageSize), revision(rev), firstCopy(pFirstCopy) {}
 	public:
 		// ---- constructors
 		static SP createEmpty(Scheduler*, unsigned keySize, unsigned dataPageSize, unsigned indexPageSize);
-		static SP createFromBuffer(Scheduler*, unsigned keySize, unsigned dataPageSize, unsigned indexPageSize, bool firstCopy, void const * ptr);
+		// journalFirstPageId & journalPagesCount are set to the location of the journal, they are set to 0 if there is no journal
+		static SP createFromBuffer(Scheduler*, unsigned keySize, unsigned dataPageSize, unsigned indexPageSize, bool firstCopy, void const * ptr
+									, unsigned & journalFirstPageId, unsigned & journalPagesCount);
+		// returns nullptr if there is no correct record (for given base revision) in the buffer, recordLength is set to the size of parsed record
+		static SP createFromJournalRecord(SP const & previous, unsigned baseRevision, void const * ptr, unsigned maxLength, unsigned & recordLength);
 		SP createSecondCopy() const;
-		// ---- save node to buffer
-		void writeToBuffer(void * ptr) const;
+		// ---- save node to buffer, location of the journal is saved only if canReferenceJournal() == true
+		void writeToBuffer(void * ptr, unsigned journalFirstPageId = 0, unsigned journalPagesCount = 0) const;
+		bool canReferenceJournal() const { return (entries.size() <= maxNumberOfEntriesWithJournal(keySize,indexPageSize)); }
+		// ---- save changes to the journal's record, baseRevision is the revision of the last node saved by writeToBuffer
+		unsigned journalRecordLength() const;
+		void writeJournalRecord(void * ptr, unsigned baseRevision) const;
 		// ---- returns list of removed data nodes
 		// takes vectors of pairs (index of data node, priority)
 		std::vector<typename DataNode::SP> reorganize( std::vector<std::pair<unsigned,unsigned>> dataNodesIds );
+		// ---- replaces data nodes containing keys of new records, returns list of removed data nodes
+		// records with the same key must be in the same chunk, the visitor is called once for each key (as in the update procedure)
+		// all data nodes must be unmodified
+		std::vector<typename DataNode::SP> bulkLoad( tNextChunkFunction nextChunk, typename Record::tUpdateByKeyFunction visitor );
 	};
 
 
@@ -0,0 +1,68 @@
+#ifndef FLATDB_KEYSFILTER_HPP_
+#define FLATDB_KEYSFILTER_HPP_
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+
+namespace flatDb {
+
+
+	// blocked Bloom filter with keys of a single data node
+	// all bits of a key are set in one 64-bit word, so the test costs one memory access
+	// there are no false negatives, the rate of false positives is about 1-2% for 10 bits per key
+	template<typename tKey>
+	class KeysFilterT
+	{
+	private:
+		std::vector<uint64_t> fWords;
+		unsigned fBitsInWord;  // number of bits set for each key
+		// 64-bit mixer (finalizer of SplitMix64)
+		static inline uint64_t hash(uint64_t x)
+		{
+			x ^= x >> 30;
+			x *= 0xbf58476d1ce4e5b9ull;
+			x ^= x >> 27;
+			x *= 0x94d049bb133111ebull;
+			x ^= x >> 31;
+			return x;
+		}
+		// the highest 32 bits choose the word, the lowest 30 bits choose up to 5 bits in the word
+		inline uint64_t mask(uint64_t h) const
+		{
+			uint64_t m = 0;
+			for (unsigned i = 0; i < fBitsInWord; ++i) {
+				m |= (1ull << (h % 64));
+				h >>= 6;
+			}
+			return m;
+		}
+		inline unsigned wordIndex(uint64_t h) const
+		{
+			return ( ((h >> 32) * fWords.size()) >> 32 );
+		}
+	public:
+		// bitsPerKey > 0, the number of bits set for each key is ~ bitsPerKey * ln(2), but not more than 5
+		KeysFilterT(unsigned keysCount, unsigned bitsPerKey)
+		: fWords( (static_cast<uint64_t>(keysCount) * bitsPerKey + 63) / 64 + 1, 0ull )
+		, fBitsInWord( std::max(1u, std::min(5u, (bitsPerKey * 7 + 5) / 10)) ) {}
+		inline void add(tKey key)
+		{
+			uint64_t const h = hash(key);
+			fWords[wordIndex(h)] |= mask(h);
+		}
+		// returns false if the key is not in the set for sure
+		inline bool mayContain(tKey key) const
+		{
+			uint64_t const h = hash(key);
+			uint64_t const m = mask(h);
+			return ((fWords[wordIndex(h)] & m) == m);
+		}
+		uint64_t sizeInBytes() const { return (fWords.size() * sizeof(uint64_t)); }
+	};
+
+}
+
+
+#endif /* FLATDB_KEYSFILTER_HPP_ */
@@ -0,0 +1,199 @@
+#include "Lz4.hpp"
+#include <cstring>
+#include <cstddef>
+
+namespace flatDb {
+
+	namespace {
+
+		unsigned const minMatch = 4;
+		unsigned const lastLiterals = 5;   // the last 5 bytes are always literals
+		unsigned const mfLimit = 12;       // the last match must start at least 12 bytes before the end
+		unsigned const maxOffset = 65535;
+		unsigned const hashBits = 14;
+
+		inline uint32_t read32(uint8_t const * p)
+		{
+			uint32_t v;
+			std::memcpy(&v, p, 4);
+			return v;
+		}
+
+		inline uint64_t read64(uint8_t const * p)
+		{
+			uint64_t v;
+			std::memcpy(&v, p, 8);
+			return v;
+		}
+
+		inline unsigned hash(uint32_t v)
+		{
+			return ((v * 2654435761u) >> (32 - hashBits));
+		}
+
+		// number of equal bytes from p and ref, p cannot go beyond the limit (little-endian)
+		inline unsigned commonLength(uint8_t const * p, uint8_t const * ref, uint8_t const * limit)
+		{
+			uint8_t const * const start = p;
+			while (p + 8 <= limit) {
+				uint64_t const diff = read64(p) ^ read64(ref);
+				if (diff != 0) return (p - start) + (__builtin_ctzll(diff) >> 3);
+				p += 8;
+				ref += 8;
+			}
+			while (p < limit && *p == *ref) {
+				++p;
+				++ref;
+			}
+			return (p - start);
+		}
+
+		// saves length >= 15 as sequence of bytes following the token
+		inline void writeLength(uint8_t *& op, unsigned length)
+		{
+			for (length -= 15; length >= 255; length -= 255) *(op++) = 255;
+			*(op++) = length;
+		}
+
+		// returns false if the data are truncated
+		inline bool readLength(uint8_t const *& ip, uint8_t const * iend, size_t & length)
+		{
+			unsigned b;
+			do {
+				if (ip >= iend) return false;
+				b = *(ip++);
+				length += b;
+			} while (b == 255);
+			return true;
+		}
+
+		// max size of literals and the match with their lengths (without token)
+		inline size_t sequenceSize(unsigned literalsLength, unsigned matchLength)
+		{
+			return (literalsLength + literalsLength / 255 + 1 + 2 + matchLength / 255 + 1);
+		}
+
+	}
+
+
+	unsigned compressLz4(uint8_t const * src, unsigned srcSize, uint8_t * dst, unsigned dstCapacity)
+	{
+		uint8_t const * ip = src;
+		uint8_t const * anchor = src;
+		uint8_t const * const iend = src + srcSize;
+		uint8_t * op = dst;
+		uint8_t * const oend = dst + dstCapacity;
+
+		if (srcSize > mfLimit) {
+			uint8_t const * const mflimit = iend - mfLimit;
+			uint8_t const * const matchlimit = iend - lastLiterals;
+			uint32_t table[1u << hashBits];  // positions of the last occurrences of 4-byte sequences
+			std::memset(table, 0, sizeof(table));
+			++ip;
+			while (ip < mflimit) {
+				// ----- find the match
+				uint32_t const sequence = read32(ip);
+				unsigned const h = hash(sequence);
+				uint8_t const * ref = src + table[h];
+				table[h] = ip - src;
+				if (ref >= ip || static_cast<unsigned>(ip - ref) > maxOffset || read32(ref) != sequence) {
+					// bytes without matches are skipped faster
+					ip += 1 + ((ip - anchor) >> 6);
+					continue;
+				}
+				while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+					--ip;
+					--ref;
+				}
+				unsigned const matchLength = commonLength(ip + minMatch, ref + minMatch, matchlimit);
+				unsigned const literalsLength = ip - anchor;
+				// ----- save the sequence
+				if (op + 1 + sequenceSize(literalsLength, matchLength) > oend) return 0;
+				uint8_t * const token = op++;
+				if (literalsLength >= 15) {
+					*token = (15 << 4);
+					writeLength(op, literalsLength);
+				} else {
+					*token = (literalsLength << 4);
+				}
+				std::memcpy(op, anchor, literalsLength);
+				op += literalsLength;
+				unsigned const offset = ip - ref;
+				*(op++) = (offset & 0xff);
+				*(op++) = (offset >> 8);
+				if (matchLength >= 15) {
+					*token |= 15;
+					writeLength(op, matchLength);
+				} else {
+					*token |= matchLength;
+				}
+				ip += minMatch + matchLength;
+				anchor = ip;
+				if (ip < mflimit) table[hash(read32(ip - 2))] = ip - 2 - src;
+			}
+		}
+
+		// ----- the last literals
+		unsigned const literalsLength = iend - anchor;
+		if (op + 1 + literalsLength + literalsLength / 255 + 1 > oend) return 0;
+		if (literalsLength >= 15) {
+			*(op++) = (15 << 4);
+			writeLength(op, literalsLength);
+		} else {
+			*(op++) = (literalsLength << 4);
+		}
+		std::memcpy(op, anchor, literalsLength);
+		op += literalsLength;
+		return (op - dst);
+	}
+
+
+	bool decompressLz4(uint8_t const * src, unsigned srcSize, uint8_t * dst, unsigned dstSize)
+	{
+		uint8_t const * ip = src;
+		uint8_t const * const iend = src + srcSize;
+		uint8_t * op = dst;
+		uint8_t * const oend = dst + dstSize;
+
+		while (ip < iend) {
+			unsigned const token = *(ip++);
+			// ----- literals
+			size_t literalsLength = (token >> 4);
+			if (literalsLength == 15 && ! readLength(ip, iend, literalsLength)) return false;
+			if (literalsLength > static_cast<size_t>(iend - ip) || literalsLength > static_cast<size_t>(oend - op)) return false;
+			if (literalsLength <= 16 && iend - ip >= 16 && oend - op >= 16) {
+				// short literals are copied by one fixed-size copy (bytes after them are overwritten later)
+				std::memcpy(op, ip, 16);
+			} else {
+				std::memcpy(op, ip, literalsLength);
+			}
+			op += literalsLength;
+			ip += literalsLength;
+			if (ip == iend) break;  // the last sequence has no match
+			// ----- match
+			if (iend - ip < 2) return false;
+			size_t const offset = ip[0] + (static_cast<size_t>(ip[1]) << 8);
+			ip += 2;
+			if (offset == 0 || offset > static_cast<size_t>(op - dst)) return false;
+			size_t matchLength = (token & 15);
+			if (matchLength == 15 && ! readLength(ip, iend, matchLength)) return false;
+			matchLength += minMatch;
+			if (matchLength > static_cast<size_t>(oend - op)) return false;
+			uint8_t const * ref = op - offset;
+			uint8_t * const matchEnd = op + matchLength;
+			if (offset >= 8) {
+				// chunks do not overlap, the last chunk may cross the end of the match if there is place in the buffer
+				if (oend - matchEnd >= 8) {
+					for ( ;  op < matchEnd;  op += 8, ref += 8) std::memcpy(op, ref, 8);
+					op = matchEnd;
+					continue;
+				}
+				for ( ;  op + 8 <= matchEnd;  op += 8, ref += 8) std::memcpy(op, ref, 8);
+			}
+			while (op < matchEnd) *(op++) = *(ref++);
+		}
+
+		return (op == oend);
+	}
+
+}
@@ -0,0 +1,19 @@
+#ifndef FLATDB_LZ4_HPP_
+#define FLATDB_LZ4_HPP_
+
+#include <cstdint>
+
+namespace flatDb {
+
+	// compression of pages in LZ4 block format (single block without the frame header)
+	// there is no external dependency, the greedy compressor with one hash table is fast enough for 256 KB pages
+
+	// returns the size of compressed data or 0 if it does not fit into the output buffer (dstCapacity bytes)
+	unsigned compressLz4(uint8_t const * src, unsigned srcSize, uint8_t * dst, unsigned dstCapacity);
+
+	// returns false if the input is not a correct LZ4 block or the size of decompressed data is not equal to dstSize
+	bool decompressLz4(uint8_t const * src, unsigned srcSize, uint8_t * dst, unsigned dstSize);
+
+}
+
+#endif /* FLATDB_LZ4_HPP_ */
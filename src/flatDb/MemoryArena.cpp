@@ -0,0 +1,179 @@
+#include "../apiDb/MemoryArena.hpp"
+#include <map>
+#include <set>
+#include <vector>
+#include <mutex>
+#include <new>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../commonTools/assert.hpp"
+
+
+	static uint64_t const hugePageSize = 2 * 1024 * 1024;
+	static int const mpolInterleave = 3;  // MPOL_INTERLEAVE from <numaif.h>, mbind is called directly (libnuma is not needed)
+
+
+	// returns the mask of online NUMA nodes (one bit per node), the list in the file has format like "0-3,5"
+	static uint64_t onlineNumaNodes()
+	{
+		std::ifstream file("/sys/devices/system/node/online");
+		std::string list;
+		if ( ! (file >> list) ) return 1;
+		uint64_t mask = 0;
+		for (std::string::size_type b = 0; b < list.size(); ) {
+			std::string::size_type e = list.find(',', b);
+			if (e == std::string::npos) e = list.size();
+			std::string const range = list.substr(b, e - b);
+			std::string::size_type const dash = range.find('-');
+			try {
+				unsigned const first = std::stoul(range.substr(0, dash));
+				unsigned const last = (dash == std::string::npos) ? first : std::stoul(range.substr(dash + 1));
+				for (unsigned i = first; i <= last && i < 64; ++i) mask |= (1ull << i);
+			} catch (std::exception const &) {
+				return 1;
+			}
+			b = e + 1;
+		}
+		return ((mask == 0) ? 1 : mask);
+	}
+
+
+	struct MemoryArena::Pim
+	{
+		struct Region
+		{
+			uint8_t * begin = nullptr;
+			bool hugeTlb = false;
+			std::vector<unsigned> freeSlabs;   // indexes of free slabs, the last one is taken first
+			unsigned usedSlabsCount = 0;
+		};
+		mutable std::mutex access;
+		unsigned const slabSize;
+		unsigned const slabsPerRegion;
+		uint64_t const regionSize;
+		uint64_t const numaNodes;
+		std::map<uint8_t*,Region> regions;          // by addresses
+		std::set<uint8_t*> regionsWithFreeSlabs;    // the one with the lowest address is used first
+		unsigned emptyRegionsCount = 0;             // regions without used slabs
+		uint64_t usedSlabsCount = 0;
+		uint64_t hugeTlbBytes = 0;
+		Pim(unsigned pSlabSize, unsigned regionSizeInMegabytes)
+		: slabSize(pSlabSize)
+		, slabsPerRegion( std::max<uint64_t>(1, (uint64_t(regionSizeInMegabytes) * 1024 * 1024 + pSlabSize - 1) / pSlabSize) )
+		, regionSize( (uint64_t(slabsPerRegion) * slabSize + hugePageSize - 1) / hugePageSize * hugePageSize )
+		, numaNodes(onlineNumaNodes())
+		{}
+		~Pim()
+		{
+			for (auto & kv: regions) munmap(kv.first, regionSize);
+		}
+		// maps new region and returns it, std::bad_alloc is thrown if there is no memory
+		Region & mapRegion(HugePages hugePages)
+		{
+			Region r;
+			void * ptr = MAP_FAILED;
+			if (hugePages == HugePages::hugetlb) {
+				ptr = mmap(nullptr, regionSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+				r.hugeTlb = (ptr != MAP_FAILED);
+			}
+			if (ptr == MAP_FAILED) {
+				// transparent huge pages require alignment, a larger area is mapped and its ends are unmapped
+				uint8_t * area = static_cast<uint8_t*>(mmap(nullptr, regionSize + hugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+				if (area == MAP_FAILED) throw std::bad_alloc();
+				uint64_t const shift = (hugePageSize - reinterpret_cast<uintptr_t>(area) % hugePageSize) % hugePageSize;
+				if (shift > 0) munmap(area, shift);
+				munmap(area + shift + regionSize, hugePageSize - shift);
+				ptr = area + shift;
+				// errors are ignored, regular pages are used then
+				madvise(ptr, regionSize, (hugePages == HugePages::none) ? MADV_NOHUGEPAGE : MADV_HUGEPAGE);
+			}
+			if ((numaNodes & (numaNodes - 1)) != 0) {
+				// more than one node, errors are ignored (the default policy is used then)
+				syscall(SYS_mbind, ptr, regionSize, mpolInterleave, &numaNodes, 65, 0);
+			}
+			r.begin = static_cast<uint8_t*>(ptr);
+			r.freeSlabs.reserve(slabsPerRegion);
+			for (unsigned i = slabsPerRegion; i > 0; --i) r.freeSlabs.push_back(i - 1);
+			if (r.hugeTlb) hugeTlbBytes += regionSize;
+			++emptyRegionsCount;
+			regionsWithFreeSlabs.insert(r.begin);
+			return (regions[r.begin] = std::move(r));
+		}
+		void unmapRegion(std::map<uint8_t*,Region>::iterator it)
+		{
+			if (it->second.hugeTlb) hugeTlbBytes -= regionSize;
+			munmap(it->first, regionSize);
+			regionsWithFreeSlabs.erase(it->first);
+			regions.erase(it);
+		}
+	};
+
+
+	MemoryArena::MemoryArena(unsigned pSlabSize, HugePages pHugePages, unsigned regionSizeInMegabytes)
+	: pim(nullptr), slabSize(pSlabSize), hugePages(pHugePages)
+	{
+		ASSERT(slabSize > 0);
+		pim = new Pim(slabSize, regionSizeInMegabytes);
+	}
+
+
+	MemoryArena::~MemoryArena()
+	{
+		delete pim;
+	}
+
+
+	uint8_t * MemoryArena::allocate()
+	{
+		std::lock_guard<std::mutex> synch(pim->access);
+		Pim::Region & r = (pim->regionsWithFreeSlabs.empty()) ? pim->mapRegion(hugePages) : pim->regions[*(pim->regionsWithFreeSlabs.begin())];
+		if (r.usedSlabsCount == 0) --(pim->emptyRegionsCount);
+		unsigned const slab = r.freeSlabs.back();
+		r.freeSlabs.pop_back();
+		if (r.freeSlabs.empty()) pim->regionsWithFreeSlabs.erase(r.begin);
+		++(r.usedSlabsCount);
+		++(pim->usedSlabsCount);
+		return (r.begin + uint64_t(slab) * slabSize);
+	}
+
+
+	void MemoryArena::free(uint8_t * slab)
+	{
+		std::lock_guard<std::mutex> synch(pim->access);
+		auto it = pim->regions.upper_bound(slab);
+		ASSERT(it != pim->regions.begin());
+		--it;
+		Pim::Region & r = it->second;
+		uint64_t const offset = slab - r.begin;
+		ASSERT(offset < uint64_t(pim->slabsPerRegion) * slabSize && offset % slabSize == 0);
+		if (r.freeSlabs.empty()) pim->regionsWithFreeSlabs.insert(r.begin);
+		r.freeSlabs.push_back(offset / slabSize);
+		--(r.usedSlabsCount);
+		--(pim->usedSlabsCount);
+		if (r.usedSlabsCount == 0) {
+			// one empty region is kept, so the cache oscillating around the border of the region does not map/unmap it all the time
+			if (pim->emptyRegionsCount > 0) {
+				pim->unmapRegion(it);
+			} else {
+				++(pim->emptyRegionsCount);
+			}
+		}
+	}
+
+
+	MemoryArena::Statistics MemoryArena::statistics() const
+	{
+		std::lock_guard<std::mutex> synch(pim->access);
+		Statistics s;
+		s.mappedBytes = pim->regions.size() * pim->regionSize;
+		s.usedBytes = pim->usedSlabsCount * slabSize;
+		s.hugeTlbBytes = pim->hugeTlbBytes;
+		s.regionsCount = pim->regions.size();
+		s.numaNodesCount = __builtin_popcountll(pim->numaNodes);
+		return s;
+	}
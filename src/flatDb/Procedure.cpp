@@ -37,6 +37,54 @@ namespace flatDb {
 
 	// ===== ProcedureReadRecordsFromRange
 
+	template<typename tKey>
+	void ProcedureReadRecordsFromRangeT<tKey>::callCallback(tDataIterator it1, tDataIterator it2, bool & lastCall)
+	{
+		// ----- raw data only
+		if (fRawCallback) {
+			std::vector<RecordViewT<tKey>> output;
+			output.reserve( it2 - it1 );
+			for ( ;  it1 != it2;  ++it1 ) {
+				uint8_t const * ptr = it1->second;
+				RecordViewT<tKey> view;
+				view.key = it1->first;
+				view.length = readUnsignedIntVarSize<1,1,unsigned>(ptr);
+				view.data = ptr;
+				output.push_back(view);
+			}
+			fRawCallback(output, lastCall);
+			return;
+		}
+		// ----- create records
+		std::vector<Record const *> output;
+		output.reserve( it2 - it1 );
+		try {
+			for ( ;  it1 != it2;  ++it1 ) {
+				uint8_t const * ptr = it1->second;
+				// read the record data size
+				unsigned const recordSize = readUnsignedIntVarSize<1,1,unsigned>(ptr);
+				// read the record
+				uint8_t const * const prevPtr = ptr;
+				Record * r = this->scheduler->callbackCreateRecord(it1->first,ptr);
+				output.push_back(r);
+				if (prevPtr + recordSize != ptr) {
+					throw std::logic_error( std::string("Record length do not match number of bytes read! (1) ")
+							+ " Expected: " + boost::lexical_cast<std::string>(recordSize)
+							+ " Key: " + boost::lexical_cast<std::string>(it1->first)
+							+ " position: " + boost::lexical_cast<std::string>(ptr-it1->second)
+							);
+				}
+			}
+			fCallback(output, lastCall);
+		} catch (...) {
+			for ( ;  ! output.empty();  output.pop_back() ) delete output.back();
+			throw;
+		}
+		// free memory
+		for ( ;  ! output.empty();  output.pop_back() ) delete output.back();
+	}
+
+
 	template<typename tKey>
 	void ProcedureReadRecordsFromRangeT<tKey>::process(std::vector<std::pair<tKey,uint8_t const *>> const & data)
 	{
@@ -49,29 +97,10 @@ namespace flatDb {
 		auto it2 = std::lower_bound( it1, data.end(), fLastKey, compDataElementToKey );
 		while ( it2 != data.end() && it2->first == fLastKey ) ++it2;
 
-		std::vector<Record const *> output;
-		output.reserve( it2 - it1 );
-		for ( ;  it1 != it2;  ++it1 ) {
-			uint8_t const * ptr = it1->second;
-			// read the record data size
-			unsigned const recordSize = readUnsignedIntVarSize<1,1,unsigned>(ptr);
-			// read the record
-			uint8_t const * const prevPtr = ptr;
-			Record * r = this->scheduler->callbackCreateRecord(it1->first,ptr);
-			output.push_back(r);
-			if (prevPtr + recordSize != ptr) {
-				throw std::logic_error( std::string("Record length do not match number of bytes read! (1) ")
-						+ " Expected: " + boost::lexical_cast<std::string>(recordSize)
-						+ " Key: " + boost::lexical_cast<std::string>(it1->first)
-						+ " position: " + boost::lexical_cast<std::string>(ptr-it1->second)
-						);
-			}
-		}
-
 		tKey const lastProcessedKey = data.rbegin()->first;
 		bool lastCall = ( lastProcessedKey >= fLastKey );
 		try {
-			fCallback(output, lastCall);
+			callCallback(it1, it2, lastCall);
 		} catch (std::exception const & e) {
 			// TODO - report bug
 			std::cerr << "Error durign read by region: " << e.what() << std::endl;
@@ -82,9 +111,6 @@ namespace flatDb {
 		} else {
 			fFirstKey = lastProcessedKey + 1;  // lastProcessedKey < fLastKey
 		}
-
-		// free memory
-		for ( ;  ! output.empty();  output.pop_back() ) delete output.back();
 	}
 
 
@@ -116,7 +142,7 @@ namespace flatDb {
 			if (it->lastKey() >= fFirstKey && it->recordsCount > 0) {  // recordsCount == 0: special case for empty database
 				std::map<unsigned,typename SubProcedureT<tKey>::SP> m;
 				unsigned const index = it - entries.begin();
-				m[index].reset( new SubProcedureReadRecordsFromRange(this) );
+				m[index].reset( new SubProcedureReadRecordsFromRange(this, accessType) );
 				this->fCounter = m.size();
 				return m;
 			}
@@ -129,15 +155,15 @@ namespace flatDb {
 			}
 			std::map<unsigned,typename SubProcedureT<tKey>::SP> m;
 			unsigned const index = it - entries.begin();
-			m[index].reset( new SubProcedureReadRecordsFromRange(this) );
+			m[index].reset( new SubProcedureReadRecordsFromRange(this, accessType) );
 			this->fCounter = m.size();
 			return m;
 		}
 		// ----- no bins overlap with given range
-		std::vector<Record const *> tEmpty;
+		std::vector<std::pair<tKey,uint8_t const *>> const tEmpty;
 		bool lastCall = true;
 		try {
-			fCallback( tEmpty, lastCall );
+			callCallback( tEmpty.begin(), tEmpty.end(), lastCall );
 		} catch (std::exception const & e) {
 			// TODO - report bug
 			std::cerr << "Error durign read by region (empty): " << e.what() << std::endl;
@@ -151,79 +177,87 @@ namespace flatDb {
 
 
 
-	template<typename tKey>
-	std::map<unsigned,typename SubProcedureT<tKey>::SP> ProcedureReadRecordsByKeysT<tKey>::createSubProcedures(std::vector<BinT<tKey>> const & entries)
+	// divides sorted elements between bins, calls callback(index of bin, begin, end) for each non-empty range
+	template<typename tKey, typename tIterator, typename tGetKey, typename tCallback>
+	static void splitBetweenBins(std::vector<BinT<tKey>> const & entries, tIterator begin, tIterator end, tGetKey getKey, tCallback callback)
 	{
-		ASSERT(! entries.empty());
-		if (fRecords.empty()) {
-			this->announceAsCompleted();
-			std::map<unsigned,typename SubProcedureT<tKey>::SP> m;
-			return m;
-		}
-
-		std::sort(fRecords.begin(), fRecords.end(), [](Record* r1, Record* r2)->bool{ return (r1->key < r2->key);} );
-		std::map<unsigned,typename SubProcedureT<tKey>::SP> m;
 		auto iE = entries.begin();
-		for ( auto iR = fRecords.begin();  iR != fRecords.end(); ) {
-			iE = std::upper_bound( iE, entries.end(), (*iR)->key, [](tKey const & k, Bin const & b)->bool{ return (k < b.firstKey); } );
+		for ( auto iR = begin;  iR != end; ) {
+			iE = std::upper_bound( iE, entries.end(), getKey(*iR), [](tKey const & k, BinT<tKey> const & b)->bool{ return (k < b.firstKey); } );
 			if (iE != entries.begin()) --iE;
 			// iE - bin for subprocedure
 			unsigned const index = iE - entries.begin();
 			auto iR2 = iR;
 			if (++iE == entries.end()) {
-				iR2 = fRecords.end();
+				iR2 = end;
 			} else {
 				tKey const nextFirstKey = iE->firstKey;
-				while ( iR2 != fRecords.end() && (*iR2)->key < nextFirstKey ) ++iR2;
+				while ( iR2 != end && getKey(*iR2) < nextFirstKey ) ++iR2;
 			}
-			// copy records
-			std::vector<Record*> records;
-			records.reserve(iR2 - iR);
-			records.assign(iR,iR2);
-			m[index].reset( new SubProcedureReadRecordsByKeys(this,fCallback,records) );
+			callback(index, iR, iR2);
 			// move to the next range of keys
 			iR = iR2;
 		}
+	}
 
-		this->fCounter = m.size();
+
+	// sorts records or keys given by user and creates subprocedures for bins (keys in raw mode are also made unique)
+	template<typename tSubProcedure, typename tKey, typename tCallback, typename tRawCallback>
+	static std::map<unsigned,typename SubProcedureT<tKey>::SP> createSubProceduresByKeys
+		( ProcedureT<tKey> * owner, std::vector<BinT<tKey>> const & entries, std::vector<RecordT<tKey>*> & records
+		, std::vector<tKey> & keys, tCallback const & callback, tRawCallback const & rawCallback )
+	{
+		std::map<unsigned,typename SubProcedureT<tKey>::SP> m;
+		if (rawCallback) {
+			std::sort(keys.begin(), keys.end());
+			keys.erase( std::unique(keys.begin(), keys.end()), keys.end() );
+			auto getKey = [](tKey const & k)->tKey{ return k; };
+			splitBetweenBins(entries, keys.begin(), keys.end(), getKey, [&](unsigned index, typename std::vector<tKey>::iterator i1, typename std::vector<tKey>::iterator i2)
+			{
+				std::vector<tKey> subKeys(i1, i2);
+				m[index].reset( new tSubProcedure(owner,rawCallback,subKeys) );
+			});
+		} else {
+			typedef RecordT<tKey> Record;
+			std::sort(records.begin(), records.end(), [](Record* r1, Record* r2)->bool{ return (r1->key < r2->key);} );
+			auto getKey = [](Record * r)->tKey{ return r->key; };
+			splitBetweenBins(entries, records.begin(), records.end(), getKey, [&](unsigned index, typename std::vector<Record*>::iterator i1, typename std::vector<Record*>::iterator i2)
+			{
+				std::vector<Record*> subRecords(i1, i2);
+				m[index].reset( new tSubProcedure(owner,callback,subRecords) );
+			});
+		}
 		return m;
 	}
 
 
 	template<typename tKey>
-	std::map<unsigned,typename SubProcedureT<tKey>::SP> ProcedureUpdateRecordsByKeysT<tKey>::createSubProcedures(std::vector<BinT<tKey>> const & entries)
+	std::map<unsigned,typename SubProcedureT<tKey>::SP> ProcedureReadRecordsByKeysT<tKey>::createSubProcedures(std::vector<BinT<tKey>> const & entries)
 	{
 		ASSERT(! entries.empty());
-		if (fRecords.empty()) {
+		if (fRecords.empty() && fKeys.empty()) {
 			this->announceAsCompleted();
 			std::map<unsigned,typename SubProcedureT<tKey>::SP> m;
 			return m;
 		}
+		std::map<unsigned,typename SubProcedureT<tKey>::SP> m
+			= createSubProceduresByKeys<SubProcedureReadRecordsByKeys>(this, entries, fRecords, fKeys, fCallback, fRawCallback);
+		this->fCounter = m.size();
+		return m;
+	}
 
-		std::sort(fRecords.begin(), fRecords.end(), [](Record* r1, Record* r2)->bool{ return (r1->key < r2->key);} );
-		std::map<unsigned,typename SubProcedureT<tKey>::SP> m;
-		auto iE = entries.begin();
-		for ( auto iR = fRecords.begin();  iR != fRecords.end(); ) {
-			iE = std::upper_bound( iE, entries.end(), (*iR)->key, [](tKey const & k, Bin const & b)->bool{ return (k < b.firstKey); } );
-			if (iE != entries.begin()) --iE;
-			// iE - bin for subprocedure
-			unsigned const index = iE - entries.begin();
-			auto iR2 = iR;
-			if (++iE == entries.end()) {
-				iR2 = fRecords.end();
-			} else {
-				tKey const nextFirstKey = iE->firstKey;
-				while ( iR2 != fRecords.end() && (*iR2)->key < nextFirstKey ) ++iR2;
-			}
-			// copy records
-			std::vector<Record*> records;
-			records.reserve(iR2 - iR);
-			records.assign(iR,iR2);
-			m[index].reset( new SubProcedureUpdateRecordsByKeys(this,fCallback,records) );
-			// move to the next range of keys
-			iR = iR2;
-		}
 
+	template<typename tKey>
+	std::map<unsigned,typename SubProcedureT<tKey>::SP> ProcedureUpdateRecordsByKeysT<tKey>::createSubProcedures(std::vector<BinT<tKey>> const & entries)
+	{
+		ASSERT(! entries.empty());
+		if (fRecords.empty() && fKeys.empty()) {
+			this->announceAsCompleted();
+			std::map<unsigned,typename SubProcedureT<tKey>::SP> m;
+			return m;
+		}
+		std::map<unsigned,typename SubProcedureT<tKey>::SP> m
+			= createSubProceduresByKeys<SubProcedureUpdateRecordsByKeys>(this, entries, fRecords, fKeys, fCallback, fRawCallback);
 		this->fCounter = m.size();
 		return m;
 	}
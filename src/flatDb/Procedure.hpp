@@ -7,12 +7,16 @@
 #include <mutex>
 #include <atomic>
 #include <condition_variable>
+#include <memory>
 
 namespace flatDb {
 
 	template <typename tKey>
 	class SchedulerT;
 
+	template <typename tKey>
+	class IndexNodeT;
+
 
 	template <typename tKey>
 	class ProcedureT
@@ -22,6 +26,9 @@ namespace flatDb {
 		typedef SubProcedureT<tKey> SubProcedure;
 		unsigned const priority;
 		SchedulerT<tKey> * const scheduler;
+		// revision of the index node read by read-only procedure, it is set by the scheduler when the procedure is scheduled
+		// for the first time (or in advance to read a snapshot), next parts of range scans read the same revision
+		std::shared_ptr<IndexNodeT<tKey>> indexNode;
 	protected:
 		// ----- tools to set procedure as completed
 		std::mutex fAccessToCompleted;
@@ -55,12 +62,26 @@ namespace flatDb {
 		typedef KeysRangeT<tKey> KeysRange;
 		typedef SubProcedureT<tKey> SubProcedure;
 		typedef SubProcedureReadRecordsFromRangeT<tKey> SubProcedureReadRecordsFromRange;
+		// state of read-ahead of next data nodes (indexes of entries of the index node), it is managed by the scheduler
+		struct ReadAhead
+		{
+			unsigned next = 0;    // index of the data node expected by sequential access
+			unsigned end = 0;     // data nodes with smaller indexes were already read ahead
+			unsigned window = 0;  // number of data nodes read in advance, 0 - the procedure was not scheduled yet
+		} readAhead;
+		// scanLowPriority - pages loaded by the scan are evicted from the cache first (long scans do not pollute the cache)
+		StorageWithCache::AccessType accessType = StorageWithCache::AccessType::scan;
 	private:
 		tKey fFirstKey;
 		tKey const fLastKey;
 		bool fEndOfQuery = false;
+		// only one of callbacks is set
 		typename Record::tReadFromRangeFunction fCallback;
+		typename Record::tReadRawFromRangeFunction fRawCallback;
 		void allSubProceduresWereDeleted() override final;
+		// calls the callback set by user, records are created if needed
+		typedef typename std::vector<std::pair<tKey,uint8_t const *>>::const_iterator tDataIterator;
+		void callCallback(tDataIterator begin, tDataIterator end, bool & lastCall);
 		// access for subprocedures
 		friend SubProcedureReadRecordsFromRange;
 		void process(std::vector<std::pair<tKey,uint8_t const *>> const & data);
@@ -68,7 +89,11 @@ namespace flatDb {
 		ProcedureReadRecordsFromRangeT
 		(SchedulerT<tKey>* scheduler, unsigned priority, typename Record::tReadFromRangeFunction callback, tKey const & first, tKey const & last)
 		: ProcedureT<tKey>(scheduler, priority), fFirstKey(first), fLastKey(last), fCallback(callback) {}
+		ProcedureReadRecordsFromRangeT
+		(SchedulerT<tKey>* scheduler, unsigned priority, typename Record::tReadRawFromRangeFunction callback, tKey const & first, tKey const & last)
+		: ProcedureT<tKey>(scheduler, priority), fFirstKey(first), fLastKey(last), fRawCallback(callback) {}
 		std::map<unsigned,typename SubProcedure::SP> createSubProcedures(std::vector<Bin> const & entries) override final;
+		tKey lastKey() const { return fLastKey; }
 	};
 
 
@@ -81,13 +106,19 @@ namespace flatDb {
 		typedef SubProcedureT<tKey> SubProcedure;
 		typedef SubProcedureReadRecordsByKeysT<tKey> SubProcedureReadRecordsByKeys;
 	private:
+		// only one of callbacks is set (with records or keys)
 		std::vector<Record*> fRecords;
+		std::vector<tKey> fKeys;
 		typename Record::tReadByKeyFunction fCallback;
+		typename Record::tReadRawByKeyFunction fRawCallback;
 		void allSubProceduresWereDeleted() override final { this->announceAsCompleted(); }
 	public:
 		ProcedureReadRecordsByKeysT
 		(SchedulerT<tKey>* scheduler, unsigned priority, typename Record::tReadByKeyFunction callback, std::vector<Record*> const & records)
 		: ProcedureT<tKey>(scheduler, priority), fRecords(records), fCallback(callback) {}
+		ProcedureReadRecordsByKeysT
+		(SchedulerT<tKey>* scheduler, unsigned priority, typename Record::tReadRawByKeyFunction callback, std::vector<tKey> const & keys)
+		: ProcedureT<tKey>(scheduler, priority), fKeys(keys), fRawCallback(callback) {}
 		std::map<unsigned,typename SubProcedure::SP> createSubProcedures(std::vector<Bin> const & entries) override final;
 	};
 
@@ -101,13 +132,19 @@ namespace flatDb {
 		typedef SubProcedureT<tKey> SubProcedure;
 		typedef SubProcedureUpdateRecordsByKeysT<tKey> SubProcedureUpdateRecordsByKeys;
 	private:
+		// only one of callbacks is set (with records or keys)
 		std::vector<Record*> fRecords;
+		std::vector<tKey> fKeys;
 		typename Record::tUpdateByKeyFunction fCallback;
+		typename Record::tUpdateRawByKeyFunction fRawCallback;
 		void allSubProceduresWereDeleted() override final { this->announceAsCompleted(); }
 	public:
 		ProcedureUpdateRecordsByKeysT
 		(SchedulerT<tKey>* scheduler, unsigned priority, typename Record::tUpdateByKeyFunction callback, std::vector<Record*> const & records)
 		: ProcedureT<tKey>(scheduler, priority), fRecords(records), fCallback(callback) {}
+		ProcedureUpdateRecordsByKeysT
+		(SchedulerT<tKey>* scheduler, unsigned priority, typename Record::tUpdateRawByKeyFunction callback, std::vector<tKey> const & keys)
+		: ProcedureT<tKey>(scheduler, priority), fKeys(keys), fRawCallback(callback) {}
 		std::map<unsigned,typename SubProcedure::SP> createSubProcedures(std::vector<Bin> const & entries) override final;
 	};
 
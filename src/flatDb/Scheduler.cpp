@@ -2,7 +2,15 @@
 #include "IndexNode.hpp"
 #include "../commonTools/assert.hpp"
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <atomic>
 #include <set>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
 
 
 #define XX SchedulerT<tKey>
@@ -10,6 +18,14 @@
 
 namespace flatDb {
 
+	// read-ahead of range scans: the number of data pages read in advance starts from initialReadAheadPages and it is doubled
+	// each time the scan has to wait for a page read ahead, it is limited by maxReadAheadPages and 1/8 of the cache
+	unsigned const initialReadAheadPages = 2;
+	unsigned const maxReadAheadPages = 32;
+
+	// compaction in background: the interval between checks of the order of data pages when all of them are on their places
+	unsigned const compactionCheckIntervalInSeconds = 60;
+
 
 	template<typename tKey>
 	struct XX::Pim
@@ -20,6 +36,7 @@ namespace flatDb {
 		std::mutex accessCurrentDb;
 		std::map<tKey,unsigned> reorganizeFirstKeys;  // firstKey -> priority
 		std::mutex              reorganizeAccess;
+		std::condition_variable reorganizeDone;  // notified at the end of each reorganize&synchronize task
 		unsigned                reorganizePriority = 0;
 		enum class SynchState
 		{
@@ -28,44 +45,138 @@ namespace flatDb {
 			, duringSynchTaskExecution
 		} synchState = SynchState::noSynchTask;
 		uint8_t * bufferForIndexNode = nullptr;
-		Pim(unsigned indexNodeSize) : bufferForIndexNode(new uint8_t[indexNodeSize]) {}
-		~Pim() { delete [] bufferForIndexNode; }
+		// ----- journal with changes of the index node committed after the last checkpoint
+		// the checkpoint is the whole index node saved in one of two copies at the beginning of the file
+		unsigned journalFirstPageId = 0;
+		unsigned journalPagesCount = 0;      // 0 - there is no journal
+		unsigned journalSize = 0;            // size of records saved after the last checkpoint (in bytes)
+		unsigned checkpointRevision = 0;     // revision of the index node saved in the last checkpoint
+		bool     checkpointInFirstCopy = false;
+		uint8_t * bufferForJournal = nullptr;
+		// ----- write-ahead log (optional)
+		WriteAheadLog * wal = nullptr;
+		std::mutex pagesToReleaseAccess;
+		std::vector<unsigned> pagesToRelease;  // pages of obsolete data nodes waiting for the next commit of the log
+		uint8_t * bufferForPage = nullptr;
+		// ----- modifications of entries of the current index node and their commits (reorganization, bulk load, compaction)
+		std::mutex synchronization;
+		// ----- compaction in background (optional)
+		std::thread compactionThread;
+		std::mutex compactionAccess;
+		std::condition_variable compactionStopped;
+		bool stopCompaction = false;
+		// ----- statistics
+		std::atomic<uint64_t> readsWithoutPageCount;
+		std::atomic<uint64_t> readAheadPagesCount;
+		std::atomic<uint64_t> compactionMovedPages;
+		std::atomic<uint64_t> compactionReclaimedBytes;
+		std::atomic<uint64_t> compactionPagesLeft;
+		Pim(unsigned indexNodeSize) : bufferForIndexNode(new uint8_t[indexNodeSize]), bufferForJournal(new uint8_t[indexNodeSize]), readsWithoutPageCount(0)
+		, readAheadPagesCount(0), compactionMovedPages(0), compactionReclaimedBytes(0), compactionPagesLeft(0) {}
+		~Pim() { delete [] bufferForIndexNode; delete [] bufferForJournal; delete [] bufferForPage; }
 	};
 
 
 	template<typename tKey>
-	XX::SchedulerT(unsigned keySize, unsigned pPagesPerIndexNode, TasksManager* cpuTM, TasksManager* ioTM, StorageWithCache* pStorage, typename Record::tCreateRecordFunction callback)
+	XX::SchedulerT(unsigned keySize, unsigned pPagesPerIndexNode, TasksManager* cpuTM, TasksManager* ioTM, StorageWithCache* pStorage, typename Record::tCreateRecordFunction callback
+				, WriteAheadLog * wal, std::string const & name, unsigned pKeysFilterBitsPerKey)
 	: pagesPerIndexNode(pPagesPerIndexNode), cpuTasksManager(cpuTM), ioTasksManager(ioTM), storage(pStorage), callbackCreateRecord(callback)
+	, keysFilterBitsPerKey(pKeysFilterBitsPerKey)
 	{
 		pim = new Pim( pagesPerIndexNode * storage->pageSize );
+		if (storage->readOnly) {
+			// the file is not modified, so there is nothing to replay and nothing can be created
+			if (wal != nullptr) throw std::logic_error("The write-ahead log cannot be used with the database opened in read-only mode");
+			if (storage->numberOfPages() == 0) throw std::runtime_error("The database " + name + " does not exist, it cannot be opened in read-only mode");
+		}
+		if (wal != nullptr) {
+			pim->wal = wal;
+			pim->bufferForPage = new uint8_t[storage->pageSize];
+		}
+		unsigned const journalCapacity = pagesPerIndexNode * storage->pageSize;
+		std::memset(pim->bufferForJournal, 0, journalCapacity);
 		typename IndexNode::SP indexNode;
 		unsigned const numberOfPages = storage->numberOfPages();
 		if ( numberOfPages  >= 2*pagesPerIndexNode ) {
 			// ----- load index
 			typename IndexNode::SP indexNode2;
+			unsigned journalFirstPageId = 0, journalPagesCount = 0;
+			unsigned journalFirstPageId2 = 0, journalPagesCount2 = 0;
 			storage->readPages(0, pagesPerIndexNode, pim->bufferForIndexNode);
 			try {
-				indexNode = IndexNode::createFromBuffer(this, keySize, storage->pageSize, pagesPerIndexNode*storage->pageSize, true, pim->bufferForIndexNode);
+				indexNode = IndexNode::createFromBuffer(this, keySize, storage->pageSize, pagesPerIndexNode*storage->pageSize, true, pim->bufferForIndexNode
+														, journalFirstPageId, journalPagesCount);
 			} catch (...) {}
 			storage->readPages(pagesPerIndexNode, pagesPerIndexNode, pim->bufferForIndexNode);
 			try {
-				indexNode2 = IndexNode::createFromBuffer(this, keySize, storage->pageSize, pagesPerIndexNode*storage->pageSize, false, pim->bufferForIndexNode);
+				indexNode2 = IndexNode::createFromBuffer(this, keySize, storage->pageSize, pagesPerIndexNode*storage->pageSize, false, pim->bufferForIndexNode
+														, journalFirstPageId2, journalPagesCount2);
 			} catch (...) {}
-			if (! indexNode) indexNode.swap(indexNode2);
+			if (! indexNode) {
+				indexNode.swap(indexNode2);
+				std::swap(journalFirstPageId, journalFirstPageId2);
+				std::swap(journalPagesCount, journalPagesCount2);
+			}
 			if (! indexNode) throw std::runtime_error("Cannot find correct index page!!!");
 			if ( indexNode2 && ( indexNode->revision < indexNode2->revision
 						|| indexNode->revision - indexNode2->revision > std::numeric_limits<unsigned>::max()/2 ) )
 			{
 				indexNode.swap(indexNode2);
+				std::swap(journalFirstPageId, journalFirstPageId2);
+				std::swap(journalPagesCount, journalPagesCount2);
+			}
+			pim->checkpointInFirstCopy = indexNode->firstCopy;
+			pim->checkpointRevision = indexNode->revision;
+			// ----- replay the journal
+			if (journalPagesCount > 0) {
+				if ( journalPagesCount != pagesPerIndexNode || journalFirstPageId < 2*pagesPerIndexNode || journalFirstPageId + journalPagesCount > numberOfPages ) {
+					throw std::runtime_error("Incorrect location of the journal of index page");
+				}
+				pim->journalFirstPageId = journalFirstPageId;
+				pim->journalPagesCount = journalPagesCount;
+				storage->readPages(journalFirstPageId, journalPagesCount, pim->bufferForJournal);
+				while (true) {
+					unsigned recordLength = 0;
+					typename IndexNode::SP next = IndexNode::createFromJournalRecord( indexNode, pim->checkpointRevision
+														, pim->bufferForJournal + pim->journalSize, journalCapacity - pim->journalSize, recordLength );
+					if (! next) break;
+					indexNode = next;
+					pim->journalSize += recordLength;
+				}
+				std::memset(pim->bufferForJournal + pim->journalSize, 0, journalCapacity - pim->journalSize);
+			}
+			// ----- replay the write-ahead log, records saved in the database file are skipped
+			if (pim->wal != nullptr) {
+				auto replay = [this,&indexNode](WriteAheadLog::RecordType type, unsigned revision, unsigned pageId, uint8_t const * data, unsigned length)
+				{
+					if (revision <= indexNode->revision) return;
+					if (type == WriteAheadLog::RecordType::page) {
+						if (length > storage->pageSize) throw std::runtime_error("Incorrect page in the write-ahead log");
+						if (pageId >= storage->numberOfPages()) storage->allocatePages(pageId + 1 - storage->numberOfPages());
+						std::memcpy(pim->bufferForPage, data, length);
+						std::memset(pim->bufferForPage + length, 0, storage->pageSize - length);
+						storage->writePageContent(pageId, pim->bufferForPage);
+					} else {
+						unsigned recordLength = 0;
+						typename IndexNode::SP next = IndexNode::createFromJournalRecord(indexNode, 0, data, length, recordLength);
+						if (next == nullptr || recordLength != length) throw std::runtime_error("Incorrect record of index page in the write-ahead log");
+						indexNode = next;
+					}
+				};
+				pim->wal->attachDatabase(name, this, replay);
 			}
 			// ----- find unused data pages
-			std::vector<bool> usedDataPages(numberOfPages,false);
+			unsigned const numberOfPagesAfterReplay = storage->numberOfPages();
+			std::vector<bool> usedDataPages(numberOfPagesAfterReplay,false);
 			for ( typename DataNode::SP dn: indexNode->entries ) {
 				usedDataPages[dn->pageId] = true;
 			}
+			for (unsigned i = 0; i < pim->journalPagesCount; ++i) {
+				usedDataPages[pim->journalFirstPageId+i] = true;
+			}
 			std::map<unsigned, unsigned> freePages;  // id -> size
 			bool freePage = false;
-			for (unsigned i = 2*pagesPerIndexNode; i < numberOfPages; ++i) {
+			for (unsigned i = 2*pagesPerIndexNode; i < numberOfPagesAfterReplay; ++i) {
 				if (usedDataPages[i]) {
 					freePage = false;
 				} else {
@@ -77,16 +188,22 @@ namespace flatDb {
 					}
 				}
 			}
-			storage->setFreePages(numberOfPages, freePages);
+			storage->setFreePages(numberOfPagesAfterReplay, freePages);
 		} else if ( numberOfPages == 0 ) {
 			std::vector<unsigned> pages = storage->allocatePages(2*pagesPerIndexNode);
 			ASSERT( pages.at(0) == 0 );
 			ASSERT( pages.at(pagesPerIndexNode) == pagesPerIndexNode );
 			indexNode = IndexNode::createEmpty(this, keySize, storage->pageSize, pagesPerIndexNode*storage->pageSize);
 			indexNode->entries.push_back( DataNode::createEmpty(this,0) );
-			indexNode->writeToBuffer( pim->bufferForIndexNode );
-			storage->writePages( (indexNode->firstCopy ? 0 : pagesPerIndexNode), pagesPerIndexNode, pim->bufferForIndexNode );  // TODO - combine with flush ?
-			storage->flush();
+			pim->checkpointInFirstCopy = ! indexNode->firstCopy;  // the first checkpoint is saved in the first copy
+			commitIndexNode(indexNode, true);
+			if (pim->wal != nullptr) {
+				auto replay = [&name](WriteAheadLog::RecordType, unsigned, unsigned, uint8_t const *, unsigned)
+				{
+					throw std::runtime_error("The write-ahead log contains records of the database " + name + ", but its file does not exist");
+				};
+				pim->wal->attachDatabase(name, this, replay);
+			}
 		} else {
 			throw std::runtime_error("Incorrect file size");
 		}
@@ -95,6 +212,86 @@ namespace flatDb {
 	}
 
 
+	template<typename tKey>
+	XX::~SchedulerT()
+	{
+		if (pim->compactionThread.joinable()) {
+			{
+				std::lock_guard<std::mutex> lock(pim->compactionAccess);
+				pim->stopCompaction = true;
+			}
+			pim->compactionStopped.notify_all();
+			pim->compactionThread.join();
+		}
+		// pim is not deleted, data nodes kept by snapshots may still use it in their destructors
+	}
+
+
+	template<typename tKey>
+	void XX::commitIndexNode(std::shared_ptr<IndexNode> indexNode, bool forceCheckpoint)
+	{
+		unsigned const journalCapacity = pim->journalPagesCount * storage->pageSize;
+		unsigned const recordLength = indexNode->journalRecordLength();
+
+		// ===== save changes in the write-ahead log
+		if (pim->wal != nullptr && ! forceCheckpoint) {
+			appendToWriteAheadLog(indexNode);
+			return;
+		}
+
+		// ===== save changes as a new record in the journal, if possible
+		if ( pim->wal == nullptr && ! forceCheckpoint && pim->journalPagesCount > 0
+				&& indexNode->canReferenceJournal() && pim->journalSize + recordLength <= journalCapacity ) {
+			indexNode->writeJournalRecord( pim->bufferForJournal + pim->journalSize, pim->checkpointRevision );
+			unsigned const firstPage = pim->journalSize / storage->pageSize;
+			unsigned const lastPage = (pim->journalSize + recordLength - 1) / storage->pageSize;
+			storage->writePages( pim->journalFirstPageId + firstPage, lastPage - firstPage + 1, pim->bufferForJournal + firstPage * storage->pageSize );
+			storage->flush();
+			pim->journalSize += recordLength;
+			return;
+		}
+
+		// ===== save checkpoint - the whole index node
+		std::vector<unsigned> obsoleteJournalPages;
+		if ( pim->wal != nullptr || ! indexNode->canReferenceJournal() ) {
+			// the write-ahead log is used or there are too many data nodes, the journal is not needed
+			for (unsigned i = 0; i < pim->journalPagesCount; ++i) obsoleteJournalPages.push_back(pim->journalFirstPageId + i);
+			pim->journalFirstPageId = pim->journalPagesCount = 0;
+		} else if (pim->journalPagesCount == 0) {
+			pim->journalPagesCount = pagesPerIndexNode;
+			pim->journalFirstPageId = storage->allocatePages(pim->journalPagesCount).front();
+		}
+		bool const firstCopy = ! pim->checkpointInFirstCopy;
+		indexNode->writeToBuffer( pim->bufferForIndexNode, pim->journalFirstPageId, pim->journalPagesCount );
+		storage->writePages( (firstCopy ? 0 : pagesPerIndexNode), pagesPerIndexNode, pim->bufferForIndexNode );
+		storage->flush();
+		pim->checkpointInFirstCopy = firstCopy;
+		pim->checkpointRevision = indexNode->revision;
+		pim->journalSize = 0;
+		std::memset(pim->bufferForJournal, 0, pagesPerIndexNode * storage->pageSize);
+		storage->releasePages(obsoleteJournalPages);
+	}
+
+
+	template<typename tKey>
+	void XX::appendToWriteAheadLog(std::shared_ptr<IndexNode> indexNode)
+	{
+		// ===== content of new data nodes
+		for (auto const & c: indexNode->changes) {
+			for (unsigned i = c.first; i < c.first + c.addedCount; ++i) {
+				DataNode const & dataNode = *(indexNode->entries[i]);
+				if (dataNode.bin.recordsCount == 0) continue;  // empty data node, its page is not used
+				storage->readPageContent(dataNode.pageId, pim->bufferForPage);
+				pim->wal->append(this, WriteAheadLog::RecordType::page, indexNode->revision, dataNode.pageId, pim->bufferForPage, dataNode.bin.totalSize());
+			}
+		}
+		// ===== changes of index node
+		std::vector<uint8_t> record(indexNode->journalRecordLength());
+		indexNode->writeJournalRecord(record.data(), 0);
+		pim->wal->append(this, WriteAheadLog::RecordType::indexNode, indexNode->revision, 0, record.data(), record.size());
+	}
+
+
 	template<typename tKey>
 	void XX::schedule(XX::Procedure * proc)
 	{
@@ -103,9 +300,9 @@ namespace flatDb {
 
 		// ===== get proper index node
 		if ( isReadOnly ) {
-			// it is read only procedure
-			std::lock_guard<std::mutex> guard(pim->accessCommittedDb);
-			indexNode = pim->committedDb;
+			// it is read only procedure, the revision is kept until the procedure is deleted
+			if (proc->indexNode == nullptr) proc->indexNode = getCommittedIndexNode();
+			indexNode = proc->indexNode;
 		} else {
 			// it is update procedure
 			pim->accessCurrentDb.lock();
@@ -116,7 +313,13 @@ namespace flatDb {
 		std::vector<Bin> bins;
 		bins.reserve(indexNode->entries.size());
 		for (auto dn: indexNode->entries) bins.push_back( dn->bin );
+		// the procedure may be completed and deleted by createSubProcedures() if it returns no subprocedures
+		ProcedureReadRecordsFromRange * rangeProc = dynamic_cast<ProcedureReadRecordsFromRange*>(proc);
 		std::map<unsigned,typename SubProcedure::SP> subprocs = proc->createSubProcedures(bins);
+		if (rangeProc != nullptr) {
+			// range scans read data nodes one by one
+			for (auto & kv: subprocs) readAhead(rangeProc, indexNode->entries, kv.first);
+		}
 		for (auto & kv: subprocs) {
 			typename DataNode::SP dataNode = indexNode->entries[kv.first];
 			typename SubProcedure::SP subproc = kv.second;
@@ -130,6 +333,37 @@ namespace flatDb {
 	}
 
 
+	template<typename tKey>
+	void XX::readAhead(ProcedureReadRecordsFromRange * proc, std::vector<std::shared_ptr<DataNode>> const & entries, unsigned index)
+	{
+		typename ProcedureReadRecordsFromRange::ReadAhead & ra = proc->readAhead;
+		unsigned const maxWindow = std::max(1u, std::min(maxReadAheadPages, storage->cacheSizeInPages() / 8));
+		if (ra.window == 0 || index < ra.next || index > ra.end) {
+			// the first data node or the scan does not read data nodes in order
+			ra.window = initialReadAheadPages;
+			ra.end = index + 1;
+		} else if (index < ra.end && (storage->readOnly || entries[index]->isWaitingForRead())) {
+			// the scan is faster than reading, more pages must be read in advance
+			// (in read-only mode pages are loaded by the kernel, so the window grows with each step of the scan)
+			ra.window = 2 * ra.window;
+		}
+		ra.window = std::min(ra.window, maxWindow);
+		ra.next = index + 1;
+		// ----- pages are read ahead only in the range of the query
+		unsigned const end = std::min<unsigned>(entries.size(), index + 1 + ra.window);
+		for ( ;  ra.end < end && entries[ra.end]->bin.firstKey <= proc->lastKey();  ++ra.end ) {
+			DataNode & dataNode = *(entries[ra.end]);
+			if (storage->readOnly) {
+				if (dataNode.bin.recordsCount == 0) continue;
+				storage->adviseWillNeed(dataNode.pageId);
+			} else if ( ! dataNode.prefetch(proc->priority, proc->accessType) ) {
+				continue;
+			}
+			++(pim->readAheadPagesCount);
+		}
+	}
+
+
 	template<typename tKey>
 	void XX::scheduleToReorganize(typename DataNode::SP dataNode, unsigned priority)
 	{
@@ -157,6 +391,8 @@ namespace flatDb {
 	void XX::reorganizeAndSynchronize()
 	{
 //DebugScope("Schedule::reorganize");
+		std::lock_guard<std::mutex> synchronizationGuard(pim->synchronization);
+
 		// ===== get keys to reorganize
 		std::map<tKey,unsigned> firstKeys;
 		{
@@ -164,10 +400,14 @@ namespace flatDb {
 			if (pim->synchState != Pim::SynchState::synchTaskScheduled) return; // obsolete task
 			pim->synchState = Pim::SynchState::duringSynchTaskExecution;
 			firstKeys = pim->reorganizeFirstKeys;
-			if (firstKeys.empty()) {
+		}
+		if (firstKeys.empty()) {
+			{
+				std::lock_guard<std::mutex> guard(pim->reorganizeAccess);
 				pim->synchState = Pim::SynchState::noSynchTask;
-				return;
 			}
+			pim->reorganizeDone.notify_all();
+			return;
 		}
 
 		// ===== convert firstKeys to data node indexes
@@ -189,21 +429,10 @@ namespace flatDb {
 			std::lock_guard<std::mutex> guard(pim->accessCurrentDb);
 			removedDataNodes = pim->currentDb->reorganize(indexes);
 			if (! removedDataNodes.empty()) {
-				indexNode = pim->currentDb->createSecondCopy();
-				pim->currentDb.swap(indexNode);
-			}
-		}
-
-		if (removedDataNodes.empty()) {
-			// ===== no changes
-			std::this_thread::yield();
-
-		} else {
-			// ===== there are changes to commit
-
-			// ===== get rid of removed data nodes from reorganizeFirstKeys, recalculate priorities
-			{
-				std::lock_guard<std::mutex> guard(pim->reorganizeAccess);
+				// ===== get rid of removed data nodes from reorganizeFirstKeys, recalculate priorities
+				// it must be done before new data nodes become visible, a new data node may have the same first key
+				// as a removed one and its modification must not be lost
+				std::lock_guard<std::mutex> guard2(pim->reorganizeAccess);
 				// remove data nodes & calculate their synchronization priority
 				for (typename DataNode::SP dn: removedDataNodes) {
 					auto it = pim->reorganizeFirstKeys.find(dn->bin.firstKey);
@@ -215,28 +444,18 @@ namespace flatDb {
 				for (auto const & kv: pim->reorganizeFirstKeys) {
 					pim->reorganizePriority = std::max(pim->reorganizePriority,kv.second);
 				}
+				indexNode = pim->currentDb->createSecondCopy();
+				pim->currentDb.swap(indexNode);
 			}
+		}
 
-			// flush all IO writes
-//Stopwatch sw;
-			storage->flush();
-//std::cout << "Flush: " << sw.get_time_ms() << " ";
-
-			// write new index node
-			indexNode->writeToBuffer( pim->bufferForIndexNode );
-			storage->writePages( (indexNode->firstCopy ? 0 : pagesPerIndexNode), pagesPerIndexNode, pim->bufferForIndexNode );  // TODO - combine with flush?
-//sw.reset_and_restart();
-			storage->flush();
-//std::cout << sw.get_time_ms() << std::endl;
-
-			// set new committed node
-			{
-				std::lock_guard<std::mutex> guard(pim->accessCommittedDb);
-				pim->committedDb = indexNode;
-			}
+		if (removedDataNodes.empty()) {
+			// ===== no changes
+			std::this_thread::yield();
 
-			// set all old data nodes as obsolete
-			for (auto dn: removedDataNodes) dn->markAsObsolete();
+		} else {
+			// ===== there are changes to commit
+			commitChanges(indexNode, removedDataNodes);
 		}
 
 		// reschedule reorganize&synchronize task if needed
@@ -250,6 +469,72 @@ namespace flatDb {
 				pim->synchState = Pim::SynchState::synchTaskScheduled;
 			}
 		}
+		pim->reorganizeDone.notify_all();
+	}
+
+
+	template<typename tKey>
+	void XX::waitForPendingChanges()
+	{
+		std::unique_lock<std::mutex> guard(pim->reorganizeAccess);
+		// data nodes waiting for reorganization now (a data node with the same first key modified later is waited for too)
+		std::vector<tKey> firstKeys;
+		for (auto const & kv: pim->reorganizeFirstKeys) firstKeys.push_back(kv.first);
+		// keys are removed before the commit, so the running task must be finished too
+		auto committed = [this,&firstKeys]()->bool
+		{
+			if (pim->synchState == Pim::SynchState::duringSynchTaskExecution) return false;
+			for (tKey key: firstKeys) if (pim->reorganizeFirstKeys.count(key)) return false;
+			return true;
+		};
+		pim->reorganizeDone.wait(guard, committed);
+	}
+
+
+	template<typename tKey>
+	void XX::commitChanges(std::shared_ptr<IndexNode> indexNode, std::vector<std::shared_ptr<DataNode>> const & removedDataNodes, bool forceCheckpoint)
+	{
+		// flush all IO writes (with the write-ahead log, data pages are synchronized by checkpoints)
+//Stopwatch sw;
+		if (pim->wal == nullptr || forceCheckpoint) storage->flush();
+//std::cout << "Flush: " << sw.get_time_ms() << " ";
+
+		// write new index node (as a record in the journal or as a checkpoint or in the write-ahead log)
+//sw.reset_and_restart();
+		if (pim->wal != nullptr) pim->wal->beginAppend();
+		commitIndexNode(indexNode, forceCheckpoint);
+//std::cout << sw.get_time_ms() << std::endl;
+
+		// set new committed node
+		{
+			std::lock_guard<std::mutex> guard(pim->accessCommittedDb);
+			pim->committedDb = indexNode;
+		}
+		if (pim->wal != nullptr) pim->wal->endAppend();
+
+		// set all old data nodes as obsolete
+		for (auto dn: removedDataNodes) dn->markAsObsolete();
+	}
+
+
+	template<typename tKey>
+	void XX::bulkLoad(std::function<bool(std::vector<std::pair<tKey,uint8_t const*>> &)> nextChunk, typename Record::tUpdateByKeyFunction visitor)
+	{
+		std::lock_guard<std::mutex> synchronizationGuard(pim->synchronization);
+		std::lock_guard<std::mutex> guard(pim->accessCurrentDb);
+		{
+			std::lock_guard<std::mutex> guard2(pim->reorganizeAccess);
+			if ( ! pim->reorganizeFirstKeys.empty() || pim->synchState == Pim::SynchState::duringSynchTaskExecution ) {
+				throw std::logic_error("Bulk load cannot be run concurrently with other modifications");
+			}
+		}
+		typename IndexNode::SP indexNode = pim->currentDb->createSecondCopy();
+		std::vector<typename DataNode::SP> removedDataNodes = indexNode->bulkLoad(nextChunk, visitor);
+		if (removedDataNodes.empty()) return;
+		// new data pages are not copied to the write-ahead log, the database file is synchronized instead
+		commitChanges(indexNode, removedDataNodes, true);
+		// the committed node must not be modified, next changes go to its copy (with the next revision)
+		pim->currentDb = indexNode->createSecondCopy();
 	}
 
 
@@ -262,6 +547,14 @@ namespace flatDb {
 	}
 
 
+	template<typename tKey>
+	std::shared_ptr<typename XX::IndexNode> XX::getCommittedIndexNode() const
+	{
+		std::lock_guard<std::mutex> guard(pim->accessCommittedDb);
+		return pim->committedDb;
+	}
+
+
 	template<typename tKey>
 	uint64_t XX::getRecordsCount() const
 	{
@@ -291,6 +584,204 @@ namespace flatDb {
 	}
 
 
+	template<typename tKey>
+	void XX::releasePages(std::vector<unsigned> const & pagesIds)
+	{
+		if (pim->wal == nullptr) {
+			storage->releasePages(pagesIds);
+			return;
+		}
+		std::lock_guard<std::mutex> guard(pim->pagesToReleaseAccess);
+		pim->pagesToRelease.insert(pim->pagesToRelease.end(), pagesIds.begin(), pagesIds.end());
+	}
+
+
+	template<typename tKey>
+	void XX::registerReadWithoutPage()
+	{
+		++(pim->readsWithoutPageCount);
+	}
+
+
+	template<typename tKey>
+	uint64_t XX::readAndResetReadsWithoutPageCount()
+	{
+		return pim->readsWithoutPageCount.exchange(0);
+	}
+
+
+	template<typename tKey>
+	uint64_t XX::readAndResetReadAheadPagesCount()
+	{
+		return pim->readAheadPagesCount.exchange(0);
+	}
+
+
+	template<typename tKey>
+	bool XX::compactionStep(unsigned maxPagesToMove, unsigned & movedPages)
+	{
+		// entries of the current index node are not modified by other threads until the lock is released
+		std::lock_guard<std::mutex> synchronizationGuard(pim->synchronization);
+		movedPages = 0;
+		typename IndexNode::SP currentDb;
+		{
+			std::lock_guard<std::mutex> guard(pim->accessCurrentDb);
+			currentDb = pim->currentDb;
+		}
+		std::vector<typename DataNode::SP> const & entries = currentDb->entries;
+
+		// ===== places of data pages follow the index node's copies, the journal is skipped
+		auto skipJournal = [this](unsigned pageId)->unsigned
+		{
+			if ( pim->journalPagesCount > 0 && pageId >= pim->journalFirstPageId && pageId < pim->journalFirstPageId + pim->journalPagesCount ) {
+				return (pim->journalFirstPageId + pim->journalPagesCount);
+			}
+			return pageId;
+		};
+		std::unordered_map<unsigned,unsigned> owners;  // pageId -> index of data node
+		owners.reserve(entries.size());
+		unsigned pagesLeft = 0;
+		unsigned place = 2 * pagesPerIndexNode;
+		for (unsigned i = 0; i < entries.size(); ++i, ++place) {
+			place = skipJournal(place);
+			owners[entries[i]->pageId] = i;
+			if (entries[i]->pageId != place) ++pagesLeft;
+		}
+		pim->compactionPagesLeft = pagesLeft;
+
+		// ===== choose data nodes to move (index of data node -> new page)
+		std::vector<std::pair<unsigned,unsigned>> moves;
+		place = 2 * pagesPerIndexNode;
+		for (unsigned i = 0; i < entries.size() && moves.size() < maxPagesToMove; ++i, ++place) {
+			place = skipJournal(place);
+			if (entries[i]->pageId == place) continue;
+			if (storage->allocateGivenPage(place)) {
+				moves.push_back( std::make_pair(i, place) );
+				continue;
+			}
+			// the place is used by a data node with larger keys, it is moved to any free page (the place is free after commit)
+			auto it = owners.find(place);
+			if (it != owners.end() && it->second > i) moves.push_back( std::make_pair(it->second, storage->allocatePages(1).front()) );
+			// otherwise the page belongs to an obsolete data node and it is released later
+			break;
+		}
+		std::sort(moves.begin(), moves.end());
+
+		// ===== copy pages, readers and writers are not blocked
+		std::vector<typename DataNode::SP> newDataNodes;
+		std::vector<unsigned> pagesToSave;
+		for (auto const & m: moves) newDataNodes.push_back( DataNode::createRelocated(this, *(entries[m.first]), m.second, pagesToSave) );
+		storage->savePagesToStorage(pagesToSave);
+		for (auto pageId: pagesToSave) storage->unlockPage(pageId);
+
+		// ===== replace data nodes that were not modified in the meantime
+		typename IndexNode::SP indexNode;
+		std::vector<typename DataNode::SP> removedDataNodes;
+		std::vector<unsigned> unusedPages;
+		{
+			std::lock_guard<std::mutex> guard(pim->accessCurrentDb);
+			for (unsigned k = 0; k < moves.size(); ++k) {
+				unsigned const i = moves[k].first;
+				if ( ! currentDb->entries[i]->tryToPrepareForRelocation() ) {
+					unusedPages.push_back(moves[k].second);
+					continue;
+				}
+				removedDataNodes.push_back(currentDb->entries[i]);
+				currentDb->entries[i]->freeMemory();
+				currentDb->entries[i] = newDataNodes[k];
+				typename IndexNode::EntriesChange change;
+				change.first = i;
+				change.removedCount = change.addedCount = 1;
+				currentDb->changes.push_back(change);
+			}
+			if ( ! removedDataNodes.empty() ) {
+				indexNode = currentDb->createSecondCopy();
+				pim->currentDb.swap(indexNode);
+			}
+		}
+		newDataNodes.clear();
+		storage->releasePages(unusedPages);
+		if ( ! removedDataNodes.empty() ) commitChanges(indexNode, removedDataNodes);
+		movedPages = removedDataNodes.size();
+		pim->compactionMovedPages += movedPages;
+
+		// ===== release free pages at the end of the file
+		pim->compactionReclaimedBytes += uint64_t(storage->truncateFreePages()) * storage->pageSize;
+		return (pagesLeft == 0);
+	}
+
+
+	template<typename tKey>
+	void XX::startCompaction(unsigned pagesPerSecond)
+	{
+		ASSERT(pagesPerSecond > 0);
+		ASSERT( ! pim->compactionThread.joinable() );
+		if (storage->readOnly) throw std::logic_error("Compaction cannot be started for the database opened in read-only mode");
+		pim->compactionThread = std::thread( [this,pagesPerSecond]()
+		{
+			// pages are moved in small groups, each group is committed separately
+			unsigned const pagesPerStep = std::max(1u, std::min(64u, pagesPerSecond / 8));
+			while (true) {
+				std::chrono::steady_clock::time_point const start = std::chrono::steady_clock::now();
+				std::chrono::steady_clock::time_point next;
+				try {
+					unsigned movedPages = 0;
+					if (compactionStep(pagesPerStep, movedPages)) {
+						next = start + std::chrono::seconds(compactionCheckIntervalInSeconds);
+					} else if (movedPages == 0) {
+						// pages of replaced data nodes may be still in use (by readers or until the commit of the write-ahead log)
+						next = start + std::chrono::seconds(1);
+					} else {
+						next = start + std::chrono::microseconds(uint64_t(movedPages) * 1000000 / pagesPerSecond);
+					}
+				} catch (std::exception const & e) {
+					std::cerr << "Compaction in background stopped: " << e.what() << std::endl;
+					return;
+				}
+				std::unique_lock<std::mutex> lock(pim->compactionAccess);
+				if (pim->compactionStopped.wait_until(lock, next, [this]()->bool { return pim->stopCompaction; })) return;
+			}
+		} );
+	}
+
+
+	template<typename tKey>
+	void XX::readAndResetCompactionStatistics(uint64_t & movedPages, uint64_t & reclaimedBytes, uint64_t & pagesLeft)
+	{
+		movedPages = pim->compactionMovedPages.exchange(0);
+		reclaimedBytes = pim->compactionReclaimedBytes.exchange(0);
+		pagesLeft = pim->compactionPagesLeft;
+	}
+
+
+	// all records appended to the log are durable, pages of obsolete data nodes can be reused
+	template<typename tKey>
+	void XX::afterCommit()
+	{
+		std::vector<unsigned> pagesIds;
+		{
+			std::lock_guard<std::mutex> guard(pim->pagesToReleaseAccess);
+			pagesIds.swap(pim->pagesToRelease);
+		}
+		storage->releasePages(pagesIds);
+	}
+
+
+	// it is called by the write-ahead log when there are no appends in progress
+	template<typename tKey>
+	void XX::checkpoint()
+	{
+		typename IndexNode::SP indexNode;
+		{
+			std::lock_guard<std::mutex> guard(pim->accessCommittedDb);
+			indexNode = pim->committedDb;
+		}
+		if (indexNode->revision == pim->checkpointRevision) return;
+		storage->flush();
+		commitIndexNode(indexNode, true);
+	}
+
+
 	template class SchedulerT<uint32_t>;
 	template class SchedulerT<uint64_t>;
 }
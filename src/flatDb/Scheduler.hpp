@@ -2,6 +2,7 @@
 #define FLATDB_SCHEDULER_HPP_
 
 #include "../apiDb/TasksManager.hpp"
+#include "../apiDb/WriteAheadLog.hpp"
 #include "Procedure.hpp"
 #include "StorageWithCache.hpp"
 #include "DataNode.hpp"
@@ -13,11 +14,12 @@ namespace flatDb {
 	template<typename tKey> class IndexNodeT;
 
 	template<typename tKey>
-	class SchedulerT
+	class SchedulerT : public WriteAheadLog::Database
 	{
 	public:
 		typedef ProcedureT<tKey> Procedure;
 		typedef ProcedureUpdateRecordsByKeysT<tKey> ProcedureUpdateRecordsByKeys;
+		typedef ProcedureReadRecordsFromRangeT<tKey> ProcedureReadRecordsFromRange;
 		typedef SubProcedureT<tKey> SubProcedure;
 		typedef DataNodeT<tKey> DataNode;
 		typedef IndexNodeT<tKey> IndexNode;
@@ -28,17 +30,60 @@ namespace flatDb {
 		TasksManager * const ioTasksManager;
 		StorageWithCache * const storage;
 		typename Record::tCreateRecordFunction const callbackCreateRecord;
+		unsigned const keysFilterBitsPerKey;  // size of filters with keys of data nodes, 0 - filters are not used
 	private:
 		struct Pim;
 		Pim * pim;
+		// saves given index node as a record in the journal or as a checkpoint (whole node), flushes the storage
+		// if the write-ahead log is used, the changes are appended to the log (checkpoint must be forced explicitly)
+		void commitIndexNode(std::shared_ptr<IndexNode>, bool forceCheckpoint = false);
+		// appends new data pages and changes of the index node to the write-ahead log
+		void appendToWriteAheadLog(std::shared_ptr<IndexNode>);
+		// saves new index node, sets it as committed and marks removed data nodes as obsolete
+		void commitChanges(std::shared_ptr<IndexNode>, std::vector<std::shared_ptr<DataNode>> const & removedDataNodes, bool forceCheckpoint = false);
+		// reads in background next data nodes of the range scan, which is going to process the data node with given index
+		// the number of data nodes read ahead grows when the scan waits for them (in the cache mode) or with each step (in read-only mode)
+		void readAhead(ProcedureReadRecordsFromRange *, std::vector<std::shared_ptr<DataNode>> const & entries, unsigned index);
 	public:
-		SchedulerT(unsigned keySize, unsigned pagesPerIndexNode, TasksManager* cpuTM, TasksManager* ioTM, StorageWithCache*, typename Record::tCreateRecordFunction);
+		// the write-ahead log is optional (nullptr = changes are synchronized by each commit)
+		// if keysFilterBitsPerKey > 0, reads by keys absent in data nodes are answered by filters kept in memory (without loading pages)
+		SchedulerT(unsigned keySize, unsigned pagesPerIndexNode, TasksManager* cpuTM, TasksManager* ioTM, StorageWithCache*, typename Record::tCreateRecordFunction
+					, WriteAheadLog * wal = nullptr, std::string const & name = "", unsigned keysFilterBitsPerKey = 0);
+		// stops the compaction in background
+		~SchedulerT();
 		void schedule(Procedure *);
 		void scheduleToReorganize(typename DataNode::SP, unsigned priority);
 		void reorganizeAndSynchronize();
+		// returns when all modifications scheduled to reorganize before the call are committed (appended to the write-ahead log)
+		void waitForPendingChanges();
+		// replaces content of data nodes directly by sorted records (without update procedures), see IndexNode::bulkLoad()
+		// there must be no other modifications in progress
+		void bulkLoad(std::function<bool(std::vector<std::pair<tKey,uint8_t const*>> &)> nextChunk, typename Record::tUpdateByKeyFunction visitor);
+		// returns the last committed revision of the index node, its data nodes and their pages are kept until it is deleted
+		// (pages of obsolete data nodes are released by destructors), so reads of this revision are not affected by modifications
+		std::shared_ptr<IndexNode> getCommittedIndexNode() const;
 		tKey getTheLargestKey() const;
 		uint64_t getRecordsCount() const;
 		void printStatus() const;
+		// releases pages of obsolete data nodes, with the write-ahead log they are released after the next commit
+		void releasePages(std::vector<unsigned> const & pagesIds);
+		// counter of subprocedures processed without loading the page (all keys were rejected by the bin's range or the filter)
+		void registerReadWithoutPage();
+		uint64_t readAndResetReadsWithoutPageCount();
+		// counter of data pages read ahead by range scans
+		uint64_t readAndResetReadAheadPagesCount();
+		// ----- compaction: data pages are moved to places following the index node in the order of keys
+		// moves at most maxPagesToMove pages (movedPages is set to their number), the free pages at the end of the file are released
+		// returns true if all data pages are already on their places, readers are not blocked
+		bool compactionStep(unsigned maxPagesToMove, unsigned & movedPages);
+		// counters since the last call, pagesLeft is the number of data pages out of their places found by the last step
+		void readAndResetCompactionStatistics(uint64_t & movedPages, uint64_t & reclaimedBytes, uint64_t & pagesLeft);
+		// starts the thread running compaction steps in background, at most pagesPerSecond pages are moved per second
+		// when all data pages are on their places, the order is checked again every minute (modifications move data pages)
+		void startCompaction(unsigned pagesPerSecond);
+		// ----- WriteAheadLog::Database
+		void afterCommit();
+		void checkpoint();
 	};
 
 }
@@ -1,7 +1,10 @@
 #include "StorageWithCache.hpp"
 #include "FileWithPages.hpp"
+#include "Lz4.hpp"
+#include "../apiDb/CacheBudget.hpp"
+#include "../apiDb/MemoryArena.hpp"
 #include <map>
-#include <list>
+#include <set>
 #include <algorithm>
 #include <stdexcept>
 #include <memory>
@@ -9,9 +12,20 @@
 #include <thread>
 #include <chrono>
 #include <cstring>
+#include <atomic>
+#include <string>
+#include <fstream>
+#include <iterator>
+#include <cstdio>
+#include <condition_variable>
+// -------- low level file access (the list of raw pages is synchronized)
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "../commonTools/Stopwatch.hpp"
 #include "../commonTools/assert.hpp"
+#include "../commonTools/bytesLevel.hpp"
 #include "../debug.hpp"
 
 
@@ -19,66 +33,157 @@ namespace flatDb {
 
 	struct CacheEntry {
 		uint8_t* buffer = nullptr;
-		std::list<unsigned>::iterator placeInLineToDelete;
+		unsigned placeInClock = 0;
+		unsigned storedSize = 0;  // number of bytes of the page saved in the file, 0 - unknown (the whole page is read)
+		uint32_t evictedAt = 0;   // value of evictionsClock when the page was evicted, 0 - the page was not evicted
 		bool locked = false;
+		bool referenced = false;
+		bool lowPriority = false;       // the page was loaded by the scan with low priority, it is evicted first
+		bool inLowPriorityList = false;
 	};
 
 
-	struct StorageWithCache::Pim {
-		FileWithPages file;
+	// compressed page is saved at the beginning of its place in the file:
+	// magic number (8 bytes), size of compressed data (4 bytes), size of content (4 bytes), content compressed by LZ4
+	// the content is the page without trailing zeros, pages that cannot be compressed are saved as they are
+	uint8_t const compressedPageMagic[8] = { 0xf1, 'f', 'l', 'a', 't', 'L', 'Z', 0x01 };
+	unsigned const compressedPageHeaderSize = 16;
+	unsigned const fileBlockSize = 4096;  // compressed pages are saved in blocks of this size
+
+	// pages saved as they are but starting with the magic number of compressed pages (very rare) are listed in the file
+	// with raw pages: magic number (8 bytes), number of pages (4 bytes), ids of pages (4 bytes each)
+	// the list is saved and synchronized before the pages are written, pages not listed there are compressed if they start
+	// with the magic number
+	uint8_t const rawPagesMagic[8] = { 0xf1, 'f', 'l', 'a', 't', 'R', 'a', 'w' };
+
+
+	// file with hot pages: magic number (8 bytes), number of pages (4 bytes), ids of pages (4 bytes each)
+	uint8_t const hotPagesMagic[8] = { 0xf1, 'f', 'l', 'a', 't', 'H', 'o', 't' };
+	unsigned const hotPagesSaveIntervalInSeconds = 60;
+
+
+	// part of the cache, page with given id belongs to the shard (pageId & shardsMask)
+	// and is stored in the vector cache at position (pageId >> shardsBits)
+	struct CacheShard {
+		std::mutex access;
+		std::vector<CacheEntry> cache;
+		std::vector<unsigned> clock;    // positions in cache of all entries with allocated buffers
+		unsigned clockHand = 0;
+		std::vector<unsigned> lowPriority;  // positions of unlocked entries with low priority (some of them may be outdated)
+		unsigned countOfCachePages = 0;
+		unsigned maxCountOfCachePages = 0;
+		unsigned pageSize = 0;
+		MemoryArena * arena = nullptr;    // buffers of pages are slabs of the arena
+		uint32_t evictionsClock = 0;      // number of evicted pages
+		unsigned ghostPagesCount = 0;     // misses of pages among the last ghostPagesCount evicted pages are counted
 		// ---- measurements
-		std::mutex timersAccess;
-		uint64_t countOfSynch  = 0;
-		uint64_t timeOfSynch   = 0;
-		uint64_t countOfWrites = 0;
-		uint64_t timeOfWrites  = 0;
-		uint64_t countOfReads  = 0;
-		uint64_t timeOfReads   = 0;
-		void updateTimes(Stopwatch timer, uint64_t & count, uint64_t & time)
+		std::atomic<uint64_t> countOfWrites;
+		std::atomic<uint64_t> timeOfWrites;
+		std::atomic<uint64_t> countOfReads;
+		std::atomic<uint64_t> timeOfReads;
+		std::atomic<uint64_t> countOfHits;
+		std::atomic<uint64_t> countOfMisses;
+		std::atomic<uint64_t> countOfEvictions;
+		std::atomic<uint64_t> countOfBytesRead;
+		std::atomic<uint64_t> countOfBytesWritten;
+		std::atomic<uint64_t> countOfScanHits;
+		std::atomic<uint64_t> countOfScanMisses;
+		std::atomic<uint64_t> countOfGhostHits;
+		CacheShard()
+		: countOfWrites(0), timeOfWrites(0), countOfReads(0), timeOfReads(0), countOfHits(0), countOfMisses(0), countOfEvictions(0)
+		, countOfBytesRead(0), countOfBytesWritten(0), countOfScanHits(0), countOfScanMisses(0), countOfGhostHits(0) {}
+		~CacheShard()
 		{
-			uint64_t t = timer.get_time_ms();
-			{
-				std::lock_guard<std::mutex> synchAccess(timersAccess);
-				time += t;
-				++count;
+			for (auto i: clock) arena->free(cache[i].buffer);
+		}
+		void updateTimes(Stopwatch timer, std::atomic<uint64_t> & count, std::atomic<uint64_t> & time)
+		{
+			time += timer.get_time_ms();
+			++count;
+		}
+		// ------------------ CLOCK
+		// returns position of unlocked entry that can be evicted or cache.size() if there is no such entry
+		inline unsigned findVictim()
+		{
+			// pages with low priority are evicted first
+			while ( ! lowPriority.empty() ) {
+				unsigned const pos = lowPriority.back();
+				lowPriority.pop_back();
+				CacheEntry & e = cache[pos];
+				e.inLowPriorityList = false;
+				if (e.buffer != nullptr && e.lowPriority && ! e.locked) return pos;
+			}
+			// two turns are enough to clear all reference bits
+			for (unsigned i = 2 * clock.size(); i > 0; --i) {
+				if (clockHand >= clock.size()) clockHand = 0;
+				CacheEntry & e = cache[clock[clockHand]];
+				if ( ! e.locked ) {
+					if ( ! e.referenced ) return clock[clockHand];
+					e.referenced = false;
+				}
+				++clockHand;
 			}
+			return cache.size();
+		}
+		inline void addToClock(unsigned pos)
+		{
+			cache[pos].placeInClock = clock.size();
+			clock.push_back(pos);
+		}
+		inline void removeFromClock(unsigned pos)
+		{
+			unsigned const place = cache[pos].placeInClock;
+			clock[place] = clock.back();
+			cache[clock[place]].placeInClock = place;
+			clock.pop_back();
 		}
-		// ---- memory & cache
-		std::mutex cacheAccess;
-		std::vector<CacheEntry> cache;
-		std::list<unsigned> pagesToDelete;
-		unsigned countOfCachePages = 0;
-		unsigned const maxCountOfCachePages;
 		// ------------------
-		inline bool lockMem(unsigned pageId, bool force)  // force = true - allow for overallocation
+		// the page is marked as referenced if reference = true, the flag is not changed for pages already locked
+		inline bool lockMem(unsigned pos, bool force, bool reference)  // force = true - allow for overallocation
 		{
-			CacheEntry & e = cache[pageId];
+			CacheEntry & e = cache[pos];
 			// ===== if already locked, there is nothing to do
 			if ( e.locked ) {
 				return true;
 			}
 			e.locked = true;
+			if (reference) e.referenced = true;
 			// ===== check if buffer is already allocated
 			if (e.buffer == nullptr) {
 				// it is not, we have to allocate it or take from another page
-				if ( countOfCachePages < maxCountOfCachePages || (pagesToDelete.empty() && force) ) {
-					e.buffer = new uint8_t[file.pageSize];
+				unsigned const victim = (countOfCachePages < maxCountOfCachePages) ? cache.size() : findVictim();
+				if (victim < cache.size()) {
+					CacheEntry & v = cache[victim];
+					std::swap( e.buffer, v.buffer );
+					v.referenced = v.lowPriority = false;
+					v.evictedAt = ++evictionsClock;
+					e.placeInClock = v.placeInClock;
+					clock[e.placeInClock] = pos;
+					++clockHand;
+					++countOfEvictions;
+				} else if ( countOfCachePages < maxCountOfCachePages || force ) {
+					e.buffer = arena->allocate();
 					++(countOfCachePages);
-				} else if (! pagesToDelete.empty()) {
-					std::swap( e.buffer, cache[pagesToDelete.front()].buffer );
-					pagesToDelete.pop_front();
+					addToClock(pos);
 				} else {
 					e.locked = false; // failure
 				}
-			} else {
-				// it is allocated, just remove if from list to delete
-				pagesToDelete.erase( e.placeInLineToDelete );
 			}
 			return e.locked;
 		}
-		inline void unlockMem(unsigned pageId)
+		// sets the priority of the locked page according to the type of access
+		inline void setAccessType(unsigned pos, StorageWithCache::AccessType accessType, bool loaded)
+		{
+			CacheEntry & e = cache[pos];
+			if (accessType == StorageWithCache::AccessType::point) {
+				e.lowPriority = false;
+			} else if (loaded) {
+				e.lowPriority = (accessType == StorageWithCache::AccessType::scanLowPriority);
+			}
+		}
+		inline void unlockMem(unsigned pos)
 		{
-			CacheEntry & e = cache[pageId];
+			CacheEntry & e = cache[pos];
 			// ===== if already unlocked, there is nothing to do
 			if ( ! e.locked ) {
 				return;
@@ -87,30 +192,478 @@ namespace flatDb {
 			// ===== check if number of pages is OK
 			if (countOfCachePages > maxCountOfCachePages) {
 				// too many pages, this one will be freed
-				delete [] e.buffer;
-				e.buffer = nullptr;
-				--(countOfCachePages);
-			} else {
-				// number of pages OK, schedule this one to be deleted
-				e.placeInLineToDelete = pagesToDelete.insert(pagesToDelete.end(), pageId);
+				freeBuffer(pos);
+			} else if (e.lowPriority && ! e.inLowPriorityList) {
+				e.inLowPriorityList = true;
+				lowPriority.push_back(pos);
 			}
+			// otherwise the page stays in the cache until CLOCK hand evicts it
+		}
+		inline void freeBuffer(unsigned pos)
+		{
+			CacheEntry & e = cache[pos];
+			removeFromClock(pos);
+			arena->free(e.buffer);
+			e.buffer = nullptr;
+			e.referenced = e.lowPriority = false;
+			e.evictedAt = ++evictionsClock;
+			--(countOfCachePages);
+		}
+		// buffers of unlocked pages are freed until the number of pages is not larger than the limit
+		inline void shrink()
+		{
+			while (countOfCachePages > maxCountOfCachePages) {
+				unsigned const victim = findVictim();
+				if (victim == cache.size()) break;  // locked pages are freed when they are unlocked
+				freeBuffer(victim);
+			}
+		}
+		// returns true if the page was evicted recently (the miss would be a hit in the cache larger by ghostPagesCount pages)
+		inline bool isGhost(unsigned pos) const
+		{
+			CacheEntry const & e = cache[pos];
+			return (e.buffer == nullptr && e.evictedAt != 0 && evictionsClock - e.evictedAt < ghostPagesCount);
+		}
+		StorageWithCache::Statistics readAndResetStatistics()
+		{
+			StorageWithCache::Statistics r;
+			r.synchCount       = 0;
+			r.synchTimeMs      = 0;
+			r.writesCount      = countOfWrites.exchange(0);
+			r.writesTimeMs     = timeOfWrites.exchange(0);
+			r.readsCount       = countOfReads.exchange(0);
+			r.readsTimeMs      = timeOfReads.exchange(0);
+			r.cacheHitsCount   = countOfHits.exchange(0);
+			r.cacheMissesCount = countOfMisses.exchange(0);
+			r.evictionsCount   = countOfEvictions.exchange(0);
+			r.bytesRead        = countOfBytesRead.exchange(0);
+			r.bytesWritten     = countOfBytesWritten.exchange(0);
+			r.scanCacheHitsCount   = countOfScanHits.exchange(0);
+			r.scanCacheMissesCount = countOfScanMisses.exchange(0);
+			r.warmUpPagesCount = 0;
+			return r;
 		}
-		Pim(std::string const & path, unsigned pageSize, uint64_t cacheMemoryInMegabyte)
-		: file(path,pageSize,false), maxCountOfCachePages(cacheMemoryInMegabyte * 1024 * 1024 / pageSize) {}
 	};
 
 
-	StorageWithCache::StorageWithCache(std::string const & path, unsigned pPageSize, uint64_t cacheMemoryInMegabyte)
-	: pim(new StorageWithCache::Pim(path, pPageSize, cacheMemoryInMegabyte)), pageSize(pPageSize)
+	struct StorageWithCache::Pim {
+		FileWithPages file;
+		bool const compressPages;
+		std::string const hotPagesPath;
+		std::mutex fileAccess;
+		// ---- raw pages starting with the magic number
+		std::string const rawPagesPath;
+		mutable std::mutex rawPagesAccess;
+		std::set<unsigned> rawPages;
+		std::atomic<bool> anyRawPages;
+		// ---- measurements
+		std::mutex timersAccess;
+		uint64_t countOfSynch  = 0;
+		uint64_t timeOfSynch   = 0;
+		// ---- memory & cache
+		std::atomic<unsigned> maxCountOfCachePages;
+		CacheBudget * const cacheBudget;
+		std::unique_ptr<MemoryArena> ownArena;   // used if the arena is not given, it must be deleted after shards
+		MemoryArena * const arena;
+		// ---- warm-up and the list of hot pages (both threads are stopped by stopWarmUp)
+		std::thread warmUpThread;
+		std::thread hotPagesThread;
+		std::mutex warmUpAccess;
+		std::condition_variable warmUpStopped;
+		bool stopWarmUp = false;
+		std::atomic<unsigned> warmUpPagesLeft;
+		std::atomic<uint64_t> countOfWarmUpPages;
+		unsigned shardsBits = 0;
+		unsigned shardsMask = 0;
+		std::vector<std::unique_ptr<CacheShard>> shards;
+		// ------------------
+		inline CacheShard & shard(unsigned pageId)
+		{
+			return *(shards[pageId & shardsMask]);
+		}
+		inline unsigned positionInShard(unsigned pageId) const
+		{
+			return (pageId >> shardsBits);
+		}
+		// sets limits of shards, pages are distributed evenly between shards
+		void setMaxCountOfCachePages(unsigned pagesCount, unsigned ghostPagesCount)
+		{
+			maxCountOfCachePages = pagesCount;
+			for (unsigned i = 0; i < shards.size(); ++i) {
+				std::lock_guard<std::mutex> synchAccess(shards[i]->access);
+				shards[i]->maxCountOfCachePages = (pagesCount >> shardsBits) + ((i < (pagesCount & shardsMask)) ? 1 : 0);
+				shards[i]->ghostPagesCount = (ghostPagesCount + shardsMask - i) >> shardsBits;
+				shards[i]->shrink();
+			}
+		}
+		// make sure that all shards can hold the pages with ids < pagesCount
+		void resizeShards(unsigned pagesCount)
+		{
+			for (unsigned i = 0; i < shards.size(); ++i) {
+				unsigned const minSize = (pagesCount + shardsMask - i) >> shardsBits;
+				std::lock_guard<std::mutex> synchAccess(shards[i]->access);
+				if (shards[i]->cache.size() < minSize) shards[i]->cache.resize(minSize);
+			}
+		}
+		// ------------------ compression
+		// compresses the page to the output buffer (page size), returns the number of bytes to save
+		// the page size is returned when the page cannot be compressed (then the page must be saved instead of the output buffer)
+		unsigned compressPage(uint8_t const * page, uint8_t * out) const
+		{
+			unsigned const pageSize = file.pageSize;
+			unsigned contentSize = pageSize;
+			for ( ;  contentSize >= 8;  contentSize -= 8 ) {
+				uint64_t word;
+				std::memcpy(&word, page + contentSize - 8, 8);
+				if (word != 0) break;
+			}
+			while (contentSize > 0 && page[contentSize-1] == 0) --contentSize;
+			// compressed page must be smaller by at least one block
+			unsigned const capacity = pageSize - fileBlockSize - compressedPageHeaderSize;
+			unsigned const compressedSize = compressLz4(page, contentSize, out + compressedPageHeaderSize, capacity);
+			if (compressedSize == 0 && contentSize > 0) return pageSize;
+			uint8_t * ptr = out;
+			std::memcpy(ptr, compressedPageMagic, 8);
+			ptr += 8;
+			writeUnsignedInteger<4>(ptr, compressedSize);
+			writeUnsignedInteger<4>(ptr, contentSize);
+			unsigned const storedSize = (compressedPageHeaderSize + compressedSize + fileBlockSize - 1) / fileBlockSize * fileBlockSize;
+			std::memset(ptr + compressedSize, 0, storedSize - compressedPageHeaderSize - compressedSize);
+			return storedSize;
+		}
+		// decompresses the page read from the file (the first bytesRead bytes of the page are in the buffer)
+		// returns the number of bytes used by the page in the file
+		unsigned decompressPage(unsigned pageId, uint8_t * buffer, unsigned bytesRead) const
+		{
+			unsigned const pageSize = file.pageSize;
+			if ( bytesRead < compressedPageHeaderSize || ! isCompressed(pageId, buffer) ) {
+				if (bytesRead < pageSize) throw std::runtime_error("Incorrect compressed page " + std::to_string(pageId));
+				return pageSize;  // the page is not compressed
+			}
+			uint8_t const * ptr = buffer + 8;
+			unsigned const compressedSize = readUnsignedInteger<4,unsigned>(ptr);
+			unsigned const contentSize = readUnsignedInteger<4,unsigned>(ptr);
+			if ( compressedSize > bytesRead - compressedPageHeaderSize || contentSize > pageSize ) {
+				throw std::runtime_error("Incorrect header of compressed page " + std::to_string(pageId));
+			}
+			// the page is decompressed to the same buffer, so compressed data must be copied first
+			thread_local std::vector<uint8_t> compressed;
+			compressed.assign(buffer + compressedPageHeaderSize, buffer + compressedPageHeaderSize + compressedSize);
+			if ( ! decompressLz4(compressed.data(), compressedSize, buffer, contentSize) ) {
+				throw std::runtime_error("Incorrect compressed page " + std::to_string(pageId));
+			}
+			std::memset(buffer + contentSize, 0, pageSize - contentSize);
+			return (compressedPageHeaderSize + compressedSize + fileBlockSize - 1) / fileBlockSize * fileBlockSize;
+		}
+		// reads the page from the file to the buffer, the page is decompressed if needed, storedSize = 0 means unknown
+		// returns the number of bytes used by the page in the file
+		unsigned readPage(unsigned pageId, uint8_t * buffer, unsigned storedSize)
+		{
+			if (storedSize == 0) storedSize = file.pageSize;
+			std::vector<FileWithPages::PagePart> parts(1, FileWithPages::PagePart{pageId, storedSize, buffer});
+			file.readPagesParts(parts);
+			shard(pageId).countOfBytesRead += storedSize;
+			return decompressPage(pageId, buffer, storedSize);
+		}
+		// returns true if the page read from the file is compressed (it starts with the magic number and it is not a raw page)
+		bool isCompressed(unsigned pageId, uint8_t const * page) const
+		{
+			if (std::memcmp(page, compressedPageMagic, 8) != 0) return false;
+			if ( ! anyRawPages ) return true;
+			std::lock_guard<std::mutex> synchAccess(rawPagesAccess);
+			return (rawPages.count(pageId) == 0);
+		}
+		// updates the list of raw pages before given pages are written (rawPagesIds - pages to save as they are, they start
+		// with the magic number), the list is saved only if it is changed
+		void updateRawPages(std::vector<std::pair<unsigned,uint8_t const*>> const & pages, std::vector<unsigned> const & rawPagesIds)
+		{
+			if (rawPagesIds.empty() && ! anyRawPages) return;
+			std::lock_guard<std::mutex> synchAccess(rawPagesAccess);
+			std::set<unsigned> newRawPages = rawPages;
+			for (auto const & kv: pages) newRawPages.erase(kv.first);
+			newRawPages.insert(rawPagesIds.begin(), rawPagesIds.end());
+			if (newRawPages == rawPages) return;
+			saveRawPages(newRawPages);
+			rawPages.swap(newRawPages);
+			anyRawPages = ! rawPages.empty();
+		}
+		// the file is replaced at once and synchronized with its directory, so the list is durable before the pages are written
+		void saveRawPages(std::set<unsigned> const & pages) const
+		{
+			std::vector<uint8_t> buffer(12 + 4 * pages.size());
+			uint8_t * ptr = buffer.data();
+			std::memcpy(ptr, rawPagesMagic, 8);
+			ptr += 8;
+			writeUnsignedInteger<4>(ptr, pages.size());
+			for (auto pageId: pages) writeUnsignedInteger<4>(ptr, pageId);
+			std::string const tmpPath = rawPagesPath + ".tmp";
+			int const fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+			if (fd < 0) throw std::runtime_error("Cannot create the file " + tmpPath);
+			bool const saved = ( write(fd, buffer.data(), buffer.size()) == static_cast<ssize_t>(buffer.size()) && fsync(fd) == 0 );
+			close(fd);
+			if ( ! saved ) throw std::runtime_error("Cannot write the file " + tmpPath);
+			if (std::rename(tmpPath.c_str(), rawPagesPath.c_str()) != 0) throw std::runtime_error("Cannot rename the file " + tmpPath);
+			std::string::size_type const slash = rawPagesPath.find_last_of('/');
+			std::string const dir = (slash == std::string::npos) ? "." : rawPagesPath.substr(0, slash + 1);
+			int const dirFd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+			if (dirFd < 0) throw std::runtime_error("Cannot open the directory " + dir);
+			bool const synchronized = (fsync(dirFd) == 0);
+			close(dirFd);
+			if ( ! synchronized ) throw std::runtime_error("Cannot synchronize the directory " + dir);
+		}
+		// returns an empty list if the file does not exist
+		std::set<unsigned> loadRawPages() const
+		{
+			std::set<unsigned> pages;
+			std::ifstream file(rawPagesPath, std::ios::binary);
+			if ( ! file.is_open() ) return pages;
+			std::vector<uint8_t> buffer( (std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>() );
+			if (buffer.size() < 12 || std::memcmp(buffer.data(), rawPagesMagic, 8) != 0) {
+				throw std::runtime_error("Incorrect content of the file " + rawPagesPath);
+			}
+			uint8_t const * ptr = buffer.data() + 8;
+			unsigned const count = readUnsignedInteger<4,unsigned>(ptr);
+			if (buffer.size() != 12 + 4 * uint64_t(count)) throw std::runtime_error("Incorrect content of the file " + rawPagesPath);
+			for (unsigned i = 0; i < count; ++i) pages.insert(readUnsignedInteger<4,unsigned>(ptr));
+			return pages;
+		}
+		// saves given pages (id -> buffer), returns sizes of saved pages in the file (in the same order)
+		std::vector<unsigned> writePages(std::vector<std::pair<unsigned,uint8_t const*>> const & pages)
+		{
+			std::vector<FileWithPages::PagePart> parts;
+			parts.reserve(pages.size());
+			std::vector<std::unique_ptr<uint8_t[]>> buffers;
+			std::vector<unsigned> storedSizes;
+			storedSizes.reserve(pages.size());
+			std::vector<unsigned> rawPagesIds;
+			for (auto const & kv: pages) {
+				unsigned storedSize = file.pageSize;
+				uint8_t * buffer = const_cast<uint8_t*>(kv.second);
+				if (compressPages) {
+					buffers.emplace_back(new uint8_t[file.pageSize]);
+					storedSize = compressPage(kv.second, buffers.back().get());
+					if (storedSize < file.pageSize) buffer = buffers.back().get();
+				}
+				// pages saved as they are but starting with the magic number are listed as raw pages (also when compression
+				// is off, because the option can be changed for existing database)
+				if (storedSize == file.pageSize && std::memcmp(kv.second, compressedPageMagic, 8) == 0) rawPagesIds.push_back(kv.first);
+				parts.push_back( FileWithPages::PagePart{kv.first, storedSize, buffer} );
+				storedSizes.push_back(storedSize);
+				shard(kv.first).countOfBytesWritten += storedSize;
+			}
+			updateRawPages(pages, rawPagesIds);
+			file.writePagesParts(parts);
+			return storedSizes;
+		}
+		// sets the size of the page in the file
+		void setStoredSize(unsigned pageId, unsigned storedSize)
+		{
+			CacheShard & s = shard(pageId);
+			std::lock_guard<std::mutex> synchAccess(s.access);
+			ASSERT(positionInShard(pageId) < s.cache.size());
+			s.cache[positionInShard(pageId)].storedSize = storedSize;
+		}
+		unsigned getStoredSize(unsigned pageId)
+		{
+			CacheShard & s = shard(pageId);
+			std::lock_guard<std::mutex> synchAccess(s.access);
+			ASSERT(positionInShard(pageId) < s.cache.size());
+			return s.cache[positionInShard(pageId)].storedSize;
+		}
+		// ------------------ warm-up
+		// returns ids of pages in the cache, referenced pages first
+		std::vector<unsigned> hotPages()
+		{
+			std::vector<unsigned> referenced;
+			std::vector<unsigned> others;
+			for (unsigned i = 0; i < shards.size(); ++i) {
+				CacheShard & s = *(shards[i]);
+				std::lock_guard<std::mutex> synchAccess(s.access);
+				for (auto pos: s.clock) {
+					unsigned const pageId = (pos << shardsBits) + i;
+					if (s.cache[pos].referenced) {
+						referenced.push_back(pageId);
+					} else {
+						others.push_back(pageId);
+					}
+				}
+			}
+			referenced.insert(referenced.end(), others.begin(), others.end());
+			return referenced;
+		}
+		void saveHotPages()
+		{
+			std::vector<unsigned> const pages = hotPages();
+			std::vector<uint8_t> buffer(12 + 4 * pages.size());
+			uint8_t * ptr = buffer.data();
+			std::memcpy(ptr, hotPagesMagic, 8);
+			ptr += 8;
+			writeUnsignedInteger<4>(ptr, pages.size());
+			for (auto pageId: pages) writeUnsignedInteger<4>(ptr, pageId);
+			// the file is replaced at once, so the previous list is not lost when the process is killed
+			std::string const tmpPath = hotPagesPath + ".tmp";
+			{
+				std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+				file.write(reinterpret_cast<char const *>(buffer.data()), buffer.size());
+				if (file.fail()) throw std::runtime_error("Cannot write the file " + tmpPath);
+			}
+			if (std::rename(tmpPath.c_str(), hotPagesPath.c_str()) != 0) throw std::runtime_error("Cannot rename the file " + tmpPath);
+		}
+		// returns an empty list if the file does not exist or is incorrect
+		std::vector<unsigned> loadHotPages()
+		{
+			std::vector<unsigned> pages;
+			std::ifstream file(hotPagesPath, std::ios::binary);
+			std::vector<uint8_t> buffer( (std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>() );
+			if (buffer.size() < 12 || std::memcmp(buffer.data(), hotPagesMagic, 8) != 0) return pages;
+			uint8_t const * ptr = buffer.data() + 8;
+			unsigned const count = readUnsignedInteger<4,unsigned>(ptr);
+			if (buffer.size() != 12 + 4 * uint64_t(count)) return pages;
+			pages.resize(count);
+			for (auto & pageId: pages) pageId = readUnsignedInteger<4,unsigned>(ptr);
+			return pages;
+		}
+		// loads the page to the cache if it is not there and there is free place in the cache (other pages are not evicted)
+		void warmUpPage(unsigned pageId, uint8_t * buffer)
+		{
+			CacheShard & s = shard(pageId);
+			unsigned const pos = positionInShard(pageId);
+			unsigned storedSize;
+			uint32_t evictedAt;
+			{
+				std::lock_guard<std::mutex> synchAccess(s.access);
+				if (pos >= s.cache.size() || s.cache[pos].buffer != nullptr) return;
+				if (s.countOfCachePages >= s.maxCountOfCachePages) return;
+				storedSize = s.cache[pos].storedSize;
+				evictedAt = s.cache[pos].evictedAt;
+			}
+			// the page is read to separate buffer, because it may be created or loaded by other threads in the meantime
+			// (the page may be not allocated, then it is never read by other threads and its content does not matter)
+			try {
+				storedSize = readPage(pageId, buffer, storedSize);
+			} catch (std::exception const &) {
+				return;  // incorrect content of the page, it is not allocated
+			}
+			std::lock_guard<std::mutex> synchAccess(s.access);
+			CacheEntry & e = s.cache[pos];
+			if (e.buffer != nullptr || e.locked || e.evictedAt != evictedAt || s.countOfCachePages >= s.maxCountOfCachePages) return;
+			// the page is marked as referenced, it was hot before restart
+			if ( ! s.lockMem(pos, false, true) ) return;
+			std::memcpy(e.buffer, buffer, file.pageSize);
+			e.storedSize = storedSize;
+			e.evictedAt = 0;
+			s.unlockMem(pos);
+			++countOfWarmUpPages;
+		}
+		void warmUp(std::vector<unsigned> pages, unsigned pagesPerSecond, bool readOnly)
+		{
+			std::unique_ptr<uint8_t[]> buffer(new uint8_t[file.pageSize]);
+			std::chrono::steady_clock::time_point const start = std::chrono::steady_clock::now();
+			for (unsigned i = 0; i < pages.size(); ++i) {
+				{
+					std::unique_lock<std::mutex> lock(warmUpAccess);
+					std::chrono::steady_clock::time_point const time = start + std::chrono::microseconds(uint64_t(i) * 1000000 / pagesPerSecond);
+					if (warmUpStopped.wait_until(lock, time, [this]()->bool { return stopWarmUp; })) break;
+				}
+				unsigned const pageId = pages[i];
+				warmUpPagesLeft = pages.size() - i - 1;
+				if (pageId >= file.numberOfPages()) continue;
+				if (readOnly && ! isCompressed(pageId, file.mappedPage(pageId))) {
+					// uncompressed pages are read directly from the memory mapping
+					file.adviseWillNeed(pageId, 1);
+					++countOfWarmUpPages;
+				} else {
+					warmUpPage(pageId, buffer.get());
+				}
+			}
+			warmUpPagesLeft = 0;
+		}
+		// saves the list of hot pages every hotPagesSaveIntervalInSeconds until stopWarmUp is set, the list is not saved
+		// during the warm-up (the previous list is better than the cache being filled)
+		void saveHotPagesPeriodically()
+		{
+			while (true) {
+				{
+					std::unique_lock<std::mutex> lock(warmUpAccess);
+					std::chrono::steady_clock::time_point const time = std::chrono::steady_clock::now() + std::chrono::seconds(hotPagesSaveIntervalInSeconds);
+					if (warmUpStopped.wait_until(lock, time, [this]()->bool { return stopWarmUp; })) break;
+				}
+				if (warmUpPagesLeft > 0) continue;
+				try {
+					saveHotPages();
+				} catch (std::exception const &) {
+					// the list is used only to warm up the cache, the next attempt is made after the interval
+				}
+			}
+		}
+		// ------------------
+		Pim(std::string const & path, unsigned pageSize, uint64_t cacheMemoryInMegabyte, unsigned shardsCount, AsyncIo * asyncIo, bool pCompressPages
+			, bool readOnly, CacheBudget * pCacheBudget, MemoryArena * pArena)
+		: file(path,pageSize,false,asyncIo,readOnly), compressPages(pCompressPages), hotPagesPath(path + ".hot"), rawPagesPath(path + ".raw")
+		, maxCountOfCachePages(cacheMemoryInMegabyte * 1024 * 1024 / pageSize), cacheBudget(pCacheBudget)
+		, ownArena((pArena == nullptr) ? new MemoryArena(pageSize) : nullptr), arena((pArena == nullptr) ? ownArena.get() : pArena), warmUpPagesLeft(0)
+		, countOfWarmUpPages(0)
+		{
+			rawPages = loadRawPages();
+			anyRawPages = ! rawPages.empty();
+			if (arena->slabSize != pageSize) throw std::logic_error("The size of slabs of the memory arena is different than the page size");
+			if (shardsCount == 0) {
+				shardsCount = 2 * std::max(1u, std::thread::hardware_concurrency());
+				// it is just a guess, minimum 4 cache pages per shard
+				shardsCount = std::min(shardsCount, std::max(1u, maxCountOfCachePages / 4));
+			}
+			// the number of shards is rounded down to a power of 2
+			while ( (2u << shardsBits) <= shardsCount ) ++shardsBits;
+			shardsMask = (1u << shardsBits) - 1;
+			for (unsigned i = 0; i <= shardsMask; ++i) {
+				shards.emplace_back(new CacheShard);
+				shards.back()->pageSize = pageSize;
+				shards.back()->arena = arena;
+			}
+			setMaxCountOfCachePages(maxCountOfCachePages, 0);
+			resizeShards(file.numberOfPages());
+		}
+	};
+
+
+	StorageWithCache::StorageWithCache(std::string const & path, unsigned pPageSize, uint64_t cacheMemoryInMegabyte, unsigned shardsCount, AsyncIo * asyncIo
+									, bool compressPages, bool pReadOnly, CacheBudget * cacheBudget, MemoryArena * arena)
+	: pim(new StorageWithCache::Pim(path, pPageSize, cacheMemoryInMegabyte, shardsCount, asyncIo, compressPages, pReadOnly, cacheBudget, arena)), pageSize(pPageSize)
+	, readOnly(pReadOnly)
 	{
 		ASSERT(pim->maxCountOfCachePages > 4);  // it is just a guess, minimum 4 cache pages
-		pim->cache.resize( pim->file.numberOfPages() );
+		if (cacheBudget != nullptr) {
+			try {
+				cacheBudget->registerCache(this, cacheMemoryInMegabyte);
+			} catch (...) {
+				delete pim;
+				throw;
+			}
+		}
+		if ( ! readOnly ) pim->hotPagesThread = std::thread( [this]() { pim->saveHotPagesPeriodically(); } );
 	}
 
 
 	StorageWithCache::~StorageWithCache()
 	{
-		// TODO - free memory from cache
+		{
+			std::lock_guard<std::mutex> lock(pim->warmUpAccess);
+			pim->stopWarmUp = true;
+		}
+		pim->warmUpStopped.notify_all();
+		if (pim->warmUpThread.joinable()) pim->warmUpThread.join();
+		if (pim->hotPagesThread.joinable()) {
+			pim->hotPagesThread.join();
+			// the list is saved at shutdown unless the warm-up was interrupted
+			if (pim->warmUpPagesLeft == 0) {
+				try {
+					pim->saveHotPages();
+				} catch (std::exception const &) {
+					// the list is used only to warm up the cache
+				}
+			}
+		}
+		if (pim->cacheBudget != nullptr) pim->cacheBudget->unregisterCache(this);
 		delete pim;
 	}
 
@@ -128,6 +681,57 @@ namespace flatDb {
 	}
 
 
+	unsigned StorageWithCache::cacheSizeInPages() const
+	{
+		return pim->maxCountOfCachePages;
+	}
+
+
+	void StorageWithCache::setCacheSizeInPages(unsigned pagesCount, unsigned ghostPagesCount)
+	{
+		pim->setMaxCountOfCachePages(pagesCount, ghostPagesCount);
+	}
+
+
+	uint64_t StorageWithCache::readAndResetGhostHitsCount()
+	{
+		uint64_t count = 0;
+		for (auto & s: pim->shards) count += s->countOfGhostHits.exchange(0);
+		return count;
+	}
+
+
+	void StorageWithCache::saveHotPages()
+	{
+		pim->saveHotPages();
+	}
+
+
+	void StorageWithCache::startWarmUp(unsigned pagesPerSecond)
+	{
+		ASSERT(pagesPerSecond > 0);
+		ASSERT( ! pim->warmUpThread.joinable() );
+		std::vector<unsigned> pages = pim->loadHotPages();
+		// the hottest pages are loaded if the cache is smaller than before, they are read in the order of the file
+		pages.resize( std::min<size_t>(pages.size(), cacheSizeInPages()) );
+		std::sort(pages.begin(), pages.end());
+		pim->warmUpPagesLeft = pages.size();
+		pim->warmUpThread = std::thread( [this,pages,pagesPerSecond]() { pim->warmUp(pages, pagesPerSecond, readOnly); } );
+	}
+
+
+	MemoryArena const & StorageWithCache::memoryArena() const
+	{
+		return *(pim->arena);
+	}
+
+
+	unsigned StorageWithCache::warmUpPagesLeft() const
+	{
+		return pim->warmUpPagesLeft;
+	}
+
+
 	// allocate new pages and bind them to unused ids, nothing is read from the file
 	// file may be extended
 	std::vector<unsigned> StorageWithCache::allocatePages(unsigned pagesCount)
@@ -136,12 +740,11 @@ namespace flatDb {
 		std::vector<unsigned> pagesIds;
 		pagesIds.reserve(pagesCount);
 		{
-			std::lock_guard<std::mutex> synchAccess(pim->cacheAccess);
+			std::lock_guard<std::mutex> synchAccess(pim->fileAccess);
 			// --- reserve pages in file
 			pagesIds.push_back( pim->file.allocatePages(pagesCount) );
 			// --- adjust size of cache, if required
-			unsigned const minPagesCount = pagesIds.back() + pagesCount;
-			if (pim->cache.size() < minPagesCount) pim->cache.resize(minPagesCount);
+			pim->resizeShards(pagesIds.back() + pagesCount);
 		}
 		while ( pagesIds.size() < pagesCount ) {
 			pagesIds.push_back( pagesIds.back() + 1 );
@@ -154,67 +757,136 @@ namespace flatDb {
 	{
 		if (pagesIds.empty()) return;
 		std::sort( pagesIds.begin(), pagesIds.end() );
+		for (auto pageId: pagesIds) {
+			CacheShard & shard = pim->shard(pageId);
+			unsigned const pos = pim->positionInShard(pageId);
+			std::lock_guard<std::mutex> synchAccess(shard.access);
+			ASSERT(pos < shard.cache.size());
+			ASSERT( ! shard.cache[pos].locked );
+			shard.cache[pos].storedSize = 0;
+			shard.cache[pos].evictedAt = 0;
+		}
 		{
-			std::lock_guard<std::mutex> synchAccess(pim->cacheAccess);
-			ASSERT(pagesIds.back() < pim->cache.size());
+			std::lock_guard<std::mutex> synchAccess(pim->fileAccess);
 			for (auto pageId: pagesIds) {
 				pim->file.releasePages(pageId, 1);
-				ASSERT( ! pim->cache[pageId].locked );
 			}
 		}
 	}
 
 
-	bool StorageWithCache::lockPage_loadFromCache(unsigned pageId, uint8_t*& outPagePtr)
+	bool StorageWithCache::allocateGivenPage(unsigned pageId)
+	{
+		std::lock_guard<std::mutex> synchAccess(pim->fileAccess);
+		return pim->file.allocateGivenPages(pageId, 1);
+	}
+
+
+	unsigned StorageWithCache::truncateFreePages()
 	{
-		std::lock_guard<std::mutex> synchAccess(pim->cacheAccess);
-		ASSERT(pageId < pim->cache.size());
-		outPagePtr = pim->cache[pageId].buffer;
+		std::lock_guard<std::mutex> synchAccess(pim->fileAccess);
+		return pim->file.truncateFreeTail();
+	}
+
+
+	bool StorageWithCache::lockPage_loadFromCache(unsigned pageId, uint8_t*& outPagePtr, AccessType accessType)
+	{
+		CacheShard & shard = pim->shard(pageId);
+		unsigned const pos = pim->positionInShard(pageId);
+		bool const scan = (accessType != AccessType::point);
+		std::lock_guard<std::mutex> synchAccess(shard.access);
+		ASSERT(pos < shard.cache.size());
+		outPagePtr = shard.cache[pos].buffer;
 		if (outPagePtr == nullptr) {
+			++(shard.countOfMisses);
+			if (scan) ++(shard.countOfScanMisses);
 			return false;
 		}
-		pim->lockMem(pageId, true);
+		++(shard.countOfHits);
+		if (scan) ++(shard.countOfScanHits);
+		shard.lockMem(pos, true, ! scan);
+		shard.setAccessType(pos, accessType, false);
 		return true;
 	}
 
 
-	bool StorageWithCache::lockPage_loadFromStorage(unsigned pageId, uint8_t*& outPagePtr)
+	bool StorageWithCache::isPageInCache(unsigned pageId)
 	{
+		CacheShard & shard = pim->shard(pageId);
+		unsigned const pos = pim->positionInShard(pageId);
+		std::lock_guard<std::mutex> synchAccess(shard.access);
+		ASSERT(pos < shard.cache.size());
+		return (shard.cache[pos].buffer != nullptr);
+	}
+
+
+	bool StorageWithCache::lockPage_loadFromStorage(unsigned pageId, uint8_t*& outPagePtr, AccessType accessType)
+	{
+		CacheShard & shard = pim->shard(pageId);
+		unsigned const pos = pim->positionInShard(pageId);
+		unsigned storedSize;
 		{
-			std::lock_guard<std::mutex> synchAccess(pim->cacheAccess);
-			ASSERT(pageId < pim->cache.size());
-			if ( ! pim->lockMem(pageId,false) ) return false;
-			outPagePtr = pim->cache[pageId].buffer;
+			std::lock_guard<std::mutex> synchAccess(shard.access);
+			ASSERT(pos < shard.cache.size());
+			bool const ghostHit = shard.isGhost(pos);
+			// the page must be accessed again to be marked as referenced
+			if ( ! shard.lockMem(pos, false, false) ) return false;
+			if (ghostHit) ++(shard.countOfGhostHits);
+			shard.cache[pos].evictedAt = 0;
+			shard.setAccessType(pos, accessType, true);
+			outPagePtr = shard.cache[pos].buffer;
+			storedSize = shard.cache[pos].storedSize;
 		}
 		Stopwatch sw;
-		pim->file.readPages(pageId, 1, outPagePtr);
-		pim->updateTimes(sw, pim->countOfReads, pim->timeOfReads);
+		storedSize = pim->readPage(pageId, outPagePtr, storedSize);
+		shard.updateTimes(sw, shard.countOfReads, shard.timeOfReads);
+		pim->setStoredSize(pageId, storedSize);
+		if (pim->cacheBudget != nullptr) pim->cacheBudget->pageLoaded();
 		return true;
 	}
 
 
 	void StorageWithCache::lockPage_createEmpty(unsigned pageId, uint8_t*& outPagePtr)
 	{
-		std::lock_guard<std::mutex> synchAccess(pim->cacheAccess);
-		ASSERT(pageId < pim->cache.size());
-		pim->lockMem(pageId, true);
-		outPagePtr = pim->cache[pageId].buffer;
+		CacheShard & shard = pim->shard(pageId);
+		unsigned const pos = pim->positionInShard(pageId);
+		std::lock_guard<std::mutex> synchAccess(shard.access);
+		ASSERT(pos < shard.cache.size());
+		shard.lockMem(pos, true, true);
+		shard.setAccessType(pos, AccessType::point, true);
+		outPagePtr = shard.cache[pos].buffer;
+		if (pim->compressPages) std::memset(outPagePtr, 0, pageSize);
 	}
 
 
 	// save locked page to the storage
 	void StorageWithCache::savePageToStorage(unsigned pageId)
 	{
-		void * ptr;
-		{
-			std::lock_guard<std::mutex> synchAccess(pim->cacheAccess);
-			ASSERT(pageId < pim->cache.size());
-			ASSERT(pim->cache[pageId].locked);
-			ptr = pim->cache[pageId].buffer;
+		savePagesToStorage(std::vector<unsigned>(1,pageId));
+	}
+
+
+	// save many locked pages to the storage
+	void StorageWithCache::savePagesToStorage(std::vector<unsigned> const & pagesIds)
+	{
+		if (pagesIds.empty()) return;
+		std::vector<std::pair<unsigned,uint8_t const*>> pages;
+		pages.reserve(pagesIds.size());
+		for (auto pageId: pagesIds) {
+			CacheShard & shard = pim->shard(pageId);
+			unsigned const pos = pim->positionInShard(pageId);
+			std::lock_guard<std::mutex> synchAccess(shard.access);
+			ASSERT(pos < shard.cache.size());
+			ASSERT(shard.cache[pos].locked);
+			pages.push_back( std::make_pair(pageId, shard.cache[pos].buffer) );
 		}
 		Stopwatch sw;
-		pim->file.writePages(pageId,1,ptr);
-		pim->updateTimes(sw, pim->countOfWrites, pim->timeOfWrites);
+		std::vector<unsigned> const storedSizes = pim->writePages(pages);
+		// the time is assigned to the shard of the first page
+		CacheShard & shard = pim->shard(pagesIds.front());
+		shard.updateTimes(sw, shard.countOfWrites, shard.timeOfWrites);
+		for (unsigned i = 1; i < pagesIds.size(); ++i) ++(pim->shard(pagesIds[i]).countOfWrites);
+		for (unsigned i = 0; i < pagesIds.size(); ++i) pim->setStoredSize(pagesIds[i], storedSizes[i]);
 	}
 
 
@@ -222,9 +894,11 @@ namespace flatDb {
 	// after calling this method, the page can be removed from cache in any moment
 	void StorageWithCache::unlockPage(unsigned pageId)
 	{
-		std::lock_guard<std::mutex> synchAccess(pim->cacheAccess);
-		ASSERT(pageId < pim->cache.size());
-		pim->unlockMem(pageId);
+		CacheShard & shard = pim->shard(pageId);
+		unsigned const pos = pim->positionInShard(pageId);
+		std::lock_guard<std::mutex> synchAccess(shard.access);
+		ASSERT(pos < shard.cache.size());
+		shard.unlockMem(pos);
 	}
 
 
@@ -239,36 +913,99 @@ namespace flatDb {
 	void StorageWithCache::writePages(unsigned firstPageId, unsigned pagesCount, uint8_t const* buffer)
 	{
 		pim->file.writePages(firstPageId, pagesCount, buffer);
+		for (unsigned i = 0; i < pagesCount; ++i) pim->setStoredSize(firstPageId + i, pageSize);
+	}
+
+
+	void StorageWithCache::readPageContent(unsigned pageId, uint8_t* buffer)
+	{
+		pim->readPage(pageId, buffer, pim->getStoredSize(pageId));
+	}
+
+
+	void StorageWithCache::writePageContent(unsigned pageId, uint8_t const* buffer)
+	{
+		std::vector<std::pair<unsigned,uint8_t const*>> pages(1, std::make_pair(pageId,buffer));
+		pim->setStoredSize(pageId, pim->writePages(pages).front());
 	}
 
 
 	// flush all new/modified pages to storage - it returns when everything is flushed
+	uint8_t const * StorageWithCache::mappedPage(unsigned pageId) const
+	{
+		ASSERT(readOnly);
+		uint8_t const * page = pim->file.mappedPage(pageId);
+		if (pim->isCompressed(pageId, page)) return nullptr;
+		return page;
+	}
+
+
+	void StorageWithCache::adviseWillNeed(unsigned pageId) const
+	{
+		ASSERT(readOnly);
+		pim->file.adviseWillNeed(pageId, 1);
+	}
+
+
 	void StorageWithCache::flush()
 	{
 		Stopwatch sw;
 		pim->file.flush();
-		pim->updateTimes(sw, pim->countOfSynch, pim->timeOfSynch);
+		uint64_t const t = sw.get_time_ms();
+		std::lock_guard<std::mutex> synchAccess(pim->timersAccess);
+		pim->timeOfSynch += t;
+		++(pim->countOfSynch);
 	}
 
 
 	typename StorageWithCache::Statistics StorageWithCache::readAndResetStatistics()
 	{
 		Statistics r;
-		std::lock_guard<std::mutex> synchAccess(pim->timersAccess);
-		r.synchCount   = pim->countOfSynch;
-		r.synchTimeMs  = pim->timeOfSynch;
-		r.writesCount  = pim->countOfWrites;
-		r.writesTimeMs = pim->timeOfWrites;
-		r.readsCount   = pim->countOfReads;
-		r.readsTimeMs  = pim->timeOfReads;
-		pim->countOfSynch  = 0;
-		pim->timeOfSynch   = 0;
-		pim->countOfWrites = 0;
-		pim->timeOfWrites  = 0;
-		pim->countOfReads  = 0;
-		pim->timeOfReads   = 0;
+		{
+			std::lock_guard<std::mutex> synchAccess(pim->timersAccess);
+			r.synchCount   = pim->countOfSynch;
+			r.synchTimeMs  = pim->timeOfSynch;
+			pim->countOfSynch  = 0;
+			pim->timeOfSynch   = 0;
+		}
+		r.writesCount      = 0;
+		r.writesTimeMs     = 0;
+		r.readsCount       = 0;
+		r.readsTimeMs      = 0;
+		r.cacheHitsCount   = 0;
+		r.cacheMissesCount = 0;
+		r.evictionsCount   = 0;
+		r.bytesRead        = 0;
+		r.bytesWritten     = 0;
+		r.scanCacheHitsCount   = 0;
+		r.scanCacheMissesCount = 0;
+		r.warmUpPagesCount = pim->countOfWarmUpPages.exchange(0);
+		for (auto const & shard: pim->shards) {
+			Statistics const s = shard->readAndResetStatistics();
+			r.writesCount      += s.writesCount;
+			r.writesTimeMs     += s.writesTimeMs;
+			r.readsCount       += s.readsCount;
+			r.readsTimeMs      += s.readsTimeMs;
+			r.cacheHitsCount   += s.cacheHitsCount;
+			r.cacheMissesCount += s.cacheMissesCount;
+			r.evictionsCount   += s.evictionsCount;
+			r.bytesRead        += s.bytesRead;
+			r.bytesWritten     += s.bytesWritten;
+			r.scanCacheHitsCount   += s.scanCacheHitsCount;
+			r.scanCacheMissesCount += s.scanCacheMissesCount;
+		}
 		return r;
 	}
 
-}
 
+	std::vector<StorageWithCache::Statistics> StorageWithCache::readAndResetStatisticsOfShards()
+	{
+		std::vector<Statistics> r;
+		r.reserve(pim->shards.size());
+		for (auto const & shard: pim->shards) {
+			r.push_back(shard->readAndResetStatistics());
+		}
+		return r;
+	}
+
+}
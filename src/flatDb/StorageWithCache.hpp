@@ -5,15 +5,31 @@
 #include <vector>
 #include <map>
 
+class AsyncIo;
+class CacheBudget;
+class MemoryArena;
+
 namespace flatDb {
 
 	// class representing storage with cache
+	// pages are distributed between independently synchronized shards (pageId modulo number of shards),
+	// each shard manages its part of the cache memory with CLOCK replacement policy
+	// pages saved from the cache may be compressed (LZ4), the cache always holds decompressed pages
+	// admission: pages loaded from the storage are not marked as referenced, so they are evicted in the next turn of CLOCK hand
+	// if they are not accessed again, hits of range scans do not mark pages as referenced (scans cannot evict the hot pages)
 	class StorageWithCache
 	{
 	private:
 		struct Pim;
 		Pim * pim;
 	public:
+		// type of access to the page, it is used by the admission policy and statistics
+		enum class AccessType
+		{
+			  point             // reads and updates by keys
+			, scan              // range scans
+			, scanLowPriority   // range scans, loaded pages are evicted before all other pages (the cache is not polluted by long scans)
+		};
 		struct Statistics {
 			uint64_t synchCount;
 			uint64_t synchTimeMs;
@@ -21,14 +37,33 @@ namespace flatDb {
 			uint64_t writesTimeMs;
 			uint64_t readsCount;
 			uint64_t readsTimeMs;
+			uint64_t cacheHitsCount;
+			uint64_t cacheMissesCount;
+			uint64_t evictionsCount;
+			uint64_t bytesRead;      // bytes read from the file by cache operations (less than pages count * page size for compressed pages)
+			uint64_t bytesWritten;   // the same for writes
+			uint64_t scanCacheHitsCount;    // hits and misses of range scans, they are included in cacheHitsCount and cacheMissesCount
+			uint64_t scanCacheMissesCount;
+			uint64_t warmUpPagesCount;      // pages loaded by the warm-up
 		};
 		unsigned const pageSize;
+		bool const readOnly;
 
 		// ===== these methods are not synchronized
 
 		// file must be ready to use, given object is deleted in destructor
 		// all pages in file are marked as allocated
-		StorageWithCache(std::string const & path, unsigned pageSize, uint64_t cacheMemoryInMegabyte);
+		// shardsCount = 0 means default (calculated from the number of hardware threads and the cache size)
+		// asyncIo - optional queue for io_uring operations (pread/pwrite are used if it is not given or not supported)
+		// compressPages - pages saved from the cache are compressed, only compressed bytes are written, the rest of the page's place
+		// in the file is released (sparse file), compressed pages are always recognized when read, so the option may be changed anytime
+		// readOnly - the file must exist, it is mapped to memory and not modified, uncompressed pages are accessed by mappedPage()
+		// without the cache, compressed pages and pages read directly (readPages) go through the cache as usual
+		// cacheBudget - optional memory shared with other caches, cacheMemoryInMegabyte is the minimum size of the cache then
+		// arena - optional memory arena for buffers of pages shared with other caches (its slabs must have pageSize bytes),
+		// if it is not given, the cache has its own arena with transparent huge pages
+		StorageWithCache(std::string const & path, unsigned pageSize, uint64_t cacheMemoryInMegabyte, unsigned shardsCount = 0, AsyncIo * asyncIo = nullptr
+						, bool compressPages = false, bool readOnly = false, CacheBudget * cacheBudget = nullptr, MemoryArena * arena = nullptr);
 
 		~StorageWithCache();
 
@@ -38,6 +73,35 @@ namespace flatDb {
 		// returns file size as number of pages (including both allocated and free pages)
 		unsigned numberOfPages() const;
 
+		// returns the maximum number of pages in the cache
+		unsigned cacheSizeInPages() const;
+
+		// returns the arena with buffers of pages
+		MemoryArena const & memoryArena() const;
+
+		// ===== size of the cache managed by CacheBudget (synchronized)
+
+		// sets the maximum number of pages in the cache, unlocked pages above the limit are evicted at once, locked pages when
+		// they are unlocked, the cache counts misses of pages that were among the last ghostPagesCount evicted pages
+		void setCacheSizeInPages(unsigned pagesCount, unsigned ghostPagesCount);
+
+		// returns the number of misses of recently evicted pages (they would be hits if the cache were larger by ghostPagesCount)
+		uint64_t readAndResetGhostHitsCount();
+
+		// ===== warm-up of the cache after restart (synchronized)
+
+		// saves ids of pages in the cache to the file with path of the storage + ".hot" (referenced pages first)
+		// if the storage is not read-only, the list is also saved every minute by a background thread and in destructor
+		// (except during the warm-up)
+		void saveHotPages();
+
+		// starts the thread loading pages listed in the file saved by saveHotPages() (in the order of ids, with given rate),
+		// pages already in the cache are skipped, no pages are evicted by the warm-up, the thread is stopped in destructor
+		void startWarmUp(unsigned pagesPerSecond);
+
+		// returns the number of pages left to load by the warm-up
+		unsigned warmUpPagesLeft() const;
+
 		// ===== all methods below are synchronized, they can be called in many threads
 
 		// allocates given number of pages and returns vector of assigned pages ids, adjusts file size if needed
@@ -47,38 +111,66 @@ namespace flatDb {
 		// pages are unlocked first
 		void releasePages(std::vector<unsigned> pagesIds);
 
+		// allocates the page with given id, returns false if the page is not free
+		bool allocateGivenPage(unsigned pageId);
+
+		// removes free pages from the end of the file, returns the number of removed pages
+		unsigned truncateFreePages();
+
 		// tries to read page from cache (no IO operations are performed)
 		// returns true <=> the page is in the cache: the routine locks it and set the given pointer
 		// returns false <=> the page is not in the cache: the given pointer is set to nullptr
-		bool lockPage_loadFromCache(unsigned pageId, uint8_t*& outPagePtr);
+		bool lockPage_loadFromCache(unsigned pageId, uint8_t*& outPagePtr, AccessType accessType = AccessType::point);
+
+		// returns true <=> the page is in the cache (it is not locked and statistics are not changed)
+		bool isPageInCache(unsigned pageId);
 
 		// the routine locks the page in cache and set the given pointer
 		// the page is load from storage to cache, if it is not there (may block on IO)
 		// the function return false, if there is no more space in cache, the given pointer is set to nullptr
-		bool lockPage_loadFromStorage(unsigned pageId, uint8_t*& outPagePtr);
+		bool lockPage_loadFromStorage(unsigned pageId, uint8_t*& outPagePtr, AccessType accessType = AccessType::point);
 
 		// the routine locks the page in cache and set the given pointer
 		// the page is created in cache, if it is not there (no IO operations are performed)
+		// if pages are compressed, the buffer is filled with zeros (the unused part of the page is not saved)
 		void lockPage_createEmpty(unsigned pageId, uint8_t*& outPagePtr);
 
 		// save locked page to the storage
 		void savePageToStorage(unsigned pageId);
 
+		// save many locked pages to the storage, adjacent pages are written by single requests
+		void savePagesToStorage(std::vector<unsigned> const & pagesIds);
+
 		// release all locks on the page
 		// after calling this method, the page can be removed from cache in any moment
 		void unlockPage(unsigned pageId);
 
-		// read directly from storage to given buffer (cache is omitted)
+		// read directly from storage to given buffer (cache is omitted), pages are never compressed
 		void readPages(unsigned firstPageId, unsigned pagesCount, uint8_t* buffer);
 
-		// write directly from given buffer to storage (cache is omitted)
+		// write directly from given buffer to storage (cache is omitted), pages are never compressed
 		void writePages(unsigned firstPageId, unsigned pagesCount, uint8_t const* buffer);
 
+		// read/write single page directly (cache is omitted), the page is saved and read in the same way as pages from the cache
+		void readPageContent(unsigned pageId, uint8_t* buffer);
+		void writePageContent(unsigned pageId, uint8_t const* buffer);
+
+		// read-only mode only: returns pointer to the page in the memory mapping, the pointer is valid until the object is deleted
+		// returns nullptr if the page is compressed (it must be loaded to the cache)
+		// no locks are used, the page is loaded by the kernel on the first access
+		uint8_t const * mappedPage(unsigned pageId) const;
+
+		// read-only mode only: hint for the kernel that the page will be read soon (e.g. next pages of the range scan)
+		void adviseWillNeed(unsigned pageId) const;
+
 		// flush all new/modified pages to storage - it returns when everything is flushed
 		void flush();
 
-		// get statistics
+		// get statistics (sum from all shards)
 		StorageWithCache::Statistics readAndResetStatistics();
+
+		// get statistics for each shard separately (synchCount & synchTimeMs are not shard-specific and are set to 0)
+		std::vector<StorageWithCache::Statistics> readAndResetStatisticsOfShards();
 	};
 
 }
@@ -23,9 +23,47 @@ namespace flatDb {
 	}
 
 
+	// creates the view of the record saved in the data page (ptr points to the length of the record)
+	template<typename tKey>
+	static inline RecordViewT<tKey> createRecordView(tKey key, uint8_t const * ptr)
+	{
+		RecordViewT<tKey> view;
+		view.key = key;
+		view.length = readUnsignedIntVarSize<1,1,unsigned>(ptr);
+		view.data = ptr;
+		return view;
+	}
+
+
+	template<typename tKey>
+	void SubProcedureReadRecordsByKeysT<tKey>::processRaw(std::vector<std::pair<tKey,uint8_t const *>> const & data)
+	{
+		auto iD = data.begin();
+		auto compDataElementToKey = [](std::pair<tKey,uint8_t const*> const& e, tKey const& k)->bool{ return (e.first<k); };
+		std::vector<RecordViewT<tKey>> dbTemp;
+		for (tKey const key: fKeys) {
+			// ----- get records range from DB
+			dbTemp.clear();
+			iD = std::lower_bound( iD, data.end(), key, compDataElementToKey );
+			for ( ;  iD != data.end() && iD->first == key;  ++iD ) dbTemp.push_back( createRecordView(key, iD->second) );
+			// ----- call callback
+			try {
+				fRawCallback(key, dbTemp);
+			} catch (std::exception const & e) {
+				// TODO - report bug
+				std::cerr << "Error durign raw read by key: " << e.what() << std::endl;
+			}
+		}
+	}
+
+
 	template<typename tKey>
 	void SubProcedureReadRecordsByKeysT<tKey>::process(std::vector<std::pair<tKey,uint8_t const *>> const & data)
 	{
+		if (fRawCallback) {
+			processRaw(data);
+			return;
+		}
 		auto iD = data.begin();
 		auto compDataElementToKey = [](std::pair<tKey,uint8_t const*> const& e, tKey const& k)->bool{ return (e.first<k); };
 		for  ( auto it = fRecords.begin();  it != fRecords.end();  ) {
@@ -71,9 +109,64 @@ namespace flatDb {
 	}
 
 
+	template<typename tKey>
+	bool SubProcedureUpdateRecordsByKeysT<tKey>::processRaw(std::vector<std::pair<tKey,uint8_t const *>> & data, tAllocateBufferFunction callAllocate)
+	{
+		std::vector<std::pair<tKey,uint8_t const *>> newData;
+		newData.reserve(data.size());
+
+		auto iD = data.begin();
+		auto compDataElementToKey = [](std::pair<tKey,uint8_t const*> const& e, tKey const& k)->bool{ return (e.first<k); };
+		// the length is saved before the data of the new record
+		auto allocate = [&callAllocate](unsigned length)->uint8_t*
+		{
+			uint8_t * ptr = callAllocate(lengthUnsignedIntVarSize<1,1,unsigned>(length) + length);
+			writeUnsignedIntVarSize<1,1,unsigned>(ptr, length);
+			return ptr;
+		};
+
+		bool hasChanges = false;
+		std::vector<RecordViewT<tKey>> dbTemp;
+		for (tKey const key: fKeys) {
+			// ----- get records range from DB
+			dbTemp.clear();
+			auto iDprevBegin = iD;
+			auto iDprevEnd = iD = std::lower_bound( iD, data.end(), key, compDataElementToKey );
+			for ( ;  iD != data.end() && iD->first == key;  ++iD ) dbTemp.push_back( createRecordView(key, iD->second) );
+			// ----- call callback
+			bool wasUpdated = false;
+			try {
+				wasUpdated = fRawCallback(key, dbTemp, allocate);
+			} catch (std::exception const & e) {
+				// TODO - report bug
+				std::cerr << "Error durign raw write by key: " << e.what() << std::endl;
+			}
+			if ( wasUpdated ) {
+				// views point to the data (old or new one), the length is saved just before it
+				hasChanges = true;
+				newData.insert(newData.end(), iDprevBegin, iDprevEnd);
+				for (auto const & v: dbTemp) {
+					ASSERT(v.key == key);
+					newData.push_back( std::make_pair(key, v.data - lengthUnsignedIntVarSize<1,1,unsigned>(v.length)) );
+				}
+			} else {
+				newData.insert(newData.end(), iDprevBegin, iD);
+			}
+		}
+		if (hasChanges) {
+			// ----- copy the rest of untouched records
+			newData.insert(newData.end(), iD, data.end());
+			// ----- replace data by new one
+			data.swap(newData);
+		}
+		return hasChanges;
+	}
+
+
 	template<typename tKey>
 	bool SubProcedureUpdateRecordsByKeysT<tKey>::process(std::vector<std::pair<tKey,uint8_t const *>> & data, tAllocateBufferFunction callAllocate)
 	{
+		if (fRawCallback) return processRaw(data, callAllocate);
 		std::vector<std::pair<tKey,uint8_t const *>> newData;
 		newData.reserve(data.size());
 
@@ -5,6 +5,7 @@
 #include <map>
 #include <vector>
 #include "../apiDb/db.hpp"
+#include "StorageWithCache.hpp"
 
 #include "../debug.hpp"
 
@@ -34,6 +35,8 @@ namespace flatDb {
 		virtual bool process(std::vector<std::pair<tKey,uint8_t const *>> & data, tAllocateBufferFunction callback) { throw std::logic_error("Not implemented"); } // TODO
 		// -----
 		virtual bool isReadOnly() const = 0;
+		// type of access to the data page, it is used by the cache
+		virtual StorageWithCache::AccessType accessType() const { return StorageWithCache::AccessType::point; }
 	};
 
 
@@ -44,11 +47,14 @@ namespace flatDb {
 		typedef RecordT<tKey> Record;
 		typedef ProcedureT<tKey> Procedure;
 		typedef SubProcedureT<tKey> SubProcedure;
+	private:
+		StorageWithCache::AccessType const fAccessType;
 	public:
-		SubProcedureReadRecordsFromRangeT(Procedure * owner)
-		: SubProcedure(owner, owner->priority) {}
+		SubProcedureReadRecordsFromRangeT(Procedure * owner, StorageWithCache::AccessType pAccessType)
+		: SubProcedure(owner, owner->priority), fAccessType(pAccessType) {}
 		void process(std::vector<std::pair<tKey,uint8_t const *>> const & data) override final;
 		bool isReadOnly() const override final { return true; }
+		StorageWithCache::AccessType accessType() const override final { return fAccessType; }
 	};
 
 
@@ -60,14 +66,26 @@ namespace flatDb {
 		typedef ProcedureT<tKey> Procedure;
 		typedef SubProcedureT<tKey> SubProcedure;
 	private:
+		// only one of callbacks is set, keys are sorted (there are no records in raw mode)
 		std::vector<Record*> fRecords;
+		std::vector<tKey> fKeys;
 		typename Record::tReadByKeyFunction fCallback;
+		typename Record::tReadRawByKeyFunction fRawCallback;
+		void processRaw(std::vector<std::pair<tKey,uint8_t const *>> const & data);
 	public:
 		SubProcedureReadRecordsByKeysT
 		(Procedure * owner, typename Record::tReadByKeyFunction callback, std::vector<Record*> & records)
-		: SubProcedure(owner, owner->priority), fRecords(records), fCallback(callback) {}
+		: SubProcedure(owner, owner->priority), fRecords(records), fCallback(callback)
+		{
+			fKeys.reserve(fRecords.size());
+			for (auto r: fRecords) fKeys.push_back(r->key);
+		}
+		SubProcedureReadRecordsByKeysT
+		(Procedure * owner, typename Record::tReadRawByKeyFunction callback, std::vector<tKey> & keys)
+		: SubProcedure(owner, owner->priority), fKeys(keys), fRawCallback(callback) {}
 		void process(std::vector<std::pair<tKey,uint8_t const *>> const & data) override final;
 		bool isReadOnly() const override final { return true; }
+		std::vector<tKey> const & keys() const { return fKeys; }
 	};
 
 
@@ -81,12 +99,19 @@ namespace flatDb {
 		typedef SubProcedureT<tKey> SubProcedure;
 		typedef std::function<uint8_t*(unsigned size)> tAllocateBufferFunction;
 	private:
+		// only one of callbacks is set, keys are sorted and unique (they are used in raw mode only)
 		std::vector<Record*> fRecords;
+		std::vector<tKey> fKeys;
 		typename Record::tUpdateByKeyFunction fCallback;
+		typename Record::tUpdateRawByKeyFunction fRawCallback;
+		bool processRaw(std::vector<std::pair<tKey,uint8_t const *>> & data, tAllocateBufferFunction callback);
 	public:
 		SubProcedureUpdateRecordsByKeysT
 		(Procedure * owner, typename Record::tUpdateByKeyFunction callback, std::vector<Record*> & records)
 		: SubProcedure(owner, owner->priority), fRecords(records), fCallback(callback) {}
+		SubProcedureUpdateRecordsByKeysT
+		(Procedure * owner, typename Record::tUpdateRawByKeyFunction callback, std::vector<tKey> & keys)
+		: SubProcedure(owner, owner->priority), fKeys(keys), fRawCallback(callback) {}
 		bool process(std::vector<std::pair<tKey,uint8_t const *>> & data, tAllocateBufferFunction callback) override final;
 		bool isReadOnly() const override final { return false; }
 	};
@@ -1,123 +1,252 @@
 #include "../apiDb/TasksManager.hpp"
-#include <list>
-#include <unordered_map>
+#include <algorithm>
+#include <deque>
+#include <unordered_set>
 #include <map>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include "../debug.hpp"
 
+	typedef std::chrono::steady_clock Clock;
+
+	static inline void updateMax(std::atomic<uint64_t> & maxValue, uint64_t value)
+	{
+		uint64_t current = maxValue.load();
+		while (current < value && ! maxValue.compare_exchange_weak(current, value));
+	}
+
 	struct TasksManager::Pim {
 
 		struct Task {
 			std::function<void()> call;
-			unsigned priority;
-			std::list<unsigned>::const_iterator iter;
+			unsigned taskId;
+			Clock::time_point addTime;
+		};
+
+		struct Worker {
+			std::mutex access;
+			std::map<unsigned, std::deque<Task>, std::greater<unsigned>> lanes; // priority -> queue of tasks
+			std::atomic<uint64_t> topPriority;  // the highest priority in lanes + 1, 0 means no tasks
+			std::thread thread;
+			Worker() : topPriority(0) {}
+			void updateTopPriority()
+			{
+				topPriority = (lanes.empty()) ? 0 : (lanes.begin()->first + uint64_t(1));
+			}
+		};
+
+		// set of unfinished tasks is divided into parts to reduce contention
+		struct UnfinishedTasks {
+			std::mutex access;
+			std::condition_variable taskCompleted;
+			std::unordered_set<unsigned> ids;
 		};
+		static unsigned const unfinishedTasksPartsCount = 16;
+
+		std::vector<std::unique_ptr<Worker>> workers;
+		UnfinishedTasks unfinishedTasks[unfinishedTasksPartsCount];
+		std::atomic<unsigned> unfinishedTasksCount;
+		std::atomic<unsigned> lastTaskId;
+		std::atomic<unsigned> nextWorker;
+		std::atomic<uint64_t> queueDepth;
+		// ---- idle workers
+		std::mutex idleAccess;
+		std::condition_variable idleCondition;
+		std::atomic<unsigned> idleWorkersCount;
+		bool stop = false;
+		// ---- measurements
+		std::atomic<uint64_t> countOfTasks;
+		std::atomic<uint64_t> countOfStolenTasks;
+		std::atomic<uint64_t> maxQueueDepth;
+		std::atomic<uint64_t> timeOfWaitingUs;
+		std::atomic<uint64_t> maxTimeOfWaitingUs;
+		std::atomic<uint64_t> timeOfExecutionUs;
+
+		Pim()
+		: unfinishedTasksCount(0), lastTaskId(0), nextWorker(0), queueDepth(0), idleWorkersCount(0)
+		, countOfTasks(0), countOfStolenTasks(0), maxQueueDepth(0), timeOfWaitingUs(0), maxTimeOfWaitingUs(0), timeOfExecutionUs(0)
+		{}
 
-		std::mutex access;
-		unsigned maxNumberOfExecutedTasks;
-		unsigned currentNumberOfExecutedTasks;
-		unsigned lastTaskId;
-		std::map<unsigned, std::list<unsigned>, std::greater<unsigned>> tasksQueue; // priority -> queue of taskId
-		std::unordered_map<unsigned,Task> tasksById;
+		// index of the worker running in the current thread, it is set only in threads of workers
+		static thread_local Pim * currentPim;
+		static thread_local unsigned currentWorker;
 
-		void processTask(std::function<void()> task)
+		void pushTask(unsigned workerId, Task && task, unsigned priority)
+		{
+			Worker & w = *(workers[workerId]);
+			{
+				std::lock_guard<std::mutex> synch_access(w.access);
+				// the counter is incremented before the task is visible to other workers, so it never goes below zero
+				updateMax(maxQueueDepth, ++queueDepth);
+				w.lanes[priority].push_back(std::move(task));
+				w.updateTopPriority();
+			}
+			if (idleWorkersCount > 0) {
+				{ std::lock_guard<std::mutex> synch_access(idleAccess); }
+				idleCondition.notify_one();
+			}
+		}
+
+		// takes the task with the highest priority, own queue is preferred when priorities are the same
+		// the task is taken from the front of own queue or from the back of another worker's queue
+		bool popTask(unsigned workerId, Task & task)
 		{
 			while (true) {
-				task();
-				{
-					std::lock_guard<std::mutex> synch_access(access);
-					// ===== exit if there is not tasks to process
-					if (tasksQueue.empty()) {
-						--currentNumberOfExecutedTasks;
-						return; // end of thread
+				unsigned selected = workerId;
+				uint64_t selectedPriority = workers[workerId]->topPriority;
+				for (unsigned i = 1; i < workers.size(); ++i) {
+					unsigned const id = (workerId + i) % workers.size();
+					uint64_t const priority = workers[id]->topPriority;
+					if (priority > selectedPriority) {
+						selected = id;
+						selectedPriority = priority;
 					}
-					// ===== get tasks ID to process and remove it from the queue
-					unsigned const taskId = tasksQueue.begin()->second.front();
-					tasksQueue.begin()->second.pop_front();
-					if (tasksQueue.begin()->second.empty()) {
-						tasksQueue.erase(tasksQueue.begin());
-					}
-					// ===== get callback and remove task
-					task = tasksById[taskId].call;
-					tasksById.erase(taskId);
 				}
+				if (selectedPriority == 0) return false;
+				Worker & w = *(workers[selected]);
+				std::lock_guard<std::mutex> synch_access(w.access);
+				if (w.lanes.empty()) continue;  // somebody was faster
+				std::deque<Task> & lane = w.lanes.begin()->second;
+				if (selected == workerId) {
+					task = std::move(lane.front());
+					lane.pop_front();
+				} else {
+					task = std::move(lane.back());
+					lane.pop_back();
+					++countOfStolenTasks;
+				}
+				if (lane.empty()) w.lanes.erase(w.lanes.begin());
+				w.updateTopPriority();
+				--queueDepth;
+				return true;
+			}
+		}
+
+		void completeTask(unsigned taskId)
+		{
+			UnfinishedTasks & u = unfinishedTasks[taskId % unfinishedTasksPartsCount];
+			{
+				std::lock_guard<std::mutex> synch_access(u.access);
+				u.ids.erase(taskId);
+			}
+			u.taskCompleted.notify_all();
+			--unfinishedTasksCount;
+		}
+
+		void processTasks(unsigned workerId)
+		{
+			currentPim = this;
+			currentWorker = workerId;
+			Task task;
+			while (true) {
+				if ( ! popTask(workerId, task) ) {
+					std::unique_lock<std::mutex> synch_access(idleAccess);
+					if (stop) return; // end of thread
+					++idleWorkersCount;
+					if (queueDepth == 0) idleCondition.wait(synch_access);
+					--idleWorkersCount;
+					continue;
+				}
+				Clock::time_point const startTime = Clock::now();
+				uint64_t const waitTime = std::chrono::duration_cast<std::chrono::microseconds>(startTime - task.addTime).count();
+				timeOfWaitingUs += waitTime;
+				updateMax(maxTimeOfWaitingUs, waitTime);
+				++countOfTasks;
+				task.call();
+				task.call = nullptr;
+				timeOfExecutionUs += std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - startTime).count();
+				completeTask(task.taskId);
 			}
 		}
 	};
 
+	thread_local TasksManager::Pim * TasksManager::Pim::currentPim = nullptr;
+	thread_local unsigned TasksManager::Pim::currentWorker = 0;
+
 
 	TasksManager::TasksManager(unsigned pMaxNumberOfConcurrentTasks)
 	: pim(new Pim), maxNumberOfConcurrentTasks(pMaxNumberOfConcurrentTasks)
 	{
-		pim->maxNumberOfExecutedTasks = pMaxNumberOfConcurrentTasks;
-		pim->currentNumberOfExecutedTasks = 0;
-		pim->lastTaskId = 0;
+		unsigned const workersCount = std::max(1u, pMaxNumberOfConcurrentTasks);
+		for (unsigned i = 0; i < workersCount; ++i) {
+			pim->workers.emplace_back(new Pim::Worker);
+		}
+		for (unsigned i = 0; i < workersCount; ++i) {
+			pim->workers[i]->thread = std::thread(&Pim::processTasks, pim, i);
+		}
 	}
 
 
 	TasksManager::~TasksManager()
 	{
-		while (true) {
-			{
-				std::lock_guard<std::mutex> synch_access(pim->access);
-				if (pim->currentNumberOfExecutedTasks == 0) break;
-			}
+		while (pim->unfinishedTasksCount > 0) {
 			std::this_thread::yield();
 		}
+		{
+			std::lock_guard<std::mutex> synch_access(pim->idleAccess);
+			pim->stop = true;
+		}
+		pim->idleCondition.notify_all();
+		for (auto & w: pim->workers) w->thread.join();
 		delete pim;
 	}
 
 
 	unsigned TasksManager::addTask(std::function<void()> task, unsigned priority)
 	{
-		unsigned taskId;
+		Pim::Task obj;
+		obj.call = task;
+		obj.taskId = ++(pim->lastTaskId);
+		obj.addTime = Clock::now();
+		++(pim->unfinishedTasksCount);
 		{
-			std::lock_guard<std::mutex> synch_access(pim->access);
-			taskId = ++(pim->lastTaskId);
-			if (pim->currentNumberOfExecutedTasks >= pim->maxNumberOfExecutedTasks) {
-				Pim::Task & obj = pim->tasksById[taskId];
-				obj.call = task;
-				obj.priority = priority;
-				pim->tasksQueue[priority].push_back(taskId);
-				obj.iter = pim->tasksQueue[priority].end();
-				--(obj.iter);
-				return taskId;
-			}
-			++(pim->currentNumberOfExecutedTasks);
+			Pim::UnfinishedTasks & u = pim->unfinishedTasks[obj.taskId % Pim::unfinishedTasksPartsCount];
+			std::lock_guard<std::mutex> synch_access(u.access);
+			u.ids.insert(obj.taskId);
 		}
-		std::thread worker(&Pim::processTask, pim, task);
-		worker.detach();
+		// tasks created by a worker are added to its own queue
+		unsigned const workerId = (Pim::currentPim == pim) ? Pim::currentWorker : (pim->nextWorker++ % pim->workers.size());
+		unsigned const taskId = obj.taskId;
+		pim->pushTask(workerId, std::move(obj), priority);
 		return taskId;
 	}
 
 
-//	void TasksManager::updatePriority(unsigned taskId, unsigned priority)
-//	{
-//		std::lock_guard<std::mutex> synch_access(pim->access);
-//		auto it = pim->tasksById.find(taskId);
-//		if ( it == pim->tasksById.end() || it->second.priority == priority ) return;
-//		std::list<unsigned> & newQueue = pim->tasksQueue[priority];
-//		std::list<unsigned> & oldQueue = pim->tasksQueue[it->second.priority];
-//		it->second.priority = priority;
-//		newQueue.splice( newQueue.end(), oldQueue, it->second.iter );
-//	}
+	void TasksManager::joinTask(unsigned taskId)
+	{
+		Pim::UnfinishedTasks & u = pim->unfinishedTasks[taskId % Pim::unfinishedTasksPartsCount];
+		std::unique_lock<std::mutex> synch_access(u.access);
+		while (u.ids.count(taskId)) {
+			u.taskCompleted.wait(synch_access);
+		}
+	}
 
 
-	void TasksManager::joinTask(unsigned taskId)
+	TasksManager::Statistics TasksManager::readAndResetStatistics()
 	{
-		// TODO - is it needed ?
-//		std::unique_lock<std::mutex> synch_access(pim->access);
-//		while (pim->numberOfSubtaskForTask.count(taskId)) {
-//			pim->waitingForTask.wait(synch_access);
-//		}
+		Statistics r;
+		r.tasksCount       = pim->countOfTasks.exchange(0);
+		r.stolenTasksCount = pim->countOfStolenTasks.exchange(0);
+		r.queueDepth       = pim->queueDepth;
+		r.maxQueueDepth    = pim->maxQueueDepth.exchange(0);
+		r.waitTimeUs       = pim->timeOfWaitingUs.exchange(0);
+		r.maxWaitTimeUs    = pim->maxTimeOfWaitingUs.exchange(0);
+		r.executionTimeUs  = pim->timeOfExecutionUs.exchange(0);
+		return r;
 	}
 
+
 	void TasksManager::printState()
 	{
-		std::lock_guard<std::mutex> synch_access(pim->access);
-		DebugVar(pim->currentNumberOfExecutedTasks);
-		DebugVar(pim->tasksQueue.size());
-		DebugVar(pim->tasksById.size());
+		DebugVar(pim->workers.size());
+		DebugVar(pim->unfinishedTasksCount);
+		DebugVar(pim->queueDepth);
+		DebugVar(pim->idleWorkersCount);
+		DebugVar(pim->countOfTasks);
+		DebugVar(pim->countOfStolenTasks);
 	}
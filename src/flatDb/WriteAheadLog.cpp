@@ -0,0 +1,389 @@
+#include "../apiDb/WriteAheadLog.hpp"
+#include "../commonTools/bytesLevel.hpp"
+#include <map>
+#include <algorithm>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <cstring>
+#include <stdexcept>
+#include <iostream>
+#include <condition_variable>
+// -------- low level file access
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+	// file header: magic(8), generation(4), CRC32(4)
+	// record: length(4), CRC32(4), generation(4), type(1), databaseId(4), revision(4), pageId(4), data
+	// records with type = databaseName declare the name of database with given id (it is done each time the database is attached)
+	// records appended after the last record with type = commit are ignored
+	// the log is truncated by saving the header with the next generation, records from previous generations are ignored
+	static char const headerMagic[8] = { 'f','l','a','t','D','b','W','L' };
+	static unsigned const headerSize = 16;
+	static unsigned const recordHeaderSize = 25;
+	static uint8_t const recordTypeDatabaseName = 0;
+	static uint8_t const recordTypeCommit = 255;
+
+
+	struct WriteAheadLog::Pim
+	{
+		std::string path;
+		int file = -1;
+		uint64_t maxSize;
+		unsigned generation = 0;
+		// ----- appends are blocked during commit, commit waits until all appends are finished
+		std::mutex appendersAccess;
+		std::condition_variable appendersWait;
+		unsigned appendersCount = 0;
+		bool commitInProgress = false;
+		std::mutex fileAccess;         // synchronizes writes at the end of the log
+		uint64_t fileSize = 0;
+		uint64_t fileSizeAfterLastCommit = 0;
+		std::map<Database*,unsigned> databasesIds;
+		std::map<Database*,std::string> databasesNames;
+		// committed records read from the log, they are kept until databases are attached
+		struct RecordLocation {
+			uint8_t type;
+			unsigned revision;
+			unsigned pageId;
+			uint64_t offset;  // data offset
+			unsigned length;  // data length
+		};
+		std::map<std::string,std::vector<RecordLocation>> recordsToReplay;
+		bool warningAboutNotAttachedDatabases = false;
+
+		// blocks appenders until the end of the scope
+		class ExclusiveAccess
+		{
+		private:
+			Pim * pim;
+		public:
+			ExclusiveAccess(Pim * p) : pim(p)
+			{
+				std::unique_lock<std::mutex> synchAccess(pim->appendersAccess);
+				pim->appendersWait.wait( synchAccess, [this]()->bool{return ! this->pim->commitInProgress;} );
+				pim->commitInProgress = true;
+				pim->appendersWait.wait( synchAccess, [this]()->bool{return this->pim->appendersCount == 0;} );
+			}
+			~ExclusiveAccess()
+			{
+				{
+					std::lock_guard<std::mutex> synchAccess(pim->appendersAccess);
+					pim->commitInProgress = false;
+				}
+				pim->appendersWait.notify_all();
+			}
+		};
+
+		void throw_error(std::string const & msg)
+		{
+			throw std::runtime_error("A problem occurred for the file " + path + ". " + msg);
+		}
+		void throw_error(std::string const & msg, int const errnum)
+		{
+			char const * buf = strerror(errnum);
+			if (buf == nullptr) throw_error(msg);
+			throw_error(msg + std::string(buf));
+		}
+		void writeToFile(uint64_t offset, void const * buf, uint64_t size)
+		{
+			while (size > 0) {
+				ssize_t const result = pwrite(file, buf, size, offset);
+				if ( result < 0 ) throw_error("Cannot write to the file: ", errno);
+				offset += result;
+				size -= result;
+				buf = static_cast<uint8_t const *>(buf) + result;
+			}
+		}
+		// returns false if there is not enough data in the file
+		bool readFromFile(uint64_t offset, void * buf, uint64_t size)
+		{
+			while (size > 0) {
+				ssize_t const result = pread(file, buf, size, offset);
+				if ( result < 0 ) throw_error("Cannot read() on the file: ", errno);
+				if ( result == 0 ) return false;
+				offset += result;
+				size -= result;
+				buf = static_cast<uint8_t*>(buf) + result;
+			}
+			return true;
+		}
+		void synchronize()
+		{
+			if ( fdatasync(file) != 0 ) throw_error("fdatasync() failed: ", errno);
+		}
+		void writeHeader()
+		{
+			uint8_t buf[headerSize];
+			uint8_t * ptr = buf;
+			std::memcpy(ptr, headerMagic, 8);
+			ptr += 8;
+			writeUnsignedInteger<4>(ptr, generation);
+			writeUnsignedInteger<4>(ptr, CRC32(buf, 12));
+			writeToFile(0, buf, headerSize);
+		}
+		// must be called with locked fileAccess
+		void appendRecord(uint8_t type, unsigned databaseId, unsigned revision, unsigned pageId, void const * data, unsigned length)
+		{
+			std::vector<uint8_t> buf(recordHeaderSize + length);
+			uint8_t * ptr = buf.data();
+			writeUnsignedInteger<4>(ptr, buf.size());
+			ptr += 4;  // CRC32
+			writeUnsignedInteger<4>(ptr, generation);
+			writeUnsignedInteger<1>(ptr, type);
+			writeUnsignedInteger<4>(ptr, databaseId);
+			writeUnsignedInteger<4>(ptr, revision);
+			writeUnsignedInteger<4>(ptr, pageId);
+			if (length) std::memcpy(ptr, data, length);
+			ptr = buf.data() + 4;
+			writeUnsignedInteger<4>(ptr, CRC32(buf.data() + 8, buf.size() - 8));
+			writeToFile(fileSize, buf.data(), buf.size());
+			fileSize += buf.size();
+		}
+		void appendDatabaseName(unsigned databaseId, std::string const & name)
+		{
+			appendRecord(recordTypeDatabaseName, databaseId, 0, 0, name.data(), name.size());
+		}
+		// reads records of the log with given size, committed records are saved in recordsToReplay
+		// returns the offset after the last commit record
+		uint64_t readRecords(uint64_t const size)
+		{
+			// ----- header
+			uint8_t header[headerSize];
+			if ( ! readFromFile(0, header, headerSize) ) throw_error("Incorrect header of the write-ahead log");
+			uint8_t const * ptr = header + 8;
+			generation = readUnsignedInteger<4,unsigned>(ptr);
+			if ( std::memcmp(header, headerMagic, 8) != 0 || readUnsignedInteger<4,unsigned>(ptr) != CRC32(header, 12) ) {
+				throw_error("Incorrect header of the write-ahead log");
+			}
+			// ----- records
+			std::map<unsigned,std::string> names;
+			std::vector<std::pair<unsigned,RecordLocation>> notCommitted;  // database id, record
+			uint64_t offset = headerSize;
+			uint64_t offsetAfterLastCommit = offset;
+			std::vector<uint8_t> record;
+			while (true) {
+				uint8_t recordHeader[recordHeaderSize];
+				if ( ! readFromFile(offset, recordHeader, recordHeaderSize) ) break;
+				uint8_t const * ptr = recordHeader;
+				unsigned const length = readUnsignedInteger<4,unsigned>(ptr);
+				unsigned const crc32 = readUnsignedInteger<4,unsigned>(ptr);
+				if (length < recordHeaderSize || offset + length > size) break;
+				record.resize(length);
+				if ( ! readFromFile(offset, record.data(), length) ) break;
+				if ( crc32 != CRC32(record.data() + 8, length - 8) ) break;
+				if ( readUnsignedInteger<4,unsigned>(ptr) != generation ) break;
+				RecordLocation r;
+				r.type = readUnsignedInteger<1,uint8_t>(ptr);
+				unsigned const databaseId = readUnsignedInteger<4,unsigned>(ptr);
+				r.revision = readUnsignedInteger<4,unsigned>(ptr);
+				r.pageId = readUnsignedInteger<4,unsigned>(ptr);
+				r.offset = offset + recordHeaderSize;
+				r.length = length - recordHeaderSize;
+				offset += length;
+				if (r.type == recordTypeDatabaseName) {
+					names[databaseId] = std::string(record.begin() + recordHeaderSize, record.end());
+				} else if (r.type == recordTypeCommit) {
+					for (auto const & kv: notCommitted) {
+						auto it = names.find(kv.first);
+						if (it == names.end()) throw_error("Unknown database id in the write-ahead log");
+						recordsToReplay[it->second].push_back(kv.second);
+					}
+					notCommitted.clear();
+					offsetAfterLastCommit = offset;
+				} else {
+					notCommitted.push_back(std::make_pair(databaseId,r));
+				}
+			}
+			return offsetAfterLastCommit;
+		}
+		uint64_t sizeOfFile()
+		{
+			struct stat buf;
+			if (fstat(file,&buf) != 0) throw_error("Cannot check the size of the file. Error returned by fstat(): ", errno);
+			return buf.st_size;
+		}
+		// reads the log, committed records are saved in recordsToReplay, the rest is removed
+		void load()
+		{
+			uint64_t const size = sizeOfFile();
+			if (size == 0) {
+				// ----- new log
+				generation = 1;
+				writeHeader();
+				synchronize();
+				fileSize = fileSizeAfterLastCommit = headerSize;
+				return;
+			}
+			uint64_t const offsetAfterLastCommit = readRecords(size);
+			// ----- remove not committed records
+			if (offsetAfterLastCommit < size) {
+				if ( ftruncate64(file, offsetAfterLastCommit) != 0 ) throw_error("ftruncate64() failed: ", errno);
+				synchronize();
+			}
+			fileSize = fileSizeAfterLastCommit = offsetAfterLastCommit;
+		}
+		// group commit of appended records, the checkpoint is saved if the log is too large or if it is forced
+		void commit(bool forceCheckpoint)
+		{
+			ExclusiveAccess synchAccess(this);
+			std::lock_guard<std::mutex> synchAccess2(fileAccess);
+			if (fileSize == fileSizeAfterLastCommit && ! forceCheckpoint) return;  // nothing to commit
+
+			// ===== group commit
+			if (fileSize != fileSizeAfterLastCommit) {
+				appendRecord(recordTypeCommit, 0, 0, 0, nullptr, 0);
+				synchronize();
+				fileSizeAfterLastCommit = fileSize;
+				for (auto const & kv: databasesIds) kv.first->afterCommit();
+			}
+
+			// ===== checkpoint
+			if (fileSize <= maxSize && ! forceCheckpoint) return;
+			if ( ! recordsToReplay.empty() ) {
+				// records of some databases were not replayed yet, the log cannot be truncated
+				if ( ! warningAboutNotAttachedDatabases ) {
+					std::cerr << "WARNING: the write-ahead log " << path << " cannot be truncated, because it contains records of not attached databases" << std::endl;
+					warningAboutNotAttachedDatabases = true;
+				}
+				return;
+			}
+			for (auto const & kv: databasesIds) kv.first->checkpoint();
+			++generation;
+			writeHeader();
+			fileSize = headerSize;
+			for (auto const & kv: databasesIds) appendDatabaseName(kv.second, databasesNames[kv.first]);
+			if ( ftruncate64(file, fileSize) != 0 ) throw_error("ftruncate64() failed: ", errno);
+			if ( fsync(file) != 0 ) throw_error("fsync() failed: ", errno);
+			fileSizeAfterLastCommit = fileSize;
+		}
+		unsigned nextDatabaseId() const
+		{
+			unsigned id = 0;
+			for (auto const & kv: databasesIds) id = std::max(id, kv.second + 1);
+			return id;
+		}
+	};
+
+
+	WriteAheadLog::WriteAheadLog(std::string const & path, unsigned checkpointSizeInMegabytes) : pim(new Pim)
+	{
+		std::unique_ptr<Pim> scopedPtr(pim);
+		pim->path = path;
+		pim->maxSize = static_cast<uint64_t>(checkpointSizeInMegabytes) * 1024 * 1024;
+		pim->file = open(path.c_str(), O_RDWR | O_CREAT | O_NOATIME, S_IRUSR | S_IWUSR );
+		if (pim->file < 0) {
+			int errnum = errno;
+			pim->throw_error("Cannot open the file. Error returned by open(): ", errnum);
+		}
+		if (flock(pim->file, LOCK_EX | LOCK_NB ) != 0) {
+			int errnum = errno;
+			close(pim->file);
+			pim->throw_error("Cannot lock the file. Error returned by flock(): ", errnum);
+		}
+		try {
+			pim->load();
+		} catch (...) {
+			close(pim->file);
+			throw;
+		}
+		scopedPtr.release();
+	}
+
+
+	WriteAheadLog::~WriteAheadLog()
+	{
+		close(pim->file);
+		delete pim;
+	}
+
+
+	bool WriteAheadLog::hasCommittedChanges(std::string const & path)
+	{
+		Pim pim;
+		pim.path = path;
+		pim.file = open(path.c_str(), O_RDONLY | O_NOATIME);
+		if (pim.file < 0) {
+			int errnum = errno;
+			if (errnum == ENOENT) return false;
+			pim.throw_error("Cannot open the file. Error returned by open(): ", errnum);
+		}
+		try {
+			uint64_t const size = pim.sizeOfFile();
+			if (size > 0) pim.readRecords(size);
+		} catch (...) {
+			close(pim.file);
+			throw;
+		}
+		close(pim.file);
+		return ! pim.recordsToReplay.empty();
+	}
+
+
+	void WriteAheadLog::attachDatabase(std::string const & name, Database * db, tReplayFunction replay)
+	{
+		Pim::ExclusiveAccess synchAccess(pim);
+		for (auto const & kv: pim->databasesNames) {
+			if (kv.second == name) pim->throw_error("The database " + name + " is already attached to the write-ahead log");
+		}
+		// ----- replay committed records
+		auto it = pim->recordsToReplay.find(name);
+		if (it != pim->recordsToReplay.end()) {
+			std::vector<uint8_t> data;
+			for (auto const & r: it->second) {
+				data.resize(r.length);
+				if ( ! pim->readFromFile(r.offset, data.data(), r.length) ) pim->throw_error("Unexpected end of the write-ahead log");
+				replay(static_cast<RecordType>(r.type), r.revision, r.pageId, data.data(), r.length);
+			}
+			pim->recordsToReplay.erase(it);
+		}
+		// ----- assign id
+		std::lock_guard<std::mutex> synchAccess2(pim->fileAccess);
+		unsigned const id = pim->nextDatabaseId();
+		pim->databasesIds[db] = id;
+		pim->databasesNames[db] = name;
+		pim->appendDatabaseName(id, name);
+	}
+
+
+	void WriteAheadLog::beginAppend()
+	{
+		std::unique_lock<std::mutex> synchAccess(pim->appendersAccess);
+		pim->appendersWait.wait( synchAccess, [this]()->bool{return ! this->pim->commitInProgress;} );
+		++(pim->appendersCount);
+	}
+
+
+	void WriteAheadLog::endAppend()
+	{
+		{
+			std::lock_guard<std::mutex> synchAccess(pim->appendersAccess);
+			if (--(pim->appendersCount) > 0) return;
+		}
+		pim->appendersWait.notify_all();
+	}
+
+
+	void WriteAheadLog::append(Database * db, RecordType type, unsigned revision, unsigned pageId, void const * data, unsigned length)
+	{
+		std::lock_guard<std::mutex> synchAccess(pim->fileAccess);
+		auto it = pim->databasesIds.find(db);
+		if (it == pim->databasesIds.end()) throw std::logic_error("WriteAheadLog::append(): database is not attached");
+		pim->appendRecord(static_cast<uint8_t>(type), it->second, revision, pageId, data, length);
+	}
+
+
+	void WriteAheadLog::commit()
+	{
+		pim->commit(false);
+	}
+
+
+	void WriteAheadLog::checkpoint()
+	{
+		pim->commit(true);
+	}
@@ -4,7 +4,9 @@
 #include <cstdint>
 #include <limits>
 #include <vector>
+#include <cstring>
 #include "../commonTools/bytesLevel.hpp"
+#include "Lz4.hpp"
 
 unsigned const dataPageSize  =    256*1024;
 unsigned const indexPageSize = 2*1024*1024;
@@ -28,6 +30,7 @@ struct IndexNode
 
 IndexNode readPage(uint8_t const * ptr, unsigned const keySize)
 {
+	uint8_t const * const pageBegin = ptr;
 	unsigned crc32 = readUnsignedInteger<unsigned>(ptr,4);
 	unsigned realCrc32 = CRC32(ptr, indexPageSize-4);
 	IndexNode indexNode;
@@ -52,6 +55,13 @@ IndexNode readPage(uint8_t const * ptr, unsigned const keySize)
 			indexNode.entries.push_back(e);
 			std::cout << "bin\t" << i << "\t[" << e.firstKey << "," << e.lastKey << "]\t" << e.recordsCount << "\t" << e.bytesCount << "\tpageId=" << e.pageId << "\n";
 		}
+		// location of the journal with changes committed after this page (zeros = no journal)
+		ptr = pageBegin + indexPageSize - 8;
+		unsigned const journalFirstPageId = readUnsignedInteger<unsigned>(ptr,4);
+		unsigned const journalPagesCount = readUnsignedInteger<unsigned>(ptr,4);
+		if (journalPagesCount > 0 && indexNode.entries.size() < maxRecordNumber) {
+			std::cout << "journal: firstPageId=" << journalFirstPageId << " pagesCount=" << journalPagesCount << "\n";
+		}
 	}
 
 	std::cout << "===================" << std::endl;
@@ -98,10 +108,23 @@ int main(int argc, char** argv)
 		IndexNodeEntry & e = in1.entries[binIndex];
 		unsigned const bytesPerKey = (neededBits(e.lastKey - e.firstKey)-1) / 8 + 1;
 
-		file.seekg(e.pageId * dataPageSize);
+		file.seekg(e.pageId * static_cast<uint64_t>(dataPageSize));
 		file.read(buf, dataPageSize);
 		ptr = reinterpret_cast<uint8_t*>(buf);
 
+		// compressed page: magic number (8 bytes), compressed size (4 bytes), content size (4 bytes), LZ4 data (see StorageWithCache.cpp)
+		if (std::memcmp(buf, "\xf1" "flatLZ\x01", 8) == 0) {
+			uint8_t const * header = ptr + 8;
+			unsigned const compressedSize = readUnsignedInteger<4,unsigned>(header);
+			unsigned const contentSize = readUnsignedInteger<4,unsigned>(header);
+			if ( compressedSize > dataPageSize - 16 || contentSize > dataPageSize
+					|| ! flatDb::decompressLz4(header, compressedSize, reinterpret_cast<uint8_t*>(buf + dataPageSize), contentSize) ) {
+				std::cerr << "Incorrect compressed page!" << std::endl;
+				return 3;
+			}
+			ptr = reinterpret_cast<uint8_t*>(buf + dataPageSize);
+		}
+
 		for ( unsigned iR = 0;  iR < e.recordsCount;  ++iR ) {
 			unsigned long long const key = e.firstKey + readUnsignedInteger<unsigned long long>(ptr, bytesPerKey);
 			unsigned const recordSize = readUnsignedIntVarSize<1,1,unsigned>(ptr);
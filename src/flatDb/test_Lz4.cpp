@@ -0,0 +1,67 @@
+#include "Lz4.hpp"
+#include "../commonTools/Stopwatch.hpp"
+#include <vector>
+#include <random>
+#include <string>
+#include <stdexcept>
+#include <iostream>
+
+
+void test_roundTrip(std::string const & name, std::vector<uint8_t> const & data)
+{
+	std::vector<uint8_t> compressed(data.size() + data.size() / 255 + 16);
+	std::vector<uint8_t> decompressed(data.size() + 1);
+	Stopwatch timer;
+	unsigned const size = flatDb::compressLz4(data.data(), data.size(), compressed.data(), compressed.size());
+	if (size == 0) throw std::logic_error(name + ": the data was not compressed");
+	if ( ! flatDb::decompressLz4(compressed.data(), size, decompressed.data(), data.size()) ) throw std::logic_error(name + ": decompression failed");
+	if ( ! std::equal(data.begin(), data.end(), decompressed.begin()) ) throw std::logic_error(name + ": decompressed data do not match");
+	// incorrect size of the output
+	if (data.size() > 0 && flatDb::decompressLz4(compressed.data(), size, decompressed.data(), data.size() - 1)) throw std::logic_error(name + ": too small buffer was accepted");
+	if (flatDb::decompressLz4(compressed.data(), size, decompressed.data(), data.size() + 1)) throw std::logic_error(name + ": too large buffer was accepted");
+	// too small buffer for compressed data
+	if (size > 1 && flatDb::compressLz4(data.data(), data.size(), compressed.data(), size - 1) != 0) throw std::logic_error(name + ": too small output buffer was accepted");
+	// truncated and corrupted input must be rejected or decompressed without crossing the buffer
+	for (unsigned i = 0; i < size && i < 256; ++i) {
+		flatDb::decompressLz4(compressed.data(), i, decompressed.data(), data.size());
+		std::vector<uint8_t> corrupted(compressed.begin(), compressed.begin() + size);
+		corrupted[(i * 7919) % size] ^= 0x5a;
+		flatDb::decompressLz4(corrupted.data(), size, decompressed.data(), data.size());
+	}
+	std::cout << name << ": " << data.size() << " -> " << size << " bytes, " << timer.get_time_ms() << " ms" << std::endl;
+}
+
+
+int main()
+{
+	std::mt19937 gen(1);
+	unsigned const pageSize = 256*1024;
+
+	test_roundTrip("empty", std::vector<uint8_t>());
+	for (unsigned size = 1; size < 40; ++size) test_roundTrip("short " + std::to_string(size), std::vector<uint8_t>(size, 'a' + size));
+
+	test_roundTrip("zeros", std::vector<uint8_t>(pageSize, 0));
+
+	std::vector<uint8_t> random(pageSize);
+	for (auto & b: random) b = gen();
+	test_roundTrip("random", random);
+
+	// records with small keys offsets, lengths and repeated identifiers, like in data pages
+	std::vector<uint8_t> records;
+	for (unsigned i = 0; records.size() + 32 < pageSize; ++i) {
+		records.push_back(i & 0xff);
+		records.push_back((i >> 8) & 0xff);
+		records.push_back(20);
+		for (unsigned j = 0; j < 20; ++j) records.push_back( (j < 12) ? (j * 3) : (gen() % 4) );
+	}
+	records.resize(pageSize, 0);
+	test_roundTrip("records", records);
+
+	// long matches with short offsets (overlapping copies)
+	std::vector<uint8_t> periodic(pageSize);
+	for (unsigned i = 0; i < pageSize; ++i) periodic[i] = "ACGTTGA"[i % 7];
+	test_roundTrip("periodic", periodic);
+
+	std::cout << "OK" << std::endl;
+	return 0;
+}
@@ -0,0 +1,113 @@
+#include "../apiDb/TasksManager.hpp"
+#include "../commonTools/Stopwatch.hpp"
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <cstdlib>
+
+TasksManager * tm;
+
+std::vector<unsigned long long> results;
+std::vector<char> completed;
+
+void test_function(unsigned outputIndex)
+{
+	unsigned long long a = 0;
+	unsigned long long b = 1;
+	unsigned const iterCount = 1024*1024;
+	for (unsigned iter = 2; iter <= iterCount; ++iter) {
+		unsigned long long c = (a + b) % 1024ull*1024*1024*1024*1024*1024;
+		a = b;
+		b = c;
+	}
+	results[outputIndex] = b;
+	completed[outputIndex] = 1;
+}
+
+int test(unsigned cores)
+{
+	tm = new TasksManager(cores);
+
+	std::vector<unsigned> tasksIds(results.size());
+
+	std::cout << "Test of " << cores << " cores: " << std::flush;
+	Stopwatch timer;
+	for (unsigned i = 0; i < results.size(); ++i) {
+		completed[i] = 0;
+		auto task = [i]() { test_function(i); };
+		tasksIds[i] = tm->addTask(task);
+	}
+
+	for (unsigned i = 0; i < tasksIds.size(); ++i) {
+		tm->joinTask(tasksIds[i]);
+		if ( ! completed[i] ) {
+			std::cerr << "The task number " << i << " was not completed after joinTask!" << std::endl;
+			return -1;
+		}
+	}
+
+	std::cout << timer.get_time_ms() << " ms";
+	TasksManager::Statistics stat = tm->readAndResetStatistics();
+	std::cout << " (tasks=" << stat.tasksCount << " stolen=" << stat.stolenTasksCount << " maxQueueDepth=" << stat.maxQueueDepth;
+	std::cout << " maxWaitTimeUs=" << stat.maxWaitTimeUs << ")" << std::endl;
+
+	for (unsigned i = 1; i < results.size(); ++i) {
+		if (results[i] != results[i-1]) {
+			std::cerr << "The result number " << i << " is incorrect!" << std::endl;
+			return -1;
+		}
+	}
+
+	delete tm;
+	return 0;
+}
+
+// tasks with higher priority must be started before tasks with lower priority
+int testPriorities()
+{
+	tm = new TasksManager(1);
+	std::atomic<unsigned> counter(0);
+	std::vector<unsigned> order(20);
+	// the first task blocks the only worker until all other tasks are added
+	std::atomic<bool> ready(false);
+	unsigned const firstTask = tm->addTask( [&]() { while (! ready) std::this_thread::yield(); }, 1000 );
+	for (unsigned i = 0; i < order.size(); ++i) {
+		tm->addTask( [&order,&counter,i]() { order[i] = counter++; }, 100 + i % 4 );
+	}
+	ready = true;
+	tm->joinTask(firstTask);
+	delete tm;
+	for (unsigned i = 0; i < order.size(); ++i) {
+		for (unsigned j = 0; j < order.size(); ++j) {
+			bool const shouldBeEarlier = (i % 4 > j % 4) || (i % 4 == j % 4 && i < j);
+			if (shouldBeEarlier && order[i] > order[j]) {
+				std::cerr << "Incorrect order of tasks " << i << " and " << j << std::endl;
+				return -1;
+			}
+		}
+	}
+	std::cout << "Priorities: OK" << std::endl;
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc != 2) {
+		std::cout << "Parameters: max_number_of_cores" << std::endl;
+		return 1;
+	}
+	if (testPriorities() != 0) return -1;
+	results.resize(2000);
+	completed.resize(results.size());
+	Stopwatch timer;
+	for (unsigned i = 0; i < results.size(); ++i) {
+		test_function(i);
+	}
+	std::cout << "Control time: " << timer.get_time_ms() << " ms" << std::endl;
+	unsigned cores = atoi(argv[1]);
+	for (unsigned i = 1; i <= cores; ++i) {
+		if (test(i) != 0) return -1;
+	}
+	return 0;
+}
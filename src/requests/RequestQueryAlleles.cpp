@@ -24,9 +24,9 @@ void RequestQueryAlleles::process()
 	};
 
 	if (fProteinAlleles) {
-		allelesDb->queryProteinVariants(callback, fRange.skip);
+		allelesDb->queryProteinVariants(callback, fRange.after, fRange.skip);
 	} else {
-		allelesDb->queryGenomicVariants(callback, fRange.skip);
+		allelesDb->queryGenomicVariants(callback, fRange.after, fRange.skip);
 	}
 }
 
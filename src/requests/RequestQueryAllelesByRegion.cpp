@@ -41,7 +41,15 @@ void RequestQueryAllelesByRegion::process()
 	for (auto const & e: ga.elements) {
 		if (fRange.limit == 0) break;
 		unsigned const chunkSize = std::min(fRange.limit, 1024u*1024u);
-		allelesDb->queryVariants(callback, fRange.skip, e.alignment.sourceRefId, e.alignment.sourceRegion().left(), e.alignment.sourceRegion().right(), chunkSize, fRange.limit);
+		if (fRange.after.isNull()) {
+			allelesDb->queryVariants(callback, fRange.skip, e.alignment.sourceRefId, e.alignment.sourceRegion().left(), e.alignment.sourceRegion().right(), chunkSize, fRange.limit);
+		} else if (allelesDb->queryVariants(callback, fRange.after, fRange.skip, e.alignment.sourceRefId, e.alignment.sourceRegion().left(), e.alignment.sourceRegion().right(), chunkSize, fRange.limit)) {
+			// the query was continued from the element with the last allele, the next elements are read from the beginning
+			fRange.after = ContinuationToken();
+		}
+	}
+	if ( fRange.limit > 0 && ! fRange.after.isNull() ) {
+		throw ExceptionIncorrectRequest("Allele given in continuation token does not belong to the queried region: " + fRange.after.toString());
 	}
 }
 
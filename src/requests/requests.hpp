@@ -15,6 +15,7 @@ struct ResultSubset {
 	static ResultSubset const all;
 	unsigned skip  = 0;
 	unsigned limit = std::numeric_limits<unsigned>::max();
+	ContinuationToken after;  // results start after this allele, skip is counted from there
 	ResultSubset() {}
 	ResultSubset(unsigned pSkip, unsigned pLimit) : skip(pSkip), limit(pLimit) {}
 	inline unsigned right() const { return ((std::numeric_limits<unsigned>::max()-skip > limit) ? (limit+skip) : (std::numeric_limits<unsigned>::max())); }
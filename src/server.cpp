@@ -271,6 +271,13 @@ int main(int argc, char** argv)
 		extractField(conf, configuration.allelesDatabase_path                  , {"allelesDatabase", "path"   } );
 		extractField(conf, configuration.allelesDatabase_threads               , {"allelesDatabase", "threads"} );
 		extractField(conf, configuration.allelesDatabase_ioTasks               , {"allelesDatabase", "ioTasks"} );
+		extractField(conf, configuration.allelesDatabase_walCheckpoint         , {"allelesDatabase", "walCheckpoint"} );
+		extractField(conf, configuration.allelesDatabase_ioUring               , {"allelesDatabase", "ioUring"} );
+		extractField(conf, configuration.allelesDatabase_readOnly              , {"allelesDatabase", "readOnly"} );
+		extractField(conf, configuration.allelesDatabase_cacheBudget           , {"allelesDatabase", "cacheBudget"} );
+		extractField(conf, configuration.allelesDatabase_hugePages             , {"allelesDatabase", "hugePages"} );
+		extractField(conf, configuration.allelesDatabase_warmUp                , {"allelesDatabase", "warmUp"} );
+		extractField(conf, configuration.allelesDatabase_compaction            , {"allelesDatabase", "compaction"} );
 		extractField(conf, configuration.allelesDatabase_cache_genomic         , {"allelesDatabase", "cache", "genomic"} );
 		extractField(conf, configuration.allelesDatabase_cache_protein         , {"allelesDatabase", "cache", "protein"} );
 		extractField(conf, configuration.allelesDatabase_cache_sequence        , {"allelesDatabase", "cache", "sequence"} );
@@ -280,6 +287,17 @@ int main(int argc, char** argv)
 		extractField(conf, configuration.allelesDatabase_cache_idClinVarVariant, {"allelesDatabase", "cache", "idClinVarVariant"} );
 		extractField(conf, configuration.allelesDatabase_cache_idDbSnp         , {"allelesDatabase", "cache", "idDbSnp"} );
 		extractField(conf, configuration.allelesDatabase_cache_idPa            , {"allelesDatabase", "cache", "idPa"} );
+		extractField(conf, configuration.allelesDatabase_cache_idTypes         , {"allelesDatabase", "cache", "idTypes"} );
+		extractField(conf, configuration.allelesDatabase_compression_genomic          , {"allelesDatabase", "compression", "genomic"} );
+		extractField(conf, configuration.allelesDatabase_compression_protein          , {"allelesDatabase", "compression", "protein"} );
+		extractField(conf, configuration.allelesDatabase_compression_sequence         , {"allelesDatabase", "compression", "sequence"} );
+		extractField(conf, configuration.allelesDatabase_compression_idCa             , {"allelesDatabase", "compression", "idCa"} );
+		extractField(conf, configuration.allelesDatabase_compression_idClinVarAllele  , {"allelesDatabase", "compression", "idClinVarAllele"} );
+		extractField(conf, configuration.allelesDatabase_compression_idClinVarRCV     , {"allelesDatabase", "compression", "idClinVarRCV"} );
+		extractField(conf, configuration.allelesDatabase_compression_idClinVarVariant , {"allelesDatabase", "compression", "idClinVarVariant"} );
+		extractField(conf, configuration.allelesDatabase_compression_idDbSnp          , {"allelesDatabase", "compression", "idDbSnp"} );
+		extractField(conf, configuration.allelesDatabase_compression_idPa             , {"allelesDatabase", "compression", "idPa"} );
+		extractField(conf, configuration.allelesDatabase_compression_idTypes          , {"allelesDatabase", "compression", "idTypes"} );
 
 		extractField(conf, configuration.logFile_path              , {"logFile", "path"} );
 